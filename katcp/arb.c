@@ -46,6 +46,7 @@ struct katcp_arb *create_type_arb_katcp(struct katcp_dispatch *d, char *name, un
   }
 
   a->a_fd = fd;
+  init_poll_katcp(&(a->a_interest));
 
   a->a_type = type;
 
@@ -132,6 +133,7 @@ static void destroy_arb_katcp(struct katcp_dispatch *d, struct katcp_arb *a)
   }
 
   if(a->a_fd >= 0){
+    release_poll_katcp(d->d_shared, &(a->a_interest), a->a_fd);
     close(a->a_fd);
     a->a_fd = (-1);
   }
@@ -151,6 +153,7 @@ int unlink_arb_katcp(struct katcp_dispatch *d, struct katcp_arb *a)
     case ARB_REAP_LIVE :
       
       if(a->a_fd >= 0){ /* release fd sooner */
+        release_poll_katcp(d->d_shared, &(a->a_interest), a->a_fd);
         close(a->a_fd);
         a->a_fd = (-1);
       }
@@ -281,7 +284,7 @@ struct katcp_arb *find_arb_katcp(struct katcp_dispatch *d, char *name)
 
 void load_arb_katcp(struct katcp_dispatch *d)
 {
-  unsigned int i;
+  unsigned int i, mask;
   struct katcp_shared *s;
   struct katcp_arb *a;
 
@@ -302,22 +305,19 @@ void load_arb_katcp(struct katcp_dispatch *d)
     switch(a->a_reap){
       case ARB_REAP_LIVE : 
         if(a->a_fd >= 0){
+          mask = 0;
           if(a->a_mode & KATCP_ARB_READ){
-            FD_SET(a->a_fd, &(s->s_read));
+            mask |= KATCP_POLL_READ;
           } 
           if(a->a_mode & KATCP_ARB_WRITE){
-            FD_SET(a->a_fd, &(s->s_write));
-          }
-
-          if(a->a_mode & (KATCP_ARB_WRITE | KATCP_ARB_READ)){
-            if(a->a_fd > s->s_max){ 
-              s->s_max = a->a_fd;
-            }
+            mask |= KATCP_POLL_WRITE;
           }
+          load_poll_katcp(s, &(a->a_interest), a->a_fd, mask);
         }
         i++;
         break;
       case ARB_REAP_FADE : 
+        load_poll_katcp(s, &(a->a_interest), a->a_fd, 0);
         mark_busy_katcp(d);
         i++;
         break;
@@ -366,10 +366,10 @@ int run_arb_katcp(struct katcp_dispatch *d)
 
           mode = 0;
 
-          if(FD_ISSET(fd, &(s->s_read))){
+          if(ready_poll_katcp(s, fd, KATCP_POLL_READ)){
             mode |= KATCP_ARB_READ;
           }
-          if(FD_ISSET(fd, &(s->s_write))){
+          if(ready_poll_katcp(s, fd, KATCP_POLL_WRITE)){
             mode |= KATCP_ARB_WRITE;
           }
 
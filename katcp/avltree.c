@@ -27,6 +27,187 @@ struct avl_tree *create_avltree()
 
   t->t_root = NULL;
 
+  t->t_slots = NULL;
+  t->t_mask  = 0;
+  t->t_count = 0;
+
+  return t;
+}
+
+/* hash index ***************************************************/
+
+#define AVL_INDEX_INITIAL  16
+
+static unsigned int hash_key_avltree(char *key)
+{
+  unsigned int h;
+
+  /* fnv-1a */
+  h = 2166136261U;
+  while (*key != '\0'){
+    h ^= (unsigned char)(*key);
+    h *= 16777619U;
+    key++;
+  }
+
+  return h;
+}
+
+static void place_index_avltree(struct avl_slot *slots, unsigned int mask, unsigned int hash, struct avl_node *n)
+{
+  unsigned int i;
+
+  for (i = hash & mask; slots[i].s_node != NULL; i = (i + 1) & mask);
+
+  slots[i].s_hash = hash;
+  slots[i].s_node = n;
+}
+
+static int resize_index_avltree(struct avl_tree *t, unsigned int size)
+{
+  struct avl_slot *slots;
+  unsigned int i;
+
+  slots = calloc(size, sizeof(struct avl_slot));
+  if (slots == NULL)
+    return -1;
+
+  if (t->t_slots){
+    for (i = 0; i <= t->t_mask; i++){
+      if (t->t_slots[i].s_node){
+        place_index_avltree(slots, size - 1, t->t_slots[i].s_hash, t->t_slots[i].s_node);
+      }
+    }
+    free(t->t_slots);
+  }
+
+  t->t_slots = slots;
+  t->t_mask  = size - 1;
+
+  return 0;
+}
+
+static void drop_index_avltree(struct avl_tree *t)
+{
+  if (t->t_slots){
+    free(t->t_slots);
+  }
+
+  t->t_slots = NULL;
+  t->t_mask  = 0;
+  t->t_count = 0;
+}
+
+static int insert_index_avltree(struct avl_tree *t, struct avl_node *n)
+{
+  /* keep the load below 3/4 */
+  if (((t->t_count + 1) * 4) > ((t->t_mask + 1) * 3)){
+    if (resize_index_avltree(t, (t->t_mask + 1) * 2) < 0)
+      return -1;
+  }
+
+  place_index_avltree(t->t_slots, t->t_mask, hash_key_avltree(n->n_key), n);
+  t->t_count++;
+
+  return 0;
+}
+
+static void remove_index_avltree(struct avl_tree *t, struct avl_node *n)
+{
+  unsigned int i, j, k;
+
+  for (i = hash_key_avltree(n->n_key) & t->t_mask; t->t_slots[i].s_node != n; i = (i + 1) & t->t_mask){
+    if (t->t_slots[i].s_node == NULL){
+#ifdef KATCP_CONSISTENCY_CHECKS
+      fprintf(stderr, "avl_tree: node <%s> missing from index\n", n->n_key);
+      abort();
+#endif
+      return;
+    }
+  }
+
+  /* backward shift, so that no tombstones are needed */
+  j = i;
+  for (;;){
+    j = (j + 1) & t->t_mask;
+    if (t->t_slots[j].s_node == NULL)
+      break;
+
+    k = t->t_slots[j].s_hash & t->t_mask;
+    if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+      continue;
+
+    t->t_slots[i] = t->t_slots[j];
+    i = j;
+  }
+
+  t->t_slots[i].s_node = NULL;
+  t->t_count--;
+}
+
+static struct avl_node *lookup_index_avltree(struct avl_tree *t, char *key)
+{
+  struct avl_slot *s;
+  unsigned int h, i;
+
+  h = hash_key_avltree(key);
+
+  for (i = h & t->t_mask; (s = &(t->t_slots[i]))->s_node != NULL; i = (i + 1) & t->t_mask){
+    if ((s->s_hash == h) && (strcmp(s->s_node->n_key, key) == 0)){
+      return s->s_node;
+    }
+  }
+
+  return NULL;
+}
+
+static int index_subtree_avltree(struct avl_tree *t, struct avl_node *n)
+{
+  if (n == NULL)
+    return 0;
+
+  if (insert_index_avltree(t, n) < 0)
+    return -1;
+
+  if (index_subtree_avltree(t, n->n_left) < 0)
+    return -1;
+
+  return index_subtree_avltree(t, n->n_right);
+}
+
+/* opt a tree into hashed lookups, worth it for trees which are searched far more than walked */
+int index_avltree(struct avl_tree *t)
+{
+  if (t == NULL)
+    return -1;
+
+  if (t->t_slots)
+    return 0;
+
+  if (resize_index_avltree(t, AVL_INDEX_INITIAL) < 0)
+    return -1;
+
+  if (index_subtree_avltree(t, t->t_root) < 0){
+    drop_index_avltree(t);
+    return -1;
+  }
+
+  return 0;
+}
+
+struct avl_tree *create_indexed_avltree()
+{
+  struct avl_tree *t;
+
+  t = create_avltree();
+  if (t == NULL)
+    return NULL;
+
+  if (index_avltree(t) < 0){
+    free(t);
+    return NULL;
+  }
+
   return t;
 }
 
@@ -695,7 +876,7 @@ struct avl_node *rebalance_avltree(struct avl_node *n)
   return c;
 }
 
-int add_node_avltree(struct avl_tree *t, struct avl_node *n)
+static int link_node_avltree(struct avl_tree *t, struct avl_node *n)
 {
   struct avl_node *c;
   int cmp, run, flag;
@@ -824,6 +1005,21 @@ int add_node_avltree(struct avl_tree *t, struct avl_node *n)
 
 }
 
+int add_node_avltree(struct avl_tree *t, struct avl_node *n)
+{
+  if (link_node_avltree(t, n) < 0)
+    return -1;
+
+  if (t->t_slots){
+    if (insert_index_avltree(t, n) < 0){
+      /* the tree is still complete, so fall back to it */
+      drop_index_avltree(t);
+    }
+  }
+
+  return 0;
+}
+
 /* WARNING: using a datastructure to hold a function pointer might be a bit excessive - *global could have been the function pointer too ... */
 
 struct free_reducer{
@@ -902,6 +1098,9 @@ int del_node_complex_avltree(struct avl_tree *t, struct avl_node *n, void *globa
   if (n == NULL)
     return -2;
 
+  if (t->t_slots)
+    remove_index_avltree(t, n);
+
   run = 1;
   flag = 0;
   if (n->n_right == NULL){
@@ -1125,6 +1324,9 @@ struct avl_node *find_name_node_avltree(struct avl_tree *t, char *key)
   
   if (t == NULL)
     return NULL;
+
+  if (t->t_slots)
+    return lookup_index_avltree(t, key);
   
   c = t->t_root;
 
@@ -1268,8 +1470,10 @@ void destroy_complex_avltree(struct avl_tree *t, void *global, void (*complex_fr
     }
   }
 
-  if (t != NULL)
+  if (t != NULL){
+    drop_index_avltree(t);
     free(t);
+  }
 }
 
 void destroy_avltree(struct avl_tree *t, void (*d_free)(void *))
@@ -1383,6 +1587,99 @@ int add_file_words_to_avltree(struct avl_tree *t, char *buffer, int bsize)
   return 0;
 }
 
+static double elapsed_avltree(struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return ((now.tv_sec - start->tv_sec) * 1000000.0) + (now.tv_usec - start->tv_usec);
+}
+
+static int bench_avltree(unsigned int count)
+{
+  struct avl_tree *plain, *indexed;
+  char **keys, buffer[32];
+  unsigned int i, j, rounds, total;
+  struct timeval start;
+  double insert[2], lookup[2];
+
+  keys = malloc(sizeof(char *) * count);
+  if (keys == NULL)
+    return -1;
+
+  for (i = 0; i < count; i++){
+    /* multiplicative scramble keeps keys unique but out of order */
+    snprintf(buffer, sizeof(buffer), "sensor.%08x.value", i * 2654435761U);
+    keys[i] = strdup(buffer);
+  }
+
+  plain = create_avltree();
+  indexed = create_indexed_avltree();
+  if ((plain == NULL) || (indexed == NULL))
+    return -1;
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < count; i++){
+    store_named_node_avltree(plain, keys[i], keys[i]);
+  }
+  insert[0] = elapsed_avltree(&start);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < count; i++){
+    store_named_node_avltree(indexed, keys[i], keys[i]);
+  }
+  insert[1] = elapsed_avltree(&start);
+
+  rounds = (count < 1000000) ? (1000000 / count) : 1;
+  total = rounds * count;
+
+  gettimeofday(&start, NULL);
+  for (j = 0; j < rounds; j++){
+    for (i = 0; i < count; i++){
+      if (find_data_avltree(plain, keys[i]) == NULL){
+        fprintf(stderr, "avl_tree: lost key %s in plain tree\n", keys[i]);
+        return -1;
+      }
+    }
+  }
+  lookup[0] = elapsed_avltree(&start);
+
+  gettimeofday(&start, NULL);
+  for (j = 0; j < rounds; j++){
+    for (i = 0; i < count; i++){
+      if (find_data_avltree(indexed, keys[i]) == NULL){
+        fprintf(stderr, "avl_tree: lost key %s in indexed tree\n", keys[i]);
+        return -1;
+      }
+    }
+  }
+  lookup[1] = elapsed_avltree(&start);
+
+  /* drop every other key, the remainder has to stay reachable */
+  for (i = 0; i < count; i += 2){
+    del_name_node_avltree(indexed, keys[i], NULL);
+  }
+  for (i = 0; i < count; i++){
+    if ((find_data_avltree(indexed, keys[i]) != NULL) != ((i % 2) != 0)){
+      fprintf(stderr, "avl_tree: index disagrees with tree for %s\n", keys[i]);
+      return -1;
+    }
+  }
+
+  printf("avl_tree: %u keys insert %.3f vs %.3fus, lookup %.3f vs %.3fus (tree vs indexed, per key)\n", count, insert[0] / count, insert[1] / count, lookup[0] / total, lookup[1] / total);
+
+  destroy_avltree(plain, NULL);
+  destroy_avltree(indexed, NULL);
+
+  for (i = 0; i < count; i++){
+    free(keys[i]);
+  }
+  free(keys);
+
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   struct avl_tree *tree;
@@ -1443,6 +1740,9 @@ int main(int argc, char *argv[])
 
 #endif 
 
+  if ((bench_avltree(100) < 0) || (bench_avltree(10000) < 0) || (bench_avltree(1000000) < 0))
+    return 1;
+
 #if 1 
   tree = create_avltree();
   
@@ -20,8 +20,19 @@ extern "C" {
 #define WALK_PUSH       1
 #define WALK_POP        2
 
+/* optional open addressing index over the nodes of a tree, 
+ * see create_indexed_avltree, the tree remains the ordered view */
+struct avl_slot {
+  unsigned int s_hash;
+  struct avl_node *s_node;
+};
+
 struct avl_tree {
   struct avl_node *t_root;
+
+  struct avl_slot *t_slots;
+  unsigned int t_mask;
+  unsigned int t_count;
 };
 
 struct avl_node {
@@ -42,6 +53,8 @@ struct avl_node_list {
 };
 
 struct avl_tree *create_avltree();
+struct avl_tree *create_indexed_avltree();
+int index_avltree(struct avl_tree *t);
 struct avl_node *create_node_avltree(char *key, void *data);
 int add_node_avltree(struct avl_tree *t, struct avl_node *n);
 int del_node_avltree(struct avl_tree *t, struct avl_node *n, void (*d_free)(void *));
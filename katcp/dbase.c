@@ -943,6 +943,11 @@ struct katcp_tag *create_tag_katcp(char *name, int level)
   t->t_tobject_root = NULL;
   t->t_tobject_count = 0;
 
+  t->t_postings = NULL;
+  t->t_posting_count = 0;
+  t->t_posting_size = 0;
+  t->t_sorted = 1;
+
 #if 0
   t->t_memb = NULL;
   t->t_memb_count = 0;
@@ -963,6 +968,7 @@ void destroy_tag_katcp(void *data)
 #if 0
   if (t->t_memb != NULL) free(t->t_memb);
 #endif
+  if (t->t_postings != NULL) free(t->t_postings);
   if (t->t_tobject_root != NULL) 
     tdestroy(t->t_tobject_root, &destroy_tobject_katcp);
 
@@ -1070,6 +1076,11 @@ int tag_tobject_katcp(struct katcp_dispatch *d, struct katcp_tag *t, struct katc
     return -1;
   }
 
+  if (add_posting_tag_katcp(t, to) < 0){
+    tdelete((void *) to, &(t->t_tobject_root), &compare_tobject_katcp);
+    return -1;
+  }
+
   t->t_tobject_count++;
   
   return 0;
@@ -1102,251 +1113,263 @@ int tag_data_katcp(struct katcp_dispatch *d, struct katcp_tag *t, void *data, st
   return 0;
 }
 
-static struct katcp_tobject **__tobjs;
-static int __tcount;
+/***************************[postings]**************************/
 
-static void __collect_from_tag(const void *nodep, const VISIT which, const int depth)
+/* each tag keeps a flat array of its tobjects next to the tree. Appends
+ * are cheap, the array is only sorted (by data pointer, the order the
+ * tree uses) once a search needs it, so bulk tagging stays linear */
+
+#define POSTING_INITIAL 16
+
+static int compare_posting_katcp(const void *m1, const void *m2)
 {
-  struct katcp_tobject *to;
+  const struct katcp_tobject *a, *b;
 
-  to = *(struct katcp_tobject **) nodep;
-  if (to == NULL)
+  a = *(struct katcp_tobject * const *) m1;
+  b = *(struct katcp_tobject * const *) m2;
+
+  if (a->o_data > b->o_data)
+    return 1;
+  else if (a->o_data < b->o_data)
+    return -1;
+
+  return 0;
+}
+
+static void sort_postings_tag_katcp(struct katcp_tag *t)
+{
+  if (t->t_sorted)
     return;
 
-  switch (which){
-    case leaf:
-    case postorder:
-      if (__tobjs == NULL)
-        return;
-      __tobjs[__tcount] = to;
-      __tcount++;
-      break;
-    case preorder:
-    case endorder:
-      break;
-  }
+  qsort(t->t_postings, t->t_posting_count, sizeof(struct katcp_tobject *), &compare_posting_katcp);
+
+  t->t_sorted = 1;
 }
 
-int search_katcp(struct katcp_dispatch *d, struct katcl_parse *p)
+int add_posting_tag_katcp(struct katcp_tag *t, struct katcp_tobject *to)
 {
-  struct katcp_stack *tags, *ans; 
-  struct katcp_type *tagtype;
-  char *tag;
-  int i, j, count, *dsize, *di, run, seen;
-  struct katcp_tobject ***data, *to;
-  struct katcp_tag *t;
-  struct timeval ts, te, delta;
-  void *min;
-  
-  t = NULL;
+  struct katcp_tobject **tmp;
+  int size;
 
-  gettimeofday(&ts, NULL);
-  
-  count = get_count_parse_katcl(p);
-  tagtype = find_name_type_katcp(d, KATCP_TYPE_TAG);
+  if (t == NULL || to == NULL)
+    return -1;
 
-  if (tagtype == NULL)
+  if (t->t_posting_count >= t->t_posting_size){
+    size = (t->t_posting_size > 0) ? (t->t_posting_size * 2) : POSTING_INITIAL;
+    tmp = realloc(t->t_postings, sizeof(struct katcp_tobject *) * size);
+    if (tmp == NULL)
+      return -1;
+    t->t_postings = tmp;
+    t->t_posting_size = size;
+  }
+
+  if (t->t_sorted && (t->t_posting_count > 0) && (t->t_postings[t->t_posting_count - 1]->o_data > to->o_data))
+    t->t_sorted = 0;
+
+  t->t_postings[t->t_posting_count] = to;
+  t->t_posting_count++;
+
+  return 0;
+}
+
+int del_posting_tag_katcp(struct katcp_tag *t, struct katcp_tobject *to)
+{
+  struct katcp_tobject **val;
+  int i;
+
+  if (t == NULL || to == NULL)
     return -1;
-  
-  tags = create_stack_katcp();
-  if (tags == NULL)
+
+  sort_postings_tag_katcp(t);
+
+  val = bsearch(&to, t->t_postings, t->t_posting_count, sizeof(struct katcp_tobject *), &compare_posting_katcp);
+  if (val == NULL)
     return -1;
 
-  for (i=1; i<count; i++){
-   
-    tag = get_string_parse_katcl(p, i);
-    if (push_stack_katcp(tags, search_type_katcp(d, tagtype, tag, NULL), tagtype) < 0){
-#ifdef DEBUG
-      fprintf(stderr, "search: cannot find tag <%s>\n", tag);
-#endif
-      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "search tag %s doesn't exist", tag);
-    }
+  i = val - t->t_postings;
+  t->t_posting_count--;
+  memmove(&(t->t_postings[i]), &(t->t_postings[i + 1]), sizeof(struct katcp_tobject *) * (t->t_posting_count - i));
 
-  }
+  return 0;
+}
 
-#if 0
-  print_stack_katcp(d, tags); 
-#endif
+/* return the first position at or after from whose data is not below key */
+static int gallop_postings_katcp(struct katcp_tobject **v, int count, int from, void *key)
+{
+  int low, high, mid, step;
 
-  count = sizeof_stack_katcp(tags);
+  if ((from >= count) || (v[from]->o_data >= key))
+    return from;
 
-  if (count == 0){
-    destroy_stack_katcp(tags);
-    return -1;
+  /* v[low] is known to be below key */
+  low = from;
+  step = 1;
+  while (((low + step) < count) && (v[low + step]->o_data < key)){
+    low += step;
+    step *= 2;
   }
 
-  ans = create_stack_katcp();
+  high = low + step;
+  if (high > count)
+    high = count;
 
-  dsize = malloc(sizeof(int) * count);
-  if (dsize == NULL){
-    destroy_stack_katcp(tags);
-    destroy_stack_katcp(ans);
-    return -1;
+  while ((high - low) > 1){
+    mid = low + ((high - low) / 2);
+    if (v[mid]->o_data < key){
+      low = mid;
+    } else {
+      high = mid;
+    }
   }
 
-  di = malloc(sizeof(int) * count);
-  if (di == NULL){
-    if (dsize)
-      free(dsize);
-    destroy_stack_katcp(tags);
-    destroy_stack_katcp(ans);
+  return high;
+}
+
+/* calls back for each tobject present in all tags, in data order, returns the match count */
+int intersect_tags_katcp(struct katcp_tag **vector, int count, int (*call)(struct katcp_tobject *to, void *data), void *data)
+{
+  struct katcp_tag *t;
+  int i, j, matched, *cursor;
+  void *key;
+
+  if (vector == NULL || count <= 0)
     return -1;
+
+  for (i = 0; i < count; i++){
+    if (vector[i] == NULL)
+      return -1;
+    sort_postings_tag_katcp(vector[i]);
   }
 
-  data = malloc(sizeof(struct katcp_tobject **) * count);
-  if (data == NULL){
-    if (dsize)
-      free(dsize);
-    if (di)
-      free(di);
-    destroy_stack_katcp(tags);
-    destroy_stack_katcp(ans);
+  /* smallest tag first, it bounds the number of candidates */
+  for (i = 1; i < count; i++){
+    t = vector[i];
+    for (j = i; (j > 0) && (vector[j - 1]->t_posting_count > t->t_posting_count); j--){
+      vector[j] = vector[j - 1];
+    }
+    vector[j] = t;
+  }
+
+  cursor = malloc(sizeof(int) * count);
+  if (cursor == NULL)
     return -1;
+
+  for (i = 0; i < count; i++){
+    cursor[i] = 0;
   }
 
-  for (i=0; i<count; i++){
-    t = index_data_stack_katcp(tags, i);
-    if (t){
-      dsize[i] = get_count_tag_katcp(t);
-      data[i] = malloc(sizeof(struct katcp_tobject *) * dsize[i]);
-      if (data[i]){
-        
-        __tobjs   = data[i];  
-        __tcount  = 0;
-        
-        if (t->t_tobject_root != NULL)
-          twalk(t->t_tobject_root, &__collect_from_tag);
-        
-#if DEBUG >1
-        fprintf(stderr,"i:%d t:(%p) [ ", i, t);
-        for (j=0; j<dsize[i]; j++)
-          fprintf(stderr,"(%p) ", (data[i][j])->o_data);
-        fprintf(stderr,"]\n");
-#endif
+  matched = 0;
 
+  while (cursor[0] < vector[0]->t_posting_count){
+    key = vector[0]->t_postings[cursor[0]]->o_data;
+
+    for (i = 1; i < count; i++){
+      t = vector[i];
+      cursor[i] = gallop_postings_katcp(t->t_postings, t->t_posting_count, cursor[i], key);
+      if (cursor[i] >= t->t_posting_count){
+        free(cursor);
+        return matched;
       }
+      if (t->t_postings[cursor[i]]->o_data != key)
+        break;
+    }
+
+    if (i >= count){
+      if (call)
+        (*call)(vector[0]->t_postings[cursor[0]], data);
+      matched++;
+      cursor[0]++;
+    } else {
+      /* leapfrog the smallest tag to the first candidate the mismatch allows */
+      cursor[0] = gallop_postings_katcp(vector[0]->t_postings, vector[0]->t_posting_count, cursor[0] + 1, vector[i]->t_postings[cursor[i]]->o_data);
     }
   }
-  
 
-  bzero(di, sizeof(int) * count);
+  free(cursor);
 
-  run  = 1;
-  min  = NULL;
-  seen = 0;
-  to = NULL;
+  return matched;
+}
 
-  while (run) {
-    
-    for(i=0; i<count; i++){
-      
-#if DEBUG>1
-      fprintf(stderr, "i:%d ", i);
-#endif
+static int collect_answer_katcp(struct katcp_tobject *to, void *data)
+{
+  struct katcp_stack *ans;
 
-      if (di[i] < dsize[i] && data[i][di[i]] != NULL){
-       
-        if(min == NULL){
-          t = index_data_stack_katcp(tags, i);
-          min = (data[i][di[i]])->o_data;
-          to = data[i][di[i]];
-          seen = 1;
-#if DEBUG >1
-          fprintf(stderr, "NULL setting t:(%p) min:(%p) ", t, min);
-#endif
-        } else if (min == (data[i][di[i]])->o_data && t != index_data_stack_katcp(tags, i)) {
-          seen++;
-#if DEBUG >1
-          fprintf(stderr, "seen: %d ", seen);
-#endif
-        } else if (min < (data[i][di[i]])->o_data) {
-          t = index_data_stack_katcp(tags, i);
-          min = (data[i][di[i]])->o_data;
-          to = data[i][di[i]];
-          seen = 1;
-#if DEBUG >1
-          fprintf(stderr, "NEW MIN setting t:(%p) min:(%p) ", t, min);
-#endif
-        } else if (min > (data[i][di[i]])->o_data){
-          (di[i])++;
-#if DEBUG >1
-          fprintf(stderr, "di[%d] %d ", i, di[i]);
-#endif
-        } else if (t == index_data_stack_katcp(tags, i)){
-#if DEBUG >1
-          fprintf(stderr, "original ");
-#endif
-          if (seen >= count){
-#if DEBUG >1
-            fprintf(stderr, "FOUND match\n");
-#endif
-            if (push_tobject_katcp(ans, copy_tobject_katcp(to)) < 0){
-#if DEBUG >1  
-              fprintf(stderr, "search: error could not push an answer onto stack\n");
-#endif
-            }
+  ans = data;
 
-            to  = NULL;
-            min = NULL;
-            seen = 0;
-            (di[i])++;
+  if (push_tobject_katcp(ans, copy_tobject_katcp(to)) < 0){
 #if DEBUG >1
-            fprintf(stderr, "reset all and di[%d] %d ", i, di[i]);
+    fprintf(stderr, "search: error could not push an answer onto stack\n");
 #endif
-          }
+    return -1;
+  }
 
-        }
+  return 0;
+}
 
+int search_katcp(struct katcp_dispatch *d, struct katcl_parse *p)
+{
+  struct katcp_stack *ans;
+  struct katcp_type *tagtype;
+  struct katcp_tag **vector, *t;
+  struct timeval ts, te, delta;
+  char *tag;
+  int i, count, found, matched;
 
-      
-      } else {
-        run = 0;
-#if DEBUG >1
-        fprintf(stderr, "the end");
-#endif
-      }
+  gettimeofday(&ts, NULL);
 
-#if DEBUG >1
-      fprintf(stderr, "\n");
-#endif
+  count = get_count_parse_katcl(p);
+  tagtype = find_name_type_katcp(d, KATCP_TYPE_TAG);
 
-    }
-#if 0
-    if (seen >= count){
-      run = 0;
+  if (tagtype == NULL)
+    return -1;
 
-    }
+  if (count < 2)
+    return -1;
+
+  vector = malloc(sizeof(struct katcp_tag *) * (count - 1));
+  if (vector == NULL)
+    return -1;
+
+  found = 0;
+
+  for (i=1; i<count; i++){
+    tag = get_string_parse_katcl(p, i);
+    t = search_type_katcp(d, tagtype, tag, NULL);
+    if (t == NULL){
+#ifdef DEBUG
+      fprintf(stderr, "search: cannot find tag <%s>\n", tag);
 #endif
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "search tag %s doesn't exist", tag);
+    } else {
+      vector[found++] = t;
+    }
   }
-  
+
+  if (found == 0){
+    free(vector);
+    return -1;
+  }
+
+  ans = create_stack_katcp();
+  if (ans == NULL){
+    free(vector);
+    return -1;
+  }
+
+  matched = intersect_tags_katcp(vector, found, &collect_answer_katcp, ans);
+
   gettimeofday(&te, NULL);
 
-  sub_time_katcp(&delta, &te, &ts); 
+  sub_time_katcp(&delta, &te, &ts);
 
   print_stack_katcp(d, ans);
 
-  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "search took %lu%06lu\xC2\xB5s", delta.tv_sec, delta.tv_usec);
-  
-  if (dsize)
-    free(dsize);
-
-  if (di)
-    free(di);
+  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "search of %d tags matched %d in %lu%06lu\xC2\xB5s", found, matched, delta.tv_sec, delta.tv_usec);
 
-  for (i=0; i<count; i++){
-    if (data[i])
-      free(data[i]);
-  }
-  if (data)
-    free(data);
-  
-  destroy_stack_katcp(tags);
+  free(vector);
   destroy_stack_katcp(ans);
 
-  __tobjs  = NULL;
-  __tcount = 0;
-  
-  return 0;
+  return (matched < 0) ? -1 : 0;
 }
 
 int search_cmd_katcp(struct katcp_dispatch *d, int argc)
@@ -1367,5 +1390,287 @@ int search_cmd_katcp(struct katcp_dispatch *d, int argc)
   
   return KATCP_RESULT_OK;
 }
+#ifdef UNIT_TEST_DBASE
+
+#define ITEMS   100000
+#define QUERIES   2000
+#define FORMATS      4
+#define DECADES      8
+#define GENRES      20
+#define ARTISTS   1000
+
+struct media_item {
+  int m_format;
+  int m_decade;
+  int m_genre;
+  int m_artist;
+  int m_starred;
+};
+
+/* the column copy baseline, as search used to do it */
+static struct katcp_tobject **copy_tobjs;
+static int copy_count;
+
+static void copy_from_tag(const void *nodep, const VISIT which, const int depth)
+{
+  switch (which){
+    case leaf:
+    case postorder:
+      copy_tobjs[copy_count++] = *(struct katcp_tobject **) nodep;
+      break;
+    default :
+      break;
+  }
+}
+
+static int copy_search(struct katcp_tag **vector, int count)
+{
+  struct katcp_tobject ***data;
+  int i, j, *di, matched;
+  void *key;
+
+  data = malloc(sizeof(struct katcp_tobject **) * count);
+  di = malloc(sizeof(int) * count);
+
+  for (i = 0; i < count; i++){
+    data[i] = malloc(sizeof(struct katcp_tobject *) * vector[i]->t_tobject_count);
+    copy_tobjs = data[i];
+    copy_count = 0;
+    twalk(vector[i]->t_tobject_root, &copy_from_tag);
+    di[i] = 0;
+  }
+
+  matched = 0;
+  for (;;){
+    key = NULL;
+    for (i = 0; i < count; i++){
+      if (di[i] >= vector[i]->t_tobject_count)
+        goto done;
+      if (data[i][di[i]]->o_data > key)
+        key = data[i][di[i]]->o_data;
+    }
+    for (j = 0, i = 0; i < count; i++){
+      while ((di[i] < vector[i]->t_tobject_count) && (data[i][di[i]]->o_data < key))
+        di[i]++;
+      if ((di[i] < vector[i]->t_tobject_count) && (data[i][di[i]]->o_data == key))
+        j++;
+    }
+    if (j == count){
+      matched++;
+      for (i = 0; i < count; i++)
+        di[i]++;
+    }
+  }
+
+done:
+  for (i = 0; i < count; i++)
+    free(data[i]);
+  free(data);
+  free(di);
+
+  return matched;
+}
+
+static void *check_last;
+
+static int check_match(struct katcp_tobject *to, void *data)
+{
+  int *seen;
+
+  seen = data;
+
+  if (to->o_data <= check_last){
+    fprintf(stderr, "dbase: match %p out of order\n", to->o_data);
+    exit(1);
+  }
+  check_last = to->o_data;
+
+  (*seen)++;
+
+  return 0;
+}
+
+static double elapsed_dbase(struct timeval *start)
+{
+  struct timeval now, delta;
+
+  gettimeofday(&now, NULL);
+  sub_time_katcp(&delta, &now, start);
+
+  return (delta.tv_sec * 1000000.0) + delta.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+  struct media_item *items, *m;
+  struct katcp_tag *formats[FORMATS], *decades[DECADES], *genres[GENRES], *artists[ARTISTS], *starred, *vector[4];
+  struct katcp_tag **all[4];
+  struct timeval start;
+  char name[32];
+  int i, j, k, count, expect, seen, total, dims[4];
+  double fast, slow;
+
+  srand(0);
+
+  items = malloc(sizeof(struct media_item) * ITEMS);
+  if (items == NULL)
+    return 1;
+
+  for (i = 0; i < FORMATS; i++){ snprintf(name, sizeof(name), "format%d", i); formats[i] = create_tag_katcp(name, 0); }
+  for (i = 0; i < DECADES; i++){ snprintf(name, sizeof(name), "decade%d", i); decades[i] = create_tag_katcp(name, 0); }
+  for (i = 0; i < GENRES;  i++){ snprintf(name, sizeof(name), "genre%d",  i); genres[i]  = create_tag_katcp(name, 0); }
+  for (i = 0; i < ARTISTS; i++){ snprintf(name, sizeof(name), "artist%d", i); artists[i] = create_tag_katcp(name, 0); }
+  starred = create_tag_katcp("starred", 0);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < ITEMS; i++){
+    m = &(items[i]);
+    m->m_format  = rand() % FORMATS;
+    m->m_decade  = rand() % DECADES;
+    m->m_genre   = rand() % GENRES;
+    m->m_artist  = rand() % ARTISTS;
+    m->m_starred = (rand() % 10) == 0;
+
+    if ((tag_data_katcp(NULL, formats[m->m_format], m, NULL) < 0) ||
+        (tag_data_katcp(NULL, decades[m->m_decade], m, NULL) < 0) ||
+        (tag_data_katcp(NULL, genres[m->m_genre], m, NULL) < 0) ||
+        (tag_data_katcp(NULL, artists[m->m_artist], m, NULL) < 0) ||
+        (m->m_starred && (tag_data_katcp(NULL, starred, m, NULL) < 0))){
+      fprintf(stderr, "dbase: unable to tag item %d\n", i);
+      return 1;
+    }
+  }
+  printf("dbase: indexed %d items in %.1fms\n", ITEMS, elapsed_dbase(&start) / 1000.0);
+
+  all[0] = formats; dims[0] = FORMATS;
+  all[1] = decades; dims[1] = DECADES;
+  all[2] = genres;  dims[2] = GENRES;
+  all[3] = artists; dims[3] = ARTISTS;
+
+  /* correctness: every query agrees with a scan over the items */
+  for (k = 0; k < 200; k++){
+    count = 1 + (rand() % 4);
+    for (j = 0; j < count; j++){
+      vector[j] = all[j][rand() % dims[j]];
+    }
+    if (k % 2)
+      vector[count - 1] = starred;
+
+    expect = 0;
+    for (i = 0; i < ITEMS; i++){
+      m = &(items[i]);
+      for (j = 0; j < count; j++){
+        if (tfind(&(struct katcp_tobject){ m, NULL, 0 }, &(vector[j]->t_tobject_root), &compare_tobject_katcp) == NULL)
+          break;
+      }
+      if (j >= count)
+        expect++;
+    }
+
+    seen = 0;
+    check_last = NULL;
+    if ((intersect_tags_katcp(vector, count, &check_match, &seen) != expect) || (seen != expect)){
+      fprintf(stderr, "dbase: query %d over %d tags matched %d, expected %d\n", k, count, seen, expect);
+      return 1;
+    }
+    if (copy_search(vector, count) != expect){
+      fprintf(stderr, "dbase: baseline disagrees on query %d\n", k);
+      return 1;
+    }
+  }
+  printf("dbase: 200 random queries agree with a linear scan\n");
+
+  /* removal keeps the postings consistent with the tree */
+  for (i = 0; i < ITEMS; i += 3){
+    m = &(items[i]);
+    if (del_posting_tag_katcp(genres[m->m_genre], &(struct katcp_tobject){ m, NULL, 0 }) < 0){
+      fprintf(stderr, "dbase: unable to remove item %d from genre\n", i);
+      return 1;
+    }
+  }
+  for (i = 0, expect = 0; i < ITEMS; i++){
+    if ((items[i].m_genre == 0) && (i % 3))
+      expect++;
+  }
+  if (intersect_tags_katcp(&(genres[0]), 1, NULL, NULL) != expect){
+    fprintf(stderr, "dbase: removal left inconsistent postings\n");
+    return 1;
+  }
+  for (i = 0; i < ITEMS; i += 3){
+    m = &(items[i]);
+    add_posting_tag_katcp(genres[m->m_genre], *(struct katcp_tobject **) tfind(&(struct katcp_tobject){ m, NULL, 0 }, &(genres[m->m_genre]->t_tobject_root), &compare_tobject_katcp));
+  }
+
+  /* benchmark: format + genre + decade (+ starred) style queries */
+  total = 0;
+  gettimeofday(&start, NULL);
+  for (k = 0; k < QUERIES; k++){
+    vector[0] = formats[k % FORMATS];
+    vector[1] = genres[k % GENRES];
+    vector[2] = decades[k % DECADES];
+    vector[3] = starred;
+    total += copy_search(vector, 3 + (k % 2));
+  }
+  slow = elapsed_dbase(&start) / QUERIES;
+
+  seen = 0;
+  gettimeofday(&start, NULL);
+  for (k = 0; k < QUERIES; k++){
+    vector[0] = formats[k % FORMATS];
+    vector[1] = genres[k % GENRES];
+    vector[2] = decades[k % DECADES];
+    vector[3] = starred;
+    seen += intersect_tags_katcp(vector, 3 + (k % 2), NULL, NULL);
+  }
+  fast = elapsed_dbase(&start) / QUERIES;
+
+  if (seen != total){
+    fprintf(stderr, "dbase: benchmark totals differ %d != %d\n", seen, total);
+    return 1;
+  }
+
+  printf("dbase: broad queries: copy and merge %.1fus, postings %.1fus (%.1fx)\n", slow, fast, slow / fast);
+
+  /* narrow queries: an artist combined with big tags */
+  total = 0;
+  gettimeofday(&start, NULL);
+  for (k = 0; k < QUERIES; k++){
+    vector[0] = formats[k % FORMATS];
+    vector[1] = decades[k % DECADES];
+    vector[2] = artists[k % ARTISTS];
+    total += copy_search(vector, 3);
+  }
+  slow = elapsed_dbase(&start) / QUERIES;
+
+  seen = 0;
+  gettimeofday(&start, NULL);
+  for (k = 0; k < QUERIES; k++){
+    vector[0] = formats[k % FORMATS];
+    vector[1] = decades[k % DECADES];
+    vector[2] = artists[k % ARTISTS];
+    seen += intersect_tags_katcp(vector, 3, NULL, NULL);
+  }
+  fast = elapsed_dbase(&start) / QUERIES;
+
+  if (seen != total){
+    fprintf(stderr, "dbase: benchmark totals differ %d != %d\n", seen, total);
+    return 1;
+  }
+
+  printf("dbase: narrow queries: copy and merge %.1fus, postings %.1fus (%.1fx)\n", slow, fast, slow / fast);
+
+  for (i = 0; i < FORMATS; i++) destroy_tag_katcp(formats[i]);
+  for (i = 0; i < DECADES; i++) destroy_tag_katcp(decades[i]);
+  for (i = 0; i < GENRES;  i++) destroy_tag_katcp(genres[i]);
+  for (i = 0; i < ARTISTS; i++) destroy_tag_katcp(artists[i]);
+  destroy_tag_katcp(starred);
+
+  free(items);
+
+  return 0;
+}
+
+#endif
+
 #endif
 
@@ -72,6 +72,7 @@ static struct katcp_dispatch *setup_internal_katcp(int fd)
   }
 
   d->d_line = create_katcl(fd);
+  init_poll_katcp(&(d->d_interest));
 
   d->d_current = NULL;
   d->d_ready = 0;
@@ -216,6 +217,137 @@ struct katcp_dispatch *clone_katcp(struct katcp_dispatch *cd)
 
 /***********************************************************************/
 
+/* named commands are also kept in a hash table, chained in the same */
+/* order as in s_commands so that the first match wins as before. */
+/* Wildcards always sit at the end of the list and are not hashed */
+
+#define KATCP_CMD_BUCKETS 64
+
+static unsigned int hash_cmd_katcp(struct katcp_shared *s, char *name)
+{
+  unsigned int v;
+
+  for(v = 5381; *name != '\0'; name++){
+    v = (v * 33) ^ ((unsigned char)(*name));
+  }
+
+  return v & (s->s_slots - 1);
+}
+
+static int build_cmd_katcp(struct katcp_shared *s, unsigned int size)
+{
+  struct katcp_cmd **table, *c, *cx;
+  unsigned int i, key;
+
+  table = malloc(sizeof(struct katcp_cmd *) * size);
+  if(table == NULL){
+    return -1;
+  }
+
+  for(i = 0; i < size; i++){
+    table[i] = NULL;
+  }
+
+  if(s->s_lookup){
+    free(s->s_lookup);
+  }
+
+  s->s_lookup = table;
+  s->s_slots = size;
+
+  /* walk in list order, appending to the end of each chain */
+  for(c = s->s_commands; c && (c != s->s_wild); c = c->c_next){
+    c->c_chain = NULL;
+    key = hash_cmd_katcp(s, c->c_name);
+    if(table[key]){
+      for(cx = table[key]; cx->c_chain; cx = cx->c_chain);
+      cx->c_chain = c;
+    } else {
+      table[key] = c;
+    }
+  }
+
+  return 0;
+}
+
+static void index_cmd_katcp(struct katcp_shared *s, struct katcp_cmd *c)
+{
+  unsigned int key;
+
+  /* expects c to have just been prepended to s_commands */
+
+  s->s_named++;
+
+  if((s->s_lookup == NULL) || (s->s_named > (s->s_slots * 2))){
+    if(build_cmd_katcp(s, s->s_slots ? (s->s_slots * 2) : KATCP_CMD_BUCKETS) == 0){
+      return;
+    }
+    if(s->s_lookup == NULL){ /* no index, lookup falls back to the list */
+      return;
+    }
+  }
+
+  key = hash_cmd_katcp(s, c->c_name);
+  c->c_chain = s->s_lookup[key];
+  s->s_lookup[key] = c;
+}
+
+static void unindex_cmd_katcp(struct katcp_shared *s, struct katcp_cmd *c)
+{
+  struct katcp_cmd **cp;
+  unsigned int key;
+
+  if((c->c_flags & KATCP_CMD_WILDCARD) || (c->c_name == NULL)){
+    return;
+  }
+
+  s->s_named--;
+
+  if(s->s_lookup == NULL){
+    return;
+  }
+
+  key = hash_cmd_katcp(s, c->c_name);
+  for(cp = &(s->s_lookup[key]); *cp; cp = &((*cp)->c_chain)){
+    if(*cp == c){
+      *cp = c->c_chain;
+      c->c_chain = NULL;
+      return;
+    }
+  }
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  fprintf(stderr, "dispatch: logic problem: command %s not found in index\n", c->c_name);
+  abort();
+#endif
+}
+
+static struct katcp_cmd *find_cmd_katcp(struct katcp_shared *s, char *name)
+{
+  struct katcp_cmd *c;
+
+  if(name == NULL){
+    c = s->s_wild;
+  } else if(s->s_lookup){
+    for(c = s->s_lookup[hash_cmd_katcp(s, name)]; c; c = c->c_chain){
+      if(((c->c_mode == 0) || (c->c_mode == s->s_mode)) && (!strcmp(c->c_name, name))){
+        return c;
+      }
+    }
+    c = s->s_wild;
+  } else {
+    c = s->s_commands;
+  }
+
+  for(; c; c = c->c_next){
+    if(((c->c_mode == 0) || (c->c_mode == s->s_mode)) && ((c->c_flags & KATCP_CMD_WILDCARD) || (name && !strcmp(c->c_name, name)))){
+      return c;
+    }
+  }
+
+  return NULL;
+}
+
 void shutdown_cmd_katcp(struct katcp_cmd *c)
 {
   if(c){
@@ -243,6 +375,10 @@ void shutdown_katcp(struct katcp_dispatch *d)
 
   disown_notices_katcp(d);
 
+  if(d->d_line){
+    release_poll_katcp(d->d_shared, &(d->d_interest), fileno_katcl(d->d_line));
+  }
+
   shutdown_shared_katcp(d);
 
   if(d->d_line){
@@ -376,6 +512,23 @@ void mark_busy_katcp(struct katcp_dispatch *d)
   }
 }
 
+void mark_soon_katcp(struct katcp_dispatch *d, struct timeval *when)
+{
+  struct katcp_shared *s;
+
+  /* like mark busy, but only need to look again by the given time */
+
+  s = d->d_shared;
+  if(s == NULL){
+    return;
+  }
+
+  if(((s->s_soon.tv_sec == 0) && (s->s_soon.tv_usec == 0)) || (cmp_time_katcp(when, &(s->s_soon)) < 0)){
+    s->s_soon.tv_sec = when->tv_sec;
+    s->s_soon.tv_usec = when->tv_usec;
+  }
+}
+
 /***************************************************/
 
 #if 0
@@ -580,6 +733,10 @@ int deregister_command_katcp(struct katcp_dispatch *d, char *match)
       } else {
         s->s_commands = nxt;
       }
+      if(s->s_wild == c){
+        s->s_wild = nxt;
+      }
+      unindex_cmd_katcp(s, c);
       shutdown_cmd_katcp(c);
       if(ptr != match){
         free(ptr);
@@ -695,6 +852,7 @@ int register_flag_mode_katcp(struct katcp_dispatch *d, char *match, char *help,
   c->c_help = NULL;
   c->c_call = NULL;
   c->c_next = NULL;
+  c->c_chain = NULL;
   c->c_mode = 0;
   c->c_flags = KATCP_CMD_HIDDEN;
 
@@ -747,12 +905,22 @@ int register_flag_mode_katcp(struct katcp_dispatch *d, char *match, char *help,
     nxt->c_next = c;
     c->c_next = NULL;
 
+    if(s->s_wild == NULL){
+      s->s_wild = c;
+    }
+
   } else {
 #ifdef DEBUG
     fprintf(stderr, "register: prepended command %s for mode %d\n", c->c_name, c->c_mode);
 #endif
     c->c_next = s->s_commands;
     s->s_commands = c;
+
+    if(flags & KATCP_CMD_WILDCARD){ /* first entry, so also the first wildcard */
+      s->s_wild = c;
+    } else {
+      index_cmd_katcp(s, c);
+    }
   }
 
   return 0;
@@ -857,20 +1025,16 @@ int lookup_katcp(struct katcp_dispatch *d)
   }
 #endif
 
-  for(search = d->d_shared->s_commands; search; search = search->c_next){
+  search = find_cmd_katcp(s, str);
+  if(search){
 #ifdef DEBUG
-    fprintf(stderr, "dispatch: checking %s against %s\n", str, search->c_name);
+    fprintf(stderr, "dispatch: found match for <%s>\n", str);
 #endif
-    if(((search->c_mode == 0) || (search->c_mode == d->d_shared->s_mode)) && ((search->c_flags & KATCP_CMD_WILDCARD) || (!strcmp(search->c_name, str)))){
-#ifdef DEBUG
-      fprintf(stderr, "dispatch: found match for <%s>\n", str);
-#endif
-      d->d_current = search->c_call;
-      if(s->s_prehook){
-        (*(s->s_prehook))(d, arg_count_katcl(d->d_line));
-      }
-      return 1; /* found */
+    d->d_current = search->c_call;
+    if(s->s_prehook){
+      (*(s->s_prehook))(d, arg_count_katcl(d->d_line));
     }
+    return 1; /* found */
   }
   
   return 1; /* not found, d->d_current == NULL */
@@ -1177,8 +1341,12 @@ void reset_katcp(struct katcp_dispatch *d, int fd)
 
 
   if(d->d_line){
+    release_poll_katcp(s, &(d->d_interest), fileno_katcl(d->d_line));
     exchange_katcl(d->d_line, fd);
   }
+
+  /* new connection, interest has to be registered afresh */
+  init_poll_katcp(&(d->d_interest));
 }
 
 /**************************************************************/
@@ -1458,6 +1626,33 @@ int broadcast_inform_katcp(struct katcp_dispatch *d, char *name, char *arg)
   return sum;
 }
 
+int relay_inform_katcp(struct katcp_dispatch *d, struct katcl_parse *p)
+{
+  struct katcp_shared *s;
+  int result, sum, i;
+
+  sane_katcp(d);
+
+  s = d->d_shared;
+  if(s == NULL){
+    return -1;
+  }
+
+  sum = 0;
+  for(i = 0; i < s->s_used; i++){
+    d = s->s_clients[i];
+    if(d->d_line){
+      result = append_parse_katcl(d->d_line, p);
+      if(result < 0){
+        return -1;
+      }
+      sum += result;
+    }
+  }
+
+  return sum;
+}
+
 int log_relay_katcp(struct katcp_dispatch *d, struct katcl_parse *p)
 {
   struct katcp_shared *s;
@@ -1526,40 +1721,21 @@ int log_relay_katcp(struct katcp_dispatch *d, struct katcl_parse *p)
   return result;
 }
 
-static int check_log_message_katcp(struct katcl_line *l, int sum, unsigned int limit, unsigned int level, char *name, char *fmt, va_list args)
-{
-  int result;
-
-  if(level < limit){
-    return 0;
-  }
-
-  result = vlog_message_katcl(l, level, name, fmt, args);
-  if(sum < 0){
-    return sum;
-  }
-  if(result < 0){
-    return result;
-  }
-
-  return sum + result;
-}
-
 int log_message_katcp(struct katcp_dispatch *d, unsigned int priority, char *name, char *fmt, ...)
 {
   va_list args;
-  int sum; 
-  unsigned int level, i;
+  int sum, size, result;
+  unsigned int level, i, count;
   struct katcp_shared *s;
   struct katcp_entry *e;
+  struct katcp_dispatch *dx;
+  struct katcl_parse *px;
   char *prefix;
 #ifdef KATCP_EXPERIMENTAL
-  int count;
-  struct katcl_parse *px;
+  int flats;
 #endif
 
   level = priority & KATCP_MASK_LEVELS;
-  sum = 0;
 
   sane_katcp(d);
 
@@ -1571,10 +1747,49 @@ int log_message_katcp(struct katcp_dispatch *d, unsigned int priority, char *nam
     return -1;
   }
 
+  /* first establish who wants to see this, so that the message is */
+  /* formatted at most once and not at all if nobody is listening */
+
+  count = 0;
+
+#ifdef KATCP_EXPERIMENTAL
+  flats = log_parse_katcp(d, priority, NULL);
+  if(flats < 0){
+    return -1;
+  }
+  count += flats;
+#endif
+
+  if(s->s_count > 0){ /* do we have clones ? Then send it to them */
+    if(s->s_template != d){ /* only honour local messages if we are not the template (which doesn't do IO) */
+      if(priority & KATCP_LEVEL_LOCAL){
+        s = NULL;
+      }
+    }
+  } else { /* running with a single dispatch, no clones */
+    s = NULL;
+  }
+
+  if(s){
+    for(i = 0; i < s->s_used; i++){
+      if(level >= s->s_clients[i]->d_level){
+        count++;
+      }
+    }
+  } else {
+    if(level >= d->d_level){
+      count++;
+    }
+  }
+
+  if(count == 0){
+    return 0;
+  }
+
   if(name){
     prefix = name;
   } else {
-    e = &(s->s_vector[s->s_mode]);
+    e = &(d->d_shared->s_vector[d->d_shared->s_mode]);
     if(e->e_name){
       prefix = e->e_name;
     } else {
@@ -1583,50 +1798,56 @@ int log_message_katcp(struct katcp_dispatch *d, unsigned int priority, char *nam
     }
   }
 
-#ifdef KATCP_EXPERIMENTAL
   px = create_referenced_parse_katcl();
   if(px == NULL){
     return -1;
   }
-  
-  va_start(args, fmt);
-  sum = vlog_parse_katcl(px, level, prefix, fmt, args);
+
   va_start(args, fmt);
+  size = vlog_parse_katcl(px, level, prefix, fmt, args);
+  va_end(args);
 
-  if(sum > 0){
-    count = log_parse_katcp(d, priority, px);
-    if(count < 0){
-      sum = (-1);
-    } else {
-      sum *= count;
-    }
+  if(size < 0){
+    destroy_parse_katcl(px);
+    return -1;
   }
 
-  destroy_parse_katcl(px);
-#endif
+  result = 0;
 
-  if(s->s_count > 0){ /* do we have clones ? Then send it to them */
-    if(s->s_template != d){ /* only honour local messages if we are not the template (which doesn't do IO) */
-      if(priority & KATCP_LEVEL_LOCAL){
-        s = NULL;
-      }
+#ifdef KATCP_EXPERIMENTAL
+  if(flats > 0){
+    if(log_parse_katcp(d, priority, px) < 0){
+      result = (-1);
     }
-  } else { /* running with a single dispatch, no clones */
-    s = NULL;
   }
+#endif
+
+  /* every recipient holds a reference to the same parse */
 
   if(s){
     for(i = 0; i < s->s_used; i++){
-      d = s->s_clients[i];
-      va_start(args, fmt);
-      sum = check_log_message_katcp(d->d_line, sum, d->d_level, level, prefix, fmt, args);
-      va_end(args);
+      dx = s->s_clients[i];
+      if(level >= dx->d_level){
+        if(append_parse_katcl(dx->d_line, px) < 0){
+          result = (-1);
+        }
+      }
     }
   } else {
-    va_start(args, fmt);
-    sum = check_log_message_katcp(d->d_line, sum, d->d_level, level, prefix, fmt, args);
-    va_end(args);
+    if(level >= d->d_level){
+      if(append_parse_katcl(d->d_line, px) < 0){
+        result = (-1);
+      }
+    }
+  }
+
+  destroy_parse_katcl(px);
+
+  if(result < 0){
+    return -1;
   }
+
+  sum = size * count;
  
   return sum;
 }
@@ -2352,3 +2573,111 @@ int dispatch_cmd_katcp(struct katcp_dispatch *d, int argc)
     return KATCP_RESULT_FAIL;
   }
 }
+
+#ifdef UNIT_TEST_DISPATCH
+
+#include <fcntl.h>
+
+#define MESSAGES 200000
+#define FLUSH        64
+
+static double elapsed_dispatch(struct timeval *start)
+{
+  struct timeval now, delta;
+
+  gettimeofday(&now, NULL);
+  sub_time_katcp(&delta, &now, start);
+
+  return (delta.tv_sec * 1000000.0) + delta.tv_usec;
+}
+
+static int bench_log_dispatch(struct katcp_dispatch *d, unsigned int clients, unsigned int limit)
+{
+  struct katcp_shared *s;
+  struct timeval start;
+  unsigned int i, j;
+  int result;
+  double us;
+
+  s = d->d_shared;
+
+  for(i = 0; i < s->s_used; i++){
+    s->s_clients[i]->d_level = (i < clients) ? limit : KATCP_LEVEL_OFF;
+  }
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < MESSAGES; i++){
+    result = log_message_katcp(d, KATCP_LEVEL_DEBUG, "raw", "read %u bytes from register %s at offset 0x%x", i & 0xff, "sys_scratchpad", i * 4);
+    if(result < 0){
+      fprintf(stderr, "dispatch: log message %u failed\n", i);
+      return -1;
+    }
+    if((result > 0) != (limit <= KATCP_LEVEL_DEBUG)){
+      fprintf(stderr, "dispatch: unexpected result %d for limit %u\n", result, limit);
+      return -1;
+    }
+    if((i % FLUSH) == 0){
+      for(j = 0; j < clients; j++){
+        while(write_katcl(s->s_clients[j]->d_line) == 0);
+      }
+    }
+  }
+  us = elapsed_dispatch(&start);
+
+  for(j = 0; j < clients; j++){
+    while(write_katcl(s->s_clients[j]->d_line) == 0);
+  }
+
+  printf("dispatch: %2u clients at %-5s: %.0f messages/s\n", clients, log_to_string_katcl(limit), MESSAGES * 1000000.0 / us);
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  struct katcp_dispatch *d, *dx;
+  unsigned int i;
+  int fd;
+  unsigned int sizes[3] = { 1, 8, 32 };
+
+  d = startup_katcp();
+  if(d == NULL){
+    fprintf(stderr, "dispatch: unable to allocate state\n");
+    return 1;
+  }
+
+  if(allocate_clients_shared_katcp(d, 32) != 32){
+    fprintf(stderr, "dispatch: unable to allocate clients\n");
+    return 1;
+  }
+
+  for(i = 0; i < 32; i++){
+    fd = open("/dev/null", O_WRONLY);
+    if(fd < 0){
+      fprintf(stderr, "dispatch: unable to open sink\n");
+      return 1;
+    }
+    dx = d->d_shared->s_clients[d->d_shared->s_used];
+    d->d_shared->s_used++;
+    reset_katcp(dx, fd);
+    name_katcp(dx, "bench-%u", i);
+  }
+
+  for(i = 0; i < 3; i++){
+    if(bench_log_dispatch(d, sizes[i], KATCP_LEVEL_TRACE) < 0){
+      return 1;
+    }
+  }
+
+  for(i = 0; i < 3; i++){
+    if(bench_log_dispatch(d, sizes[i], KATCP_LEVEL_INFO) < 0){
+      return 1;
+    }
+  }
+
+  shutdown_katcp(d);
+
+  return 0;
+}
+
+#endif
@@ -240,7 +240,7 @@ struct katcp_cmd_map *create_cmd_map_katcp(char *name)
   m->m_tree = NULL;
   m->m_fallback = NULL;
 
-  m->m_tree = create_avltree();
+  m->m_tree = create_indexed_avltree();
   if(m->m_tree == NULL){
     destroy_cmd_map_katcp(m);
     return NULL;
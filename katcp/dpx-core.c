@@ -462,6 +462,9 @@ int switch_group_katcp(struct katcp_dispatch *d, struct katcp_flat *fx, struct k
   /* update ownership */
   fx->f_group = gx;
 
+  /* sensors now resolve relative to the new group */
+  clear_relay_info_katcp(d, fx);
+
 #if 0
   /* maybe ? */
   reconfigure_flat_katcp(d, f, flags);
@@ -697,6 +700,7 @@ static void deallocate_flat_katcp(struct katcp_dispatch *d, struct katcp_flat *f
   }
 
   if(f->f_line){
+    release_poll_katcp(f->f_shared, &(f->f_interest), fileno_katcl(f->f_line));
     destroy_katcl(f->f_line, 1);
     f->f_line = NULL;
   }
@@ -770,6 +774,8 @@ static void deallocate_flat_katcp(struct katcp_dispatch *d, struct katcp_flat *f
 
   f->f_group = NULL;
 
+  clear_relay_info_katcp(d, f);
+
   /* WARNING: might be awkward if there a callbacks which assume a valid flat ... maybe move this code higher up ... */
 
   if(f->f_region){
@@ -1218,7 +1224,6 @@ int wake_endpoint_peer_flat_katcp(struct katcp_dispatch *d, struct katcp_endpoin
     default :
 #ifdef KATCP_CONSISTENCY_CHECKS
       fprintf(stderr, "duplex: possible problem: peer endpoint run while in state %u, not an operational one\n", fx->f_state);
-      sleep(1);
 #endif
       return KATCP_RESULT_FAIL;
   }
@@ -1603,6 +1608,10 @@ int reconfigure_flat_katcp(struct katcp_dispatch *d, struct katcp_flat *fx, unsi
     trigger_connect_flat(d, fx);
   }
 
+  if((fx->f_flags ^ flags) & KATCP_FLAT_PREFIXED){
+    clear_relay_info_katcp(d, fx);
+  }
+
   fx->f_flags = flags & (KATCP_FLAT_TOSERVER | KATCP_FLAT_TOCLIENT | KATCP_FLAT_HIDDEN | KATCP_FLAT_PREFIXED | KATCP_FLAT_RETAINFO | KATCP_FLAT_SEESKATCP | KATCP_FLAT_SEESADMIN | KATCP_FLAT_SEESUSER);
 
   return 0;
@@ -1660,6 +1669,7 @@ struct katcp_flat *create_flat_katcp(struct katcp_dispatch *d, int fd, unsigned
   f->f_remote = NULL;
 
   f->f_line = NULL;
+  init_poll_katcp(&(f->f_interest));
   f->f_shared = NULL;
 
 #if 0
@@ -1693,6 +1703,9 @@ struct katcp_flat *create_flat_katcp(struct katcp_dispatch *d, int fd, unsigned
 
   f->f_region = NULL;
 
+  f->f_relays = NULL;
+  f->f_relay_epoch = 0;
+
   if(name){
     f->f_name = strdup(name);
     if(f->f_name == NULL){
@@ -2485,6 +2498,9 @@ int rename_flat_katcp(struct katcp_dispatch *d, char *group, char *was, char *sh
   fx->f_name = ptr;
   memcpy(fx->f_name, should, len);
 
+  /* relayed sensor names include the client name */
+  clear_relay_info_katcp(d, fx);
+
   return 0;
 }
 
@@ -3548,13 +3564,16 @@ int load_flat_katcp(struct katcp_dispatch *d)
   struct katcp_flat *fx;
   struct katcp_shared *s;
   struct katcp_group *gx;
-  unsigned int i, j, inc, jnc;
+  struct timeval now, until;
+  unsigned int i, j, inc, jnc, mask;
   int result, fd;
 
   s = d->d_shared;
 
   result = 0;
 
+  gettimeofday(&now, NULL);
+
 #ifdef DEBUG 
   fprintf(stderr, "dpx[*]: loading %u groups\n", s->s_members);
 #endif
@@ -3591,20 +3610,20 @@ int load_flat_katcp(struct katcp_dispatch *d)
       switch(fx->f_state){
 
         case FLAT_STATE_CONNECTING : 
-          FD_SET(fd, &(s->s_write));
-          if(fd > s->s_max){
-            s->s_max = fd;
-          }
+          load_poll_katcp(s, &(fx->f_interest), fd, KATCP_POLL_WRITE);
           break;
 
         case FLAT_STATE_UP : 
-          FD_SET(fd, &(s->s_read));
+          /* stop taking in requests while our output backs up */
+          mask = congested_katcl(fx->f_line) ? 0 : KATCP_POLL_READ;
           if(flushing_katcl(fx->f_line)){
-            FD_SET(fd, &(s->s_write));
-          } 
-          if(fd > s->s_max){
-            s->s_max = fd;
+            if(deferring_katcl(fx->f_line, &now, &until)){
+              mark_soon_katcp(d, &until);
+            } else {
+              mask |= KATCP_POLL_WRITE;
+            }
           }
+          load_poll_katcp(s, &(fx->f_interest), fd, mask);
           break;
 
         case FLAT_STATE_FINISHING : 
@@ -3627,13 +3646,12 @@ int load_flat_katcp(struct katcp_dispatch *d)
 #endif
 
           if(flushing_katcl(fx->f_line)){
-            FD_SET(fd, &(s->s_write));
-            if(fd > s->s_max){
-              s->s_max = fd;
-            }
+            load_poll_katcp(s, &(fx->f_interest), fd, KATCP_POLL_WRITE);
             break;
           } 
 
+          load_poll_katcp(s, &(fx->f_interest), fd, 0);
+
           if(pending_endpoint_katcp(d, fx->f_peer) > 0){
             break;
           }
@@ -3656,6 +3674,7 @@ int load_flat_katcp(struct katcp_dispatch *d)
           }
 
           if(fx->f_line){
+            release_poll_katcp(s, &(fx->f_interest), fileno_katcl(fx->f_line));
             destroy_katcl(fx->f_line, 1);
             fx->f_line = NULL;
           }
@@ -3766,7 +3785,7 @@ int run_flat_katcp(struct katcp_dispatch *d)
 
         fd = fileno_katcl(fx->f_line);
 
-        if(FD_ISSET(fd, &(s->s_write))){
+        if(ready_poll_katcp(s, fd, KATCP_POLL_WRITE)){
           /* resume connect */
           if(fx->f_state == FLAT_STATE_CONNECTING){
             len = sizeof(int);
@@ -3796,7 +3815,7 @@ int run_flat_katcp(struct katcp_dispatch *d)
           }
         }
 
-        if(FD_ISSET(fd, &(s->s_read))){
+        if(ready_poll_katcp(s, fd, KATCP_POLL_READ)){
           /* acquire data */
           if(read_katcl(fx->f_line) != 0){
             fx->f_state = FLAT_STATE_CRASHING;
@@ -3902,6 +3921,7 @@ int list_duplex_cmd_katcp(struct katcp_dispatch *d, int argc)
   struct katcp_group *gx;
   struct katcp_response_handler *rh;
   struct katcp_flat *fx;
+  struct katcl_line *lx;
 
   s = d->d_shared;
 
@@ -3922,6 +3942,11 @@ int list_duplex_cmd_katcp(struct katcp_dispatch *d, int argc)
       }
       log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%s has log level %d", fx->f_name, fx->f_log_level);
       log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%s is part of group %p", fx->f_name, fx->f_group);
+      if(fx->f_line){
+        lx = fx->f_line;
+        log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%s gathers up to %u output bytes, holding them for up to %uus, congested beyond %u bytes", fx->f_name, lx->l_limit, lx->l_delay, lx->l_watermark);
+        log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%s has written %lu bytes in %lu calls averaging %lu bytes with %u bytes queued", fx->f_name, lx->l_bytes, lx->l_calls, lx->l_calls ? (lx->l_bytes / lx->l_calls) : 0UL, lx->l_queued + lx->l_pending);
+      }
     }
   }
 
@@ -4069,7 +4094,7 @@ int setup_default_group(struct katcp_dispatch *d, char *name)
     add_full_cmd_map_katcp(m, "client-halt", "stop a client (?client-halt [name [group]])", 0, &client_halt_group_cmd_katcp, NULL, NULL);
     add_full_cmd_map_katcp(m, "client-connect", "create a client to a remote host (?client-connect host:port [group])", 0, &client_connect_group_cmd_katcp, NULL, NULL);
     add_full_cmd_map_katcp(m, "?client-exec", "create a client to a local process (?client-exec label [group [binary [args]*])", 0, &client_exec_group_cmd_katcp, NULL, NULL);
-    add_full_cmd_map_katcp(m, "client-config", "set a client option (?client-config option [client])", 0, &client_config_group_cmd_katcp, NULL, NULL);
+    add_full_cmd_map_katcp(m, "client-config", "set a client option (?client-config option[=value] [client])", 0, &client_config_group_cmd_katcp, NULL, NULL);
     add_full_cmd_map_katcp(m, "client-switch", "set a client option (?client-switch group [client])", 0, &client_switch_group_cmd_katcp, NULL, NULL);
 
     add_full_cmd_map_katcp(m, "group-create", "create a new group (?group-create name [group])", 0, &group_create_group_cmd_katcp, NULL, NULL);
@@ -4094,7 +4119,7 @@ int setup_default_group(struct katcp_dispatch *d, char *name)
 
     add_full_cmd_map_katcp(m, "sensor-list", "lists available sensors (?sensor-list [sensor])", 0, &sensor_list_group_cmd_katcp, NULL, NULL);
     add_full_cmd_map_katcp(m, "sensor-value", "query a sensor (?sensor-value sensor)", 0, &sensor_value_group_cmd_katcp, NULL, NULL);
-    add_full_cmd_map_katcp(m, "sensor-sampling", "configure a sensor (?sensor-sampling sensor [strategy [parameter]])", 0, &sensor_sampling_group_cmd_katcp, NULL, NULL);
+    add_full_cmd_map_katcp(m, "sensor-sampling", "configure a sensor (?sensor-sampling sensor [strategy [parameter]*])", 0, &sensor_sampling_group_cmd_katcp, NULL, NULL);
 
     add_full_cmd_map_katcp(m, "var-declare", "declare a variable (?var-declare name attribute[,attribute]* [path])", 0, &var_declare_group_cmd_katcp, NULL, NULL);
     add_full_cmd_map_katcp(m, "var-list", "list variables (?var-list [variable])", 0, &var_list_group_cmd_katcp, NULL, NULL);
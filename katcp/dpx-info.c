@@ -28,6 +28,10 @@ static int each_log_parse_katcp(struct katcl_line *l, int count, unsigned int li
     return count;
   }
 
+  if(px == NULL){ /* only counting interested parties */
+    return (count < 0) ? count : (count + 1);
+  }
+
   result = append_parse_katcl(l, px);
   if(count < 0){
     return -1;
@@ -43,6 +47,7 @@ int log_parse_katcp(struct katcp_dispatch *d, int level, struct katcl_parse *px)
 {
 
   /* WARNING: assumption if level < 0, then a relayed log message ... this probably should be a flag in its own right */
+  /* a null px with a valid level only counts the connections which would accept the message */
 
   int limit, count;
   unsigned int mask;
@@ -54,7 +59,7 @@ int log_parse_katcp(struct katcp_dispatch *d, int level, struct katcl_parse *px)
 
   count = 0;
 
-  if(px == NULL){
+  if((px == NULL) && (level < 0)){
     return -1;
   }
 
@@ -70,18 +75,20 @@ int log_parse_katcp(struct katcp_dispatch *d, int level, struct katcl_parse *px)
   ft = this_flat_katcp(d);
   gt = this_group_katcp(d);
 
-  ptr = get_string_parse_katcl(px, 0);
-  if(ptr == NULL){
+  if(px){
+    ptr = get_string_parse_katcl(px, 0);
+    if(ptr == NULL){
 #ifdef KATCP_CONSISTENCY_CHECKS
-    fprintf(stderr, "log: empty message type\n");
+      fprintf(stderr, "log: empty message type\n");
 #endif
-    return -1;
-  }
-  if(strcmp(ptr, KATCP_LOG_INFORM)){
+      return -1;
+    }
+    if(strcmp(ptr, KATCP_LOG_INFORM)){
 #ifdef KATCP_CONSISTENCY_CHECKS
-    fprintf(stderr, "log: expected message %s, not %s\n", KATCP_LOG_INFORM, ptr);
+      fprintf(stderr, "log: expected message %s, not %s\n", KATCP_LOG_INFORM, ptr);
 #endif
-    return -1;
+      return -1;
+    }
   }
 
   if(level < 0){
@@ -166,7 +173,7 @@ int log_parse_katcp(struct katcp_dispatch *d, int level, struct katcl_parse *px)
     }
   }
 
-#ifdef DEBUG
+#if DEBUG > 1
   fprintf(stderr, "log: message %p reported %d times\n", px, count);
 #endif
 
@@ -462,6 +469,9 @@ int sensor_list_group_info_katcp(struct katcp_dispatch *d, int argc)
 
   log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "saw a sensor list - attempting to load it");
 
+  /* definitions may be changing, resolve sensor updates afresh */
+  clear_relay_info_katcp(d, fx);
+
   name = get_string_parse_katcl(px, 1);
   description = get_string_parse_katcl(px, 2);
   units = get_string_parse_katcl(px, 3);
@@ -535,6 +545,89 @@ int sensor_list_group_info_katcp(struct katcp_dispatch *d, int argc)
   return KATCP_RESULT_OK;
 }
 
+/* relays: remote sensor name to its variable and payload slots, saves the name fixup and path walks on each update */
+
+void clear_relay_info_katcp(struct katcp_dispatch *d, struct katcp_flat *fx)
+{
+  if(fx == NULL){
+    return;
+  }
+
+  if(fx->f_relays){
+    destroy_avltree(fx->f_relays, &free);
+    fx->f_relays = NULL;
+  }
+}
+
+static struct katcp_relay *find_relay_info_katcp(struct katcp_dispatch *d, struct katcp_flat *fx, char *name)
+{
+  static char *paths[KATCP_RELAY_SLOTS] = { KATCP_VRC_SENSOR_TIME, KATCP_VRC_SENSOR_STATUS, KATCP_VRC_SENSOR_VALUE };
+  struct katcp_shared *s;
+  struct katcp_relay *y;
+  struct katcp_vrbl *vx;
+  unsigned int i;
+  char *ptr;
+
+  s = d->d_shared;
+
+  /* some variable or payload has gone away or appeared, any of ours might be stale */
+  if(fx->f_relays && (fx->f_relay_epoch != s->s_vrbl_epoch)){
+    clear_relay_info_katcp(d, fx);
+  }
+
+  if(fx->f_relays == NULL){
+    fx->f_relays = create_indexed_avltree();
+    if(fx->f_relays == NULL){
+      return NULL;
+    }
+    fx->f_relay_epoch = s->s_vrbl_epoch;
+  }
+
+  y = find_data_avltree(fx->f_relays, name);
+  if(y){
+    return y;
+  }
+
+  ptr = make_child_field_katcp(d, fx, name, 0);
+  if(ptr == NULL){
+    return NULL;
+  }
+
+  vx = find_vrbl_katcp(d, ptr);
+  free(ptr);
+
+  if((vx == NULL) || !is_vrbl_sensor_katcp(d, vx)){
+    return NULL;
+  }
+
+  y = malloc(sizeof(struct katcp_relay));
+  if(y == NULL){
+    return NULL;
+  }
+
+  y->y_variable = vx;
+
+  for(i = 0; i < KATCP_RELAY_SLOTS; i++){
+    y->y_slots[i] = find_payload_katcp(d, vx, paths[i]);
+    if((y->y_slots[i] == NULL) || (y->y_slots[i]->p_type != KATCP_VRT_STRING)){
+      /* first update still has to create the fields, or they are not plain strings */
+      free(y);
+      return NULL;
+    }
+  }
+
+  if(store_named_node_avltree(fx->f_relays, name, y) < 0){
+    free(y);
+    return NULL;
+  }
+
+#ifdef DEBUG
+  fprintf(stderr, "relay: resolved sensor %s to variable %p\n", name, vx);
+#endif
+
+  return y;
+}
+
 int sensor_status_group_info_katcp(struct katcp_dispatch *d, int argc)
 {
 #define TIMESTAMP_BUFFER 20
@@ -542,7 +635,9 @@ int sensor_status_group_info_katcp(struct katcp_dispatch *d, int argc)
   struct katcl_parse *px;
   struct katcp_endpoint *self, *remote, *origin;
   struct katcp_vrbl *vx;
+  struct katcp_relay *y;
   char *name, *stamp, *value, *status, *ptr;
+  char *vector[KATCP_RELAY_SLOTS];
   char buffer[TIMESTAMP_BUFFER];
   int unhide;
 
@@ -584,6 +679,20 @@ int sensor_status_group_info_katcp(struct katcp_dispatch *d, int argc)
     }
     buffer[TIMESTAMP_BUFFER - 1] = '\0';
 
+    y = find_relay_info_katcp(d, fx, name);
+    if(y){
+      vector[KATCP_RELAY_TIME]   = buffer;
+      vector[KATCP_RELAY_STATUS] = status;
+      vector[KATCP_RELAY_VALUE]  = value;
+
+      if(set_strings_vrbl_katcp(d, y->y_variable, y->y_slots, vector, KATCP_RELAY_SLOTS) == 0){
+        return 0;
+      }
+
+      /* payloads no longer fit, take the long way and resolve again next time */
+      del_name_node_avltree(fx->f_relays, name, &free);
+    }
+
     ptr = make_child_field_katcp(d, fx, name, 0);
     if(ptr == NULL){
       log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "unable fixup sensor name %s", name);
@@ -796,10 +796,10 @@ int sensor_list_group_cmd_katcp(struct katcp_dispatch *d, int argc)
 int sensor_sampling_group_cmd_katcp(struct katcp_dispatch *d, int argc)
 {
   int result;
-  char *key, *strategy;
+  char *key, *strategy, **vector;
   struct katcp_vrbl *vx;
   struct katcp_flat *fx;
-  int stg;
+  int stg, i;
 
   if(argc <= 1){
     return extra_response_katcp(d, KATCP_RESULT_INVALID, KATCP_FAIL_USAGE);
@@ -839,17 +839,7 @@ int sensor_sampling_group_cmd_katcp(struct katcp_dispatch *d, int argc)
     return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_BUG);
   }
 
-  if(argc <= 2){
-    stg = current_strategy_sensor_katcp(d, vx, fx);
-    /* WARNING: will have to get more information for period sensors ... */
-
-    strategy = strategy_to_string_sensor_katcp(d, stg);
-
-    if(strategy == NULL){
-      return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_BUG);
-    } 
-
-  } else {
+  if(argc > 2){
 
     strategy = arg_string_katcp(d, 2);
     if(strategy == NULL){
@@ -859,9 +849,31 @@ int sensor_sampling_group_cmd_katcp(struct katcp_dispatch *d, int argc)
     stg = strategy_from_string_sensor_katcp(d, strategy);
     switch(stg){
       case KATCP_STRATEGY_EVENT :
-        if(monitor_event_variable_katcp(d, vx, fx) < 0){
-          log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register event based sampling for sensor %s", key);
-          return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_BUG);
+      case KATCP_STRATEGY_PERIOD :
+      case KATCP_STRATEGY_DIFF :
+      case KATCP_STRATEGY_EVENT_RATE :
+      case KATCP_STRATEGY_DIFF_RATE :
+        vector = NULL;
+        if(argc > 3){
+          vector = malloc(sizeof(char *) * (argc - 3));
+          if(vector == NULL){
+            return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_MALLOC);
+          }
+          for(i = 3; i < argc; i++){
+            vector[i - 3] = arg_string_katcp(d, i);
+            if(vector[i - 3] == NULL){
+              free(vector);
+              return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_USAGE);
+            }
+          }
+        }
+        result = monitor_strategy_variable_katcp(d, vx, fx, stg, vector, argc - 3);
+        if(vector){
+          free(vector);
+        }
+        if(result < 0){
+          log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register %s sampling for sensor %s", strategy, key);
+          return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_USAGE);
         }
         break;
 
@@ -872,12 +884,6 @@ int sensor_sampling_group_cmd_katcp(struct katcp_dispatch *d, int argc)
         }
         break;
 
-      /* TODO */
-      case KATCP_STRATEGY_PERIOD :
-      case KATCP_STRATEGY_DIFF :
-        log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "sampling strategy %s not implemented for sensor %s", strategy, key);
-        return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_USAGE);
-
       default :
         log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "invalid sensor sampling strategy %s", strategy);
         return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_USAGE);
@@ -887,7 +893,7 @@ int sensor_sampling_group_cmd_katcp(struct katcp_dispatch *d, int argc)
   /* WARNING: all ERROR paths should have exited above ... can safely report now */
 
 #ifdef KATCP_CONSISTENCY_CHECKS
-  if((key == NULL) || (strategy == NULL)){
+  if(key == NULL){
     fprintf(stderr, "dpx: sensor-sampling: logic problem: essential display field left out\n");
     abort();
   }
@@ -897,7 +903,7 @@ int sensor_sampling_group_cmd_katcp(struct katcp_dispatch *d, int argc)
 
   append_string_katcp(d, KATCP_FLAG_STRING, KATCP_OK);
   append_string_katcp(d, KATCP_FLAG_STRING, key);
-  append_string_katcp(d, KATCP_FLAG_STRING | KATCP_FLAG_LAST, strategy);
+  append_strategy_variable_katcp(d, KATCP_FLAG_LAST, vx, fx);
 
   dump_variable_sensor_katcp(d, vx, KATCP_LEVEL_DEBUG);
 
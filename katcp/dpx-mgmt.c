@@ -138,9 +138,11 @@ int client_connect_group_cmd_katcp(struct katcp_dispatch *d, int argc)
 
 int client_config_group_cmd_katcp(struct katcp_dispatch *d, int argc)
 {
-  char *option, *client;
-  unsigned int mask, set;
+  char *option, *client, *value, *end;
+  unsigned int mask, set, len;
+  unsigned long number;
   struct katcp_flat *fx, *fy;
+  struct katcl_line *lx;
 
   fy = this_flat_katcp(d);
   if(fy == NULL){
@@ -174,6 +176,46 @@ int client_config_group_cmd_katcp(struct katcp_dispatch *d, int argc)
     fx = fy;
   }
 
+  lx = fx->f_line;
+  if(lx == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "client %s has no connection to configure", fx->f_name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  /* output policy, either as preset or option=value */
+
+  if(!strcmp(option, "immediate")){
+    output_policy_katcl(lx, KATCL_IO_SIZE, 0, lx->l_watermark);
+    return KATCP_RESULT_OK;
+  } else if(!strcmp(option, "bulk")){
+    output_policy_katcl(lx, KATCP_BULK_SIZE, KATCP_BULK_DELAY, lx->l_watermark);
+    return KATCP_RESULT_OK;
+  }
+
+  value = strchr(option, '=');
+  if(value){
+    len = value - option;
+    value++;
+
+    number = strtoul(value, &end, 0);
+    if((value[0] == '\0') || (end[0] != '\0')){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to convert %s to a number", value);
+      return extra_response_katcp(d, KATCP_RESULT_FAIL, KATCP_FAIL_USAGE);
+    }
+
+    if((len == 13) && !strncmp(option, "output-buffer", len)){
+      output_policy_katcl(lx, number, lx->l_delay, lx->l_watermark);
+    } else if((len == 14) && !strncmp(option, "coalesce-delay", len)){
+      output_policy_katcl(lx, lx->l_limit, number, lx->l_watermark);
+    } else if((len == 14) && !strncmp(option, "high-watermark", len)){
+      output_policy_katcl(lx, lx->l_limit, lx->l_delay, number);
+    } else {
+      log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unknown configuration option %s", option);
+    }
+
+    return KATCP_RESULT_OK;
+  }
+
   set  = 0;
   mask = 0;
 
@@ -1161,6 +1203,7 @@ int system_info_group_cmd_katcp(struct katcp_dispatch *d, int argc)
   log_message_katcp(d, KATCP_LEVEL_INFO | KATCP_LEVEL_LOCAL, NULL, "server was launched at %lu000", s->s_start); 
 #endif  
   log_message_katcp(d, KATCP_LEVEL_INFO | KATCP_LEVEL_LOCAL, NULL, "server has been running for %s", buffer);
+  log_message_katcp(d, KATCP_LEVEL_INFO | KATCP_LEVEL_LOCAL, NULL, "server delivers up to %u messages per endpoint per pass", s->s_endpoint_batch);
 #ifdef __DATE__
   log_message_katcp(d, KATCP_LEVEL_INFO | KATCP_LEVEL_LOCAL, NULL, "server was built on %s at %s", __DATE__, __TIME__);
 #endif
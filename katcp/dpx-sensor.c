@@ -10,6 +10,7 @@
 #include <sysexits.h>
 
 #include <sys/stat.h>
+#include <sys/time.h>
 
 #include <katcp.h>
 #include <katpriv.h>
@@ -18,6 +19,8 @@
 
 #define WIT_MAGIC 0x120077e1
 
+#define SENSOR_STRATEGY_COUNT   7
+
 /* sorry, sensor was taken, now move onto wit ... */
 
 #ifdef KATCP_CONSISTENCY_CHECKS
@@ -38,6 +41,7 @@ static void sane_wit(struct katcp_wit *w)
 #endif
 
 void destroy_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *sub);
+static void unschedule_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *sub);
 
 /*************************************************************************/
 
@@ -74,6 +78,12 @@ static void destroy_wit_katcp(struct katcp_dispatch *d, struct katcp_wit *w)
   }
   w->w_size = 0;
 
+  if(w->w_cache){
+    destroy_parse_katcl(w->w_cache);
+    w->w_cache = NULL;
+  }
+  w->w_variable = NULL;
+
   if(w->w_endpoint){
     release_endpoint_katcp(d, w->w_endpoint);
     w->w_endpoint = NULL;
@@ -98,6 +108,10 @@ static struct katcp_wit *create_wit_katcp(struct katcp_dispatch *d)
   w->w_vector = NULL;
   w->w_size = 0;
 
+  w->w_variable = NULL;
+  w->w_cache = NULL;
+  w->w_stamp = 0;
+
   w->w_endpoint = create_endpoint_katcp(d, NULL, &release_endpoint_wit, w);
   if(w->w_endpoint == NULL){
     destroy_wit_katcp(d, w);
@@ -142,6 +156,24 @@ struct katcp_subscribe *create_subscribe_katcp(struct katcp_dispatch *d, struct
 
   sub->s_strategy = KATCP_STRATEGY_OFF;
 
+  sub->s_wit = w;
+
+  sub->s_period.tv_sec = 0;
+  sub->s_period.tv_usec = 0;
+  sub->s_floor.tv_sec = 0;
+  sub->s_floor.tv_usec = 0;
+  sub->s_delta = 0.0;
+
+  sub->s_reported = 0.0;
+  sub->s_numeric = 0;
+  sub->s_held = 0;
+
+  sub->s_last.tv_sec = 0;
+  sub->s_last.tv_usec = 0;
+  sub->s_when.tv_sec = 0;
+  sub->s_when.tv_usec = 0;
+  sub->s_index = (-1);
+
   /*********************/
 
   reference_endpoint_katcp(d, tx->f_peer);
@@ -177,6 +209,8 @@ void destroy_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *s
     return;
   }
 
+  unschedule_subscribe_katcp(d, sub);
+
   if(sub->s_endpoint){
 #ifdef DEBUG
     fprintf(stderr, "subscribe: forgetting endpoint %p\n", sub->s_endpoint);
@@ -194,6 +228,7 @@ void destroy_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *s
   }
 
   sub->s_strategy = KATCP_STRATEGY_OFF;
+  sub->s_wit = NULL;
 
   free(sub);
 }
@@ -251,10 +286,415 @@ struct katcp_subscribe *locate_subscribe_katcp(struct katcp_dispatch *d, struct
 
 /*************************************************************************/
 
+/* sampling schedule: one heap of subscriptions for all sensors, one timer ***/
+
+static void swap_sampling_katcp(struct katcp_shared *s, unsigned int a, unsigned int b)
+{
+  struct katcp_subscribe *tmp;
+
+  tmp = s->s_sampling[a];
+  s->s_sampling[a] = s->s_sampling[b];
+  s->s_sampling[b] = tmp;
+
+  s->s_sampling[a]->s_index = a;
+  s->s_sampling[b]->s_index = b;
+}
+
+static void up_sampling_katcp(struct katcp_shared *s, unsigned int i)
+{
+  unsigned int p;
+
+  while(i > 0){
+    p = (i - 1) / 2;
+    if(cmp_time_katcp(&(s->s_sampling[p]->s_when), &(s->s_sampling[i]->s_when)) <= 0){
+      return;
+    }
+    swap_sampling_katcp(s, p, i);
+    i = p;
+  }
+}
+
+static void down_sampling_katcp(struct katcp_shared *s, unsigned int i)
+{
+  unsigned int c, m;
+
+  for(;;){
+    m = i;
+
+    c = (2 * i) + 1;
+    if((c < s->s_sampled) && (cmp_time_katcp(&(s->s_sampling[c]->s_when), &(s->s_sampling[m]->s_when)) < 0)){
+      m = c;
+    }
+    c++;
+    if((c < s->s_sampled) && (cmp_time_katcp(&(s->s_sampling[c]->s_when), &(s->s_sampling[m]->s_when)) < 0)){
+      m = c;
+    }
+
+    if(m == i){
+      return;
+    }
+
+    swap_sampling_katcp(s, i, m);
+    i = m;
+  }
+}
+
+static int arm_sampling_katcp(struct katcp_dispatch *d);
+
+static int schedule_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *sub, struct timeval *when)
+{
+  struct katcp_shared *s;
+  struct katcp_subscribe **tmp;
+  unsigned int size;
+
+  s = d->d_shared;
+
+  sub->s_when.tv_sec = when->tv_sec;
+  sub->s_when.tv_usec = when->tv_usec;
+
+  if(sub->s_index >= 0){
+#ifdef KATCP_CONSISTENCY_CHECKS
+    if((sub->s_index >= s->s_sampled) || (s->s_sampling[sub->s_index] != sub)){
+      fprintf(stderr, "sensor: major logic problem: subscription %p not at claimed heap position %d\n", sub, sub->s_index);
+      abort();
+    }
+#endif
+    up_sampling_katcp(s, sub->s_index);
+    down_sampling_katcp(s, sub->s_index);
+    return 0;
+  }
+
+  if(s->s_sampled >= s->s_sample_size){
+    size = (s->s_sample_size > 0) ? (s->s_sample_size * 2) : 16;
+    tmp = realloc(s->s_sampling, sizeof(struct katcp_subscribe *) * size);
+    if(tmp == NULL){
+      return -1;
+    }
+    s->s_sampling = tmp;
+    s->s_sample_size = size;
+  }
+
+  sub->s_index = s->s_sampled;
+  s->s_sampling[s->s_sampled] = sub;
+  s->s_sampled++;
+
+  up_sampling_katcp(s, sub->s_index);
+
+  return 0;
+}
+
+static void unschedule_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *sub)
+{
+  struct katcp_shared *s;
+  unsigned int i;
+
+  s = d->d_shared;
+
+  if(sub->s_index < 0){
+    return;
+  }
+
+  i = sub->s_index;
+  sub->s_index = (-1);
+
+  if((s == NULL) || (s->s_sampling == NULL) || (i >= s->s_sampled)){
+    /* heap already gone during shutdown */
+    return;
+  }
+
+  s->s_sampled--;
+  if(i < s->s_sampled){
+    s->s_sampling[i] = s->s_sampling[s->s_sampled];
+    s->s_sampling[i]->s_index = i;
+    up_sampling_katcp(s, i);
+    down_sampling_katcp(s, s->s_sampling[i]->s_index);
+  }
+}
+
+/* work out when a subscription next needs attention, relative to now */
+
+static int plan_subscribe_katcp(struct katcp_dispatch *d, struct katcp_subscribe *sub, struct timeval *now)
+{
+  struct timeval when;
+  unsigned long long period, at;
+
+  switch(sub->s_strategy){
+    case KATCP_STRATEGY_PERIOD :
+      add_time_katcp(&when, &(sub->s_when), &(sub->s_period));
+      if(cmp_time_katcp(&when, now) <= 0){
+        /* first time or fallen behind: pick the next multiple of the period, so that equal periods share deadlines */
+        period = (sub->s_period.tv_sec * 1000000ULL) + sub->s_period.tv_usec;
+        at = (now->tv_sec * 1000000ULL) + now->tv_usec;
+        at = ((at / period) + 1) * period;
+        when.tv_sec = at / 1000000;
+        when.tv_usec = at % 1000000;
+      }
+      break;
+
+    case KATCP_STRATEGY_EVENT_RATE :
+    case KATCP_STRATEGY_DIFF_RATE :
+      if(sub->s_held){
+        add_time_katcp(&when, &(sub->s_last), &(sub->s_floor));
+      } else if(sub->s_period.tv_sec || sub->s_period.tv_usec){
+        add_time_katcp(&when, &(sub->s_last), &(sub->s_period));
+      } else {
+        unschedule_subscribe_katcp(d, sub);
+        return 0;
+      }
+      break;
+
+    default :
+      unschedule_subscribe_katcp(d, sub);
+      return 0;
+  }
+
+  return schedule_subscribe_katcp(d, sub, &when);
+}
+
+static int value_sensor_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, double *value)
+{
+  struct katcp_vrbl_payload *py;
+  char *end;
+  double v;
+
+  if(vx == NULL){
+    return -1;
+  }
+
+  py = find_payload_katcp(d, vx, KATCP_VRC_SENSOR_VALUE);
+  if((py == NULL) || (py->p_type != KATCP_VRT_STRING) || (py->p_union.u_string == NULL)){
+    return -1;
+  }
+
+  v = strtod(py->p_union.u_string, &end);
+  if(end == py->p_union.u_string){
+    return -1;
+  }
+
+  *value = v;
+
+  return 0;
+}
+
+static int differs_subscribe_katcp(struct katcp_subscribe *sub, int numeric, double value)
+{
+  double delta;
+
+  if((numeric < 0) || (sub->s_numeric == 0)){
+    /* can not compare, so any update counts */
+    return 1;
+  }
+
+  delta = value - sub->s_reported;
+  if(delta < 0.0){
+    delta = (-delta);
+  }
+
+  return (delta > sub->s_delta) ? 1 : 0;
+}
+
+static void note_subscribe_katcp(struct katcp_subscribe *sub, struct timeval *now, int numeric, double value)
+{
+  sub->s_last.tv_sec = now->tv_sec;
+  sub->s_last.tv_usec = now->tv_usec;
+
+  sub->s_held = 0;
+
+  if(numeric < 0){
+    sub->s_numeric = 0;
+  } else {
+    sub->s_numeric = 1;
+    sub->s_reported = value;
+  }
+}
+
+static struct katcl_parse *refresh_wit_katcp(struct katcp_dispatch *d, struct katcp_wit *w, char *name)
+{
+  struct katcp_shared *s;
+  struct katcl_parse *px;
+
+  s = d->d_shared;
+
+  if((w->w_variable == NULL) || (w->w_variable->v_flags & KATCP_VRF_HID)){
+    return NULL;
+  }
+
+  if(w->w_cache){
+    destroy_parse_katcl(w->w_cache);
+    w->w_cache = NULL;
+  }
+
+  px = make_sensor_katcp(d, name, w->w_variable, KATCP_SENSOR_STATUS_INFORM);
+  if(px == NULL){
+    return NULL;
+  }
+
+  w->w_cache = px;
+  w->w_stamp = s->s_sample_pass;
+
+  return px;
+}
+
+static struct katcl_parse *sample_wit_katcp(struct katcp_dispatch *d, struct katcp_wit *w)
+{
+  struct katcp_shared *s;
+
+  s = d->d_shared;
+
+  if(w->w_cache && (w->w_stamp == s->s_sample_pass)){
+    return w->w_cache;
+  }
+
+  return refresh_wit_katcp(d, w, NULL);
+}
+
+static int remove_subscribe_katcp(struct katcp_dispatch *d, struct katcp_wit *w, struct katcp_subscribe *sub)
+{
+  unsigned int i;
+
+  for(i = 0; i < w->w_size; i++){
+    if(w->w_vector[i] == sub){
+      return delete_subscribe_katcp(d, w, i);
+    }
+  }
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  fprintf(stderr, "sensor: major logic problem: subscription %p not held by its wit %p\n", sub, w);
+  abort();
+#endif
+
+  return -1;
+}
+
+int run_sampling_katcp(struct katcp_dispatch *d, void *data)
+{
+  struct katcp_shared *s;
+  struct katcp_subscribe *sub;
+  struct katcp_wit *w;
+  struct katcl_parse *px;
+  struct timeval now, limit, slack;
+  unsigned int count;
+  double value;
+  int numeric;
+
+  s = d->d_shared;
+
+  s->s_sample_due.tv_sec = 0;
+  s->s_sample_due.tv_usec = 0;
+
+  gettimeofday(&now, NULL);
+
+  slack.tv_sec = 0;
+  slack.tv_usec = KATCP_SAMPLE_SLACK;
+  add_time_katcp(&limit, &now, &slack);
+
+  /* a new pass: each sensor gets formatted at most once, and all sends to a flat end up in its output before the next write */
+  s->s_sample_pass++;
+  count = 0;
+
+  while(s->s_sampled > 0){
+    sub = s->s_sampling[0];
+    if(cmp_time_katcp(&(sub->s_when), &limit) > 0){
+      break;
+    }
+
+    w = sub->s_wit;
+    sane_wit(w);
+
+    px = sample_wit_katcp(d, w);
+    if(px == NULL){
+      /* nothing to report, try again later */
+      sub->s_held = 0;
+      sub->s_last.tv_sec = now.tv_sec;
+      sub->s_last.tv_usec = now.tv_usec;
+      plan_subscribe_katcp(d, sub, &now);
+      continue;
+    }
+
+    if(send_message_endpoint_katcp(d, w->w_endpoint, sub->s_endpoint, px, 0) < 0){
+      /* also takes it off the heap */
+      remove_subscribe_katcp(d, w, sub);
+      continue;
+    }
+
+    numeric = value_sensor_katcp(d, w->w_variable, &value);
+    note_subscribe_katcp(sub, &now, numeric, value);
+
+    plan_subscribe_katcp(d, sub, &now);
+
+    count++;
+  }
+
+#ifdef DEBUG
+  fprintf(stderr, "sensor: sampling pass %u sent %u updates, %u subscriptions pending\n", s->s_sample_pass, count, s->s_sampled);
+#endif
+
+  arm_sampling_katcp(d);
+
+  return 0;
+}
+
+static int arm_sampling_katcp(struct katcp_dispatch *d)
+{
+  struct katcp_shared *s;
+  struct timeval *when;
+
+  s = d->d_shared;
+
+  if(s->s_sampled <= 0){
+    /* let an armed timer run out, it will find nothing to do */
+    return 0;
+  }
+
+  when = &(s->s_sampling[0]->s_when);
+
+  if((s->s_sample_due.tv_sec || s->s_sample_due.tv_usec) && (cmp_time_katcp(&(s->s_sample_due), when) <= 0)){
+    return 0;
+  }
+
+  if(register_at_tv_katcp(d, when, &run_sampling_katcp, &(s->s_sampled)) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to arm sensor sampling timer");
+    return -1;
+  }
+
+  s->s_sample_due.tv_sec = when->tv_sec;
+  s->s_sample_due.tv_usec = when->tv_usec;
+
+  return 0;
+}
+
+void destroy_sampling_katcp(struct katcp_dispatch *d)
+{
+  struct katcp_shared *s;
+  unsigned int i;
+
+  s = d->d_shared;
+  if(s == NULL){
+    return;
+  }
+
+  for(i = 0; i < s->s_sampled; i++){
+    s->s_sampling[i]->s_index = (-1);
+  }
+
+  if(s->s_sampling){
+    free(s->s_sampling);
+    s->s_sampling = NULL;
+  }
+
+  s->s_sampled = 0;
+  s->s_sample_size = 0;
+}
+
+/*************************************************************************/
+
 int broadcast_subscribe_katcp(struct katcp_dispatch *d, struct katcp_wit *w, struct katcl_parse *px)
 {
   unsigned int i, inc;
   struct katcp_subscribe *sub;
+  struct timeval now, due;
+  double value;
+  int numeric, send;
 
   sane_wit(w);
 
@@ -262,6 +702,9 @@ int broadcast_subscribe_katcp(struct katcp_dispatch *d, struct katcp_wit *w, str
   fprintf(stderr, "sensor: broadcasting sensor update to %u interested parties\n", w->w_size);
 #endif
 
+  numeric = value_sensor_katcp(d, w->w_variable, &value);
+  gettimeofday(&now, NULL);
+
   i = 0; 
   while(i < w->w_size){
     sub = w->w_vector[i];
@@ -276,7 +719,50 @@ int broadcast_subscribe_katcp(struct katcp_dispatch *d, struct katcp_wit *w, str
 
     /* WARNING: for events: should we check that something actually has changed ? */
 
-    if(sub->s_strategy == KATCP_STRATEGY_EVENT){
+    switch(sub->s_strategy){
+      case KATCP_STRATEGY_EVENT :
+        send = 1;
+        break;
+
+      case KATCP_STRATEGY_PERIOD :
+        /* picked up by the sampling schedule */
+        send = 0;
+        break;
+
+      case KATCP_STRATEGY_DIFF :
+        send = differs_subscribe_katcp(sub, numeric, value);
+        break;
+
+      case KATCP_STRATEGY_DIFF_RATE :
+      case KATCP_STRATEGY_EVENT_RATE :
+        if((sub->s_strategy == KATCP_STRATEGY_DIFF_RATE) && (differs_subscribe_katcp(sub, numeric, value) == 0)){
+          send = 0;
+          break;
+        }
+        add_time_katcp(&due, &(sub->s_last), &(sub->s_floor));
+        if(cmp_time_katcp(&now, &due) < 0){
+          /* too soon, let the schedule send the latest value once the shortest period has passed */
+          if(sub->s_held == 0){
+            sub->s_held = 1;
+            plan_subscribe_katcp(d, sub, &now);
+            arm_sampling_katcp(d);
+          }
+          send = 0;
+        } else {
+          send = 1;
+        }
+        break;
+
+      default :
+#ifdef KATCP_CONSISTENCY_CHECKS
+        fprintf(stderr, "major logic problem: unimplemented sensor strategy %u\n", sub->s_strategy);
+        abort();
+#endif
+        send = 0;
+        break;
+    }
+
+    if(send){
       if(send_message_endpoint_katcp(d, w->w_endpoint, sub->s_endpoint, px, 0) < 0){
 #if 0
         log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "subscriber %u/%u unreachable at enpoint %p, retiring it", i, w->w_size, sub->s_endpoint);
@@ -284,12 +770,14 @@ int broadcast_subscribe_katcp(struct katcp_dispatch *d, struct katcp_wit *w, str
         /* other end could have gone away, notice it ... */
         delete_subscribe_katcp(d, w, i); /* implies a w_size-- */
         inc = 0;
+      } else {
+        note_subscribe_katcp(sub, &now, numeric, value);
+        if(sub->s_index >= 0){
+          /* rate strategies: longest period restarts from now */
+          plan_subscribe_katcp(d, sub, &now);
+          arm_sampling_katcp(d);
+        }
       }
-#ifdef KATCP_CONSISTENCY_CHECKS
-    } else {
-      fprintf(stderr, "major logic problem: unimplemented sensor strategy %u\n", sub->s_strategy);
-      abort();
-#endif
     }
 
     i += inc;
@@ -326,11 +814,11 @@ int is_vrbl_sensor_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx)
 
 /*************************************************************************/
 
-static char *sensor_strategy_table[KATCP_STRATEGIES_COUNT] = { "none", "period", "event", "differential", "forced" };
+static char *sensor_strategy_table[SENSOR_STRATEGY_COUNT] = { "none", "period", "event", "differential", "forced", "event-rate", "differential-rate" };
 
 char *strategy_to_string_sensor_katcp(struct katcp_dispatch *d, unsigned int strategy)
 {
-  if(strategy >= KATCP_STRATEGIES_COUNT){
+  if(strategy >= SENSOR_STRATEGY_COUNT){
     return NULL;
   }
 
@@ -345,7 +833,7 @@ int strategy_from_string_sensor_katcp(struct katcp_dispatch *d, char *name)
     return -1;
   }
 
-  for(i = 0; i < KATCP_STRATEGIES_COUNT; i++){
+  for(i = 0; i < SENSOR_STRATEGY_COUNT; i++){
     if(!strcmp(name, sensor_strategy_table[i])){
       return i;
     }
@@ -478,15 +966,14 @@ int change_sensor_katcp(struct katcp_dispatch *d, void *state, char *name, struc
     return 0;
   }
 
-  px = make_sensor_katcp(d, name, vx, KATCP_SENSOR_STATUS_INFORM);
+  /* held by the wit, also serves the sampling pass */
+  px = refresh_wit_katcp(d, w, name);
   if(px == NULL){
     return -1;
   }
 
   broadcast_subscribe_katcp(d, w, px);
 
-  destroy_parse_katcl(px);
-
   return 0;
 }
 
@@ -531,6 +1018,8 @@ struct katcp_subscribe *attach_variable_katcp(struct katcp_dispatch *d, struct k
     w = vx->v_extra;
   }
 
+  w->w_variable = vx;
+
   sub = create_subscribe_katcp(d, w, fx);
   if(sub == NULL){
     return NULL;
@@ -539,10 +1028,124 @@ struct katcp_subscribe *attach_variable_katcp(struct katcp_dispatch *d, struct k
   return sub;
 }
 
-int monitor_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx)
+static int scan_interval_sensor_katcp(struct timeval *tv, char *string)
+{
+#if KATCP_PROTOCOL_MAJOR_VERSION >= 5 
+  return string_to_tv_katcp(tv, string);
+#else
+  unsigned long period;
+  char *end;
+
+  period = strtoul(string, &end, 10);
+  if((end == string) || (*end != '\0')){
+    return -1;
+  }
+
+  tv->tv_sec = period / 1000;
+  tv->tv_usec = (period % 1000) * 1000;
+
+  return 0;
+#endif
+}
+
+static int append_interval_sensor_katcp(struct katcp_dispatch *d, int flags, struct timeval *tv)
+{
+#if KATCP_PROTOCOL_MAJOR_VERSION >= 5 
+  return append_args_katcp(d, flags | KATCP_FLAG_STRING, "%lu.%06lu", tv->tv_sec, tv->tv_usec);
+#else
+  return append_unsigned_long_katcp(d, flags | KATCP_FLAG_ULONG, (tv->tv_sec * 1000) + (tv->tv_usec / 1000));
+#endif
+}
+
+int monitor_strategy_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx, unsigned int strategy, char **vector, unsigned int count)
 {
   struct katcp_subscribe *sub;
   struct katcl_parse *px;
+  struct timeval period, floor, minimum, now;
+  unsigned int need, i;
+  double delta, value;
+  char *end, *name;
+  int numeric;
+
+  name = strategy_to_string_sensor_katcp(d, strategy);
+
+  switch(strategy){
+    case KATCP_STRATEGY_EVENT :
+      need = 0;
+      break;
+    case KATCP_STRATEGY_PERIOD :
+    case KATCP_STRATEGY_DIFF :
+      need = 1;
+      break;
+    case KATCP_STRATEGY_EVENT_RATE :
+      need = 2;
+      break;
+    case KATCP_STRATEGY_DIFF_RATE :
+      need = 3;
+      break;
+    default :
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "sampling strategy %s not available for duplex sensors", name ? name : "unknown");
+      return -1;
+  }
+
+  if(count < need){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "sampling strategy %s requires %u %s", name, need, (need == 1) ? "parameter" : "parameters");
+    return -1;
+  }
+
+  period.tv_sec = 0;
+  period.tv_usec = 0;
+  floor.tv_sec = 0;
+  floor.tv_usec = 0;
+  delta = 0.0;
+
+  minimum.tv_sec = 0;
+  minimum.tv_usec = KATCP_SAMPLE_SLACK;
+
+  numeric = value_sensor_katcp(d, vx, &value);
+
+  i = 0;
+
+  if((strategy == KATCP_STRATEGY_DIFF) || (strategy == KATCP_STRATEGY_DIFF_RATE)){
+    if(numeric < 0){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "differential strategy needs a numeric sensor value");
+      return -1;
+    }
+    delta = strtod(vector[i], &end);
+    if((end == vector[i]) || (*end != '\0') || (delta < 0.0)){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to scan delta value %s", vector[i]);
+      return -1;
+    }
+    i++;
+  }
+
+  if((strategy == KATCP_STRATEGY_EVENT_RATE) || (strategy == KATCP_STRATEGY_DIFF_RATE)){
+    if(scan_interval_sensor_katcp(&floor, vector[i]) < 0){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to scan shortest period %s", vector[i]);
+      return -1;
+    }
+    i++;
+  }
+
+  if((strategy == KATCP_STRATEGY_PERIOD) || (strategy == KATCP_STRATEGY_EVENT_RATE) || (strategy == KATCP_STRATEGY_DIFF_RATE)){
+    if(scan_interval_sensor_katcp(&period, vector[i]) < 0){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to scan period %s", vector[i]);
+      return -1;
+    }
+    i++;
+
+    if((strategy == KATCP_STRATEGY_PERIOD) || period.tv_sec || period.tv_usec){
+      if(cmp_time_katcp(&period, &minimum) < 0){
+        period.tv_sec = minimum.tv_sec;
+        period.tv_usec = minimum.tv_usec;
+        log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "clamping sampling period to %lu.%06lus", period.tv_sec, period.tv_usec);
+      }
+      if(cmp_time_katcp(&period, &floor) < 0){
+        log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "longest period should not be shorter than shortest period");
+        return -1;
+      }
+    }
+  }
 
   px = make_sensor_katcp(d, NULL, vx, KATCP_SENSOR_STATUS_INFORM);
   if(px == NULL){
@@ -558,7 +1161,27 @@ int monitor_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx
     }
   }
 
-  sub->s_strategy = KATCP_STRATEGY_EVENT;
+  sub->s_strategy = strategy;
+
+  sub->s_period.tv_sec = period.tv_sec;
+  sub->s_period.tv_usec = period.tv_usec;
+  sub->s_floor.tv_sec = floor.tv_sec;
+  sub->s_floor.tv_usec = floor.tv_usec;
+  sub->s_delta = delta;
+
+  /* the current value goes out now, the schedule takes it from there */
+  gettimeofday(&now, NULL);
+  note_subscribe_katcp(sub, &now, numeric, value);
+
+  sub->s_when.tv_sec = 0;
+  sub->s_when.tv_usec = 0;
+
+  if(plan_subscribe_katcp(d, sub, &now) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to schedule sampling");
+    destroy_parse_katcl(px);
+    return -1;
+  }
+  arm_sampling_katcp(d);
 
   append_parse_katcp(d, px);
   destroy_parse_katcl(px);
@@ -566,6 +1189,54 @@ int monitor_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx
   return 0;
 }
 
+int monitor_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx)
+{
+  return monitor_strategy_variable_katcp(d, vx, fx, KATCP_STRATEGY_EVENT, NULL, 0);
+}
+
+int append_strategy_variable_katcp(struct katcp_dispatch *d, int flags, struct katcp_vrbl *vx, struct katcp_flat *fx)
+{
+  struct katcp_subscribe *sub;
+  unsigned int strategy;
+  char *name;
+  int result;
+
+  sub = locate_subscribe_katcp(d, vx, fx);
+  strategy = (sub == NULL) ? KATCP_STRATEGY_OFF : sub->s_strategy;
+
+  name = strategy_to_string_sensor_katcp(d, strategy);
+  if(name == NULL){
+    return -1;
+  }
+
+  switch(strategy){
+    case KATCP_STRATEGY_PERIOD :
+      result = append_string_katcp(d, KATCP_FLAG_STRING, name);
+      result += append_interval_sensor_katcp(d, flags & KATCP_FLAG_LAST, &(sub->s_period));
+      break;
+    case KATCP_STRATEGY_DIFF :
+      result = append_string_katcp(d, KATCP_FLAG_STRING, name);
+      result += append_args_katcp(d, KATCP_FLAG_STRING | (flags & KATCP_FLAG_LAST), "%g", sub->s_delta);
+      break;
+    case KATCP_STRATEGY_EVENT_RATE :
+      result = append_string_katcp(d, KATCP_FLAG_STRING, name);
+      result += append_interval_sensor_katcp(d, 0, &(sub->s_floor));
+      result += append_interval_sensor_katcp(d, flags & KATCP_FLAG_LAST, &(sub->s_period));
+      break;
+    case KATCP_STRATEGY_DIFF_RATE :
+      result = append_string_katcp(d, KATCP_FLAG_STRING, name);
+      result += append_args_katcp(d, KATCP_FLAG_STRING, "%g", sub->s_delta);
+      result += append_interval_sensor_katcp(d, 0, &(sub->s_floor));
+      result += append_interval_sensor_katcp(d, flags & KATCP_FLAG_LAST, &(sub->s_period));
+      break;
+    default :
+      result = append_string_katcp(d, KATCP_FLAG_STRING | (flags & KATCP_FLAG_LAST), name);
+      break;
+  }
+
+  return result;
+}
+
 int forget_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx)
 {
   int index;
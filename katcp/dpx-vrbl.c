@@ -362,6 +362,56 @@ int set_string_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struc
   return actually_set_string_vrbl_katcp(d, vx, py, value, 0);
 }
 
+/* replace several string payloads of one variable, either all or none change, the change callback runs once at the end */
+int set_strings_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_vrbl_payload **vector, char **values, unsigned int count)
+{
+  struct katcp_vrbl_payload *py;
+  unsigned int i;
+  int len, have;
+  char *ptr;
+
+  if(vx == NULL){
+#ifdef KATCP_CONSISTENCY_CHECKS
+    abort();
+#else
+    return -1;
+#endif
+  }
+
+  for(i = 0; i < count; i++){
+    if((vector[i] == NULL) || (vector[i]->p_type != KATCP_VRT_STRING) || (values[i] == NULL)){
+      return -1;
+    }
+  }
+
+  /* grow everything first, so that an allocation failure leaves the old values intact */
+  for(i = 0; i < count; i++){
+    py = vector[i];
+    len = strlen(values[i]) + 1;
+    have = py->p_union.u_string ? (strlen(py->p_union.u_string) + 1) : 0;
+    if(len > have){
+      ptr = realloc(py->p_union.u_string, len);
+      if(ptr == NULL){
+        return -1;
+      }
+      if(have == 0){
+        ptr[0] = '\0';
+      }
+      py->p_union.u_string = ptr;
+    }
+  }
+
+  for(i = 0; i < count; i++){
+    memcpy(vector[i]->p_union.u_string, values[i], strlen(values[i]) + 1);
+  }
+
+  if(vx->v_change){
+    (*(vx->v_change))(d, vx->v_extra, vx->v_name, vx);
+  }
+
+  return 0;
+}
+
 int scan_string_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_vrbl_payload *py, char *text, char *path, int how, unsigned int type)
 {
 
@@ -1601,6 +1651,11 @@ void release_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct
     return;
   }
 
+  /* anybody holding on to payloads has to look them up again */
+  if(d && d->d_shared){
+    d->d_shared->s_vrbl_epoch++;
+  }
+
   if(py->p_type < KATCP_MAX_VRT){
     (*(ops_type_vrbl[py->p_type].t_clear))(d, vx, py);
     py->p_type = KATCP_VRT_GONE;
@@ -1942,6 +1997,11 @@ static int insert_region_katcp(struct katcp_dispatch *d, struct katcp_region *rx
     return -1;
   }
 
+  /* might shadow a variable of the same name further up */
+  if(d->d_shared){
+    d->d_shared->s_vrbl_epoch++;
+  }
+
   /* WARNING v_name will become invalid whenever this is removed from tree */
   /* TODO - check that variable deletion unsets this ? */
   vx->v_name = node->n_key;
@@ -2549,7 +2609,7 @@ struct katcp_region *create_region_katcp(struct katcp_dispatch *d)
     return NULL;
   }
 
-  rx->r_tree = create_avltree();
+  rx->r_tree = create_indexed_avltree();
 
   if(rx->r_tree == NULL){
     destroy_region_katcp(d, rx);
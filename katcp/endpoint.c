@@ -27,6 +27,13 @@
 
 #define KATCP_ENDPOINT_MAGIC 0x4c06dd5c
 
+/* messages are kept in one fifo per level, each fifo has a precedence */
+/* and is eligible for delivery if it is at least that of the endpoint */
+#define ENDPOINT_LEVEL_REQUEST     0
+#define ENDPOINT_LEVEL_OTHER       1
+
+static unsigned int precedence_level_endpoint[KATCP_ENDPOINT_LEVELS] = { ENDPOINT_PRECEDENCE_LOW, ENDPOINT_PRECEDENCE_HIGH };
+
 #ifdef KATCP_CONSISTENCY_CHECKS
 void sane_endpoint_katcp(struct katcp_endpoint *ep)
 {
@@ -54,6 +61,8 @@ static void clear_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint
 static void free_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep);
 
 static void precedence_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, unsigned int precedence);
+static struct katcp_message *head_endpoint_katcp(struct katcp_endpoint *ep, unsigned int precedence);
+static void ready_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep);
 
 /* setup/destroy routines for messages **********************************/
 
@@ -74,7 +83,8 @@ static struct katcp_message *create_message_katcp(struct katcp_dispatch *d, stru
   msg->m_parse = NULL;
   msg->m_from = NULL;
   msg->m_to = NULL;
-
+  msg->m_level = ENDPOINT_LEVEL_OTHER;
+  msg->m_sequence = 0;
 
   if(acknowledged){
 #ifdef KATCP_CONSISTENCY_CHECKS
@@ -126,11 +136,24 @@ static int queue_message_katcp(struct katcp_dispatch *d, struct katcp_message *m
     return -1;
   }
 
-  if(add_tail_gueue_katcl(ep->e_queue, msg)){
+  if(msg->m_parse && is_request_parse_katcl(msg->m_parse)){
+    /* requests are low priority, handle existing work before attempting new */
+    msg->m_level = ENDPOINT_LEVEL_REQUEST;
+  } else {
+    msg->m_level = ENDPOINT_LEVEL_OTHER;
+  }
+
+  msg->m_sequence = ep->e_sequence++;
+
+  if(add_tail_gueue_katcl(ep->e_fifo[msg->m_level], msg)){
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to queue message");
     return -1;
   }
 
+  if(precedence_level_endpoint[msg->m_level] >= ep->e_precedence){
+    ready_endpoint_katcp(d, ep);
+  }
+
   return 0;
 }
 
@@ -254,7 +277,7 @@ struct katcp_message *head_message_endpoint_katcp(struct katcp_dispatch *d, stru
     return NULL;
   }
 
-  msg = get_head_gueue_katcl(ep->e_queue);
+  msg = head_endpoint_katcp(ep, 0);
 
   return msg;
 }
@@ -287,27 +310,10 @@ struct katcp_endpoint *create_endpoint_katcp(struct katcp_dispatch *d, int (*wak
   return ep;
 }
 
-static unsigned int compute_precedence_endpoint(void *datum)
-{
-  struct katcp_message *msg;
-
-  msg = datum;
-
-  if(msg->m_parse == NULL){
-    return ENDPOINT_PRECEDENCE_HIGH;    
-  }
-  
-  if(is_request_parse_katcl(msg->m_parse)){
-    /* requests are low priority, handle existing work before attempting new */
-    return ENDPOINT_PRECEDENCE_LOW;
-  }
-
-  return ENDPOINT_PRECEDENCE_HIGH;
-}
-
 int init_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, int (*wake)(struct katcp_dispatch *d, struct katcp_endpoint *ep, struct katcp_message *msg, void *data), void (*release)(struct katcp_dispatch *d, void *data), void *data)
 {
   struct katcp_shared *s;
+  unsigned int i;
 
   s = d->d_shared;
 
@@ -316,16 +322,33 @@ int init_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, int
   ep->e_state = ENDPOINT_STATE_GONE;
   ep->e_refcount = 0; 
 
+  ep->e_precedence = ENDPOINT_PRECEDENCE_LOW;
+  ep->e_sequence = 0;
+
+  ep->e_ready = 0;
+  ep->e_ready_next = NULL;
+  ep->e_pass = 0;
+
+  ep->e_wake    = NULL;
+  ep->e_release = NULL;
+  ep->e_data    = NULL;
+
+  ep->e_next = NULL;
+
   /* destroying an endpoint with items in the queue is a serious failure */
   /* and can not be done properly anyway as there may be acknowledged    */
   /* in flight - hence the NULL release function */
 
-  ep->e_queue = create_precedence_gueue_katcl(NULL, &compute_precedence_endpoint);
-  ep->e_precedence = ENDPOINT_PRECEDENCE_LOW;
+  for(i = 0; i < KATCP_ENDPOINT_LEVELS; i++){
+    ep->e_fifo[i] = NULL;
+  }
 
-  if(ep->e_queue == NULL){
-    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to initialise endpoint");
-    return -1;
+  for(i = 0; i < KATCP_ENDPOINT_LEVELS; i++){
+    ep->e_fifo[i] = create_gueue_katcl(NULL);
+    if(ep->e_fifo[i] == NULL){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to initialise endpoint");
+      return -1;
+    }
   }
 
   ep->e_wake    = wake;
@@ -348,6 +371,8 @@ int init_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, int
 
 static void clear_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
 {
+  unsigned int i;
+
   sane_endpoint_katcp(ep);
 
 #ifdef KATCP_CONSISTENCY_CHECKS
@@ -357,15 +382,24 @@ static void clear_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint
   }
 #endif
   
-  if(ep->e_queue){
 #ifdef KATCP_CONSISTENCY_CHECKS
-    if(size_gueue_katcl(ep->e_queue) > 0){
-      fprintf(stderr, "endpoint: logic failure: attempting to clear endpoint which still has items in queue\n");
-      abort();
-    }
+  if(ep->e_ready){
+    fprintf(stderr, "endpoint: logic failure: attempting to clear endpoint which is still marked ready\n");
+    abort();
+  }
 #endif
-    destroy_gueue_katcl(ep->e_queue);
-    ep->e_queue = NULL;
+
+  for(i = 0; i < KATCP_ENDPOINT_LEVELS; i++){
+    if(ep->e_fifo[i]){
+#ifdef KATCP_CONSISTENCY_CHECKS
+      if(size_gueue_katcl(ep->e_fifo[i]) > 0){
+        fprintf(stderr, "endpoint: logic failure: attempting to clear endpoint which still has items in queue\n");
+        abort();
+      }
+#endif
+      destroy_gueue_katcl(ep->e_fifo[i]);
+      ep->e_fifo[i] = NULL;
+    }
   }
 
   ep->e_wake = NULL;
@@ -420,6 +454,10 @@ void forget_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
 #endif
   }
 
+  if(ep->e_refcount == 0){
+    d->d_shared->s_endpoint_sweep = 1;
+  }
+
   /* do deallocation in global run_endpoints_katcp */
 }
 
@@ -427,16 +465,114 @@ void forget_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
 
 int pending_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
 {
+  unsigned int i;
+  int total;
+
   sane_endpoint_katcp(ep);
 
+  total = 0;
+
+  for(i = 0; i < KATCP_ENDPOINT_LEVELS; i++){
 #ifdef KATCP_CONSISTENCY_CHECKS
-  if(ep->e_queue == NULL){
-    fprintf(stderr, "endpoint: endpoint %p has no queue\n", ep);
-    abort();
+    if(ep->e_fifo[i] == NULL){
+      fprintf(stderr, "endpoint: endpoint %p has no queue\n", ep);
+      abort();
+    }
+#endif
+    total += size_gueue_katcl(ep->e_fifo[i]);
   }
+
+  return total;
+}
+
+static struct katcp_message *head_endpoint_katcp(struct katcp_endpoint *ep, unsigned int precedence)
+{
+  /* oldest message at the head of any eligible fifo, compare sequence numbers allowing for wrap */
+  struct katcp_message *msg, *best;
+  unsigned int i;
+
+  best = NULL;
+
+  for(i = 0; i < KATCP_ENDPOINT_LEVELS; i++){
+    if(precedence_level_endpoint[i] < precedence){
+      continue;
+    }
+    msg = get_head_gueue_katcl(ep->e_fifo[i]);
+    if(msg == NULL){
+      continue;
+    }
+    if((best == NULL) || (((int)(msg->m_sequence - best->m_sequence)) < 0)){
+      best = msg;
+    }
+  }
+
+  return best;
+}
+
+static int remove_endpoint_katcp(struct katcp_endpoint *ep, struct katcp_message *msg)
+{
+  /* normally msg is at the head of its fifo, so this is cheap */
+  if(remove_datum_gueue_katcl(ep->e_fifo[msg->m_level], msg) == NULL){
+#ifdef KATCP_CONSISTENCY_CHECKS
+    fprintf(stderr, "endpoint: major corruption in queue: unable to remove %p\n", msg);
+    abort();
 #endif
+    return -1;
+  }
 
-  return size_gueue_katcl(ep->e_queue);
+  return 0;
+}
+
+static void ready_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
+{
+  struct katcp_shared *s;
+
+  if(ep->e_ready){
+    return;
+  }
+
+  s = d->d_shared;
+
+  ep->e_ready = 1;
+  ep->e_ready_next = NULL;
+
+  if(s->s_waking_tail){
+    s->s_waking_tail->e_ready_next = ep;
+  } else {
+    s->s_waking_head = ep;
+  }
+  s->s_waking_tail = ep;
+}
+
+static void unready_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
+{
+  struct katcp_endpoint *ex, *et;
+  struct katcp_shared *s;
+
+  if(ep->e_ready == 0){
+    return;
+  }
+
+  s = d->d_shared;
+
+  ex = NULL;
+  for(et = s->s_waking_head; et && (et != ep); et = et->e_ready_next){
+    ex = et;
+  }
+
+  if(et){
+    if(ex){
+      ex->e_ready_next = ep->e_ready_next;
+    } else {
+      s->s_waking_head = ep->e_ready_next;
+    }
+    if(s->s_waking_tail == ep){
+      s->s_waking_tail = ex;
+    }
+  }
+
+  ep->e_ready = 0;
+  ep->e_ready_next = NULL;
 }
 
 int vturnaround_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, struct katcp_message *msg, int code, char *fmt, va_list args)
@@ -531,7 +667,7 @@ int answer_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, s
     return -1;
   }
 
-  msg = get_head_gueue_katcl(ep->e_queue);
+  msg = head_endpoint_katcp(ep, 0);
   if(msg == NULL){
 #ifdef KATCP_CONSISTENCY_CHECKS
     fprintf(stderr, "endpoint: no message available, nothing to answer\n");
@@ -581,7 +717,21 @@ struct katcp_endpoint *destination_endpoint_katcp(struct katcp_dispatch *d, stru
 
 static void precedence_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep, unsigned int precedence)
 {
+  unsigned int previous;
+
+  if(ep == NULL){
+    return;
+  }
+
+  previous = ep->e_precedence;
   ep->e_precedence = precedence;
+
+  /* only a lowered precedence can make messages deliverable */
+  if((precedence < previous) && (ep->e_state & ENDPOINT_STATE_UP)){
+    if(head_endpoint_katcp(ep, precedence)){
+      ready_endpoint_katcp(d, ep);
+    }
+  }
 }
 
 void close_receiving_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
@@ -625,7 +775,8 @@ int flush_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
 
   count = 0;
 
-  while((msg = remove_head_gueue_katcl(ep->e_queue)) != NULL){
+  while((msg = head_endpoint_katcp(ep, 0)) != NULL){
+    remove_endpoint_katcp(ep, msg);
     if(is_request_parse_katcl(msg->m_parse)){
       turnaround_endpoint_katcp(d, ep, msg, KATCP_RESULT_FAIL, "handler detached");
     } else {
@@ -665,6 +816,8 @@ int release_endpoint_katcp(struct katcp_dispatch *d, struct katcp_endpoint *ep)
 
   ep->e_state = ENDPOINT_STATE_GONE;
 
+  d->d_shared->s_endpoint_sweep = 1;
+
   return count;
 
   /* do actual cleanup in global run_endpoints */
@@ -690,6 +843,7 @@ void release_endpoints_katcp(struct katcp_dispatch *d)
 #endif
 
   /* WARNING: assume that previous routines have cleaned up, collect all unowned endpoints */
+  s->s_endpoint_sweep = 1;
   run_endpoints_katcp(d);
 
 #ifdef KATCP_CONSISTENCY_CHECKS
@@ -699,134 +853,39 @@ void release_endpoints_katcp(struct katcp_dispatch *d)
 #endif
 }
 
-void load_endpoints_katcp(struct katcp_dispatch *d)
+void batch_endpoints_katcp(struct katcp_dispatch *d, unsigned int batch)
 {
-  struct katcp_endpoint *ep;
   struct katcp_shared *s;
 
   s = d->d_shared;
 
-  ep = s->s_endpoints;
-  while(ep){
+  /* zero restores the default */
+  s->s_endpoint_batch = (batch > 0) ? batch : KATCP_ENDPOINT_BATCH;
+}
 
-    if(get_precedence_head_gueue_katcl(ep->e_queue, ep->e_precedence) != NULL){
-      mark_busy_katcp(d);
-      return;
-    }
+void load_endpoints_katcp(struct katcp_dispatch *d)
+{
+  struct katcp_shared *s;
 
-    ep = ep->e_next;
+  s = d->d_shared;
+
+  if(s->s_waking_head){
+    mark_busy_katcp(d);
   }
 }
 
-void run_endpoints_katcp(struct katcp_dispatch *d)
+static void sweep_endpoints_katcp(struct katcp_dispatch *d)
 {
   struct katcp_endpoint *ep, *ex, *en;
   struct katcp_shared *s;
-  struct katcp_message *msg, *msx;
-  int result;
-#ifdef DEBUG
-  char *ptr;
-#endif
 
   s = d->d_shared;
 
+  s->s_endpoint_sweep = 0;
+
   ex = NULL;
   ep = s->s_endpoints;
   while(ep){
-
-    if(ep->e_state & ENDPOINT_STATE_UP){
-      msg = get_precedence_head_gueue_katcl(ep->e_queue, ep->e_precedence);
-      if(msg != NULL){
-#ifdef DEBUG
-        if(msg->m_parse){
-          ptr = get_string_parse_katcl(msg->m_parse, 0);
-        } else {
-          ptr = NULL;
-        }
-        fprintf(stderr, "endpoint[%p]: got message %p (from=%p, parse[%p]=%s ...)\n", ep, msg, msg->m_from, msg->m_parse, ptr);
-#endif
-#ifdef KATCP_CONSISTENCY_CHECKS
-        if(msg->m_to != ep){
-          fprintf(stderr, "endpoint[%p]: consistency failure: message destined for endpoint %p\n", msg->m_to, ep);
-          abort();
-        }
-#endif
-        if(ep->e_wake){
-          result = (*(ep->e_wake))(d, ep, msg, ep->e_data);
-        } else {
-#ifdef DEBUG
-          fprintf(stderr, "endpoint[%p]: unusual condition - endpoint saw message despite having no wake handler set\n", ep);
-#endif          
-          result = KATCP_RESULT_FAIL;
-        }
-#ifdef DEBUG
-        fprintf(stderr, "endpoint[%p]: callback %p returns %d\n", ep, ep->e_wake, result);
-#endif
-        switch(result){
-
-          case KATCP_RESULT_OWN :
-            /* all comms done internal to wake callback */
-            if(remove_datum_gueue_katcl(ep->e_queue, msg) == NULL){
-#ifdef KATCP_CONSISTENCY_CHECKS
-              fprintf(stderr, "endpoint: major corruption in queue: unable to remove %p\n", msg);
-              abort();
-#endif
-            }
-            destroy_message_katcp(d, msg);
-            /* WARNING: fall - pause also removes queued message */
-          case KATCP_RESULT_PAUSE :
-#ifdef KATCP_CONSISTENCY_CHECKS
-            /* TODO: check that we aren't in a HIGH state already, check that only requests stall the processing queue */
-#endif
-            precedence_endpoint_katcp(d, ep, ENDPOINT_PRECEDENCE_HIGH);
-            break;
-
-          case KATCP_RESULT_OK :
-          case KATCP_RESULT_FAIL :
-          case KATCP_RESULT_INVALID :
-
-            if(remove_datum_gueue_katcl(ep->e_queue, msg) == NULL){
-#ifdef KATCP_CONSISTENCY_CHECKS
-              fprintf(stderr, "endpoint: major corruption in queue: unable to remove %p\n", msg);
-              abort();
-#endif
-            }
-            if(is_request_parse_katcl(msg->m_parse)){
-              turnaround_endpoint_katcp(d, ep, msg, result, NULL);
-            } else {
-              destroy_message_katcp(d, msg);
-            }
-
-            break;
-
-          case KATCP_RESULT_YIELD :
-#if 0
-            /* WARNING: redundant, run for all cases below, but case needed to avoid triggering paranoia check */
-            mark_busy_katcp(d);
-#endif
-            break;
-
-          default :
-#ifdef KATCP_CONSISTENCY_CHECKS
-            fprintf(stderr, "endpoint: bad return code %d from wake callback\n", result);
-            abort();
-#endif
-            break;
-        }
-
-        msx = get_precedence_head_gueue_katcl(ep->e_queue, ep->e_precedence);
-        if(msx){
-          mark_busy_katcp(d);
-        }
-
-#ifdef DEBUG
-      } else {
-        fprintf(stderr, "endpoint[%p]: idle\n", ep);
-#endif
-      }
-
-    }
-
     if((ep->e_state == ENDPOINT_STATE_GONE) && (ep->e_refcount <= 0)){
       /* collect GONE endpoints */
       en = ep->e_next; 
@@ -838,6 +897,8 @@ void run_endpoints_katcp(struct katcp_dispatch *d)
 
       ep->e_next = NULL;
 
+      unready_endpoint_katcp(d, ep);
+
       if(ep->e_freeable){
         free_endpoint_katcp(d, ep);
       } else {
@@ -851,21 +912,164 @@ void run_endpoints_katcp(struct katcp_dispatch *d)
         fprintf(stderr, "endpoint[%p]: still referenced %u times with state 0x%x\n", ep, ep->e_refcount, ep->e_state);
       }
 #endif
-      /* still something to do */
       ex = ep;
       ep = ep->e_next;
     }
+  }
+}
+
+void run_endpoints_katcp(struct katcp_dispatch *d)
+{
+  struct katcp_endpoint *ep, *deferred, *last;
+  struct katcp_shared *s;
+  struct katcp_message *msg;
+  unsigned int count;
+  int result, more;
+#ifdef DEBUG
+  char *ptr;
+#endif
+
+  s = d->d_shared;
+
+  /* endpoints woken while we run are served in this pass too, but */
+  /* each only once, so that a busy pair can not starve the io */
+
+  s->s_endpoint_pass++;
+
+  deferred = NULL;
+  last = NULL;
+
+  while((ep = s->s_waking_head) != NULL){
+    sane_endpoint_katcp(ep);
+
+    s->s_waking_head = ep->e_ready_next;
+    if(s->s_waking_head == NULL){
+      s->s_waking_tail = NULL;
+    }
+    ep->e_ready_next = NULL;
 
+    if(ep->e_pass == s->s_endpoint_pass){
+      /* had its turn already, remains ready for the next pass */
+      if(last){
+        last->e_ready_next = ep;
+      } else {
+        deferred = ep;
+      }
+      last = ep;
+      continue;
+    }
+
+    ep->e_pass = s->s_endpoint_pass;
+
+    /* e_ready stays set while we deliver, so messages arriving now don't queue ep twice */
+
+    count = 0;
+    more = 1;
+
+    while(more && (count < s->s_endpoint_batch) && (ep->e_state & ENDPOINT_STATE_UP) && ((msg = head_endpoint_katcp(ep, ep->e_precedence)) != NULL)){
+#ifdef DEBUG
+      if(msg->m_parse){
+        ptr = get_string_parse_katcl(msg->m_parse, 0);
+      } else {
+        ptr = NULL;
+      }
+      fprintf(stderr, "endpoint[%p]: got message %p (from=%p, parse[%p]=%s ...)\n", ep, msg, msg->m_from, msg->m_parse, ptr);
+#endif
+#ifdef KATCP_CONSISTENCY_CHECKS
+      if(msg->m_to != ep){
+        fprintf(stderr, "endpoint[%p]: consistency failure: message destined for endpoint %p\n", msg->m_to, ep);
+        abort();
+      }
+#endif
+      count++;
+
+      if(ep->e_wake){
+        result = (*(ep->e_wake))(d, ep, msg, ep->e_data);
+      } else {
+#ifdef DEBUG
+        fprintf(stderr, "endpoint[%p]: unusual condition - endpoint saw message despite having no wake handler set\n", ep);
+#endif          
+        result = KATCP_RESULT_FAIL;
+      }
+#ifdef DEBUG
+      fprintf(stderr, "endpoint[%p]: callback %p returns %d\n", ep, ep->e_wake, result);
+#endif
+      switch(result){
+
+        case KATCP_RESULT_OWN :
+          /* all comms done internal to wake callback */
+          remove_endpoint_katcp(ep, msg);
+          destroy_message_katcp(d, msg);
+          precedence_endpoint_katcp(d, ep, ENDPOINT_PRECEDENCE_HIGH);
+          break;
+
+        case KATCP_RESULT_PAUSE :
+#ifdef KATCP_CONSISTENCY_CHECKS
+          /* TODO: check that we aren't in a HIGH state already, check that only requests stall the processing queue */
+#endif
+          precedence_endpoint_katcp(d, ep, ENDPOINT_PRECEDENCE_HIGH);
+          more = 0;
+          break;
+
+        case KATCP_RESULT_OK :
+        case KATCP_RESULT_FAIL :
+        case KATCP_RESULT_INVALID :
+
+          remove_endpoint_katcp(ep, msg);
+          if(is_request_parse_katcl(msg->m_parse)){
+            turnaround_endpoint_katcp(d, ep, msg, result, NULL);
+          } else {
+            destroy_message_katcp(d, msg);
+          }
+
+          break;
+
+        case KATCP_RESULT_YIELD :
+          /* try again on the next pass */
+          more = 0;
+          break;
+
+        default :
+#ifdef KATCP_CONSISTENCY_CHECKS
+          fprintf(stderr, "endpoint: bad return code %d from wake callback\n", result);
+          abort();
+#endif
+          more = 0;
+          break;
+      }
+    }
+
+#ifdef DEBUG
+    if(count == 0){
+      fprintf(stderr, "endpoint[%p]: idle\n", ep);
+    }
+#endif
+
+    ep->e_ready = 0;
+
+    if((ep->e_state & ENDPOINT_STATE_UP) && head_endpoint_katcp(ep, ep->e_precedence)){
+      ready_endpoint_katcp(d, ep);
+    }
   }
 
+  s->s_waking_head = deferred;
+  s->s_waking_tail = last;
+
+  if(s->s_waking_head){
+    mark_busy_katcp(d);
+  }
+
+  if(s->s_endpoint_sweep){
+    sweep_endpoints_katcp(d);
+  }
 }
 
 void show_endpoint_katcp(struct katcp_dispatch *d, char *prefix, int level, struct katcp_endpoint *ep)
 {
   log_message_katcp(d, level, NULL, "%s endpoint %p current precedence %u", prefix, ep, ep->e_precedence);
-  log_message_katcp(d, level, NULL, "%s endpoint %p size %u", prefix, ep, size_gueue_katcl(ep->e_queue));
+  log_message_katcp(d, level, NULL, "%s endpoint %p size %u (%u requests)", prefix, ep, pending_endpoint_katcp(d, ep), size_gueue_katcl(ep->e_fifo[ENDPOINT_LEVEL_REQUEST]));
   log_message_katcp(d, level, NULL, "%s endpoint %p references %u", prefix, ep, ep->e_refcount);
-  log_message_katcp(d, level, NULL, "%s endpoint %p state 0x%x", prefix, ep, ep->e_state);
+  log_message_katcp(d, level, NULL, "%s endpoint %p state 0x%x%s", prefix, ep, ep->e_state, ep->e_ready ? " ready" : "");
 }
 
 #endif
@@ -71,7 +71,7 @@ void destroy_gueue_katcl(struct katcl_gueue *g)
   unsigned int i, j;
 
   for(j = 0; j < g->g_count; j++){
-    i = (g->g_head + j) % g->g_size;
+    i = (g->g_head + j) & (g->g_size - 1);
     if(g->g_release){
       (*(g->g_release))(g->g_queue[i]);
     }
@@ -104,7 +104,7 @@ void clear_gueue_katcl(struct katcl_gueue *g)
 #endif
 
   for(j = 0; j < g->g_count; j++){
-    i = (g->g_head + j) % g->g_size;
+    i = (g->g_head + j) & (g->g_size - 1);
     if(g->g_release){
       (*(g->g_release))(g->g_queue[i]);
     }
@@ -112,13 +112,64 @@ void clear_gueue_katcl(struct katcl_gueue *g)
   }
 
   g->g_count = 0;
+  g->g_head = 0;
 }
 
 /* logic to manage the queue ****************************************************/
 
-int add_tail_gueue_katcl(struct katcl_gueue *g, void *datum)
+/* the queue is a ring of power of two size, doubling when full and halving once it drains to a quarter */
+
+#define GUEUE_MINIMUM   8    /* smallest allocation */
+#define GUEUE_KEEP     64    /* never shrink to below this */
+
+static int resize_gueue_katcl(struct katcl_gueue *g, unsigned int size)
 {
   void **tmp;
+  unsigned int i, j;
+
+  /* copies entries to the start of a fresh ring, so the head ends up at zero */
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if((size < g->g_count) || (size & (size - 1))){
+    fprintf(stderr, "generic queue: bad resize to %u with %u entries\n", size, g->g_count);
+    abort();
+  }
+#endif
+
+  tmp = malloc(sizeof(void *) * size);
+  if(tmp == NULL){
+    return -1;
+  }
+
+  for(j = 0; j < g->g_count; j++){
+    i = (g->g_head + j) & (g->g_size - 1);
+    tmp[j] = g->g_queue[i];
+  }
+  for(; j < size; j++){
+    tmp[j] = NULL;
+  }
+
+  if(g->g_queue){
+    free(g->g_queue);
+  }
+
+  g->g_queue = tmp;
+  g->g_size = size;
+  g->g_head = 0;
+
+  return 0;
+}
+
+static void shrink_gueue_katcl(struct katcl_gueue *g)
+{
+  if((g->g_size > GUEUE_KEEP) && (g->g_count <= (g->g_size / 4))){
+    /* failure to shrink is harmless, keep the larger ring */
+    resize_gueue_katcl(g, g->g_size / 2);
+  }
+}
+
+int add_tail_gueue_katcl(struct katcl_gueue *g, void *datum)
+{
   unsigned int index;
 
   if(datum == NULL){
@@ -141,24 +192,11 @@ int add_tail_gueue_katcl(struct katcl_gueue *g, void *datum)
       abort();
     }
 #endif
-    tmp = realloc(g->g_queue, sizeof(void *) * (g->g_size + 1));
-
-    if(tmp == NULL){
+    if(resize_gueue_katcl(g, (g->g_size > 0) ? (g->g_size * 2) : GUEUE_MINIMUM) < 0){
       return -1;
     }
-    g->g_queue = tmp;
-
-    if(g->g_head > 0){
-      g->g_queue[g->g_size] = g->g_queue[0];
-      if(g->g_head > 1){
-        memmove(&(g->g_queue[0]), &(g->g_queue[1]), sizeof(void *) * (g->g_head - 1));
-      }
-      g->g_queue[g->g_head - 1] = NULL;
-    }
-
-    g->g_size = g->g_size + 1;
   } 
-  index = (g->g_head + g->g_count) % g->g_size;
+  index = (g->g_head + g->g_count) & (g->g_size - 1);
 
 #if DEBUG > 1
   fprintf(stderr, "generic queue: %p add[%d]=%p\n", g, index, datum);
@@ -174,22 +212,12 @@ int add_tail_gueue_katcl(struct katcl_gueue *g, void *datum)
 
 void *get_from_head_gueue_katcl(struct katcl_gueue *g, unsigned int position)
 {
-  unsigned int wrap;
-
   if((g->g_count == 0) || (g->g_size == 0) || (g->g_count > g->g_size)){
     return NULL;
   }
 
-#ifdef KATCP_CONSISTENCY_CHECKS
-  if(g->g_size < g->g_count){
-    fprintf(stderr, "generic queue: more elements %u than slots %u\n", g->g_count, g->g_size);
-    abort();
-  }
-#endif
-
   if(position < g->g_count){
-    wrap = ((g->g_head + position) % g->g_size);
-    return g->g_queue[wrap];
+    return g->g_queue[(g->g_head + position) & (g->g_size - 1)];
   } else {
     return NULL;
   }
@@ -212,7 +240,7 @@ void *get_precedence_head_gueue_katcl(struct katcl_gueue *g, unsigned int preced
   }
 
   if(g->g_count == 0){ 
-#ifdef DEBUG
+#if DEBUG > 1
     fprintf(stderr, "generic queue: shortcut test triggered on empty queue %p\n", g);
 #endif
     return NULL;
@@ -226,9 +254,9 @@ void *get_precedence_head_gueue_katcl(struct katcl_gueue *g, unsigned int preced
 #endif
 
   for(j = 0; j < g->g_count; j++){
-    i = (g->g_head + j) % g->g_size;
+    i = (g->g_head + j) & (g->g_size - 1);
     value =  (*(g->g_precedence))(g->g_queue[i]);
-#ifdef DEBUG
+#if DEBUG > 1
     fprintf(stderr, "generic queue: %p->%u, looking for at least %u\n", g->g_queue[i], value, precedence);
 #endif
     if(value >= precedence){
@@ -236,7 +264,7 @@ void *get_precedence_head_gueue_katcl(struct katcl_gueue *g, unsigned int preced
     }
   }
 
-#ifdef DEBUG
+#if DEBUG > 1
   fprintf(stderr, "generic queue: no match found, need precedence %u, searched %u\n", precedence, g->g_count);
 #endif
 
@@ -247,7 +275,7 @@ void *get_precedence_head_gueue_katcl(struct katcl_gueue *g, unsigned int preced
 
 static void *remove_index_gueue_katcl(struct katcl_gueue *g, unsigned int index)
 {
-  unsigned int end;
+  unsigned int mask, position, i, j;
   void *datum;
 
   if(g->g_count <= 0){
@@ -268,55 +296,50 @@ static void *remove_index_gueue_katcl(struct katcl_gueue *g, unsigned int index)
   }
 #endif
 
-#if DEBUG
+  mask = g->g_size - 1;
+  position = (index - g->g_head) & mask;
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if(position >= g->g_count){
+    fprintf(stderr, "generic queue: logic problem: attempting to remove %u, queue only valid from head=%u for %u entries\n", index, g->g_head, g->g_count);
+    abort();
+  }
+#endif
+
+#if DEBUG > 1
   fprintf(stderr, "generic queue: del[%u]=%p\n", index, g->g_queue[index]);
 #endif
 
   datum = g->g_queue[index];
-  g->g_queue[index] = NULL;
 
-  if(index == g->g_head){
+  if(position == 0){
     /* hopefully the common, simple case - remove from head */
-    g->g_head = (g->g_head + 1) % g->g_size;
-    g->g_count--;
-
-#if DEBUG 
-    fprintf(stderr, "generic gueue: removed %p from %p\n", datum, g);
-#endif
-
-    return datum;
-  }
-
-  if(index > g->g_head){ /* index ahead of head, move head toward index */
-    memmove(&(g->g_queue[g->g_head + 1]), &(g->g_queue[g->g_head]), (index - g->g_head) * sizeof(void *));
+    g->g_queue[index] = NULL;
+    g->g_head = (g->g_head + 1) & mask;
+  } else if(position < (g->g_count / 2)){
+    /* closer to the head: shuffle the earlier entries up by one and advance the head */
+    for(j = position; j > 0; j--){
+      i = (g->g_head + j) & mask;
+      g->g_queue[i] = g->g_queue[(i - 1) & mask];
+    }
     g->g_queue[g->g_head] = NULL;
-    g->g_head = (g->g_head + 1) % g->g_size;
-    g->g_count--;
-#if DEBUG 
-    fprintf(stderr, "generic queue: removed %p from %p, head advanced to %u\n", datum, g, g->g_head);
-#endif
-    return datum; /* WARNING: done here */
+    g->g_head = (g->g_head + 1) & mask;
+  } else {
+    /* closer to the tail: shuffle the later entries down by one */
+    for(j = position; (j + 1) < g->g_count; j++){
+      i = (g->g_head + j) & mask;
+      g->g_queue[i] = g->g_queue[(i + 1) & mask];
+    }
+    g->g_queue[(g->g_head + g->g_count - 1) & mask] = NULL;
   }
 
-  /* else index < g->g_head, move tail back */
+  g->g_count--;
 
-  /* now move back end by one, to overwrite position at index */
-  end = (g->g_head + g->g_count - 1) % g->g_size; /* WARNING: relies on count+head never being zero, hence earlier test */
-#ifdef KATCP_CONSISTENCY_CHECKS
-  if(index > end){
-    fprintf(stderr, "generic queue: logic problem: attempting to remove %u, queue only valid from head=%u to head+count=%u+%u-1=%u", index, g->g_head, g->g_head, g->g_count, end);
-    abort();
+  if(g->g_count == 0){
+    g->g_head = 0;
   }
-#endif
-
-  if(index < end){
-    memmove(&(g->g_queue[index]), &(g->g_queue[index + 1]), (end - index) * sizeof(void *));
-  } /* else index is end, no copy needed  */
 
-  fprintf(stderr, "generic queue: removed %p from %p, tail reduced from %u\n", datum, g, end);
-
-  g->g_queue[end] = NULL;
-  g->g_count--;
+  shrink_gueue_katcl(g);
 
 #if DEBUG > 1
   fprintf(stderr, "generic queue: removed %p from %p\n", datum, g);
@@ -335,22 +358,15 @@ void *remove_from_head_gueue_katcl(struct katcl_gueue *g, unsigned int position)
   }
 #endif
 
-#ifdef KATCP_CONSISTENCY_CHECKS
-  if(g->g_size < g->g_count){
-    fprintf(stderr, "generic queue: more elements %u than slots %u\n", g->g_count, g->g_size);
-    abort();
-  }
-#endif
-
   if(position >= g->g_count){
     return NULL;
   }
 
-#ifdef DEBUG
+#if DEBUG > 1
   fprintf(stderr, "generic queue: removing position %u from head (used=%u/size=%u)\n", position, g->g_count, g->g_size);
 #endif
 
-  index = (g->g_head + position) % g->g_size;
+  index = (g->g_head + position) & (g->g_size - 1);
 
   return remove_index_gueue_katcl(g, index);
 }
@@ -366,7 +382,7 @@ void *remove_datum_gueue_katcl(struct katcl_gueue *g, void *datum)
 #endif
 
   for(j = 0; j < g->g_count; j++){
-    i = (g->g_head + j) % g->g_size;
+    i = (g->g_head + j) & (g->g_size - 1);
     if(g->g_queue[i] == datum){
       break;
     }
@@ -376,8 +392,8 @@ void *remove_datum_gueue_katcl(struct katcl_gueue *g, void *datum)
     return NULL;
   }
 
-#ifdef DEBUG
-  fprintf(stderr, "generic queue: removing position %u from head (used=%u/size=%u)\n", i, g->g_count, g->g_size);
+#if DEBUG > 1
+  fprintf(stderr, "generic queue: removing position %u from head (used=%u/size=%u)\n", j, g->g_count, g->g_size);
 #endif
 
   return remove_index_gueue_katcl(g, i);
@@ -412,7 +428,7 @@ void dump_gueue(struct katcl_gueue *g, FILE *fp)
   }
   fprintf(fp, "\n");
 
-  for(k = g->g_head, i = 0; i < g->g_count; i++, k = (k + 1) % g->g_size){
+  for(k = g->g_head, i = 0; i < g->g_count; i++, k = (k + 1) & (g->g_size - 1)){
     if(g->g_queue[k] == NULL){
       fprintf(stderr, "generic gueue: error: null field at %d\n", k);
       abort();
@@ -426,7 +442,7 @@ void dump_gueue(struct katcl_gueue *g, FILE *fp)
       abort();
     }
 
-    k = (k + 1) % g->g_size;
+    k = (k + 1) & (g->g_size - 1);
     i++;
   }
 }
@@ -436,20 +452,36 @@ void dump_gueue(struct katcl_gueue *g, FILE *fp)
 #ifdef UNIT_TEST_GENERIC_QUEUE
 
 #include <unistd.h>
+#include <sys/time.h>
 
 #define RUNS  2000
 
+#define GROWTH    100000
+#define CHURN    1000000
+#define DEPTH       1000
+
 #define FROM_HEAD_RANGE       4
 #define REMOVE_BATCH        100
 /* these have to be primes */
 #define CHANCE_HEAD_REMOVE    3
 #define CHANCE_POS_REMOVE     7
 
+static unsigned long usecs_since(struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return ((now.tv_sec - start->tv_sec) * 1000000UL) + now.tv_usec - start->tv_usec;
+}
+
 int main(int argc, char **argv)
 {
   struct katcl_gueue *g;
   unsigned int *a, *b;
   unsigned int insert, remove, margin, arb, distance, seed;
+  struct timeval start;
+  unsigned long us;
   int i, k, r;
 
   g = create_gueue_katcl(free);
@@ -466,6 +498,8 @@ int main(int argc, char **argv)
 
   insert = 0;
   remove = 0;
+  margin = 0;
+  distance = 0;
 
   for(i = 0; i < RUNS; i++){
     r = rand() % REMOVE_BATCH;
@@ -533,7 +567,50 @@ int main(int argc, char **argv)
       add_tail_gueue_katcl(g, a);
     }
     dump_gueue(g, stderr);
+    if(g->g_size & (g->g_size - 1)){
+      fprintf(stderr, "test: implementation problem: size %u not a power of two\n", g->g_size);
+      abort();
+    }
+  }
+
+  destroy_gueue_katcl(g);
+
+  /* growth: a slow reader, backlog builds up while the head moves, then drains */
+
+  g = create_gueue_katcl(NULL);
+  if(g == NULL){
+    return 1;
+  }
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < GROWTH; i++){
+    add_tail_gueue_katcl(g, &start);
+    add_tail_gueue_katcl(g, &start);
+    remove_head_gueue_katcl(g);
+  }
+  for(i = 0; i < GROWTH; i++){
+    remove_head_gueue_katcl(g);
+  }
+  us = usecs_since(&start);
+  printf("test: growth to %u entries and drain in %luus (%.1fns/op)\n", GROWTH, us, (us * 1000.0) / (4 * GROWTH));
+
+  if((size_gueue_katcl(g) != 0) || (g->g_size > GUEUE_KEEP)){
+    fprintf(stderr, "test: implementation problem: drained queue holds %u entries in %u slots\n", size_gueue_katcl(g), g->g_size);
+    abort();
+  }
+
+  /* churn: steady state with a backlog of depth entries */
+
+  for(i = 0; i < DEPTH; i++){
+    add_tail_gueue_katcl(g, &start);
+  }
+  gettimeofday(&start, NULL);
+  for(i = 0; i < CHURN; i++){
+    add_tail_gueue_katcl(g, &start);
+    remove_head_gueue_katcl(g);
   }
+  us = usecs_since(&start);
+  printf("test: churn of %u at depth %u in %luus (%.1fns/op)\n", CHURN, DEPTH, us, (us * 1000.0) / (2 * CHURN));
 
   destroy_gueue_katcl(g);
   
@@ -266,6 +266,7 @@ static void delete_job_katcp(struct katcp_dispatch *d, struct katcp_job *j)
   }
 
   if(j->j_line){
+    release_poll_katcp(d->d_shared, &(j->j_interest), fileno_katcl(j->j_line));
     destroy_katcl(j->j_line, 1);
     j->j_line = NULL;
   }
@@ -651,6 +652,7 @@ struct katcp_job *create_job_katcp(struct katcp_dispatch *d, struct katcp_url *n
   j->j_recvr = 0;
 
   j->j_line = NULL;
+  init_poll_katcp(&(j->j_interest));
 
   j->j_queue = NULL;
   j->j_head = 0;
@@ -1417,6 +1419,7 @@ int load_jobs_katcp(struct katcp_dispatch *d)
   struct katcp_shared *s;
   struct katcp_job *j;
   int i, fd;
+  unsigned int mask;
 
   s = d->d_shared;
 
@@ -1425,25 +1428,25 @@ int load_jobs_katcp(struct katcp_dispatch *d)
 
     fd = fileno_katcl(j->j_line);
     if(fd >= 0){
+      mask = 0;
 
       switch(j->j_state){
         case JOB_STATE_PRE   :  
-          FD_SET(fd, &(s->s_write));
+          mask |= KATCP_POLL_WRITE;
           break;
         case JOB_STATE_UP    :
-          FD_SET(fd, &(s->s_read));
+          mask |= KATCP_POLL_READ;
           /* FALL */
         case JOB_STATE_POST :  
         case JOB_STATE_DRAIN :  
           if(flushing_katcl(j->j_line)){
-            FD_SET(fd, &(s->s_write));
+            mask |= KATCP_POLL_WRITE;
           }
           break;
         /* case JOB_STATE_DONE : */
       }
-      if(fd > s->s_max){ /* WARNING: what if no fd gets added ? */
-        s->s_max = fd;
-      }
+
+      load_poll_katcp(s, &(j->j_interest), fd, mask);
     }
 
 #if 0
@@ -1504,7 +1507,7 @@ int run_jobs_katcp(struct katcp_dispatch *d)
 
     switch(j->j_state){ /* async connect completes */
       case JOB_STATE_PRE : 
-        if(FD_ISSET(fd, &(s->s_write))){
+        if(ready_poll_katcp(s, fd, KATCP_POLL_WRITE)){
           len = sizeof(int);
           result = getsockopt(fd, SOL_SOCKET, SO_ERROR, &code, &len);
           if(result == 0){
@@ -1528,7 +1531,7 @@ int run_jobs_katcp(struct katcp_dispatch *d)
 
     switch(j->j_state){ /* read */
       case JOB_STATE_UP : 
-        if(FD_ISSET(fd, &(s->s_read))){
+        if(ready_poll_katcp(s, fd, KATCP_POLL_READ)){
           result = read_katcl(j->j_line);
 #ifdef DEBUG
           fprintf(stderr, "job: read from job returns %d\n", result);
@@ -1581,7 +1584,7 @@ int run_jobs_katcp(struct katcp_dispatch *d)
       case JOB_STATE_UP :
       case JOB_STATE_POST :
       case JOB_STATE_DRAIN :
-        if(FD_ISSET(fd, &(s->s_write))){
+        if(ready_poll_katcp(s, fd, KATCP_POLL_WRITE)){
           result = write_katcl(j->j_line);
 
           if(result < 0){
@@ -77,6 +77,10 @@ int relay_katcl(struct katcl_line *lx, struct katcl_line *ly);
 int flushing_katcl(struct katcl_line *l);
 int write_katcl(struct katcl_line *l);
 
+int output_policy_katcl(struct katcl_line *l, unsigned int size, unsigned int delay, unsigned int watermark);
+int deferring_katcl(struct katcl_line *l, struct timeval *now, struct timeval *until);
+int congested_katcl(struct katcl_line *l);
+
 int fileno_katcl(struct katcl_line *l);
 int problem_katcl(struct katcl_line *l);
 
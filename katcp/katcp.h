@@ -208,6 +208,7 @@ int run_config_server_katcp(struct katcp_dispatch *dl, char *file, int count, ch
 int run_pipe_server_katcp(struct katcp_dispatch *dl, char *file, int pfd);
 
 void mark_busy_katcp(struct katcp_dispatch *d);
+void mark_soon_katcp(struct katcp_dispatch *d, struct timeval *when);
 
 /******************* io functions ****************/
 
@@ -289,6 +290,7 @@ int log_parse_katcp(struct katcp_dispatch *d, int level, struct katcl_parse *px)
 int extra_response_katcp(struct katcp_dispatch *d, int code, char *fmt, ...);
 int basic_inform_katcp(struct katcp_dispatch *d, char *name, char *arg);
 int broadcast_inform_katcp(struct katcp_dispatch *d, char *name, char *arg);
+int relay_inform_katcp(struct katcp_dispatch *d, struct katcl_parse *p);
 
 int error_katcp(struct katcp_dispatch *d);
 
@@ -304,6 +306,9 @@ int exiting_katcp(struct katcp_dispatch *d); /* run cleanup functions once */
 #define KATCP_STRATEGY_DIFF    3
 #define KATCP_STRATEGY_FORCED  4
 #define KATCP_STRATEGIES_COUNT 5
+/* only available to duplex sensors, beyond the count used by the classic engine */
+#define KATCP_STRATEGY_EVENT_RATE 5
+#define KATCP_STRATEGY_DIFF_RATE  6
 
 #define KATCP_STATUS_UNKNOWN   0
 #define KATCP_STATUS_NOMINAL   1
@@ -343,6 +348,9 @@ int is_up_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a);
 
 void adjust_acquire_katcp(struct katcp_acquire *a, struct timeval *defpoll, struct timeval *maxrate);
 int propagate_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a);
+#ifdef KATCP_ASYNC_ACQUIRE
+int async_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, struct timeval *timeout);
+#endif
 
 /****************************************************************************/
 
@@ -446,6 +454,7 @@ int unwarp_timers_katcp(struct katcp_dispatch *d);
 int register_every_ms_katcp(struct katcp_dispatch *d, unsigned int milli, int (*call)(struct katcp_dispatch *d, void *data), void *data);
 int register_every_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data);
 int register_at_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data);
+int register_every_at_tv_katcp(struct katcp_dispatch *d, struct timeval *at, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data);
 int register_in_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data);
 
 int wake_notice_at_tv_katcp(struct katcp_dispatch *d, struct katcp_notice *n, struct timeval *tv);
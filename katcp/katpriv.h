@@ -6,9 +6,14 @@
 
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <avltree.h>
 
+#ifdef KATCP_ASYNC_ACQUIRE
+#include <pthread.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,6 +21,7 @@ extern "C" {
 #define KATCP_NAME_LENGTH     64
 
 #define KATCL_IO_SIZE       4096  /* block we want to write out */
+#define KATCL_IOV_MAX         64  /* pieces gathered into one write */
 #define KATCL_BUFFER_INC     512  /* amount by which we resize read */
 #define KATCL_ARGS_INC         8  /* grow the vector by this amount */
 
@@ -68,6 +74,28 @@ struct katcl_parse{
 
   int p_refs;
   int p_tag;
+
+  struct katcl_pool *p_pool; /* where to return this to, if anywhere */
+};
+
+#define KATCL_POOL_SMALLEST    64  /* smallest pooled buffer */
+#define KATCL_POOL_CLASSES      9  /* powers of two, so up to 16k */
+#define KATCL_POOL_DEPTH      256  /* idle entries kept per class */
+#define KATCL_POOL_ARGS        32  /* largest argument vector kept with a shell */
+
+struct katcl_pool{
+  struct katcl_parse *k_shells[KATCL_POOL_DEPTH];
+  unsigned int k_idle;
+
+  char *k_buffers[KATCL_POOL_CLASSES][KATCL_POOL_DEPTH];
+  unsigned int k_spare[KATCL_POOL_CLASSES];
+
+  unsigned int k_live;  /* parses handed out, not yet returned */
+  unsigned int k_high;  /* most ever live at once */
+  unsigned long k_requests; /* shells and buffers asked for */
+  unsigned long k_hits;     /* ... of which came from the pool */
+
+  int k_closing;
 };
 
 struct katcl_line{
@@ -78,11 +106,29 @@ struct katcl_line{
 
   struct katcl_parse *l_stage;
 
-  char l_buffer[KATCL_IO_SIZE];
-  unsigned int l_pending;
+  char *l_buffer;         /* separators, escaped fragments, short arguments */
+  unsigned int l_size;    /* allocated size of l_buffer */
+  unsigned int l_used;    /* amount of l_buffer referenced by l_iov */
+  unsigned int l_pending; /* bytes in l_iov not yet written */
   unsigned int l_arg;  /* argument */
   unsigned int l_offset; /* offset into argument */
 
+  struct iovec l_iov[KATCL_IOV_MAX];
+  unsigned int l_iovs;  /* entries in l_iov */
+  unsigned int l_sent;  /* first entry not yet fully written */
+
+  struct katcl_parse *l_hold[KATCL_IOV_MAX]; /* messages l_iov points into */
+  unsigned int l_holds;
+
+  unsigned int l_limit;     /* wanted size of l_buffer, applied between writes */
+  unsigned int l_delay;     /* microseconds to hold back output to coalesce it */
+  unsigned int l_watermark; /* queued bytes beyond which we are congested, 0 unlimited */
+  unsigned int l_queued;    /* approximate size of messages not yet packed */
+  struct timeval l_since;   /* when output started to accumulate */
+
+  unsigned long l_bytes;    /* written in total */
+  unsigned long l_calls;    /* write system calls made */
+
   struct katcl_queue *l_queue;
 
   int l_error;
@@ -98,6 +144,7 @@ struct katcp_cmd{
   char *c_help;
   int (*c_call)(struct katcp_dispatch *d, int argc);
   struct katcp_cmd *c_next;
+  struct katcp_cmd *c_chain; /* next in same hash bucket */
   unsigned int c_mode;
   unsigned int c_flags;
 };
@@ -138,6 +185,58 @@ struct katcp_integer_acquire{
   int (*ia_get)(struct katcp_dispatch *d, struct katcp_acquire *a);
 };
 
+#ifdef KATCP_ASYNC_ACQUIRE
+#define KATCP_ACQUIRE_WORKERS  2
+
+/* an acquire which may be read off the main loop, one per acquire, reused */
+struct katcp_acquire_job{
+  struct katcp_acquire *j_acquire;
+  struct katcp_acquire_job *j_next; /* queue or done list, under p_lock */
+
+  int j_busy;   /* handed to the pool, not yet collected */
+  int j_late;   /* exceeded j_timeout, sensors marked failed */
+  int j_doomed; /* acquire destroyed while busy, finish on collection */
+
+  int j_integer;
+#ifdef KATCP_USE_FLOATS
+  double j_double;
+#endif
+  unsigned int j_discrete;
+
+  struct timeval j_timeout;
+  struct timeval j_start;
+  struct timeval j_stop;   /* written by the worker */
+
+  unsigned long j_count;
+  unsigned long j_timeouts;
+  struct timeval j_total;
+  struct timeval j_worst;
+};
+
+struct katcp_acquire_pool{
+  pthread_mutex_t p_lock;
+  pthread_cond_t p_wake;
+  pthread_t p_workers[KATCP_ACQUIRE_WORKERS];
+  unsigned int p_started;
+  unsigned int p_busy;
+  int p_stop;
+
+  struct katcp_acquire_job *p_head;
+  struct katcp_acquire_job *p_tail;
+  struct katcp_acquire_job *p_done;
+
+  int p_fds[2]; /* workers write to 1, the loop watches 0 */
+};
+#endif
+
+/* acquires polled at the same rate share one timer */
+struct katcp_acquire_tick{
+  struct timeval k_period;
+  struct katcp_acquire **k_vector;
+  unsigned int k_count;
+  unsigned int k_size;
+};
+
 struct katcp_acquire{
   struct katcp_sensor **a_sensors;
   unsigned int a_count;
@@ -158,6 +257,12 @@ struct katcp_acquire{
   void (*a_release)(struct katcp_dispatch *d, struct katcp_acquire *a);
 
   void *a_more; /* could be a union */
+
+  struct katcp_acquire_tick *a_tick; /* set while polled periodically */
+
+#ifdef KATCP_ASYNC_ACQUIRE
+  struct katcp_acquire_job *a_job; /* NULL unless read by the pool */
+#endif
 };
 
 struct katcp_sensor{
@@ -331,6 +436,20 @@ struct katcp_map{
   unsigned int m_size;
 };
 
+#define KATCP_POLL_READ      0x1
+#define KATCP_POLL_WRITE     0x2
+
+struct katcp_poll{
+  int p_fd;               /* fd for which interest was last registered */
+};
+
+struct katcp_ready{
+  unsigned int r_want;    /* interest registered with kernel */
+  unsigned int r_seen;    /* round in which interest was last declared */
+  unsigned int r_when;    /* round in which r_have was collected */
+  unsigned int r_have;    /* readiness */
+};
+
 #ifdef KATCP_SUBPROCESS
 struct katcp_job{
   unsigned int j_magic;
@@ -345,6 +464,7 @@ struct katcp_job{
   int j_sendr; /* number of requests sent */
 
   struct katcl_line *j_line;
+  struct katcp_poll j_interest;
 
   struct katcp_notice *j_halt;
 
@@ -372,6 +492,11 @@ struct katcp_time{
 
   int t_armed;
 
+  int t_index;                 /* position in heap, negative if not in it */
+  int t_due;                   /* taken off the heap to be run */
+  struct katcp_time *t_next;   /* hash chain, keyed on t_data */
+  struct katcp_time *t_later;  /* list of timers due in this pass */
+
   void *t_data;
   int (*t_call)(struct katcp_dispatch *d, void *data);
 };
@@ -409,6 +534,12 @@ struct katcp_notice{
 #endif
   int n_changes;
 
+  unsigned int n_slot;            /* position in s_notices */
+  struct katcp_notice *n_chain;   /* next in same name bucket */
+  struct katcp_notice *n_ready;   /* next on the list of notices to visit */
+  int n_listed;
+  unsigned int n_pass;
+
 #if 0
   void *n_target;
   int (*n_release)(struct katcp_dispatch *d, struct katcp_notice *n, void *target);
@@ -418,6 +549,7 @@ struct katcp_notice{
 struct katcp_arb{
   char *a_name;
   int a_fd;
+  struct katcp_poll a_interest;
   
   unsigned int a_type;
 
@@ -517,12 +649,35 @@ struct katcp_region{
   struct avl_tree *r_tree;
 };
 
+/* a resolved remote sensor, saves name fixup and path walks per #sensor-status */
+#define KATCP_RELAY_TIME     0
+#define KATCP_RELAY_STATUS   1
+#define KATCP_RELAY_VALUE    2
+#define KATCP_RELAY_SLOTS    3
+
+struct katcp_relay{
+  struct katcp_vrbl *y_variable;
+  struct katcp_vrbl_payload *y_slots[KATCP_RELAY_SLOTS];
+};
+
 struct katcp_subscribe{
   struct katcp_vrbl *s_variable;
   struct katcp_endpoint *s_endpoint;
   unsigned int s_strategy;
 
-  /* for time, last time updated, next time when ... */
+  struct katcp_wit *s_wit;
+
+  struct timeval s_period;  /* period, or longest gap for rate strategies */
+  struct timeval s_floor;   /* shortest gap for rate strategies */
+  double s_delta;           /* threshold for differential strategies */
+
+  double s_reported;        /* value last sent, valid if s_numeric */
+  int s_numeric;
+  int s_held;               /* an update arrived within s_floor */
+
+  struct timeval s_last;    /* when last sent */
+  struct timeval s_when;    /* when next due, if s_index >= 0 */
+  int s_index;              /* position in the shared sampling heap */
 };
 
 struct katcp_wit{
@@ -531,7 +686,9 @@ struct katcp_wit{
   struct katcp_subscribe **w_vector;
   unsigned int w_size;
 
-  /* todo - timeval counter ... runs at rate */
+  struct katcp_vrbl *w_variable;
+  struct katcl_parse *w_cache; /* update built during sampling pass w_stamp */
+  unsigned int w_stamp;
 };
 
 struct katcp_listener{
@@ -585,6 +742,10 @@ struct katcp_cmd_map{
 /* discard entire pending set after this many queued elements */
 #define KATCP_FLUSH_DEFER         8
 
+/* output policy for clients configured as bulk consumers */
+#define KATCP_BULK_SIZE       65536  /* bytes gathered for one write */
+#define KATCP_BULK_DELAY      20000  /* microseconds output may be held back */
+
 struct katcp_group{
   /* a set of flats which belong together, probably spawned off the same listener, probably same set of commands, probably same "mode" */
   char *g_name;
@@ -665,6 +826,7 @@ struct katcp_flat{
   struct katcp_endpoint *f_remote; /* queue for remote messages, used to make remote messages "fit" into peer queue */
 
   struct katcl_line *f_line;
+  struct katcp_poll f_interest;
   struct katcp_shared *f_shared;
 
   struct katcl_parse *f_orx;     /* originating received message (needed for replies) */
@@ -694,6 +856,9 @@ struct katcp_flat{
 
   struct katcp_region *f_region;
   time_t f_start;
+
+  struct avl_tree *f_relays;     /* remote sensor name to katcp_relay */
+  unsigned int f_relay_epoch;    /* s_vrbl_epoch at which relays were resolved */
 };
 #endif
 
@@ -711,7 +876,11 @@ struct katcp_shared{
   int (*s_prehook)(struct katcp_dispatch *d, int argc);
   int (*s_posthook)(struct katcp_dispatch *d, int argc);
 
-  struct katcp_cmd *s_commands;
+  struct katcp_cmd *s_commands; /* newest first, wildcards at the end */
+  struct katcp_cmd *s_wild;     /* first wildcard in s_commands */
+  struct katcp_cmd **s_lookup;  /* named commands by hash, same order */
+  unsigned int s_slots;
+  unsigned int s_named;
   struct katcp_sensor *s_mode_sensor;
   unsigned int s_mode;
   unsigned int s_flaky; /* mode transition failed, breaking the old one */
@@ -727,6 +896,7 @@ struct katcp_shared{
   unsigned int s_used;
 
   int s_lfd;
+  struct katcp_poll s_listen;
 
   struct katcp_job **s_tasks;
   unsigned int s_number;
@@ -736,8 +906,11 @@ struct katcp_shared{
   int s_entries;
 #endif
 
-  struct katcp_time **s_queue;
+  struct katcp_time **s_queue;  /* binary heap, earliest at top */
   unsigned int s_length;
+  unsigned int s_room;
+  struct katcp_time **s_timers; /* hash of timers by t_data */
+  unsigned int s_buckets;
 
   struct katcp_arb **s_extras;
   unsigned int s_total;
@@ -745,7 +918,18 @@ struct katcp_shared{
   struct katcp_notice **s_notices;
   unsigned int s_pending;
 
+  struct katcp_notice **s_notice_table; /* named notices by hash */
+  unsigned int s_notice_slots;
+  struct katcp_notice **s_notice_order; /* named notices sorted by name */
+  unsigned int s_notice_named;
+  struct katcp_notice *s_ready_head;    /* triggered or possibly unused */
+  struct katcp_notice *s_ready_tail;
+  unsigned int s_notice_pass;
+
+  struct katcl_pool *s_pool; /* recycled parse structures */
+
   unsigned int s_busy; /* more things to do, keep select short */
+  struct timeval s_soon; /* look again by this time, zero if not needed */
 
   struct katcp_group **s_groups;
   struct katcp_group *s_fallback;
@@ -758,9 +942,21 @@ struct katcp_shared{
 
   unsigned int s_changes;
 
+  struct katcp_subscribe **s_sampling; /* heap of subscriptions ordered by s_when */
+  unsigned int s_sampled;
+  unsigned int s_sample_size;
+  unsigned int s_sample_pass;
+  struct timeval s_sample_due; /* when the sampling timer is armed, zero if not */
+
   struct katcp_endpoint *s_endpoints;
+  struct katcp_endpoint *s_waking_head; /* endpoints with deliverable messages */
+  struct katcp_endpoint *s_waking_tail;
+  unsigned int s_endpoint_batch;        /* messages delivered per endpoint per pass */
+  int s_endpoint_sweep;                 /* an endpoint may be collectable */
+  unsigned int s_endpoint_pass;
 
   struct katcp_region *s_region;
+  unsigned int s_vrbl_epoch;  /* bumped when variables or payloads are added or freed */
 
 #if 0
   int s_version_major;
@@ -774,6 +970,13 @@ struct katcp_shared{
   struct katcp_sensor **s_sensors;
   unsigned int s_tally;
 
+  struct katcp_acquire_tick **s_ticks;
+  unsigned int s_tick_count;
+
+#ifdef KATCP_ASYNC_ACQUIRE
+  struct katcp_acquire_pool *s_acquire_pool;
+#endif
+
   struct katcp_version **s_versions;
   unsigned int s_amount;
 
@@ -784,6 +987,12 @@ struct katcp_shared{
 
   fd_set s_read, s_write;
   int s_max;
+
+  int s_epoll;              /* epoll instance, negative if we use pselect */
+  struct katcp_ready *s_ready;
+  unsigned int s_limit;
+  unsigned int s_round;
+  unsigned int s_mute;
   
   struct katcp_type **s_type;
   unsigned int s_type_count;
@@ -798,6 +1007,7 @@ struct katcp_dispatch{
   int d_exit; /* exit code, reason for shutting down */
   int d_pause; /* waiting for a notice */
   struct katcl_line *d_line;
+  struct katcp_poll d_interest;
 
   int (*d_current)(struct katcp_dispatch *d, int argc);
 
@@ -867,8 +1077,15 @@ struct katcp_message{
   struct katcl_parse *m_parse;
   struct katcp_endpoint *m_from;
   struct katcp_endpoint *m_to;
+  unsigned int m_level;    /* which of the destination fifos holds this message */
+  unsigned int m_sequence; /* arrival order across fifos of destination */
 };
 
+#define KATCP_ENDPOINT_LEVELS        2
+#ifndef KATCP_ENDPOINT_BATCH
+#define KATCP_ENDPOINT_BATCH        64
+#endif
+
 struct katcp_endpoint{
   unsigned int e_magic;
   unsigned short e_freeable;
@@ -880,8 +1097,13 @@ struct katcp_endpoint{
   struct katcp_endpoint *e_peer;
 #endif
 
-  struct katcl_gueue *e_queue;
+  struct katcl_gueue *e_fifo[KATCP_ENDPOINT_LEVELS];
   unsigned int e_precedence;
+  unsigned int e_sequence;
+
+  int e_ready;                      /* on the waking list of shared */
+  struct katcp_endpoint *e_ready_next;
+  unsigned int e_pass;              /* last pass of run_endpoints_katcp to deliver to us */
 
   int (*e_wake)(struct katcp_dispatch *d, struct katcp_endpoint *ep, struct katcp_message *msg, void *data);
   void (*e_release)(struct katcp_dispatch *d, void *data);
@@ -923,6 +1145,20 @@ int link_shared_katcp(struct katcp_dispatch *d, struct katcp_dispatch *cd);
 int load_shared_katcp(struct katcp_dispatch *d);
 int run_shared_katcp(struct katcp_dispatch *d);
 int ended_shared_katcp(struct katcp_dispatch *d);
+void detach_shared_katcp(struct katcp_dispatch *d);
+
+/* io readiness */
+int startup_poll_katcp(struct katcp_shared *s);
+void shutdown_poll_katcp(struct katcp_shared *s);
+int epoll_poll_katcp(struct katcp_shared *s);
+void init_poll_katcp(struct katcp_poll *p);
+void reset_poll_katcp(struct katcp_shared *s);
+void load_poll_katcp(struct katcp_shared *s, struct katcp_poll *p, int fd, unsigned int mask);
+void release_poll_katcp(struct katcp_shared *s, struct katcp_poll *p, int fd);
+void mute_poll_katcp(struct katcp_shared *s, unsigned int mask);
+int wait_poll_katcp(struct katcp_shared *s, struct timespec *delta);
+unsigned int ready_poll_katcp(struct katcp_shared *s, int fd, unsigned int mask);
+void clear_poll_katcp(struct katcp_shared *s);
 
 void shutdown_cmd_katcp(struct katcp_cmd *c);
 
@@ -1043,6 +1279,11 @@ struct katcp_arb *create_listen_flat_katcp(struct katcp_dispatch *d, char *name,
 int destroy_listen_flat_katcp(struct katcp_dispatch *d, char *name);
 
 /* parse: setup */
+struct katcl_pool *create_pool_katcl();
+void destroy_pool_katcl(struct katcl_pool *k);
+struct katcl_pool *install_pool_katcl(struct katcl_pool *k);
+int space_buffer_parse_katcl(struct katcl_parse *p, unsigned int need);
+
 struct katcl_parse *create_parse_katcl();
 struct katcl_parse *create_referenced_parse_katcl();
 void destroy_parse_katcl(struct katcl_parse *p);
@@ -1168,6 +1409,11 @@ struct katcp_tag {
 
   void *t_tobject_root;
   int t_tobject_count;
+
+  struct katcp_tobject **t_postings; /* same members as the tree, sorted by data when t_sorted */
+  int t_posting_count;
+  int t_posting_size;
+  int t_sorted;
 };
 
 void print_string_type_katcp(struct katcp_dispatch *d, char *key, void *data);
@@ -1190,6 +1436,9 @@ void *parse_tag_katcp(struct katcp_dispatch *d, char **str);
 int compare_tag_katcp(const void *m1, const void *m2);
 char *getkey_tag_katcp(void *data);
 int register_tag_katcp(struct katcp_dispatch *d, char *name, int level);
+int add_posting_tag_katcp(struct katcp_tag *t, struct katcp_tobject *to);
+int del_posting_tag_katcp(struct katcp_tag *t, struct katcp_tobject *to);
+int intersect_tags_katcp(struct katcp_tag **vector, int count, int (*call)(struct katcp_tobject *to, void *data), void *data);
 
 
 /* endpoints: internal ********************/
@@ -1198,6 +1447,7 @@ void run_endpoints_katcp(struct katcp_dispatch *d);
 void load_endpoints_katcp(struct katcp_dispatch *d);
 
 void release_endpoints_katcp(struct katcp_dispatch *d);
+void batch_endpoints_katcp(struct katcp_dispatch *d, unsigned int batch);
 
 struct katcp_endpoint *create_endpoint_katcp(struct katcp_dispatch *d, int (*wake)(struct katcp_dispatch *d, struct katcp_endpoint *ep, struct katcp_message *msg, void *data), void (*release)(struct katcp_dispatch *d, void *data), void *data);
 
@@ -1226,6 +1476,10 @@ char *string_from_scope_katcp(unsigned int scope);
 
 int fixup_timestamp_katcp(char *src, char *dst, int size);
 
+/* duplex inform processing ***************/
+
+void clear_relay_info_katcp(struct katcp_dispatch *d, struct katcp_flat *fx);
+
 /* internal variable use ******************/
 
 #define KATCP_VRBL_DELIM_GROUP    '*'
@@ -1254,6 +1508,8 @@ int for_all_flats_vrbl_katcp(struct katcp_dispatch *d, struct katcp_flat *fx, ch
 int hide_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx);
 int show_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx);
 
+int set_strings_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_vrbl_payload **vector, char **values, unsigned int count);
+
 /* variable payload manipulation */
 
 struct katcp_vrbl *scan_vrbl_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, char *text, char *path, int create, unsigned int type);
@@ -1286,6 +1542,8 @@ char *strategy_to_string_sensor_katcp(struct katcp_dispatch *d, unsigned int str
 int strategy_from_string_sensor_katcp(struct katcp_dispatch *d, char *name);
 
 int monitor_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx);
+int monitor_strategy_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx, unsigned int strategy, char **vector, unsigned int count);
+int append_strategy_variable_katcp(struct katcp_dispatch *d, int flags, struct katcp_vrbl *vx, struct katcp_flat *fx);
 int forget_event_variable_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, struct katcp_flat *fx);
 
 struct katcl_parse *make_sensor_katcp(struct katcp_dispatch *d, char *name, struct katcp_vrbl *vx, char *prefix);
@@ -1293,6 +1551,9 @@ struct katcl_parse *make_sensor_katcp(struct katcp_dispatch *d, char *name, stru
 #define KATCP_NAGLE_CHANGE  500000    /* defer device-changes by this much (us) ... */
 int schedule_sensor_update_katcp(struct katcp_dispatch *d, char *name);
 
+#define KATCP_SAMPLE_SLACK    1000    /* subscriptions due within this (us) go out in the same pass */
+void destroy_sampling_katcp(struct katcp_dispatch *d);
+
 void dump_variable_sensor_katcp(struct katcp_dispatch *d, struct katcp_vrbl *vx, int level);
 
 
@@ -14,6 +14,7 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "katpriv.h"
 #include "katcl.h"
@@ -62,6 +63,8 @@ static void sane_line_katcl(struct katcl_line *l)
 #define sane_line_katcl(l)
 #endif
 
+static void release_katcl(struct katcl_line *l);
+
 /****************************************************************/
 
 struct katcl_line *create_katcl(int fd)
@@ -79,10 +82,27 @@ struct katcl_line *create_katcl(int fd)
   l->l_next = NULL; 
   l->l_stage = NULL;
 
+  l->l_buffer = NULL;
+  l->l_size = 0;
+  l->l_used = 0;
   l->l_pending = 0;
   l->l_arg = 0;
   l->l_offset = 0;
 
+  l->l_iovs = 0;
+  l->l_sent = 0;
+  l->l_holds = 0;
+
+  l->l_limit = KATCL_IO_SIZE;
+  l->l_delay = 0;
+  l->l_watermark = 0;
+  l->l_queued = 0;
+  l->l_since.tv_sec = 0;
+  l->l_since.tv_usec = 0;
+
+  l->l_bytes = 0;
+  l->l_calls = 0;
+
   l->l_queue = NULL;
 
   l->l_error = 0;
@@ -100,6 +120,13 @@ struct katcl_line *create_katcl(int fd)
     return NULL;
   }
 
+  l->l_buffer = malloc(l->l_limit);
+  if(l->l_buffer == NULL){
+    destroy_katcl(l, 0);
+    return NULL;
+  }
+  l->l_size = l->l_limit;
+
   return l;
 }
 
@@ -127,9 +154,16 @@ void destroy_katcl(struct katcl_line *l, int end)
     l->l_stage = NULL;
   }
 
-  l->l_pending = 0;
+  release_katcl(l);
   l->l_arg = 0;
   l->l_offset = 0;
+  l->l_queued = 0;
+
+  if(l->l_buffer){
+    free(l->l_buffer);
+    l->l_buffer = NULL;
+  }
+  l->l_size = 0;
 
   if(l->l_queue){
     destroy_queue_katcl(l->l_queue);
@@ -174,9 +208,10 @@ void exchange_katcl(struct katcl_line *l, int fd)
     l->l_stage = NULL;
   }
 
-  l->l_pending = 0;
+  release_katcl(l);
   l->l_arg = 0;
   l->l_offset = 0;
+  l->l_queued = 0;
 
   clear_queue_katcl(l->l_queue);
 
@@ -217,7 +252,6 @@ int error_katcl(struct katcl_line *l)
 
 int load_katcl(struct katcl_line *l, char *buffer, unsigned int size)
 {
-  char *ptr;
   struct katcl_parse *p;
 
   sane_line_katcl(l);
@@ -236,17 +270,13 @@ int load_katcl(struct katcl_line *l, char *buffer, unsigned int size)
   p = l->l_next;
 
   if(p->p_size <= (p->p_have + size)){
-    ptr = (char *)realloc(p->p_buffer, p->p_have + size + 1);
-    if(ptr == NULL){
+    if(space_buffer_parse_katcl(p, p->p_have + size + 1) < 0){
 #ifdef DEBUG 
-      fprintf(stderr, "read: realloc to %d failed\n", p->p_size + KATCL_BUFFER_INC);
+      fprintf(stderr, "read: resize to %d failed\n", p->p_have + size + 1);
 #endif
       l->l_error = ENOMEM;
       return -1;
     }
-
-    p->p_buffer = ptr;
-    p->p_size = p->p_have + size + 1;
   }
 
   memcpy(p->p_buffer + p->p_have, buffer, size);
@@ -259,7 +289,6 @@ int load_katcl(struct katcl_line *l, char *buffer, unsigned int size)
 int read_katcl(struct katcl_line *l)
 {
   int rr;
-  char *ptr;
   struct katcl_parse *p;
 
   sane_line_katcl(l);
@@ -278,17 +307,13 @@ int read_katcl(struct katcl_line *l)
   p = l->l_next;
 
   if(p->p_size <= p->p_have){
-    ptr = (char  *)realloc(p->p_buffer, p->p_size + KATCL_BUFFER_INC);
-    if(ptr == NULL){
+    if(space_buffer_parse_katcl(p, p->p_size + KATCL_BUFFER_INC) < 0){
 #ifdef DEBUG 
-      fprintf(stderr, "read: realloc to %d failed\n", p->p_size + KATCL_BUFFER_INC);
+      fprintf(stderr, "read: resize to %d failed\n", p->p_size + KATCL_BUFFER_INC);
 #endif
       l->l_error = ENOMEM;
       return -1;
     }
-
-    p->p_buffer = ptr;
-    p->p_size += KATCL_BUFFER_INC;
   }
 
   rr = read(l->l_fd, p->p_buffer + p->p_have, p->p_size - p->p_have);
@@ -477,6 +502,15 @@ unsigned int arg_buffer_katcl(struct katcl_line *l, unsigned int index, void *bu
 
 /******************************************************************/
 
+static void queued_katcl(struct katcl_line *l, struct katcl_parse *p)
+{
+  if((l->l_delay > 0) && (l->l_pending == 0) && (size_queue_katcl(l->l_queue) == 0)){
+    gettimeofday(&(l->l_since), NULL); /* start of a new burst of output */
+  }
+
+  l->l_queued += p->p_kept;
+}
+
 static struct katcl_parse *before_append_katcl(struct katcl_line *l, int flags)
 {
   sane_line_katcl(l);
@@ -528,6 +562,7 @@ static int after_append_katcl(struct katcl_line *l, int flags, int result)
     return -1;
   }
 
+  queued_katcl(l, l->l_stage);
   add_tail_queue_katcl(l->l_queue, l->l_stage);
   
   destroy_parse_katcl(l->l_stage);
@@ -749,6 +784,7 @@ int append_parse_katcl(struct katcl_line *l, struct katcl_parse *p)
   }
 #endif
 
+  queued_katcl(l, p);
   result = add_tail_queue_katcl(l->l_queue, p);	
 
   return result;
@@ -909,205 +945,326 @@ static int escape_copy_katcl(char *dst, char *src, unsigned int want)
   return j;
 }
 
-#define WRITE_STATE_DONE   0
-#define WRITE_STATE_FILL   1
-#define WRITE_STATE_NEXT   2
-#define WRITE_STATE_SEND   3
+/* output is gathered into l_iov: unescaped arguments are referenced where */
+/* they sit in the parse buffer, separators and escaped fragments are built */
+/* up in l_buffer. Messages which l_iov points into are held until all of */
+/* it has been written */
 
-int write_katcl(struct katcl_line *l)
+static void release_katcl(struct katcl_line *l)
+{
+  unsigned int i;
+
+  for(i = 0; i < l->l_holds; i++){
+    destroy_parse_katcl(l->l_hold[i]);
+    l->l_hold[i] = NULL;
+  }
+
+  l->l_holds = 0;
+  l->l_iovs = 0;
+  l->l_sent = 0;
+  l->l_used = 0;
+  l->l_pending = 0;
+}
+
+static void vector_katcl(struct katcl_line *l, char *base, unsigned int len)
+{
+  struct iovec *v;
+
+  if(len <= 0){
+    return;
+  }
+
+  l->l_pending += len;
+
+  if(l->l_iovs > 0){
+    v = &(l->l_iov[l->l_iovs - 1]);
+    if(((char *)(v->iov_base) + v->iov_len) == base){ /* contiguous, extend */
+      v->iov_len += len;
+      return;
+    }
+  }
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if(l->l_iovs >= KATCL_IOV_MAX){
+    fprintf(stderr, "write: logic problem: no more io vectors available\n");
+    abort();
+  }
+#endif
+
+  v = &(l->l_iov[l->l_iovs]);
+  v->iov_base = base;
+  v->iov_len = len;
+
+  l->l_iovs++;
+}
+
+static void side_katcl(struct katcl_line *l, char *string, unsigned int len)
+{
+  memcpy(l->l_buffer + l->l_used, string, len);
+  vector_katcl(l, l->l_buffer + l->l_used, len);
+  l->l_used += len;
+}
+
+static void pack_katcl(struct katcl_line *l)
 {
-  int wr;
-  int state;
   unsigned int space, want, can, actual;
   struct katcl_parse *p;
   struct katcl_larg *la;
+  int held;
 #define TMP_MARGIN 32
+#define SMALL_COPY 256
 
-  p = NULL;
+  held = 0;
 
-  for(state = WRITE_STATE_FILL; state != WRITE_STATE_DONE; ){
-#if DEBUG > 1
-    fprintf(stderr, "write: state=%d, parse=%p, arg=%u, offset=%u, pending=%u\n", state, p, l->l_arg, l->l_offset, l->l_pending);
-#endif
-    switch(state){
+  while((l->l_iovs < KATCL_IOV_MAX) && ((l->l_used + TMP_MARGIN) <= l->l_size)){
 
-      case WRITE_STATE_FILL : 
-
-        p = get_head_queue_katcl(l->l_queue);
-        if(p == NULL){
-          state = (l->l_pending > 0) ? WRITE_STATE_SEND : WRITE_STATE_DONE;
-          continue; /* WARNING */
-        } 
+    p = get_head_queue_katcl(l->l_queue);
+    if(p == NULL){
+      return;
+    }
 
 #ifdef KATCP_CONSISTENCY_CHECKS
-        if(p->p_magic != KATCL_PARSE_MAGIC){
-          fprintf(stderr, "write: bad magic returned from get_head (%x, expected %x)\n", p->p_magic, KATCL_PARSE_MAGIC);
-          abort();
-        }
+    if(p->p_magic != KATCL_PARSE_MAGIC){
+      fprintf(stderr, "write: bad magic returned from get_head (%x, expected %x)\n", p->p_magic, KATCL_PARSE_MAGIC);
+      abort();
+    }
+    if(l->l_arg >= p->p_got){
+      fprintf(stderr, "write: logic problem: arg=%u >= got=%u\n", l->l_arg, p->p_got);
+      abort();
+    }
 #endif
 
-        if((l->l_pending + TMP_MARGIN) > KATCL_IO_SIZE){
-          state = WRITE_STATE_SEND; /* drain if no margin */
-          continue; /* WARNING */
-        }
+    if(held == 0){
+      if(l->l_holds >= KATCL_IOV_MAX){
+        return;
+      }
+      l->l_hold[l->l_holds++] = copy_parse_katcl(p);
+      held = 1;
+    }
+
+    la = &(p->p_args[l->l_arg]);
 
 #ifdef KATCP_CONSISTENCY_CHECKS
-        if(l->l_arg >= p->p_got){
-          fprintf(stderr, "write: logic problem: arg=%u >= got=%u\n", l->l_arg, p->p_got);
-          abort();
-        }
+    if((la->a_begin + l->l_offset) > la->a_end){
+      fprintf(stderr, "write: logic problem: offset=%u extends beyond argument %u (%u-%u)\n", l->l_offset, l->l_arg, la->a_begin, la->a_end);
+      abort();
+    }
 #endif
 
-        la = &(p->p_args[l->l_arg]);
-
+    if((la->a_begin + l->l_offset) >= la->a_end){ /* done ? */
+      if(l->l_offset == 0){ /* special case - null arg */
 #ifdef KATCP_CONSISTENCY_CHECKS
-        if((la->a_begin + l->l_offset) > la->a_end){
-          fprintf(stderr, "write: logic problem: offset=%u extends beyond argument %u (%u-%u)\n", l->l_offset, l->l_arg, la->a_begin, la->a_end);
+        if(l->l_arg == 0){
+          fprintf(stderr, "write: problem - arg0 is null\n");
           abort();
         }
 #endif
+        side_katcl(l, "\\@", 2);
+      }
+      if(la->a_escape <= 1){ /* mark things which were thought to need escaping, but did not appropriately */
+        la->a_escape = 0;
+      }
 
-        if((la->a_begin + l->l_offset) >= la->a_end){ /* done ? */
-          if(l->l_offset == 0){ /* special case - null arg */
-#ifdef KATCP_CONSISTENCY_CHECKS
-            if(l->l_arg == 0){
-              fprintf(stderr, "write: problem - arg0 is null\n");
-              abort();
-            }
-#endif
-            strcpy(l->l_buffer + l->l_pending, "\\@");
-            l->l_pending += 2;
-          }
-          if(la->a_escape <= 1){ /* mark things which were thought to need escaping, but did not appropriately */
-            la->a_escape = 0;
-          }
+      l->l_arg++;
+      l->l_offset = 0;
 
-          l->l_arg++;
-          l->l_offset = 0;
-          state = WRITE_STATE_NEXT;
+      if((p->p_tag >= 0) && (l->l_arg == 1)){
+        /* !#$ : TODO: enter tag printing state */
+      }
 
-          continue;
-        }
+      if(l->l_arg < p->p_got){ /* more args */
+        side_katcl(l, " ", 1);
+        continue;
+      }
 
-        want = la->a_end - (la->a_begin + l->l_offset);
-        space = KATCL_IO_SIZE - (l->l_pending + 1);
+      l->l_arg = 0;
+      side_katcl(l, "\n", 1);
 
-#if DEBUG>1
-        fprintf(stderr, "write: arg[%u] has %u more, space is %u\n", l->l_arg, want, space);
+#if DEBUG > 1
+      fprintf(stderr, "write: packed parse %p (refs %d)\n", p, p->p_refs);
 #endif
 
-        if(la->a_escape){
-          can = ((space / 2) >= want) ? want : space / 2;
-          actual = escape_copy_katcl(l->l_buffer + l->l_pending, p->p_buffer + la->a_begin + l->l_offset, can);
-          if(actual > can){
-            la->a_escape = 2; /* record that we needed to escape */
-          }
-          l->l_pending += actual;
-        } else {
-          can = (space >= want) ? want : space;
-          memcpy(l->l_buffer + l->l_pending, p->p_buffer + la->a_begin + l->l_offset, can);
-          l->l_pending += can;
-        }
-        l->l_offset += can;
+      l->l_queued = (l->l_queued > p->p_kept) ? (l->l_queued - p->p_kept) : 0;
 
-        break;
+      /* still held by l_hold until written out */
+      p = remove_head_queue_katcl(l->l_queue);
+      destroy_parse_katcl(p);
+      held = 0;
 
-      case WRITE_STATE_NEXT : /* move onto next */
-        /* gets a proposed position, updates to next parse or end if needed, adding separators and tags */
+      continue;
+    }
 
-        p = get_head_queue_katcl(l->l_queue);
-        if(p == NULL){
-          l->l_offset = 0;
-          l->l_arg = 0;
-          state = WRITE_STATE_SEND;
-          continue;
-        }
+    want = la->a_end - (la->a_begin + l->l_offset);
 
-#ifdef KATCP_CONSISTENCY_CHECKS
-        if(p->p_magic != KATCL_PARSE_MAGIC){
-          fprintf(stderr, "write: bad magic returned from get_head (%x, expected %x)\n", p->p_magic, KATCL_PARSE_MAGIC);
-          abort();
-        }
-#endif
+    if(la->a_escape){
+      space = l->l_size - l->l_used;
+      can = ((space / 2) >= want) ? want : space / 2;
+      actual = escape_copy_katcl(l->l_buffer + l->l_used, p->p_buffer + la->a_begin + l->l_offset, can);
+      if(actual > can){
+        la->a_escape = 2; /* record that we needed to escape */
+      }
+      vector_katcl(l, l->l_buffer + l->l_used, actual);
+      l->l_used += actual;
+    } else {
+      can = want;
+      if((want <= SMALL_COPY) && ((l->l_used + want) <= l->l_size)){ /* cheaper to copy than to give it a vector */
+        side_katcl(l, p->p_buffer + la->a_begin + l->l_offset, can);
+      } else {
+        vector_katcl(l, p->p_buffer + la->a_begin + l->l_offset, can);
+      }
+    }
 
-        if(l->l_pending >= KATCL_IO_SIZE){
-          fprintf(stderr, "write: logic problem: pending=%u, no space left\n", l->l_pending);
-        }
-      
-        if((p->p_tag >= 0) && (l->l_arg == 1)){
-          /* !#$ : TODO: enter tag printing state */
-        }
+#if DEBUG>1
+    fprintf(stderr, "write: arg[%u] had %u more, packed %u\n", l->l_arg, want, can);
+#endif
 
-        if(l->l_arg < p->p_got){ /* more args */
-          state = WRITE_STATE_FILL;
-          l->l_buffer[l->l_pending++] = ' ';
-          continue;
-        }
+    l->l_offset += can;
+  }
 
-        l->l_arg = 0;
-        l->l_buffer[l->l_pending++] = '\n';
+#undef SMALL_COPY
+#undef TMP_MARGIN
+}
 
-#if DEBUG > 1
-        fprintf(stderr, "write: wrote out parse %p (refs %d)\n", p, p->p_refs);
+int write_katcl(struct katcl_line *l)
+{
+  int wr;
+  unsigned int left;
+  struct iovec *v;
+  char *ptr;
+#ifdef MSG_NOSIGNAL
+  struct msghdr msg;
 #endif
 
-        p = remove_head_queue_katcl(l->l_queue);
-        destroy_parse_katcl(p);
-        state = p ? WRITE_STATE_FILL : WRITE_STATE_SEND;
+  for(;;){
 
-        break;
-
-      case WRITE_STATE_SEND : /* do io */
-
-        p = get_head_queue_katcl(l->l_queue);
-        if(l->l_pending <= 0){ /* nothing more to write ? */
-          state = p ? WRITE_STATE_FILL : WRITE_STATE_DONE;
-          continue; /* WARNING: added later, attempt to remove write(,,0) cases */
+    if(l->l_pending <= 0){
+      release_katcl(l);
+      if(get_head_queue_katcl(l->l_queue) == NULL){
+        return 1; /* done everything */
+      }
+      if(l->l_size != l->l_limit){ /* nothing points into the buffer now */
+        ptr = realloc(l->l_buffer, l->l_limit);
+        if(ptr){
+          l->l_buffer = ptr;
+          l->l_size = l->l_limit;
         }
+      }
+      pack_katcl(l);
+#if DEBUG > 1
+      fprintf(stderr, "write: packed %u bytes into %u vectors for %u messages\n", l->l_pending, l->l_iovs, l->l_holds);
+#endif
+      continue;
+    }
 
-        if(l->l_sendable){
+    if(l->l_sendable){
 #ifdef MSG_NOSIGNAL
-          wr = send(l->l_fd, l->l_buffer, l->l_pending, MSG_DONTWAIT | MSG_NOSIGNAL);
+      memset(&msg, 0, sizeof(struct msghdr));
+      msg.msg_iov = l->l_iov + l->l_sent;
+      msg.msg_iovlen = l->l_iovs - l->l_sent;
+      wr = sendmsg(l->l_fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
 #else
-          wr = send(l->l_fd, l->l_buffer, l->l_pending, MSG_DONTWAIT);
+      wr = writev(l->l_fd, l->l_iov + l->l_sent, l->l_iovs - l->l_sent);
 #endif
-        } else {
-          wr = write(l->l_fd, l->l_buffer, l->l_pending);
-        }
+    } else {
+      wr = writev(l->l_fd, l->l_iov + l->l_sent, l->l_iovs - l->l_sent);
+    }
 
-        if(wr < 0){
-          switch(errno){
-            case EAGAIN :
-            case EINTR  :
-              return 0; /* returns zero if still more to do */
-            case ENOTSOCK :
-              if(l->l_sendable > 0){
-                l->l_sendable = 0; /* try again, this time with write() not send() */
-                continue; /* WARNING, restart for();  */
-              }
-              /* WARNING: drop through */
-            default :
-              l->l_error = errno;
-              return -1;
+    if(wr < 0){
+      switch(errno){
+        case EAGAIN :
+        case EINTR  :
+          return 0; /* returns zero if still more to do */
+        case ENOTSOCK :
+          if(l->l_sendable > 0){
+            l->l_sendable = 0; /* try again, this time with writev() not sendmsg() */
+            continue; /* WARNING, restart for();  */
           }
-        }
+          /* WARNING: drop through */
+        default :
+          l->l_error = errno;
+          return -1;
+      }
+    }
 
-        if(wr > 0){
-          if(wr < l->l_pending){ /* a tad expensive, but we expect this to be rare */
-            memmove(l->l_buffer, l->l_buffer + wr, l->l_pending - wr);
-            l->l_pending -= wr;
-          } else {
-            l->l_pending = 0;
-          }
-        }
+    l->l_calls++;
+    l->l_bytes += wr;
 
-        break;
+    /* advance the cursor, trimming a partially written entry in place */
+    left = wr;
+    l->l_pending -= left;
+
+    while(left > 0){
+      v = &(l->l_iov[l->l_sent]);
+      if(left >= v->iov_len){
+        left -= v->iov_len;
+        l->l_sent++;
+      } else {
+        v->iov_base = (char *)(v->iov_base) + left;
+        v->iov_len -= left;
+        left = 0;
+      }
     }
   }
+}
 
-  /* done everything */
-  return 1;
-#undef TMP_MARGIN
+int output_policy_katcl(struct katcl_line *l, unsigned int size, unsigned int delay, unsigned int watermark)
+{
+  /* size is the most we gather for a single write, delay the time in */
+  /* microseconds we may hold back output to let more accumulate, */
+  /* watermark the amount of queued output at which we report congestion */
+
+  if(size < KATCL_IO_SIZE){
+    size = KATCL_IO_SIZE; /* needs to fit escaped fragments */
+  }
+
+  l->l_limit = size;
+  l->l_delay = delay;
+  l->l_watermark = watermark;
+
+  return 0;
+}
+
+int deferring_katcl(struct katcl_line *l, struct timeval *now, struct timeval *until)
+{
+  /* returns nonzero if pending output should be held back until the given time */
+
+  if((l->l_delay == 0) || (l->l_pending > 0)){
+    return 0;
+  }
+
+  if(size_queue_katcl(l->l_queue) == 0){
+    return 0;
+  }
+
+  if(l->l_queued >= l->l_limit){ /* enough for a full write */
+    return 0;
+  }
+
+  if(congested_katcl(l)){
+    return 0;
+  }
+
+  until->tv_sec = l->l_since.tv_sec + (l->l_delay / 1000000);
+  until->tv_usec = l->l_since.tv_usec + (l->l_delay % 1000000);
+  if(until->tv_usec >= 1000000){
+    until->tv_sec++;
+    until->tv_usec -= 1000000;
+  }
+
+  if(now->tv_sec != until->tv_sec){
+    return (now->tv_sec < until->tv_sec) ? 1 : 0;
+  }
+
+  return (now->tv_usec < until->tv_usec) ? 1 : 0;
+}
+
+int congested_katcl(struct katcl_line *l)
+{
+  if(l->l_watermark == 0){
+    return 0;
+  }
+
+  return ((l->l_queued + l->l_pending) > l->l_watermark) ? 1 : 0;
 }
 
 int flushing_katcl(struct katcl_line *l)
@@ -1265,6 +1422,254 @@ int echobuffer(int fd)
 #include <unistd.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define BENCH_TOTAL  (64 * 1024 * 1024)
+#define BENCH_BATCH   256
+
+int loopback_bench(int *fds)
+{
+  struct sockaddr_in sa;
+  socklen_t len;
+  int lfd;
+
+  lfd = socket(AF_INET, SOCK_STREAM, 0);
+  if(lfd < 0){
+    return -1;
+  }
+
+  memset(&sa, 0, sizeof(struct sockaddr_in));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = 0;
+
+  len = sizeof(struct sockaddr_in);
+
+  if((bind(lfd, (struct sockaddr *)&sa, len) < 0) || (listen(lfd, 1) < 0) || (getsockname(lfd, (struct sockaddr *)&sa, &len) < 0)){
+    close(lfd);
+    return -1;
+  }
+
+  fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+  if((fds[0] < 0) || (connect(fds[0], (struct sockaddr *)&sa, len) < 0)){
+    close(lfd);
+    return -1;
+  }
+
+  fds[1] = accept(lfd, NULL, NULL);
+  close(lfd);
+
+  return (fds[1] < 0) ? -1 : 0;
+}
+
+int run_bench(char *name, struct katcl_parse *p)
+{
+  struct katcl_line *l;
+  struct timeval start, stop;
+  unsigned int size, total, i;
+  int fds[2], result, status;
+  char buffer[64 * 1024];
+  fd_set fsw;
+  double seconds;
+  pid_t pid;
+
+  if(loopback_bench(fds) < 0){
+    fprintf(stderr, "bench: unable to set up loopback connection\n");
+    return -1;
+  }
+
+  pid = fork();
+  if(pid < 0){
+    return -1;
+  }
+
+  if(pid == 0){
+    close(fds[0]);
+    while(read(fds[1], buffer, sizeof(buffer)) > 0);
+    _exit(0);
+  }
+
+  close(fds[1]);
+
+  l = create_katcl(fds[0]);
+  if(l == NULL){
+    return -1;
+  }
+
+  size = buffer_from_parse_katcl(p, buffer, sizeof(buffer));
+
+  gettimeofday(&start, NULL);
+
+  for(total = 0; total < BENCH_TOTAL; ){
+    for(i = 0; i < BENCH_BATCH; i++){
+      append_parse_katcl(l, p);
+      total += size;
+    }
+    while((result = write_katcl(l)) == 0){
+      FD_ZERO(&fsw);
+      FD_SET(fds[0], &fsw);
+      select(fds[0] + 1, NULL, &fsw, NULL, NULL);
+    }
+    if(result < 0){
+      fprintf(stderr, "bench: write failed\n");
+      return -1;
+    }
+  }
+
+  destroy_katcl(l, 1);
+  waitpid(pid, &status, 0);
+
+  gettimeofday(&stop, NULL);
+
+  seconds = (stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0);
+
+  printf("line bench %s: %u messages of %u bytes in %.3fs: %.1f MB/s\n", name, total / size, size, seconds, total / (seconds * 1024.0 * 1024.0));
+
+  return 0;
+}
+
+int bench_line()
+{
+  struct katcl_parse *p;
+  char value[16 * 1024];
+  unsigned int i;
+
+  for(i = 0; i < sizeof(value); i++){
+    value[i] = "0123456789abcdef"[i % 16];
+  }
+
+  p = create_referenced_parse_katcl();
+  add_string_parse_katcl(p, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, "!read");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "ok");
+  add_buffer_parse_katcl(p, KATCP_FLAG_LAST | KATCP_FLAG_BUFFER, value, sizeof(value));
+
+  if(run_bench("read", p) < 0){
+    return -1;
+  }
+  destroy_parse_katcl(p);
+
+  p = create_referenced_parse_katcl();
+  add_string_parse_katcl(p, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, "#sensor-status");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "1318345234.123");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "1");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "roach.temperature.ambient");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "nominal");
+  add_string_parse_katcl(p, KATCP_FLAG_LAST | KATCP_FLAG_STRING, "42.5");
+
+  if(run_bench("sensor-status", p) < 0){
+    return -1;
+  }
+  destroy_parse_katcl(p);
+
+  p = create_referenced_parse_katcl();
+  add_string_parse_katcl(p, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, "#log");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "info");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "1318345234123");
+  add_string_parse_katcl(p, KATCP_FLAG_STRING, "raw");
+  add_string_parse_katcl(p, KATCP_FLAG_LAST | KATCP_FLAG_STRING, "a message with spaces which needs escaping");
+
+  if(run_bench("escaped log", p) < 0){
+    return -1;
+  }
+  destroy_parse_katcl(p);
+
+  return 0;
+}
+
+#define FANOUT_CLIENTS     8
+#define FANOUT_UPDATES  200000
+
+int fill_status(struct katcl_parse *p, unsigned int i)
+{
+  struct timeval tv;
+  int result;
+
+  tv.tv_sec = 1318345234 + i;
+  tv.tv_usec = (i % 1000) * 1000;
+
+  result = 0;
+
+  result += add_string_parse_katcl(p, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, "#sensor-status");
+  result += add_timestamp_parse_katcl(p, 0, &tv);
+  result += add_string_parse_katcl(p, KATCP_FLAG_STRING, "1");
+  result += add_string_parse_katcl(p, KATCP_FLAG_STRING, "roach temperature ambient");
+  result += add_string_parse_katcl(p, KATCP_FLAG_STRING, (i % 7) ? "nominal" : "warn");
+  result += add_double_parse_katcl(p, KATCP_FLAG_DOUBLE | KATCP_FLAG_LAST, 40.0 + (i % 100) / 8.0);
+
+  return result;
+}
+
+/* mode 0 formats per client, 1 shares a fresh parse */
+
+int run_fanout(char *name, int mode)
+{
+  struct katcl_line *l[FANOUT_CLIENTS];
+  struct katcl_parse *p;
+  struct timeval start, stop;
+  unsigned int i, j;
+  double seconds;
+  int fd;
+
+  for(j = 0; j < FANOUT_CLIENTS; j++){
+    fd = open("/dev/null", O_WRONLY);
+    l[j] = (fd < 0) ? NULL : create_katcl(fd);
+    if(l[j] == NULL){
+      return -1;
+    }
+  }
+
+  gettimeofday(&start, NULL);
+
+  for(i = 0; i < FANOUT_UPDATES; i++){
+    if(mode == 0){
+      for(j = 0; j < FANOUT_CLIENTS; j++){
+        p = create_referenced_parse_katcl();
+        fill_status(p, i);
+        append_parse_katcl(l[j], p);
+        destroy_parse_katcl(p);
+      }
+    } else {
+      p = create_referenced_parse_katcl();
+      fill_status(p, i);
+      for(j = 0; j < FANOUT_CLIENTS; j++){
+        append_parse_katcl(l[j], p);
+      }
+      destroy_parse_katcl(p);
+    }
+
+    for(j = 0; j < FANOUT_CLIENTS; j++){
+      while(write_katcl(l[j]) == 0);
+    }
+  }
+
+  gettimeofday(&stop, NULL);
+
+  for(j = 0; j < FANOUT_CLIENTS; j++){
+    destroy_katcl(l[j], 1);
+  }
+
+  seconds = (stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0);
+
+  printf("fanout bench %s: %u updates to %u clients in %.3fs: %.0f updates/s\n", name, FANOUT_UPDATES, FANOUT_CLIENTS, seconds, FANOUT_UPDATES / seconds);
+
+  return 0;
+}
+
+int bench_fanout()
+{
+  if(run_fanout("per client", 0) < 0){
+    return -1;
+  }
+
+  if(run_fanout("shared", 1) < 0){
+    return -1;
+  }
+
+  return 0;
+}
 
 int main()
 {
@@ -1380,6 +1785,14 @@ int main()
 
   destroy_katcl(l, 1);
 
+  if(bench_line() < 0){
+    return 1;
+  }
+
+  if(bench_fanout() < 0){
+    return 1;
+  }
+
   printf("line test: ok\n");
 
   return 0;
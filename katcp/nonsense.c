@@ -9,6 +9,12 @@
 #include <math.h>
 #endif
 
+#ifdef KATCP_ASYNC_ACQUIRE
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#endif
+
 #include "katcp.h"
 #include "katpriv.h"
 #include "netc.h"
@@ -29,6 +35,12 @@
 /**********************************************************************************************/
 
 static int run_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, int forced);
+static int join_tick_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a);
+static int propagate_at_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, struct timeval *now);
+static void leave_tick_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a);
+#ifdef KATCP_ASYNC_ACQUIRE
+static int submit_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, struct timeval *now);
+#endif
 
 /**********************************************************************************************/
 
@@ -125,6 +137,7 @@ int generic_sensor_update_katcp(struct katcp_dispatch *d, struct katcp_sensor *s
 static int configure_sensor_katcp(struct katcp_dispatch *d, struct katcp_sensor *sn, int strategy, int manual, char *extra);
 
 char *type_name_sensor_katcp(struct katcp_sensor *sn);
+char *status_name_sensor_katcp(struct katcp_sensor *sn);
 
 /**********************************************************************************************/
 
@@ -151,7 +164,7 @@ struct katcp_check_table{
   int (*c_create_acquire)(struct katcp_dispatch *d, struct katcp_acquire *a, int type);
   int (*c_create_nonsense)(struct katcp_dispatch *d, struct katcp_nonsense *ns);
   int (*c_append_type)(struct katcp_dispatch *d, int flags, struct katcp_sensor *sn);
-  int (*c_append_value)(struct katcp_dispatch *d, int flags, struct katcp_sensor *sn);
+  int (*c_add_value)(struct katcl_parse *px, int flags, struct katcp_sensor *sn);
   int (*c_append_diff)(struct katcp_dispatch *d, int flags, struct katcp_nonsense *ns);
   int (*c_scan_diff)(struct katcp_nonsense *ns, char *extra);
   int (*c_scan_value)(struct katcp_sensor *sn, char *value);
@@ -505,7 +518,7 @@ int append_type_double_katcp(struct katcp_dispatch *d, int flags, struct katcp_s
   }
 }
 
-int append_value_double_katcp(struct katcp_dispatch *d, int flags, struct katcp_sensor *sn)
+int add_value_double_katcp(struct katcl_parse *px, int flags, struct katcp_sensor *sn)
 {
   struct katcp_double_sensor *ds;
 
@@ -515,7 +528,7 @@ int append_value_double_katcp(struct katcp_dispatch *d, int flags, struct katcp_
 
   ds = sn->s_more;
 
-  return append_double_katcp(d, KATCP_FLAG_DOUBLE | (flags & (KATCP_FLAG_FIRST | KATCP_FLAG_LAST)), ds->ds_current);
+  return add_double_parse_katcl(px, KATCP_FLAG_DOUBLE | (flags & (KATCP_FLAG_FIRST | KATCP_FLAG_LAST)), ds->ds_current);
 }
 
 int append_diff_double_katcp(struct katcp_dispatch *d, int flags, struct katcp_nonsense *ns)
@@ -789,7 +802,7 @@ int append_type_discrete_katcp(struct katcp_dispatch *d, int flags, struct katcp
   return total;
 }
 
-int append_value_discrete_katcp(struct katcp_dispatch *d, int flags, struct katcp_sensor *sn)
+int add_value_discrete_katcp(struct katcl_parse *px, int flags, struct katcp_sensor *sn)
 {
   struct katcp_discrete_sensor *ds;
 
@@ -799,14 +812,15 @@ int append_value_discrete_katcp(struct katcp_dispatch *d, int flags, struct katc
 
   ds = sn->s_more;
 
-#ifdef DEBUG
   if(ds->ds_current >= ds->ds_size){
-    fprintf(stderr, "append discrete value: major logic problem: current %u is larger than size %u\n", ds->ds_current, ds->ds_size);
+#ifdef DEBUG
+    fprintf(stderr, "add discrete value: major logic problem: current %u is larger than size %u\n", ds->ds_current, ds->ds_size);
     abort();
-  }
 #endif
+    return -1;
+  }
 
-  return append_string_katcp(d, KATCP_FLAG_STRING | (flags & (KATCP_FLAG_FIRST | KATCP_FLAG_LAST)), ds->ds_vector[ds->ds_current]);
+  return add_string_parse_katcl(px, KATCP_FLAG_STRING | (flags & (KATCP_FLAG_FIRST | KATCP_FLAG_LAST)), ds->ds_vector[ds->ds_current]);
 }
 
 int set_value_discrete_katcp(struct katcp_acquire *a, unsigned int value)
@@ -1377,7 +1391,7 @@ int append_type_integer_katcp(struct katcp_dispatch *d, int flags, struct katcp_
   }
 }
 
-int append_value_intbool_katcp(struct katcp_dispatch *d, int flags, struct katcp_sensor *sn)
+int add_value_intbool_katcp(struct katcl_parse *px, int flags, struct katcp_sensor *sn)
 {
   struct katcp_integer_sensor *is;
 
@@ -1387,7 +1401,7 @@ int append_value_intbool_katcp(struct katcp_dispatch *d, int flags, struct katcp
 
   is = sn->s_more;
 
-  return append_signed_long_katcp(d, KATCP_FLAG_SLONG | (flags & (KATCP_FLAG_FIRST | KATCP_FLAG_LAST)), (long)(is->is_current));
+  return add_signed_long_parse_katcl(px, KATCP_FLAG_SLONG | (flags & (KATCP_FLAG_FIRST | KATCP_FLAG_LAST)), (long)(is->is_current));
 }
 
 int append_diff_integer_katcp(struct katcp_dispatch *d, int flags, struct katcp_nonsense *ns)
@@ -1637,7 +1651,7 @@ static struct katcp_check_table type_lookup_table[] = {
       &create_acquire_intbool_katcp,
       &create_nonsense_intbool_katcp,
       &append_type_integer_katcp,
-      &append_value_intbool_katcp,
+      &add_value_intbool_katcp,
       &append_diff_integer_katcp,
       &scan_diff_integer_katcp,
       &scan_value_intbool_katcp,
@@ -1657,7 +1671,7 @@ static struct katcp_check_table type_lookup_table[] = {
       &create_acquire_intbool_katcp,
       &create_nonsense_intbool_katcp,
        NULL,
-      &append_value_intbool_katcp,
+      &add_value_intbool_katcp,
        NULL,
        NULL,
       &scan_value_intbool_katcp,
@@ -1677,7 +1691,7 @@ static struct katcp_check_table type_lookup_table[] = {
        &create_acquire_discrete_katcp, 
        &create_nonsense_discrete_katcp, 
        &append_type_discrete_katcp,
-       &append_value_discrete_katcp, 
+       &add_value_discrete_katcp,
        NULL,
        NULL,
        &scan_value_discrete_katcp,
@@ -1719,7 +1733,7 @@ static struct katcp_check_table type_lookup_table[] = {
       &create_acquire_double_katcp,
       &create_nonsense_double_katcp,
       &append_type_double_katcp,
-      &append_value_double_katcp,
+      &add_value_double_katcp,
       &append_diff_double_katcp,
       &scan_diff_double_katcp,
       &scan_value_double_katcp,
@@ -1782,6 +1796,31 @@ void destroy_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
 #endif
   struct katcp_discrete_acquire *dsa;
 
+#ifdef KATCP_ASYNC_ACQUIRE
+  if(a->a_job){
+    if(a->a_job->j_busy){
+      /* a worker still holds the acquire, only unhook it now */
+      if(a->a_job->j_doomed == 0){
+        a->a_job->j_doomed = 1;
+        discharge_timer_katcp(d, a->a_job);
+        for(i = 0; i < a->a_count; i++){
+          s = a->a_sensors[i];
+          if(s){
+            s->s_acquire = NULL;
+          }
+        }
+        a->a_count = 0;
+        leave_tick_acquire_katcp(d, a);
+        a->a_periodics = 0;
+        a->a_users = 0;
+      }
+      return;
+    }
+    free(a->a_job);
+    a->a_job = NULL;
+  }
+#endif
+
   if(a->a_release){
     (*(a->a_release))(d, a);
     a->a_release = NULL;
@@ -1802,9 +1841,7 @@ void destroy_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
   }
   a->a_count = 0;
 
-  if(a->a_periodics){
-    discharge_timer_katcp(d, a);
-  }
+  leave_tick_acquire_katcp(d, a);
   a->a_periodics = 0;
   a->a_users = 0;
 
@@ -1896,6 +1933,12 @@ static struct katcp_acquire *extended_create_acquire_katcp(struct katcp_dispatch
 
   a->a_more = NULL; 
 
+  a->a_tick = NULL;
+
+#ifdef KATCP_ASYNC_ACQUIRE
+  a->a_job = NULL;
+#endif
+
   if((*(type_lookup_table[type].c_create_acquire))(d, a, type) < 0){
     destroy_acquire_katcp(d, a);
     return NULL;
@@ -2084,28 +2127,204 @@ static int del_acquire_katcp(struct katcp_dispatch *d, struct katcp_sensor *sn)
 
 /* core function invoked to emit sensor notifications ********************************/
 
-int run_timer_acquire_katcp(struct katcp_dispatch *d, void *data)
+/* shared ticks: acquires with the same poll period are run from one timer,
+ * off a single clock reading. As all their updates are queued in the
+ * same pass through the loop, each client gets them in one write */
+
+static int run_at_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, int forced, struct timeval *now);
+
+static int run_tick_acquire_katcp(struct katcp_dispatch *d, void *data)
 {
+  struct katcp_acquire_tick *k;
   struct katcp_acquire *a;
+  struct timeval now;
+  unsigned int i;
 
-  a = data;
+  k = data;
 
-  if(a == NULL){
+  if(k == NULL){
     return -1;
   }
 
+  gettimeofday(&now, NULL);
+
+  for(i = 0; i < k->k_count; i++){
+    a = k->k_vector[i];
 #ifdef DEBUG
-  if(a->a_periodics <= 0){
-    fprintf(stderr, "run: major logic failure: polling acquire %p from timer without any polling clients (%d users)\n", a, a->a_users);
-    abort();
+    if(a->a_periodics <= 0){
+      fprintf(stderr, "run: major logic failure: polling acquire %p from timer without any polling clients (%d users)\n", a, a->a_users);
+      abort();
+    }
+#endif
+    run_at_acquire_katcp(d, a, 0, &now);
+  }
+
+  return 0;
+}
+
+/* first run on a multiple of the period, counted from a whole second */
+
+static void phase_tick_katcp(struct timeval *when, struct timeval *now, struct timeval *period)
+{
+  unsigned long step;
+
+  if((period->tv_usec == 0) && (period->tv_sec > 0)){
+    when->tv_sec = ((now->tv_sec / period->tv_sec) + 1) * period->tv_sec;
+    when->tv_usec = 0;
+    return;
+  }
+
+  if((period->tv_sec == 0) && (period->tv_usec > 0) && ((1000000 % period->tv_usec) == 0)){
+    step = period->tv_usec;
+    when->tv_sec = now->tv_sec;
+    when->tv_usec = ((now->tv_usec / step) + 1) * step;
+    if(when->tv_usec >= 1000000){
+      when->tv_sec++;
+      when->tv_usec -= 1000000;
+    }
+    return;
+  }
+
+  /* awkward periods can not be phase locked, but still share */
+  add_time_katcp(when, now, period);
+}
+
+static int join_tick_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
+{
+  struct katcp_shared *s;
+  struct katcp_acquire_tick *k, **tmp;
+  struct katcp_acquire **vector;
+  struct timeval now, when;
+  unsigned int i;
+
+  s = d->d_shared;
+
+  if(a->a_tick){
+    if(cmp_time_katcp(&(a->a_tick->k_period), &(a->a_current)) == 0){
+      return 0;
+    }
+    leave_tick_acquire_katcp(d, a);
+  }
+
+  k = NULL;
+  for(i = 0; i < s->s_tick_count; i++){
+    if(cmp_time_katcp(&(s->s_ticks[i]->k_period), &(a->a_current)) == 0){
+      k = s->s_ticks[i];
+      break;
+    }
+  }
+
+  if(k == NULL){
+    tmp = realloc(s->s_ticks, sizeof(struct katcp_acquire_tick *) * (s->s_tick_count + 1));
+    if(tmp == NULL){
+      return -1;
+    }
+    s->s_ticks = tmp;
+
+    k = malloc(sizeof(struct katcp_acquire_tick));
+    if(k == NULL){
+      return -1;
+    }
+
+    k->k_period.tv_sec = a->a_current.tv_sec;
+    k->k_period.tv_usec = a->a_current.tv_usec;
+    k->k_vector = NULL;
+    k->k_count = 0;
+    k->k_size = 0;
+
+    gettimeofday(&now, NULL);
+    phase_tick_katcp(&when, &now, &(k->k_period));
+
+    if(register_every_at_tv_katcp(d, &when, &(k->k_period), &run_tick_acquire_katcp, k) < 0){
+      free(k);
+      return -1;
+    }
+
+    s->s_ticks[s->s_tick_count] = k;
+    s->s_tick_count++;
+
+    log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "new sensor tick every %lu.%06lus starting at %lu.%06lu", k->k_period.tv_sec, k->k_period.tv_usec, when.tv_sec, when.tv_usec);
+  }
+
+  if(k->k_count >= k->k_size){
+    vector = realloc(k->k_vector, sizeof(struct katcp_acquire *) * (k->k_size + 8));
+    if(vector == NULL){
+      return -1;
+    }
+    k->k_vector = vector;
+    k->k_size += 8;
+  }
+
+  k->k_vector[k->k_count] = a;
+  k->k_count++;
+
+  a->a_tick = k;
+
+  return 0;
+}
+
+static void leave_tick_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
+{
+  struct katcp_shared *s;
+  struct katcp_acquire_tick *k;
+  unsigned int i;
+
+  k = a->a_tick;
+  if(k == NULL){
+    return;
   }
-  fprintf(stderr, "sensor: running acquire %p with %d users, %d periodic\n", a, a->a_users, a->a_periodics);
+
+  a->a_tick = NULL;
+
+  for(i = 0; (i < k->k_count) && (k->k_vector[i] != a); i++);
+
+  if(i >= k->k_count){
+#ifdef KATCP_CONSISTENCY_CHECKS
+    fprintf(stderr, "logic problem: acquire %p not found in its tick %p\n", a, k);
+    abort();
 #endif
+    return;
+  }
+
+  /* keep the order, a tick in progress may be iterating over it */
+  k->k_count--;
+  memmove(&(k->k_vector[i]), &(k->k_vector[i + 1]), sizeof(struct katcp_acquire *) * (k->k_count - i));
+
+  if(k->k_count > 0){
+    return;
+  }
 
-  return run_acquire_katcp(d, a, 0);
+  s = d->d_shared;
+
+  discharge_timer_katcp(d, k);
+
+  for(i = 0; (i < s->s_tick_count) && (s->s_ticks[i] != k); i++);
+  if(i < s->s_tick_count){
+    s->s_tick_count--;
+    s->s_ticks[i] = s->s_ticks[s->s_tick_count];
+  }
+
+  if(s->s_tick_count == 0){
+    free(s->s_ticks);
+    s->s_ticks = NULL;
+  }
+
+  if(k->k_vector){
+    free(k->k_vector);
+  }
+  free(k);
 }
 
 static int run_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, int forced)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return run_at_acquire_katcp(d, a, forced, &now);
+}
+
+static int run_at_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, int forced, struct timeval *when)
 {
   struct katcp_integer_acquire *ia;
 #ifdef KATCP_USE_FLOATS
@@ -2124,7 +2343,8 @@ static int run_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a,
 
   log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "sensor: running acquire %p with %d sensors %d users of which %d periodic", a, a->a_count, a->a_users, a->a_periodics);
 
-  gettimeofday(&now, NULL);
+  now.tv_sec = when->tv_sec;
+  now.tv_usec = when->tv_usec;
 
   add_time_katcp(&legal, &(a->a_last), &(a->a_limit));
   if(cmp_time_katcp(&now, &legal) < 0){
@@ -2137,6 +2357,15 @@ static int run_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a,
     a->a_real.tv_usec = now.tv_usec;
 #endif
 
+#ifdef KATCP_ASYNC_ACQUIRE
+    /* propagated once the pool hands back the result */
+    if(a->a_job && (submit_acquire_katcp(d, a, &now) == 0)){
+      a->a_last.tv_sec  = now.tv_sec;
+      a->a_last.tv_usec = now.tv_usec;
+      return 0;
+    }
+#endif
+
     switch(a->a_type){
       case KATCP_SENSOR_INTEGER :
       case KATCP_SENSOR_BOOLEAN :
@@ -2171,20 +2400,127 @@ static int run_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a,
     a->a_last.tv_usec = now.tv_usec;
   }
 
-  propagate_acquire_katcp(d, a);
+  propagate_at_acquire_katcp(d, a, &now);
 
   return 0;
 }
 
-int propagate_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
+/* sensor status updates: built once per change, shared by all subscribers */
+
+static int add_value_sensor_katcp(struct katcl_parse *px, int flags, struct katcp_sensor *sn)
 {
-  int j, i;
-  struct katcp_sensor *sn;
+  if(type_lookup_table[sn->s_type].c_add_value == NULL){
+    return -1;
+  }
+
+  return (*(type_lookup_table[sn->s_type].c_add_value))(px, flags, sn);
+}
+
+static struct timeval *time_sensor_katcp(struct katcp_sensor *sn)
+{
+#ifdef KATCP_EXPERIMENTAL
+  if(sn->s_acquire){
+    return &(sn->s_acquire->a_real);
+  }
+#endif
+  return &(sn->s_recent);
+}
+
+/* a complete update, name is the sensor-status or sensor-value inform */
+
+static struct katcl_parse *status_parse_sensor_katcp(struct katcp_sensor *sn, char *name)
+{
+  struct katcl_parse *px;
+  char *status;
+  int result;
+
+  status = status_name_sensor_katcp(sn);
+  if(status == NULL){
+    return NULL;
+  }
+
+  px = create_referenced_parse_katcl();
+  if(px == NULL){
+    return NULL;
+  }
+
+  result = 0;
+  result += add_string_parse_katcl(px, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, name);
+  result += add_timestamp_parse_katcl(px, 0, time_sensor_katcp(sn));
+  result += add_string_parse_katcl(px, KATCP_FLAG_STRING, "1");
+  result += add_string_parse_katcl(px, KATCP_FLAG_STRING, sn->s_name);
+  result += add_string_parse_katcl(px, KATCP_FLAG_STRING, status);
+
+  if((add_value_sensor_katcp(px, KATCP_FLAG_LAST, sn) < 0) || (result <= 0)){
+    destroy_parse_katcl(px);
+    return NULL;
+  }
+
+  return px;
+}
+
+static void notify_sensor_katcp(struct katcp_dispatch *d, struct katcp_sensor *sn, struct timeval *now)
+{
+  int i;
   struct katcp_nonsense *ns;
   struct katcp_dispatch *dx;
-  struct timeval now;
+  struct katcl_parse *px;
 
-  gettimeofday(&now, NULL);
+  px = NULL;
+
+  log_message_katcp(d, KATCP_LEVEL_TRACE | KATCP_LEVEL_LOCAL, NULL, "checking %d clients of %s@%p", sn->s_refs, sn->s_name, sn);
+
+  for(i = 0; i < sn->s_refs; i++){
+    ns = sn->s_nonsense[i];
+    sane_nonsense(ns);
+#ifdef DEBUG
+    if((ns == NULL) || (ns->n_client == NULL)){
+      fprintf(stderr, "run: logic problem: null nonsense fields\n");
+      abort();
+    }
+#endif
+    dx = ns->n_client;
+
+#ifdef DEBUG
+    if((ns->n_strategy < 0) || (ns->n_strategy >= KATCP_STRATEGIES_COUNT)){
+      fprintf(stderr, "run: logic problem: invalid strategy %d\n", ns->n_strategy);
+      abort();
+    }
+#endif
+
+    sn->s_recent.tv_sec = now->tv_sec;
+    sn->s_recent.tv_usec = now->tv_usec;
+
+    log_message_katcp(d, KATCP_LEVEL_TRACE | KATCP_LEVEL_LOCAL, NULL, "calling check function %p (type %d, strategy %d)", type_lookup_table[sn->s_type].c_checks[ns->n_strategy], sn->s_type, ns->n_strategy);
+
+    if(type_lookup_table[sn->s_type].c_checks[ns->n_strategy]){
+
+      if((*(type_lookup_table[sn->s_type].c_checks[ns->n_strategy]))(ns)){
+        log_message_katcp(d, KATCP_LEVEL_TRACE | KATCP_LEVEL_LOCAL, NULL, "strategy %d reports a match", ns->n_strategy);
+        /* TODO: needs work for having tags in katcp messages */
+        if(ns->n_strategy == KATCP_STRATEGY_FORCED){
+          generic_sensor_update_katcp(dx, sn, KATCP_SENSOR_VALUE_INFORM);
+        } else {
+          if(px == NULL){
+            px = status_parse_sensor_katcp(sn, KATCP_SENSOR_STATUS_INFORM);
+          }
+          if(px){
+            append_parse_katcp(dx, px);
+          }
+        }
+      }
+    }
+  }
+
+  if(px){
+    destroy_parse_katcl(px);
+  }
+}
+
+static int propagate_at_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, struct timeval *now)
+{
+  int j;
+  struct katcp_sensor *sn;
 
   for(j = 0; j < a->a_count; j++){
 
@@ -2199,49 +2535,450 @@ int propagate_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
 #endif
 
     if((*(sn->s_extract))(d, sn) >= 0){ /* got a useful value */
+      notify_sensor_katcp(d, sn, now);
+    } else {
+      log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "extract function for sensor %s failed", sn->s_name);
+    }
+  }
 
-      log_message_katcp(d, KATCP_LEVEL_TRACE | KATCP_LEVEL_LOCAL, NULL, "checking %d clients of %s@%p", sn->s_refs, sn->s_name, sn);
+  return 0;
+}
 
-      for(i = 0; i < sn->s_refs; i++){
-        ns = sn->s_nonsense[i];
-        sane_nonsense(ns);
-#ifdef DEBUG
-        if((ns == NULL) || (ns->n_client == NULL)){
-          fprintf(stderr, "run: logic problem: null nonsense fields\n");
-          abort();
-        }
+int propagate_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return propagate_at_acquire_katcp(d, a, &now);
+}
+
+#ifdef KATCP_ASYNC_ACQUIRE
+
+/* asynchronous acquires: slow get functions (i2c, sysfs) run on a
+ * small pool of threads. The get function is called with a NULL
+ * dispatch and must only touch its own local state. Results come back
+ * over a socket watched by the main loop, which then propagates them */
+
+static void fetch_job_acquire_katcp(struct katcp_acquire_job *j)
+{
+  struct katcp_acquire *a;
+  struct katcp_integer_acquire *ia;
+#ifdef KATCP_USE_FLOATS
+  struct katcp_double_acquire *doa;
 #endif
-        dx = ns->n_client;
+  struct katcp_discrete_acquire *dsa;
 
-#ifdef DEBUG
-        if((ns->n_strategy < 0) || (ns->n_strategy >= KATCP_STRATEGIES_COUNT)){
-          fprintf(stderr, "run: logic problem: invalid strategy %d\n", ns->n_strategy);
-          abort();
-        }
+  a = j->j_acquire;
+
+  switch(a->a_type){
+    case KATCP_SENSOR_INTEGER :
+    case KATCP_SENSOR_BOOLEAN :
+      ia = a->a_more;
+      if(ia->ia_get){
+        j->j_integer = (*(ia->ia_get))(NULL, a);
+      }
+      break;
+#ifdef KATCP_USE_FLOATS
+    case KATCP_SENSOR_FLOAT :
+      doa = a->a_more;
+      if(doa->da_get){
+        j->j_double = (*(doa->da_get))(NULL, a);
+      }
+      break;
 #endif
+    case KATCP_SENSOR_DISCRETE :
+      dsa = a->a_more;
+      if(dsa->da_get){
+        j->j_discrete = (*(dsa->da_get))(NULL, a);
+      }
+      break;
+  }
+}
 
-        sn->s_recent.tv_sec = now.tv_sec;
-        sn->s_recent.tv_usec = now.tv_usec;
+static void *worker_acquire_katcp(void *data)
+{
+  struct katcp_acquire_pool *p;
+  struct katcp_acquire_job *j;
+  char token;
 
-        log_message_katcp(d, KATCP_LEVEL_TRACE | KATCP_LEVEL_LOCAL, NULL, "calling check function %p (type %d, strategy %d)", type_lookup_table[sn->s_type].c_checks[ns->n_strategy], sn->s_type, ns->n_strategy);
+  p = data;
+  token = 0;
 
-        if(type_lookup_table[sn->s_type].c_checks[ns->n_strategy]){
-          
-          if((*(type_lookup_table[sn->s_type].c_checks[ns->n_strategy]))(ns)){
-            log_message_katcp(d, KATCP_LEVEL_TRACE | KATCP_LEVEL_LOCAL, NULL, "strategy %d reports a match", ns->n_strategy);
-            /* TODO: needs work for having tags in katcp messages */
-            generic_sensor_update_katcp(dx, sn, (ns->n_strategy == KATCP_STRATEGY_FORCED) ? KATCP_SENSOR_VALUE_INFORM : KATCP_SENSOR_STATUS_INFORM);
-          }
-        }
-      }
-    } else {
-      log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "extract function for sensor %s failed", sn->s_name);
+  pthread_mutex_lock(&(p->p_lock));
+
+  for(;;){
+    while((p->p_stop == 0) && (p->p_head == NULL)){
+      pthread_cond_wait(&(p->p_wake), &(p->p_lock));
+    }
+
+    if(p->p_stop){
+      break;
+    }
+
+    j = p->p_head;
+    p->p_head = j->j_next;
+    if(p->p_head == NULL){
+      p->p_tail = NULL;
+    }
+    p->p_busy++;
+
+    pthread_mutex_unlock(&(p->p_lock));
+
+    fetch_job_acquire_katcp(j);
+    gettimeofday(&(j->j_stop), NULL);
+
+    pthread_mutex_lock(&(p->p_lock));
+
+    p->p_busy--;
+    j->j_next = p->p_done;
+    p->p_done = j;
+
+    /* a full socket means the loop has a wakeup pending anyway */
+    send(p->p_fds[1], &token, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+
+  pthread_mutex_unlock(&(p->p_lock));
+
+  return NULL;
+}
+
+static void stop_pool_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire_pool *p)
+{
+  unsigned int i;
+
+  pthread_mutex_lock(&(p->p_lock));
+  p->p_stop = 1;
+  pthread_cond_broadcast(&(p->p_wake));
+  i = p->p_busy;
+  pthread_mutex_unlock(&(p->p_lock));
+
+  if(i > 0){
+    /* a worker is stuck in a read, leave the pool for it, process is going away */
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "abandoning %u sensor acquires still in progress", i);
+    for(i = 0; i < p->p_started; i++){
+      pthread_detach(p->p_workers[i]);
+    }
+    return;
+  }
+
+  for(i = 0; i < p->p_started; i++){
+    pthread_join(p->p_workers[i], NULL);
+  }
+
+  /* read side belongs to the arb */
+  close(p->p_fds[1]);
+
+  pthread_cond_destroy(&(p->p_wake));
+  pthread_mutex_destroy(&(p->p_lock));
+
+  free(p);
+}
+
+static void collect_job_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire_job *j)
+{
+  struct katcp_acquire *a;
+  struct katcp_integer_acquire *ia;
+#ifdef KATCP_USE_FLOATS
+  struct katcp_double_acquire *doa;
+#endif
+  struct katcp_discrete_acquire *dsa;
+  struct katcp_sensor *sn;
+  struct timeval delta;
+  unsigned int i;
+
+  a = j->j_acquire;
+
+  j->j_busy = 0;
+
+  if(j->j_doomed){
+    destroy_acquire_katcp(d, a);
+    return;
+  }
+
+  if(j->j_late == 0){
+    discharge_timer_katcp(d, j);
+  }
+
+  sub_time_katcp(&delta, &(j->j_stop), &(j->j_start));
+  add_time_katcp(&(j->j_total), &(j->j_total), &delta);
+  if(cmp_time_katcp(&delta, &(j->j_worst)) > 0){
+    j->j_worst.tv_sec = delta.tv_sec;
+    j->j_worst.tv_usec = delta.tv_usec;
+  }
+  j->j_count++;
+
+  switch(a->a_type){
+    case KATCP_SENSOR_INTEGER :
+    case KATCP_SENSOR_BOOLEAN :
+      ia = a->a_more;
+      ia->ia_current = j->j_integer;
+      break;
+#ifdef KATCP_USE_FLOATS
+    case KATCP_SENSOR_FLOAT :
+      doa = a->a_more;
+      doa->da_current = j->j_double;
+      break;
+#endif
+    case KATCP_SENSOR_DISCRETE :
+      dsa = a->a_more;
+      dsa->da_current = j->j_discrete;
+      break;
+  }
+
+  if(j->j_late){
+    /* extract functions need not reset the status we forced */
+    for(i = 0; i < a->a_count; i++){
+      sn = a->a_sensors[i];
+      set_status_sensor_katcp(sn, KATCP_STATUS_NOMINAL);
     }
+    log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "late sensor acquire completed after %lu.%06lus", delta.tv_sec, delta.tv_usec);
+    j->j_late = 0;
+  }
+
+  propagate_acquire_katcp(d, a);
+}
+
+static int run_pool_acquire_katcp(struct katcp_dispatch *d, struct katcp_arb *arb, unsigned int mode)
+{
+  struct katcp_acquire_pool *p;
+  struct katcp_acquire_job *j, *done;
+  struct katcp_shared *s;
+  char buffer[64];
+
+  p = data_arb_katcp(d, arb);
+  s = d->d_shared;
+
+  if(mode & KATCP_ARB_STOP){
+    if(s && (s->s_acquire_pool == p)){
+      s->s_acquire_pool = NULL;
+    }
+    stop_pool_acquire_katcp(d, p);
+    return 0;
+  }
+
+  while(recv(fileno_arb_katcp(d, arb), buffer, sizeof(buffer), MSG_DONTWAIT) > 0);
+
+  pthread_mutex_lock(&(p->p_lock));
+  done = p->p_done;
+  p->p_done = NULL;
+  pthread_mutex_unlock(&(p->p_lock));
+
+  while(done){
+    j = done;
+    done = j->j_next;
+    j->j_next = NULL;
+    collect_job_acquire_katcp(d, j);
   }
 
   return 0;
 }
 
+static struct katcp_acquire_pool *create_pool_acquire_katcp(struct katcp_dispatch *d)
+{
+  struct katcp_acquire_pool *p;
+  sigset_t all, previous;
+  unsigned int i;
+
+  p = malloc(sizeof(struct katcp_acquire_pool));
+  if(p == NULL){
+    return NULL;
+  }
+
+  p->p_started = 0;
+  p->p_busy = 0;
+  p->p_stop = 0;
+  p->p_head = NULL;
+  p->p_tail = NULL;
+  p->p_done = NULL;
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, p->p_fds) < 0){
+    free(p);
+    return NULL;
+  }
+
+  for(i = 0; i < 2; i++){
+    fcntl(p->p_fds[i], F_SETFD, FD_CLOEXEC);
+    fcntl(p->p_fds[i], F_SETFL, O_NONBLOCK);
+  }
+
+  pthread_mutex_init(&(p->p_lock), NULL);
+  pthread_cond_init(&(p->p_wake), NULL);
+
+  if(create_arb_katcp(d, "acquire-pool", p->p_fds[0], KATCP_ARB_READ | KATCP_ARB_STOP, &run_pool_acquire_katcp, p) == NULL){
+    close(p->p_fds[0]);
+    close(p->p_fds[1]);
+    pthread_cond_destroy(&(p->p_wake));
+    pthread_mutex_destroy(&(p->p_lock));
+    free(p);
+    return NULL;
+  }
+
+  /* signals are for the main loop, workers inherit the mask */
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &previous);
+
+  for(i = 0; i < KATCP_ACQUIRE_WORKERS; i++){
+    if(pthread_create(&(p->p_workers[i]), NULL, &worker_acquire_katcp, p) != 0){
+      break;
+    }
+    p->p_started++;
+  }
+
+  pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+  if(p->p_started == 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to start any sensor acquire threads");
+  }
+
+  /* from now on the arb owns the pool, including on failure */
+  return p;
+}
+
+static int timeout_acquire_katcp(struct katcp_dispatch *d, void *data)
+{
+  struct katcp_acquire_job *j;
+  struct katcp_acquire *a;
+  struct katcp_sensor *sn;
+  struct timeval now;
+  unsigned int i;
+
+  j = data;
+
+  if((j->j_busy == 0) || j->j_doomed){
+    return 0;
+  }
+
+  a = j->j_acquire;
+
+  j->j_late = 1;
+  j->j_timeouts++;
+
+  log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "sensor acquire for %s still outstanding after %lu.%06lus", (a->a_count > 0) ? a->a_sensors[0]->s_name : "unused sensor", j->j_timeout.tv_sec, j->j_timeout.tv_usec);
+
+  gettimeofday(&now, NULL);
+
+  for(i = 0; i < a->a_count; i++){
+    sn = a->a_sensors[i];
+    set_status_sensor_katcp(sn, KATCP_STATUS_FAILURE);
+    notify_sensor_katcp(d, sn, &now);
+  }
+
+  return 0;
+}
+
+/* returns 0 if the acquire was handed to the pool, otherwise caller reads it inline */
+
+static int submit_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, struct timeval *now)
+{
+  struct katcp_acquire_pool *p;
+  struct katcp_acquire_job *j;
+  struct katcp_shared *s;
+
+  s = d->d_shared;
+  j = a->a_job;
+
+  p = s->s_acquire_pool;
+  if((p == NULL) || (p->p_started == 0)){
+    return -1;
+  }
+
+  if(j->j_busy){
+    log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "previous read of acquire %p still in progress", a);
+    return 0;
+  }
+
+  j->j_busy = 1;
+  j->j_start.tv_sec = now->tv_sec;
+  j->j_start.tv_usec = now->tv_usec;
+
+  pthread_mutex_lock(&(p->p_lock));
+  j->j_next = NULL;
+  if(p->p_tail){
+    p->p_tail->j_next = j;
+  } else {
+    p->p_head = j;
+  }
+  p->p_tail = j;
+  pthread_cond_signal(&(p->p_wake));
+  pthread_mutex_unlock(&(p->p_lock));
+
+  if(j->j_timeout.tv_sec || j->j_timeout.tv_usec){
+    if(register_in_tv_katcp(d, &(j->j_timeout), &timeout_acquire_katcp, j) < 0){
+      log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unable to schedule timeout for acquire %p", a);
+    }
+  }
+
+  return 0;
+}
+
+/* opt in: future reads of this acquire happen off the main loop. A
+ * read taking longer than timeout (if nonzero) fails its sensors until
+ * it completes. Once set, the get function may not use its dispatch */
+
+int async_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a, struct timeval *timeout)
+{
+  struct katcp_shared *s;
+  struct katcp_acquire_job *j;
+
+  sane_acquire(a);
+
+  s = d->d_shared;
+  if(s == NULL){
+    return -1;
+  }
+
+  if(s->s_acquire_pool == NULL){
+    s->s_acquire_pool = create_pool_acquire_katcp(d);
+    if(s->s_acquire_pool == NULL){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to set up sensor acquire pool");
+      return -1;
+    }
+  }
+
+  j = a->a_job;
+  if(j == NULL){
+    j = malloc(sizeof(struct katcp_acquire_job));
+    if(j == NULL){
+      return -1;
+    }
+
+    j->j_acquire = a;
+    j->j_next = NULL;
+
+    j->j_busy = 0;
+    j->j_late = 0;
+    j->j_doomed = 0;
+
+    j->j_integer = 0;
+#ifdef KATCP_USE_FLOATS
+    j->j_double = 0.0;
+#endif
+    j->j_discrete = 0;
+
+    j->j_count = 0;
+    j->j_timeouts = 0;
+    j->j_total.tv_sec = 0;
+    j->j_total.tv_usec = 0;
+    j->j_worst.tv_sec = 0;
+    j->j_worst.tv_usec = 0;
+
+    a->a_job = j;
+  }
+
+  if(timeout){
+    j->j_timeout.tv_sec = timeout->tv_sec;
+    j->j_timeout.tv_usec = timeout->tv_usec;
+  } else {
+    j->j_timeout.tv_sec = 0;
+    j->j_timeout.tv_usec = 0;
+  }
+
+  return 0;
+}
+
+#endif
+
 void *get_local_acquire_katcp(struct katcp_dispatch *d, struct katcp_acquire *a)
 {
   if(a == NULL){
@@ -2538,7 +3275,7 @@ static int reload_sensor_katcp(struct katcp_dispatch *d, struct katcp_sensor *sz
 
   if(periodics == 0){
     if(a->a_periodics > 0){ /* we had timers, but don't want them anymore */
-      discharge_timer_katcp(d, a);
+      leave_tick_acquire_katcp(d, a);
     } else {
       /* we didn't have timers previously, we don't want them now */
     }
@@ -2552,7 +3289,7 @@ static int reload_sensor_katcp(struct katcp_dispatch *d, struct katcp_sensor *sz
 
   } else { /* we need timers, replace old with new if necessary */
     a->a_periodics = periodics;
-    if(register_every_tv_katcp(d, &(a->a_current), &run_timer_acquire_katcp, a) < 0){
+    if(join_tick_acquire_katcp(d, a) < 0){
       return -1;
     }
   }
@@ -3184,67 +3921,49 @@ int scan_value_sensor_katcp(struct katcp_sensor *sn, char *value)
 
 int append_sensor_value_katcp(struct katcp_dispatch *d, int flags, struct katcp_sensor *sn)
 {
+  struct katcl_parse *px;
+  int result;
+
   sane_sensor(sn);
 
-  if(type_lookup_table[sn->s_type].c_append_value == NULL){
-    fprintf(stderr, "append value: major logic problem: no append value function\n");
+  if(type_lookup_table[sn->s_type].c_add_value == NULL){
+    fprintf(stderr, "append value: major logic problem: no add value function\n");
     abort();
   }
 
-  return (*(type_lookup_table[sn->s_type].c_append_value))(d, flags, sn);
-}
-
-int generic_sensor_update_katcp(struct katcp_dispatch *d, struct katcp_sensor *sn, char *name)
-{
-  char *status;
-  struct timeval *tv;
-
-#ifdef KATCP_EXPERIMENTAL
-  struct katcp_acquire *a;
-
-  a = sn->s_acquire;
-  if(a){
-    tv = &(a->a_real);
-  } else {
-    tv = &(sn->s_recent);
-  }
-#else
-  tv = &(sn->s_recent);
-#endif
-
-  if(append_string_katcp(d, KATCP_FLAG_STRING | KATCP_FLAG_FIRST, name) < 0){
+  /* formatted once by the type, copied across as a parameter */
+  px = create_referenced_parse_katcl();
+  if(px == NULL){
     return -1;
   }
 
-#if KATCP_PROTOCOL_MAJOR_VERSION >= 5
-  if(append_args_katcp(d, 0, "%lu.%03lu", tv->tv_sec, tv->tv_usec / 1000) < 0){
-    return -1;
-  }
-#else 
-  if(append_args_katcp(d, 0, "%lu%03lu", tv->tv_sec, tv->tv_usec / 1000) < 0){
+  if((*(type_lookup_table[sn->s_type].c_add_value))(px, KATCP_FLAG_FIRST | KATCP_FLAG_LAST, sn) < 0){
+    destroy_parse_katcl(px);
     return -1;
   }
-#endif
 
-  /* dirty shortcut */
-  if(append_string_katcp(d, KATCP_FLAG_STRING, "1") < 0){
-    return -1;
-  }
+  result = append_parameter_katcp(d, flags, px, 0);
 
-  if(append_string_katcp(d, KATCP_FLAG_STRING, sn->s_name) < 0){
-    return -1;
-  }
+  destroy_parse_katcl(px);
 
-  status = status_name_sensor_katcp(sn);
-  if(status == NULL){
-    return -1;
-  }
+  return result;
+}
+
+int generic_sensor_update_katcp(struct katcp_dispatch *d, struct katcp_sensor *sn, char *name)
+{
+  struct katcl_parse *px;
+  int result;
 
-  if(append_string_katcp(d, KATCP_FLAG_STRING, status) < 0){
+  px = status_parse_sensor_katcp(sn, name);
+  if(px == NULL){
     return -1;
   }
 
-  return append_sensor_value_katcp(d, KATCP_FLAG_LAST, sn);
+  result = append_parse_katcp(d, px);
+
+  destroy_parse_katcl(px);
+
+  return result;
 }
 
 int force_acquire_katcp(struct katcp_dispatch *d, struct katcp_sensor *sn)
@@ -3868,6 +4587,11 @@ int sensor_dump_cmd_katcp(struct katcp_dispatch *d, int argc)
         break;
 #endif
     }
+#ifdef KATCP_ASYNC_ACQUIRE
+    if(a->a_job){
+      log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "acquire read %lu times off the main loop taking %luus on average and %lu.%06lus at worst, %lu timeouts%s", a->a_job->j_count, a->a_job->j_count ? (((a->a_job->j_total.tv_sec * 1000000UL) + a->a_job->j_total.tv_usec) / a->a_job->j_count) : 0UL, a->a_job->j_worst.tv_sec, a->a_job->j_worst.tv_usec, a->a_job->j_timeouts, a->a_job->j_busy ? ", read in progress" : "");
+    }
+#endif
     if(got == 0){
       log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "logic problem - acquire does not know about this sensor");
     }
@@ -39,6 +39,243 @@ static void sane_notice_katcp(struct katcp_notice *n)
 
 /**********************************************************************************/
 
+/* named notices are indexed twice: by hash for exact lookups and in an */
+/* array sorted by name for prefix searches. Notices which have been */
+/* triggered, or which may have lost their last user, are put on a */
+/* ready list, so that run_notices does not need to visit all of them */
+
+#define KATCP_NOTICE_BUCKETS 64
+
+static unsigned int hash_notice_katcp(struct katcp_shared *s, char *name)
+{
+  unsigned int v;
+
+  for(v = 5381; *name != '\0'; name++){
+    v = (v * 33) ^ ((unsigned char)(*name));
+  }
+
+  return v & (s->s_notice_slots - 1);
+}
+
+static unsigned int order_notice_katcp(struct katcp_shared *s, char *name)
+{
+  unsigned int low, high, mid;
+
+  /* first position with a name not less than the given one */
+
+  low = 0;
+  high = s->s_notice_named;
+
+  while(low < high){
+    mid = low + ((high - low) / 2);
+    if(strcmp(s->s_notice_order[mid]->n_name, name) < 0){
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  return low;
+}
+
+static int build_table_notice_katcp(struct katcp_shared *s, unsigned int size)
+{
+  struct katcp_notice **table, *n, *nx;
+  unsigned int i, key;
+
+  table = malloc(sizeof(struct katcp_notice *) * size);
+  if(table == NULL){
+    return -1;
+  }
+
+  for(i = 0; i < size; i++){
+    table[i] = NULL;
+  }
+
+  if(s->s_notice_table){
+    free(s->s_notice_table);
+  }
+
+  s->s_notice_table = table;
+  s->s_notice_slots = size;
+
+  for(i = 0; i < s->s_pending; i++){
+    n = s->s_notices[i];
+    if(n->n_name){
+      n->n_chain = NULL;
+      key = hash_notice_katcp(s, n->n_name);
+      if(table[key]){
+        for(nx = table[key]; nx->n_chain; nx = nx->n_chain);
+        nx->n_chain = n;
+      } else {
+        table[key] = n;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/* make room for one more named notice, so that insert_notice can not fail */
+
+static int reserve_notice_katcp(struct katcp_shared *s)
+{
+  struct katcp_notice **tmp;
+  unsigned int i;
+
+  tmp = realloc(s->s_notice_order, sizeof(struct katcp_notice *) * (s->s_notice_named + 1));
+  if(tmp == NULL){
+    return -1;
+  }
+  s->s_notice_order = tmp;
+
+  if(s->s_notice_table == NULL){
+    /* nothing indexed yet, so start empty rather than build, which would pick up the notice about to be inserted */
+    tmp = malloc(sizeof(struct katcp_notice *) * KATCP_NOTICE_BUCKETS);
+    if(tmp == NULL){
+      return -1;
+    }
+    for(i = 0; i < KATCP_NOTICE_BUCKETS; i++){
+      tmp[i] = NULL;
+    }
+    s->s_notice_table = tmp;
+    s->s_notice_slots = KATCP_NOTICE_BUCKETS;
+  }
+
+  return 0;
+}
+
+static void insert_notice_katcp(struct katcp_shared *s, struct katcp_notice *n)
+{
+  struct katcp_notice *nx;
+  unsigned int pos, key;
+
+  /* expects n to be in s_notices already, with a name, and reserve_notice to have succeeded */
+
+  n->n_chain = NULL;
+
+  pos = order_notice_katcp(s, n->n_name);
+  if(pos < s->s_notice_named){
+    memmove(&(s->s_notice_order[pos + 1]), &(s->s_notice_order[pos]), sizeof(struct katcp_notice *) * (s->s_notice_named - pos));
+  }
+  s->s_notice_order[pos] = n;
+  s->s_notice_named++;
+
+  if(s->s_notice_named > (s->s_notice_slots * 2)){
+    if(build_table_notice_katcp(s, s->s_notice_slots * 2) == 0){
+      return;
+    }
+    /* failure to grow only makes chains longer */
+  }
+
+  /* append, so that the oldest of equally named notices is found first */
+  key = hash_notice_katcp(s, n->n_name);
+  if(s->s_notice_table[key]){
+    for(nx = s->s_notice_table[key]; nx->n_chain; nx = nx->n_chain);
+    nx->n_chain = n;
+  } else {
+    s->s_notice_table[key] = n;
+  }
+}
+
+static int index_notice_katcp(struct katcp_shared *s, struct katcp_notice *n)
+{
+  n->n_chain = NULL;
+
+  if(n->n_name == NULL){
+    return 0;
+  }
+
+  if(reserve_notice_katcp(s) < 0){
+    return -1;
+  }
+
+  insert_notice_katcp(s, n);
+
+  return 0;
+}
+
+static void unindex_notice_katcp(struct katcp_shared *s, struct katcp_notice *n)
+{
+  struct katcp_notice **np;
+  unsigned int pos;
+
+  if(n->n_name == NULL){
+    return;
+  }
+
+  if(s->s_notice_table){
+    for(np = &(s->s_notice_table[hash_notice_katcp(s, n->n_name)]); *np; np = &((*np)->n_chain)){
+      if(*np == n){
+        *np = n->n_chain;
+        break;
+      }
+    }
+  }
+  n->n_chain = NULL;
+
+  for(pos = order_notice_katcp(s, n->n_name); pos < s->s_notice_named; pos++){
+    if(s->s_notice_order[pos] == n){
+      s->s_notice_named--;
+      memmove(&(s->s_notice_order[pos]), &(s->s_notice_order[pos + 1]), sizeof(struct katcp_notice *) * (s->s_notice_named - pos));
+      return;
+    }
+  }
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  fprintf(stderr, "notice: logic problem: %s (%p) not in sorted index\n", n->n_name, n);
+  abort();
+#endif
+}
+
+static void forget_notice_katcp(struct katcp_shared *s, struct katcp_notice *n)
+{
+  unsigned int i;
+
+  i = n->n_slot;
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if((i >= s->s_pending) || (s->s_notices[i] != n)){
+    fprintf(stderr, "notice: logic problem: notice %p not at position %u\n", n, i);
+    abort();
+  }
+#endif
+
+  unindex_notice_katcp(s, n);
+
+  s->s_pending--;
+  if(i < s->s_pending){
+    s->s_notices[i] = s->s_notices[s->s_pending];
+    s->s_notices[i]->n_slot = i;
+  }
+}
+
+static void ready_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n)
+{
+  struct katcp_shared *s;
+
+  if(n->n_listed){
+    return;
+  }
+
+  s = d->d_shared;
+  if(s == NULL){
+    return;
+  }
+
+  n->n_listed = 1;
+  n->n_ready = NULL;
+
+  if(s->s_ready_tail){
+    s->s_ready_tail->n_ready = n;
+  } else {
+    s->s_ready_head = n;
+  }
+  s->s_ready_tail = n;
+}
+
+/**********************************************************************************/
+
 static void deallocate_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n)
 {
   if(n == NULL){
@@ -89,7 +326,6 @@ static void deallocate_notice_katcp(struct katcp_dispatch *d, struct katcp_notic
 
 static void reap_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n)
 {
-  int i, k, check;
   struct katcp_shared *s;
 
   if(n == NULL){
@@ -109,38 +345,8 @@ static void reap_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n)
     return;
   }
 
-  i = 0;
-  check = 0;
-
-  while(i < s->s_pending){
-    if(s->s_notices[i] == n){
-
-      if(check == 0){
-        deallocate_notice_katcp(d, n);
-      }
-
-      s->s_pending--;
-      check++;
-
-      for(k = i; k < s->s_pending; k++){
-        s->s_notices[k] = s->s_notices[k + 1];
-      }
-
-#if 0
-      if(i < s->s_pending){
-        s->s_notices[i] = s->s_notices[s->s_pending];
-      }
-#endif
-      
-    } else {
-      i++;
-    }
-  }
-
-  if(check > 1){
-    log_message_katcp(d, KATCP_LEVEL_FATAL, NULL, "major corruption as notice %p encountered %d times", n, check);
-  }
-
+  forget_notice_katcp(s, n);
+  deallocate_notice_katcp(d, n);
 }
 
 /**********************************************************************************/
@@ -171,6 +377,7 @@ static int notice_compact_notice_katcp(struct katcp_notice *n, struct katcp_disp
       free(n->n_vector);
       n->n_vector = NULL;
     }
+    ready_notice_katcp(d, n);
   }
 
 #if 0
@@ -271,14 +478,29 @@ void destroy_notices_katcp(struct katcp_dispatch *d)
   fprintf(stderr, "notice: final cleanup: pending=%d, notices=%p\n", s->s_pending, s->s_notices);
 #endif
 
+  s->s_ready_head = NULL;
+  s->s_ready_tail = NULL;
+
   while(s->s_pending > 0){
-    reap_notice_katcp(d, s->s_notices[0]);
+    reap_notice_katcp(d, s->s_notices[s->s_pending - 1]);
   }
 
   if(s->s_notices){
     free(s->s_notices);
     s->s_notices = NULL;
   }
+
+  if(s->s_notice_table){
+    free(s->s_notice_table);
+    s->s_notice_table = NULL;
+  }
+  s->s_notice_slots = 0;
+
+  if(s->s_notice_order){
+    free(s->s_notice_order);
+    s->s_notice_order = NULL;
+  }
+  s->s_notice_named = 0;
 }
 
 /**********************************************************************************/
@@ -343,6 +565,12 @@ struct katcp_notice *create_parse_notice_katcp(struct katcp_dispatch *d, char *n
 
   n->n_changes = NOTICE_CHANGE_CLEAR;
 
+  n->n_slot = 0;
+  n->n_chain = NULL;
+  n->n_ready = NULL;
+  n->n_listed = 0;
+  n->n_pass = 0;
+
 #if 0
   n->n_msg = NULL;
   n->n_target = NULL;
@@ -373,17 +601,29 @@ struct katcp_notice *create_parse_notice_katcp(struct katcp_dispatch *d, char *n
   }
   s->s_notices = t;
 
+  n->n_slot = s->s_pending;
+  s->s_notices[s->s_pending] = n;
+  s->s_pending++;
+
+  if(index_notice_katcp(s, n) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to index notice %s", name);
+    s->s_pending--;
+    deallocate_notice_katcp(d, n);
+    return NULL;
+  }
+
   /* has to be last - on failure, deallocate notice will destroy p */
   if(p){
     if(add_tail_queue_katcl(n->n_queue, p) < 0){
+      forget_notice_katcp(s, n);
       deallocate_notice_katcp(d, n);
       return NULL;
     }
     n->n_changes |= NOTICE_CHANGE_ADD;
   }
 
-  s->s_notices[s->s_pending] = n;
-  s->s_pending++;
+  /* collected on the next run unless somebody subscribes or holds it */
+  ready_notice_katcp(d, n);
 
   return n;
 }
@@ -460,6 +700,7 @@ int remove_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n, int (*
         if(n->n_count == 0){
           free(n->n_vector);
           n->n_vector = NULL;
+          ready_notice_katcp(d, n);
         }
 
         /* WARNING: require a return here, otherwise i will be increment while count decremented, skipping one invoke entry */
@@ -576,7 +817,6 @@ struct katcp_notice *find_notice_katcp(struct katcp_dispatch *d, char *name)
 {
   struct katcp_notice *n;
   struct katcp_shared *s;
-  int i;
 
   if(name == NULL){
     return NULL;
@@ -584,9 +824,12 @@ struct katcp_notice *find_notice_katcp(struct katcp_dispatch *d, char *name)
 
   s = d->d_shared;
 
-  for(i = 0; i < s->s_pending; i++){
-    n = s->s_notices[i];
-    if(n->n_name && (!strcmp(name, n->n_name))){
+  if(s->s_notice_table == NULL){
+    return NULL;
+  }
+
+  for(n = s->s_notice_table[hash_notice_katcp(s, name)]; n; n = n->n_chain){
+    if(!strcmp(name, n->n_name)){
       return n;
     }
   }
@@ -598,7 +841,8 @@ int find_prefix_notices_katcp(struct katcp_dispatch *d, char *prefix, struct kat
 {
   struct katcp_notice *n;
   struct katcp_shared *s;
-  int len, i, found;
+  unsigned int i;
+  int len, found;
 
   if (prefix == NULL)
     return -1;
@@ -607,14 +851,17 @@ int find_prefix_notices_katcp(struct katcp_dispatch *d, char *prefix, struct kat
   len   = strlen(prefix);
   found = 0;
 
-  for (i = 0; i < s->s_pending; i++){
-    n = s->s_notices[i];
-    if (n->n_name && (!strncmp(prefix, n->n_name, len))){
-      if (found < n_count && n_set != NULL){
-        n_set[found] = n;
-      } 
-      found++;    
+  /* all names with the given prefix are adjacent in the sorted index */
+
+  for (i = order_notice_katcp(s, prefix); i < s->s_notice_named; i++){
+    n = s->s_notice_order[i];
+    if (strncmp(prefix, n->n_name, len)){
+      break;
     }
+    if (found < n_count && n_set != NULL){
+      n_set[found] = n;
+    } 
+    found++;    
   }
 
   return found;
@@ -790,6 +1037,9 @@ void release_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n)
  log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "releasing %p %s with use %d", n, n->n_name ? n->n_name : "<anonymous>", n->n_use);
   if(n->n_use > 0){
     n->n_use--;
+    if(n->n_use == 0){
+      ready_notice_katcp(d, n);
+    }
   } else {
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "notice: releasing %p %s already at 0 refcount", n, n->n_name ? n->n_name : "<anonymous>");
   }
@@ -908,6 +1158,7 @@ static int configure_notice_katcp(struct katcp_dispatch *d, struct katcp_notice
     case KATCP_NOTICE_TRIGGER_SINGLE :
     case KATCP_NOTICE_TRIGGER_ALL :
       n->n_trigger = trigger;
+      ready_notice_katcp(d, n);
 
       if(trigger == KATCP_NOTICE_TRIGGER_SINGLE){
 #ifdef DEBUG
@@ -926,11 +1177,11 @@ static int configure_notice_katcp(struct katcp_dispatch *d, struct katcp_notice
           fprintf(stderr, "notice: attempted to wake single item (%p) which can not be found\n", data);
         }
 #endif
-
-        mark_busy_katcp(d);
-
       }
 
+      /* run_notices happens after the wait, so don't sleep on a triggered notice */
+      mark_busy_katcp(d);
+
       return 0;
   }
 
@@ -1008,11 +1259,24 @@ int rename_notice_katcp(struct katcp_dispatch *d, struct katcp_notice *n, char *
     ptr = NULL;
   }
 
+  /* allocate before touching the index, a failure leaves n under its old name */
+  if(ptr && (reserve_notice_katcp(d->d_shared) < 0)){
+    free(ptr);
+    return -1;
+  }
+
+  unindex_notice_katcp(d->d_shared, n);
+
   if(n->n_name){
     free(n->n_name);
   }
 
   n->n_name = ptr;
+  n->n_chain = NULL;
+
+  if(ptr){
+    insert_notice_katcp(d->d_shared, n);
+  }
 
   return 0;
 }
@@ -1040,25 +1304,55 @@ int run_notices_katcp(struct katcp_dispatch *d)
 {
   struct katcp_shared *s;
   struct katcp_notice *n;
+  struct katcp_notice *deferred, *last;
   struct katcp_invoke *v;
-  int i, k, result, test, limit;
+  int k, result, test, limit;
 
   s = d->d_shared;
-  i = 0;
+
+  if(s->s_ready_head == NULL){
+    return 0;
+  }
 
 #ifdef DEBUG
-  fprintf(stderr, "notice: running %d pending entries\n", s->s_pending);
+  fprintf(stderr, "notice: running ready entries out of %d pending\n", s->s_pending);
 #endif
 
-  while(i < s->s_pending){
-    n = s->s_notices[i];
+  /* notices readied by callbacks are visited in the same pass, but a */
+  /* notice is only run once per pass, repeats are left for the next */
+
+  s->s_notice_pass++;
+  deferred = NULL;
+  last = NULL;
+
+  while(s->s_ready_head){
+    n = s->s_ready_head;
+
+    s->s_ready_head = n->n_ready;
+    if(s->s_ready_head == NULL){
+      s->s_ready_tail = NULL;
+    }
+    n->n_ready = NULL;
+
+    if(n->n_pass == s->s_notice_pass){
+      if(last){
+        last->n_ready = n;
+      } else {
+        deferred = n;
+      }
+      last = n;
+      continue;
+    }
+
+    n->n_listed = 0;
+    n->n_pass = s->s_notice_pass;
 
     if(n->n_trigger != KATCP_NOTICE_TRIGGER_OFF){
 
       test = (n->n_trigger == KATCP_NOTICE_TRIGGER_ALL) ? 0 : 1;
 
 #ifdef DEBUG
-      fprintf(stderr, "notice: trigger[%d] (%s) with code %d\n", i, n->n_name ? n->n_name : "<anonymous>", test);
+      fprintf(stderr, "notice: trigger[%u] (%s) with code %d\n", n->n_slot, n->n_name ? n->n_name : "<anonymous>", test);
 #endif
 
       n->n_trigger = KATCP_NOTICE_TRIGGER_OFF;
@@ -1131,27 +1425,20 @@ int run_notices_katcp(struct katcp_dispatch *d)
 
     }
 
-    /* move onto the next notice */
+    /* a notice readied again by its own callbacks is still referenced by the list */
 
-    if((n->n_count <= 0) && (n->n_use <= 0)){
+    if((n->n_count <= 0) && (n->n_use <= 0) && (n->n_listed == 0)){
+      forget_notice_katcp(s, n);
       deallocate_notice_katcp(d, n);
-
-      s->s_pending--;
-
-      for(k = i; k < s->s_pending; k++){
-        s->s_notices[k] = s->s_notices[k + 1];
-      }
-#if 0
-      if(i < s->s_pending){
-        s->s_notices[i] = s->s_notices[s->s_pending];
-      }
-#endif
-    } else {
-      i++;
     }
 
   }
 
+  if(deferred){
+    s->s_ready_head = deferred;
+    s->s_ready_tail = last;
+  }
+
   return 0;
 }
 
@@ -1339,3 +1626,145 @@ int notice_cmd_katcp(struct katcp_dispatch *d, int argc)
     }
   }
 }
+
+#ifdef UNIT_TEST_NOTICE
+
+#include <sys/time.h>
+
+#define NOTICES 10000
+#define PASSES   1000
+#define BUFFER     64
+
+static unsigned int woken_notice = 0;
+
+static int stay_notice(struct katcp_dispatch *d, struct katcp_notice *n, void *data)
+{
+  woken_notice++;
+  return 1;
+}
+
+static int leave_notice(struct katcp_dispatch *d, struct katcp_notice *n, void *data)
+{
+  woken_notice++;
+  return 0;
+}
+
+static double elapsed_notice(struct timeval *start)
+{
+  struct timeval now, delta;
+
+  gettimeofday(&now, NULL);
+  sub_time_katcp(&delta, &now, start);
+
+  return (delta.tv_sec * 1000000.0) + delta.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+  struct katcp_dispatch *d;
+  struct katcp_notice *n, *set[16];
+  struct timeval start;
+  char name[BUFFER];
+  unsigned int i, pending;
+  int found;
+
+  d = startup_katcp();
+  if(d == NULL){
+    fprintf(stderr, "notice: unable to allocate state\n");
+    return 1;
+  }
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < NOTICES; i++){
+    snprintf(name, BUFFER, "sm%05u-task", (i * 7919) % NOTICES);
+    if(register_notice_katcp(d, name, 0, &stay_notice, NULL) == NULL){
+      fprintf(stderr, "notice: unable to register %s\n", name);
+      return 1;
+    }
+  }
+  printf("notice: register %d notices: %.3fus per notice\n", NOTICES, elapsed_notice(&start) / NOTICES);
+
+  run_notices_katcp(d);
+  pending = d->d_shared->s_pending;
+  if(pending != NOTICES){
+    fprintf(stderr, "notice: have %u notices, expected %d\n", pending, NOTICES);
+    return 1;
+  }
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < PASSES; i++){
+    run_notices_katcp(d);
+  }
+  printf("notice: idle run over %d notices: %.3fus per pass\n", NOTICES, elapsed_notice(&start) / PASSES);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < NOTICES; i++){
+    snprintf(name, BUFFER, "sm%05u-task", i);
+    n = find_notice_katcp(d, name);
+    if((n == NULL) || strcmp(n->n_name, name)){
+      fprintf(stderr, "notice: lookup of %s failed\n", name);
+      return 1;
+    }
+  }
+  printf("notice: find among %d notices: %.3fus per lookup\n", NOTICES, elapsed_notice(&start) / NOTICES);
+
+  if(find_notice_katcp(d, "sm-missing") != NULL){
+    fprintf(stderr, "notice: found a notice which does not exist\n");
+    return 1;
+  }
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < PASSES; i++){
+    found = find_prefix_notices_katcp(d, "sm0012", set, 16);
+    if(found != 10){
+      fprintf(stderr, "notice: prefix search found %d, expected 10\n", found);
+      return 1;
+    }
+  }
+  printf("notice: prefix search among %d notices: %.3fus per search\n", NOTICES, elapsed_notice(&start) / PASSES);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < PASSES; i++){
+    snprintf(name, BUFFER, "sm%05u-task", i);
+    n = find_notice_katcp(d, name);
+    trigger_notice_katcp(d, n);
+    run_notices_katcp(d);
+  }
+  printf("notice: trigger and run one of %d notices: %.3fus per round\n", NOTICES, elapsed_notice(&start) / PASSES);
+
+  if(woken_notice != PASSES){
+    fprintf(stderr, "notice: woke %u callbacks, expected %d\n", woken_notice, PASSES);
+    return 1;
+  }
+
+  n = find_notice_katcp(d, "sm00042-task");
+  if(add_notice_katcp(d, n, &leave_notice, NULL) < 0){
+    fprintf(stderr, "notice: unable to add second subscriber\n");
+    return 1;
+  }
+  if(remove_notice_katcp(d, n, &stay_notice, NULL) < 0){
+    fprintf(stderr, "notice: unable to remove first subscriber\n");
+    return 1;
+  }
+  rename_notice_katcp(d, n, "zz-renamed");
+  if((find_notice_katcp(d, "sm00042-task") != NULL) || (find_notice_katcp(d, "zz-renamed") != n)){
+    fprintf(stderr, "notice: rename not reflected in index\n");
+    return 1;
+  }
+
+  trigger_notice_katcp(d, n);
+  run_notices_katcp(d);
+
+  if((d->d_shared->s_pending != (NOTICES - 1)) || (find_notice_katcp(d, "zz-renamed") != NULL)){
+    fprintf(stderr, "notice: expected notice to be collected, have %u notices\n", d->d_shared->s_pending);
+    return 1;
+  }
+
+  printf("notice: ok\n");
+
+  shutdown_katcp(d);
+
+  return 0;
+}
+
+#endif
@@ -10,6 +10,11 @@
 
 #include <sys/time.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define KATCL_PARSE_SSE2
+#endif
+
 #include "katpriv.h"
 #include "katcl.h"
 #include "katcp.h"
@@ -38,15 +43,224 @@ static void sane_parse_katcl(struct katcl_parse *p)
 #define sane_parse_katcl(p)
 #endif
 
+/* recycling of parse structures and their buffers ****************/
+
+/* parses are allocated and freed at a high rate when messages are */
+/* relayed or broadcast. A pool keeps idle parse shells (with their */
+/* argument vectors) and buffers in power of two size classes. The */
+/* pool in use is installed by the owner, usually the shared state */
+/* of a server, standalone users of this library just get malloc */
+
+static struct katcl_pool *pool_in_use_katcl = NULL;
+
+struct katcl_pool *create_pool_katcl()
+{
+  struct katcl_pool *k;
+  unsigned int i;
+
+  k = malloc(sizeof(struct katcl_pool));
+  if(k == NULL){
+    return NULL;
+  }
+
+  k->k_idle = 0;
+  for(i = 0; i < KATCL_POOL_CLASSES; i++){
+    k->k_spare[i] = 0;
+  }
+
+  k->k_live = 0;
+  k->k_high = 0;
+  k->k_requests = 0;
+  k->k_hits = 0;
+
+  k->k_closing = 0;
+
+  return k;
+}
+
+static void free_pool_katcl(struct katcl_pool *k)
+{
+  struct katcl_parse *p;
+  unsigned int i, j;
+
+  for(i = 0; i < k->k_idle; i++){
+    p = k->k_shells[i];
+    if(p->p_args){
+      free(p->p_args);
+    }
+    free(p);
+  }
+  k->k_idle = 0;
+
+  for(i = 0; i < KATCL_POOL_CLASSES; i++){
+    for(j = 0; j < k->k_spare[i]; j++){
+      free(k->k_buffers[i][j]);
+    }
+    k->k_spare[i] = 0;
+  }
+
+  free(k);
+}
+
+void destroy_pool_katcl(struct katcl_pool *k)
+{
+  if(k == NULL){
+    return;
+  }
+
+  if(pool_in_use_katcl == k){
+    pool_in_use_katcl = NULL;
+  }
+
+  if(k->k_live > 0){ /* parses still out there, last one to return frees us */
+#ifdef DEBUG
+    fprintf(stderr, "pool[%p]: deferring destruction, %u parses still live\n", k, k->k_live);
+#endif
+    k->k_closing = 1;
+    return;
+  }
+
+  free_pool_katcl(k);
+}
+
+struct katcl_pool *install_pool_katcl(struct katcl_pool *k)
+{
+  struct katcl_pool *previous;
+
+  previous = pool_in_use_katcl;
+  pool_in_use_katcl = k;
+
+  return previous;
+}
+
+static int class_pool_katcl(unsigned int size)
+{
+  /* smallest class able to hold size, -1 if too large to be pooled */
+  unsigned int i, c;
+
+  for(i = 0, c = KATCL_POOL_SMALLEST; i < KATCL_POOL_CLASSES; i++, c *= 2){
+    if(size <= c){
+      return i;
+    }
+  }
+
+  return -1;
+}
+
+static void release_buffer_pool_katcl(struct katcl_pool *k, char *buffer, unsigned int size)
+{
+  int i;
+
+  /* a buffer goes into the largest class it can completely satisfy */
+
+  if(size >= KATCL_POOL_SMALLEST){
+    i = class_pool_katcl(size);
+    if((i < 0) || ((KATCL_POOL_SMALLEST << i) > size)){
+      i = (i < 0) ? (KATCL_POOL_CLASSES - 1) : (i - 1);
+    }
+    if((size < (KATCL_POOL_SMALLEST << (KATCL_POOL_CLASSES))) && (k->k_spare[i] < KATCL_POOL_DEPTH) && (k->k_closing == 0)){
+      k->k_buffers[i][k->k_spare[i]] = buffer;
+      k->k_spare[i]++;
+      return;
+    }
+  }
+
+  free(buffer);
+}
+
+int space_buffer_parse_katcl(struct katcl_parse *p, unsigned int need)
+{
+  struct katcl_pool *k;
+  char *tmp;
+  unsigned int size;
+  int i;
+
+  /* make the parse buffer at least need bytes, keeping its content */
+
+  if(need <= p->p_size){
+    return 0;
+  }
+
+  k = p->p_pool;
+  if(k == NULL){
+    tmp = realloc(p->p_buffer, need);
+    if(tmp == NULL){
+      return -1;
+    }
+    p->p_buffer = tmp;
+    p->p_size = need;
+    return 0;
+  }
+
+  k->k_requests++;
+
+  i = class_pool_katcl(need);
+  if(i < 0){
+    tmp = realloc(p->p_buffer, need);
+    if(tmp == NULL){
+      return -1;
+    }
+    p->p_buffer = tmp;
+    p->p_size = need;
+    return 0;
+  }
+
+  size = KATCL_POOL_SMALLEST << i;
+
+  if(k->k_spare[i] > 0){
+    k->k_spare[i]--;
+    tmp = k->k_buffers[i][k->k_spare[i]];
+    k->k_hits++;
+  } else {
+    tmp = malloc(size);
+    if(tmp == NULL){
+      return -1;
+    }
+  }
+
+  if(p->p_buffer){
+    memcpy(tmp, p->p_buffer, p->p_size);
+    release_buffer_pool_katcl(k, p->p_buffer, p->p_size);
+  }
+
+  p->p_buffer = tmp;
+  p->p_size = size;
+
+  return 0;
+}
+
+/****************************************************************/
+
 struct katcl_parse *create_parse_katcl()
 {
   struct katcl_parse *p;
+  struct katcl_pool *k;
 
-  p = malloc(sizeof(struct katcl_parse));
-  if(p == NULL){
-    return NULL;
+  k = pool_in_use_katcl;
+
+  if(k && (k->k_idle > 0)){
+    k->k_idle--;
+    p = k->k_shells[k->k_idle];
+    k->k_hits++;
+  } else {
+    p = malloc(sizeof(struct katcl_parse));
+    if(p == NULL){
+      return NULL;
+    }
+    p->p_args = NULL;
+    p->p_count = 0;
+  }
+
+  if(k){
+    k->k_requests++;
+    k->k_live++;
+    if(k->k_live > k->k_high){
+      k->k_high = k->k_live;
+    }
   }
 
+  p->p_pool = k;
+
   p->p_magic = KATCL_PARSE_MAGIC;
   p->p_state = KATCL_PARSE_FRESH;
 
@@ -56,13 +270,12 @@ struct katcl_parse *create_parse_katcl()
   p->p_used = 0;
   p->p_kept = 0;
 
-  p->p_args = NULL;
+  /* p_args and p_count may be kept from a recycled shell */
   p->p_current = NULL;
 
   p->p_refs = 0; 
   p->p_tag = (-1);
 
-  p->p_count = 0;
   p->p_got = 0;
 
   return p;
@@ -143,6 +356,8 @@ struct katcl_parse *reuse_parse_katcl(struct katcl_parse *p)
 
 void destroy_parse_katcl(struct katcl_parse *p)
 {
+  struct katcl_pool *k;
+
   sane_parse_katcl(p);
 
 #if DEBUG > 1
@@ -158,8 +373,15 @@ void destroy_parse_katcl(struct katcl_parse *p)
     p->p_magic = 0xdead;
     p->p_state = (-1);
 
+    k = p->p_pool;
+    p->p_pool = NULL;
+
     if(p->p_buffer){
-      free(p->p_buffer);
+      if(k){
+        release_buffer_pool_katcl(k, p->p_buffer, p->p_size);
+      } else {
+        free(p->p_buffer);
+      }
       p->p_buffer = NULL;
     }
     p->p_size = 0;
@@ -167,18 +389,32 @@ void destroy_parse_katcl(struct katcl_parse *p)
     p->p_used = 0;
     p->p_kept = 0;
 
-    if(p->p_args){
-      free(p->p_args);
-      p->p_args = NULL;
-    }
     p->p_current = NULL;
-    p->p_count = 0;
     p->p_got = 0;
 
     p->p_refs = (-1);
     p->p_tag = (-1);
 
+    if(k){
+      k->k_live--;
+      if((k->k_closing == 0) && (k->k_idle < KATCL_POOL_DEPTH) && (p->p_count <= KATCL_POOL_ARGS)){
+        k->k_shells[k->k_idle] = p; /* keeps its argument vector */
+        k->k_idle++;
+        return;
+      }
+    }
+
+    if(p->p_args){
+      free(p->p_args);
+      p->p_args = NULL;
+    }
+    p->p_count = 0;
+
     free(p);
+
+    if(k && k->k_closing && (k->k_live == 0)){
+      free_pool_katcl(k);
+    }
   }
 }
 
@@ -353,7 +589,6 @@ static unsigned int actual_space_parse_katcl(struct katcl_parse *p)
 
 static char *request_space_parse_katcl(struct katcl_parse *p, unsigned int amount)
 {
-  char *tmp;
   unsigned int need;
 
   need = p->p_kept + amount;
@@ -361,14 +596,9 @@ static char *request_space_parse_katcl(struct katcl_parse *p, unsigned int amoun
 
     need++; /* TODO: could try to guess harder */
 
-    tmp = realloc(p->p_buffer, need);
-
-    if(tmp == NULL){
+    if(space_buffer_parse_katcl(p, need) < 0){
       return NULL;
     }
-
-    p->p_buffer = tmp;
-    p->p_size = need;
   }
 
   return p->p_buffer + p->p_kept;
@@ -1110,7 +1340,6 @@ static int check_array_parse_katcl(struct katcl_parse *p)
 
 static int stash_remainder_parse_katcl(struct katcl_parse *p, char *buffer, unsigned int len)
 {
-  char *tmp;
   unsigned int need;
 
   sane_parse_katcl(p);
@@ -1121,13 +1350,8 @@ static int stash_remainder_parse_katcl(struct katcl_parse *p, char *buffer, unsi
   
   need = p->p_used + len;
 
-  if(need > p->p_size){
-    tmp = realloc(p->p_buffer, need);
-    if(tmp == NULL){
-      return -1;
-    }
-    p->p_buffer = tmp;
-    p->p_size = need;
+  if(space_buffer_parse_katcl(p, need) < 0){
+    return -1;
   }
 
   memcpy(p->p_buffer + p->p_used, buffer, len);
@@ -1192,9 +1416,82 @@ int awaiting_katcl(struct katcl_line *l)
   return p->p_have;
 }
 
+/* find the next byte which could end a plain run of argument text: space, tab, */
+/* newline, carriage return or backslash. In the command name an opening */
+/* bracket also counts, as it introduces a tag. Returns have if none found */
+
+#define KATCL_SPAN_ONES   ((unsigned long)(-1) / 0xff)
+#define KATCL_SPAN_HIGHS  (KATCL_SPAN_ONES * 0x80)
+#define KATCL_SPAN_HIT(w, c) ((((w) ^ (KATCL_SPAN_ONES * (c))) - KATCL_SPAN_ONES) & ~((w) ^ (KATCL_SPAN_ONES * (c))) & KATCL_SPAN_HIGHS)
+
+static unsigned int span_parse_katcl(char *buffer, unsigned int used, unsigned int have, int bracket)
+{
+  unsigned int i;
+  unsigned long w, hit;
+#ifdef KATCL_PARSE_SSE2
+  __m128i v, m;
+  unsigned int bits;
+#endif
+
+  i = used;
+
+#ifdef KATCL_PARSE_SSE2
+  while((i + 16) <= have){
+    v = _mm_loadu_si128((__m128i *)(buffer + i));
+    m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    if(bracket){
+      m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('[')));
+    }
+    bits = _mm_movemask_epi8(m);
+    if(bits){
+      return i + __builtin_ctz(bits);
+    }
+    i += 16;
+  }
+#endif
+
+  while((i + sizeof(unsigned long)) <= have){
+    memcpy(&w, buffer + i, sizeof(unsigned long));
+    hit = KATCL_SPAN_HIT(w, ' ') | KATCL_SPAN_HIT(w, '\t') | KATCL_SPAN_HIT(w, '\n') | KATCL_SPAN_HIT(w, '\r') | KATCL_SPAN_HIT(w, '\\');
+    if(bracket){
+      hit |= KATCL_SPAN_HIT(w, '[');
+    }
+    if(hit){
+      break; /* somewhere in this word, leave it to the byte loop */
+    }
+    i += sizeof(unsigned long);
+  }
+
+  while(i < have){
+    switch(buffer[i]){
+      case ' '  :
+      case '\t' :
+      case '\n' :
+      case '\r' :
+      case '\\' :
+        return i;
+      case '[' :
+        if(bracket){
+          return i;
+        }
+        break;
+    }
+    i++;
+  }
+
+  return have;
+}
+
+#undef KATCL_SPAN_HIT
+#undef KATCL_SPAN_HIGHS
+#undef KATCL_SPAN_ONES
+
 int parse_katcl(struct katcl_line *l) /* transform buffer -> args */
 {
   int increment;
+  unsigned int end, run;
   struct katcl_parse *p;
 
   p = l->l_next;
@@ -1213,6 +1510,24 @@ int parse_katcl(struct katcl_line *l) /* transform buffer -> args */
 
   while((p->p_used < p->p_have) && (p->p_state != KATCL_PARSE_DONE)){
 
+    /* fast path: skip over plain text in a name or argument in one go, */
+    /* only moving it down if an earlier escape left a gap. The delimiter */
+    /* which ends the run is handled by the state machine below */
+    if((p->p_state == KATCL_PARSE_ARG) || (p->p_state == KATCL_PARSE_COMMAND)){
+      end = span_parse_katcl(p->p_buffer, p->p_used, p->p_have, p->p_state == KATCL_PARSE_COMMAND);
+      run = end - p->p_used;
+      if(run > 0){
+        if(p->p_kept < p->p_used){
+          memmove(p->p_buffer + p->p_kept, p->p_buffer + p->p_used, run);
+        }
+        p->p_used = end;
+        p->p_kept += run;
+        if(p->p_used >= p->p_have){
+          break;
+        }
+      }
+    }
+
     increment = 0; /* what to do to keep */
 
 #if DEBUG > 1
@@ -1501,6 +1816,206 @@ int dump_parse_katcl(struct katcl_parse *p, char *prefix, FILE *fp)
 
 #ifdef UNIT_TEST_PARSE
 
+#define BENCH_TOTAL  (16 * 1024 * 1024)
+
+static int feed_parse_katcl(struct katcl_line *l, char *buffer, unsigned int len)
+{
+  struct katcl_parse *p;
+  int result, count;
+
+  p = l->l_next;
+
+  if(space_buffer_parse_katcl(p, p->p_have + len) < 0){
+    return -1;
+  }
+
+  memcpy(p->p_buffer + p->p_have, buffer, len);
+  p->p_have += len;
+
+  count = 0;
+  while((result = parse_katcl(l)) > 0){
+    count++;
+  }
+
+  return (result < 0) ? result : count;
+}
+
+static int check_line_parse_katcl(char *input, int tag, unsigned int count, char **expect)
+{
+  struct katcl_line line, *l;
+  struct katcl_parse *p;
+  unsigned int i, len;
+  char *ptr;
+
+  l = &line;
+  memset(l, 0, sizeof(struct katcl_line));
+  l->l_next = create_referenced_parse_katcl();
+
+  len = strlen(input);
+
+  /* dribble the input in one byte at a time to exercise partial runs */
+  for(i = 0; i < len; i++){
+    if(feed_parse_katcl(l, input + i, 1) < 0){
+      fprintf(stderr, "parse of <%s> failed at %u\n", input, i);
+      return -1;
+    }
+  }
+
+  p = l->l_ready;
+  if(p == NULL){
+    fprintf(stderr, "no complete line for <%s>\n", input);
+    return -1;
+  }
+
+  if(get_count_parse_katcl(p) != count){
+    fprintf(stderr, "expected %u arguments, not %u for <%s>\n", count, get_count_parse_katcl(p), input);
+    return -1;
+  }
+
+  if(get_tag_parse_katcl(p) != tag){
+    fprintf(stderr, "expected tag %d, not %d for <%s>\n", tag, get_tag_parse_katcl(p), input);
+    return -1;
+  }
+
+  for(i = 0; i < count; i++){
+    ptr = get_string_parse_katcl(p, i);
+    if((ptr == NULL) ? (expect[i] != NULL) : ((expect[i] == NULL) || strcmp(ptr, expect[i]))){
+      fprintf(stderr, "argument %u of <%s> is <%s>, expected <%s>\n", i, input, ptr ? ptr : "(null)", expect[i] ? expect[i] : "(null)");
+      return -1;
+    }
+  }
+
+  destroy_parse_katcl(l->l_ready);
+  destroy_parse_katcl(l->l_next);
+
+  return 0;
+}
+
+static int bench_parse_katcl(char *name, char *sample)
+{
+  struct katcl_line line, *l;
+  struct timeval start, stop;
+  unsigned int len, fill, total, i;
+  char *traffic;
+  int result, count;
+  double seconds;
+
+  len = strlen(sample);
+  fill = (KATCL_IO_SIZE / len) * len;
+
+  traffic = malloc(fill);
+  if(traffic == NULL){
+    return -1;
+  }
+
+  /* a full read worth of back to back messages, like a busy client */
+  for(i = 0; i < fill; i += len){
+    memcpy(traffic + i, sample, len);
+  }
+
+  l = &line;
+  memset(l, 0, sizeof(struct katcl_line));
+  l->l_next = create_referenced_parse_katcl();
+
+  count = 0;
+
+  /* feed it in pieces no larger than what read_katcl pulls in at a time */
+  gettimeofday(&start, NULL);
+  for(total = 0; total < BENCH_TOTAL; total += fill){
+    for(i = 0; i < fill; i += KATCL_BUFFER_INC){
+      result = feed_parse_katcl(l, traffic + i, ((i + KATCL_BUFFER_INC) < fill) ? KATCL_BUFFER_INC : fill - i);
+      if(result < 0){
+        fprintf(stderr, "bench: parse failed\n");
+        return -1;
+      }
+      count += result;
+    }
+  }
+  gettimeofday(&stop, NULL);
+
+  seconds = (stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0);
+
+  printf("parse bench %s: %u bytes, %d messages in %.3fs: %.1f MB/s, %.0f messages/s\n", name, total, count, seconds, total / (seconds * 1024.0 * 1024.0), count / seconds);
+
+  if(l->l_ready){
+    destroy_parse_katcl(l->l_ready);
+  }
+  destroy_parse_katcl(l->l_next);
+  free(traffic);
+
+  return 0;
+}
+
+#define FANOUT_MESSAGES 1000000
+
+static int fanout_parse_katcl(char *name, unsigned int clients)
+{
+  struct katcl_parse *p, *copies[64];
+  struct timeval start, stop;
+  unsigned int i, j;
+  double seconds;
+
+  /* roughly what a log message broadcast to a number of clients costs */
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < FANOUT_MESSAGES; i++){
+    p = create_referenced_parse_katcl();
+    if(p == NULL){
+      return -1;
+    }
+    add_plain_parse_katcl(p, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, "#log");
+    add_plain_parse_katcl(p, KATCP_FLAG_STRING, "info");
+    add_unsigned_long_parse_katcl(p, KATCP_FLAG_ULONG, 1318345234123UL + i);
+    add_plain_parse_katcl(p, KATCP_FLAG_STRING, "raw");
+    add_string_parse_katcl(p, KATCP_FLAG_LAST | KATCP_FLAG_STRING, "sensor roach.temperature.ambient changed to nominal");
+
+    for(j = 0; j < clients; j++){
+      copies[j] = copy_parse_katcl(p);
+    }
+    destroy_parse_katcl(p);
+    for(j = 0; j < clients; j++){
+      destroy_parse_katcl(copies[j]);
+    }
+  }
+  gettimeofday(&stop, NULL);
+
+  seconds = (stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0);
+
+  printf("parse fanout %s to %u clients: %u messages in %.3fs: %.0f messages/s\n", name, clients, FANOUT_MESSAGES, seconds, FANOUT_MESSAGES / seconds);
+
+  return 0;
+}
+
+static int bench_pool_parse_katcl()
+{
+  struct katcl_pool *k;
+
+  install_pool_katcl(NULL);
+
+  if(fanout_parse_katcl("with malloc", 8) || 
+     bench_parse_katcl("sensor-status with malloc", "#sensor-status 1318345234.123 1 roach.temperature.ambient nominal 42.5\n")){
+    return -1;
+  }
+
+  k = create_pool_katcl();
+  if(k == NULL){
+    return -1;
+  }
+  install_pool_katcl(k);
+
+  if(fanout_parse_katcl("with pool", 8) || 
+     bench_parse_katcl("sensor-status with pool", "#sensor-status 1318345234.123 1 roach.temperature.ambient nominal 42.5\n")){
+    return -1;
+  }
+
+  printf("parse pool: %lu of %lu shell and buffer allocations recycled, high water %u, %u live\n", k->k_hits, k->k_requests, k->k_high, k->k_live);
+
+  install_pool_katcl(NULL);
+  destroy_pool_katcl(k);
+
+  return 0;
+}
+
 int main()
 {
 #define BUFFER 32
@@ -1548,6 +2063,29 @@ int main()
   destroy_parse_katcl(p);
   destroy_parse_katcl(pc);
 
+  {
+    char *plain[] = { "#sensor-status", "1318345234.123", "1", "roach.temperature.ambient", "nominal", "42.5" };
+    char *escaped[] = { "?write", "sys scratch", NULL, "a\\b\nc" };
+    char *tagged[] = { "?read", "sys_scratchpad", "0", "4" };
+    char *mixed[] = { "!read", "ok", "\033[value]\t" };
+
+    if(check_line_parse_katcl("#sensor-status 1318345234.123 1 roach.temperature.ambient nominal 42.5\n", -1, 6, plain) ||
+       check_line_parse_katcl("?write sys\\_scratch \\@ a\\\\b\\nc\r\n", -1, 4, escaped) ||
+       check_line_parse_katcl("?read[17]  sys_scratchpad\t0 4\n", 17, 4, tagged) ||
+       check_line_parse_katcl("!read ok \\e[value]\\t\n", -1, 3, mixed)){
+      return 1;
+    }
+  }
+
+  if(bench_parse_katcl("sensor-status", "#sensor-status 1318345234.123 1 roach.temperature.ambient nominal 42.5\n") ||
+     bench_parse_katcl("read", "?read sys_scratchpad 0 4\n")){
+    return 1;
+  }
+
+  if(bench_pool_parse_katcl()){
+    return 1;
+  }
+
   printf("parse test: ok\n");
 
   return 0;
@@ -0,0 +1,705 @@
+/* (c) 2010,2011 SKA SA */
+/* Released under the GNU GPLv3 - see COPYING */
+
+/* io readiness for the core loop: pselect by default, optionally epoll */
+
+/* with KATCP_USE_EPOLL interest lives in the kernel across loop iterations,
+ * load_poll_katcp only issues a system call when the interest of an fd
+ * changes (eg flushing starts or stops), and readiness is looked up in
+ * a table indexed by fd rather than an fd_set, so there is no FD_SETSIZE limit.
+ * If the epoll instance can not be created we quietly fall back to pselect
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include <sys/time.h>
+#include <sys/select.h>
+
+#ifdef KATCP_USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
+#include "katpriv.h"
+#include "katcl.h"
+#include "katcp.h"
+
+#define KATCP_POLL_EVENTS  256   /* events collected per wait, rest picked up next time */
+#define KATCP_POLL_INC      64   /* grow fd table by at least this much */
+
+int startup_poll_katcp(struct katcp_shared *s)
+{
+  s->s_epoll = (-1);
+
+  s->s_ready = NULL;
+  s->s_limit = 0;
+  s->s_round = 0;
+  s->s_mute = 0;
+
+  s->s_max = (-1);
+
+  FD_ZERO(&(s->s_read));
+  FD_ZERO(&(s->s_write));
+
+  init_poll_katcp(&(s->s_listen));
+
+#ifdef KATCP_USE_EPOLL
+  s->s_epoll = epoll_create1(EPOLL_CLOEXEC);
+#ifdef DEBUG
+  if(s->s_epoll < 0){
+    fprintf(stderr, "poll: unable to create epoll instance, falling back to pselect: %s\n", strerror(errno));
+  }
+#endif
+#endif
+
+  return 0;
+}
+
+void shutdown_poll_katcp(struct katcp_shared *s)
+{
+  if(s->s_epoll >= 0){
+    close(s->s_epoll);
+    s->s_epoll = (-1);
+  }
+
+  if(s->s_ready){
+    free(s->s_ready);
+    s->s_ready = NULL;
+  }
+
+  s->s_limit = 0;
+}
+
+int epoll_poll_katcp(struct katcp_shared *s)
+{
+  return (s->s_epoll >= 0) ? 1 : 0;
+}
+
+void init_poll_katcp(struct katcp_poll *p)
+{
+  p->p_fd = (-1);
+}
+
+/* start of a loop iteration, everybody has to declare interest again */
+
+void reset_poll_katcp(struct katcp_shared *s)
+{
+  FD_ZERO(&(s->s_read));
+  FD_ZERO(&(s->s_write));
+
+  s->s_max = (-1);
+
+  s->s_round++;
+  if(s->s_round == 0){ /* zero used as never seen */
+    s->s_round++;
+  }
+}
+
+#ifdef KATCP_USE_EPOLL
+static struct katcp_ready *entry_poll_katcp(struct katcp_shared *s, int fd)
+{
+  struct katcp_ready *tmp;
+  unsigned int size, i;
+
+  if(fd < 0){
+    return NULL;
+  }
+
+  if(fd >= s->s_limit){
+    size = fd + KATCP_POLL_INC;
+
+    tmp = realloc(s->s_ready, sizeof(struct katcp_ready) * size);
+    if(tmp == NULL){
+      return NULL;
+    }
+
+    for(i = s->s_limit; i < size; i++){
+      tmp[i].r_want = 0;
+      tmp[i].r_seen = 0;
+      tmp[i].r_when = 0;
+      tmp[i].r_have = 0;
+    }
+
+    s->s_ready = tmp;
+    s->s_limit = size;
+  }
+
+  return &(s->s_ready[fd]);
+}
+
+static int change_poll_katcp(struct katcp_shared *s, int fd, unsigned int from, unsigned int to, int fresh)
+{
+  struct epoll_event ev;
+  int result;
+
+  memset(&ev, 0, sizeof(struct epoll_event));
+
+  ev.data.fd = fd;
+  if(to & KATCP_POLL_READ){
+    ev.events |= EPOLLIN;
+  }
+  if(to & KATCP_POLL_WRITE){
+    ev.events |= EPOLLOUT;
+  }
+
+  if(to == 0){
+    /* callers ignore errors here, except when the kernel has an entry which we no longer can name */
+    return epoll_ctl(s->s_epoll, EPOLL_CTL_DEL, fd, &ev);
+  }
+
+  if(fresh || (from == 0)){
+    result = epoll_ctl(s->s_epoll, EPOLL_CTL_ADD, fd, &ev);
+    if((result < 0) && (errno == EEXIST)){
+      result = epoll_ctl(s->s_epoll, EPOLL_CTL_MOD, fd, &ev);
+    }
+  } else {
+    result = epoll_ctl(s->s_epoll, EPOLL_CTL_MOD, fd, &ev);
+    if((result < 0) && (errno == ENOENT)){
+      result = epoll_ctl(s->s_epoll, EPOLL_CTL_ADD, fd, &ev);
+    }
+  }
+
+#ifdef KATCP_STDERR_ERRORS
+  if(result < 0){
+    fprintf(stderr, "poll: unable to update interest of fd %d to 0x%x: %s\n", fd, to, strerror(errno));
+  }
+#endif
+
+  return result;
+}
+
+/* an fd was closed without being released first while a copy of it lives on (eg in a forked child), so the kernel entry can not be deleted - start over with a new instance */
+
+static int rebuild_poll_katcp(struct katcp_shared *s)
+{
+  struct katcp_ready *r;
+  unsigned int i;
+  int fd;
+
+  fd = epoll_create1(EPOLL_CLOEXEC);
+  if(fd < 0){
+#ifdef KATCP_STDERR_ERRORS
+    fprintf(stderr, "poll: unable to recreate epoll instance: %s\n", strerror(errno));
+#endif
+    return -1;
+  }
+
+#ifdef DEBUG
+  fprintf(stderr, "poll: replacing epoll instance %d with %d\n", s->s_epoll, fd);
+#endif
+
+  close(s->s_epoll);
+  s->s_epoll = fd;
+
+  for(i = 0; i < s->s_limit; i++){
+    r = &(s->s_ready[i]);
+    if(r->r_want){
+      if(change_poll_katcp(s, i, 0, r->r_want, 1) < 0){
+        r->r_want = 0;
+      }
+    }
+  }
+
+  return 0;
+}
+#endif
+
+/* declare what an entity wants to do with its fd in this iteration, p is the per entity record of what it previously asked for */
+
+void load_poll_katcp(struct katcp_shared *s, struct katcp_poll *p, int fd, unsigned int mask)
+{
+#ifdef KATCP_USE_EPOLL
+  struct katcp_ready *r;
+  int fresh;
+#endif
+
+  if(fd < 0){
+    return;
+  }
+
+  mask &= ~(s->s_mute);
+
+#ifdef KATCP_USE_EPOLL
+  if(s->s_epoll >= 0){
+    r = entry_poll_katcp(s, fd);
+    if(r == NULL){
+      return;
+    }
+
+    /* a different fd for this entity, any earlier record for the fd number belonged to a closed file */
+    fresh = (p == NULL) || (p->p_fd != fd);
+
+    if(fresh || (r->r_want != mask)){
+      if(change_poll_katcp(s, fd, fresh ? 0 : r->r_want, mask, fresh) == 0){
+        r->r_want = mask;
+      } else {
+        r->r_want = 0;
+      }
+    }
+
+    if(p){
+      p->p_fd = fd;
+    }
+
+    if(mask){
+      r->r_seen = s->s_round;
+    }
+
+    return;
+  }
+#endif
+
+  if(mask & KATCP_POLL_READ){
+    FD_SET(fd, &(s->s_read));
+  }
+  if(mask & KATCP_POLL_WRITE){
+    FD_SET(fd, &(s->s_write));
+  }
+
+  if(mask && (fd > s->s_max)){
+    s->s_max = fd;
+  }
+}
+
+/* drop interest in fd, to be called before the owning entity closes it */
+
+void release_poll_katcp(struct katcp_shared *s, struct katcp_poll *p, int fd)
+{
+#ifdef KATCP_USE_EPOLL
+  struct katcp_ready *r;
+#endif
+
+  if((s == NULL) || (fd < 0)){
+    return;
+  }
+
+  if(p){
+    if(p->p_fd != fd){ /* interest never registered for this fd */
+      return;
+    }
+    p->p_fd = (-1);
+  }
+
+#ifdef KATCP_USE_EPOLL
+  if((s->s_epoll < 0) || (fd >= s->s_limit)){
+    return;
+  }
+
+  r = &(s->s_ready[fd]);
+  if(r->r_want){
+    change_poll_katcp(s, fd, r->r_want, 0, 0);
+    r->r_want = 0;
+  }
+  r->r_have = 0;
+  r->r_seen = 0;
+#endif
+}
+
+/* stop paying attention to the given direction for the rest of our lifetime, used when shutting down */
+
+void mute_poll_katcp(struct katcp_shared *s, unsigned int mask)
+{
+#ifdef KATCP_USE_EPOLL
+  unsigned int i;
+  struct katcp_ready *r;
+#endif
+
+  s->s_mute |= mask;
+
+  if(mask & KATCP_POLL_READ){
+    FD_ZERO(&(s->s_read));
+  }
+  if(mask & KATCP_POLL_WRITE){
+    FD_ZERO(&(s->s_write));
+  }
+
+#ifdef KATCP_USE_EPOLL
+  if(s->s_epoll >= 0){
+    for(i = 0; i < s->s_limit; i++){
+      r = &(s->s_ready[i]);
+      if(r->r_want & mask){
+        r->r_want &= ~mask;
+        change_poll_katcp(s, i, r->r_want | mask, r->r_want, 0);
+      }
+      r->r_have &= ~mask;
+    }
+  }
+#endif
+}
+
+int wait_poll_katcp(struct katcp_shared *s, struct timespec *delta)
+{
+#ifdef KATCP_USE_EPOLL
+  struct epoll_event events[KATCP_POLL_EVENTS];
+  struct katcp_ready *r;
+  int result, timeout, i, fd;
+  unsigned int have;
+
+  if(s->s_epoll >= 0){
+
+    if(delta){
+      timeout = (delta->tv_sec * 1000) + ((delta->tv_nsec + 999999) / 1000000);
+    } else {
+      timeout = (-1);
+    }
+
+    result = epoll_pwait(s->s_epoll, events, KATCP_POLL_EVENTS, timeout, &(s->s_signal_mask));
+    if(result <= 0){
+      return result;
+    }
+
+    for(i = 0; i < result; i++){
+      fd = events[i].data.fd;
+      r = entry_poll_katcp(s, fd);
+      if(r == NULL){
+        continue;
+      }
+
+      if(r->r_seen != s->s_round){
+        /* nobody asked for this one, an owner closed it without calling release_poll_katcp */
+#ifdef DEBUG
+        fprintf(stderr, "poll: dropping stale interest in fd %d\n", fd);
+#endif
+        r->r_want = 0;
+        if(change_poll_katcp(s, fd, r->r_want, 0, 0) < 0){
+          /* left alone this entry would be reported on every wait */
+          rebuild_poll_katcp(s);
+        }
+        continue;
+      }
+
+      have = 0;
+      if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+        have |= KATCP_POLL_READ;
+      }
+      if(events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)){
+        have |= KATCP_POLL_WRITE;
+      }
+
+      r->r_have = have & r->r_want;
+      r->r_when = s->s_round;
+    }
+
+    return result;
+  }
+#endif
+
+  return pselect(s->s_max + 1, &(s->s_read), &(s->s_write), NULL, delta, &(s->s_signal_mask));
+}
+
+/* after a wait, which of the directions in mask can proceed on fd */
+
+unsigned int ready_poll_katcp(struct katcp_shared *s, int fd, unsigned int mask)
+{
+  unsigned int have;
+#ifdef KATCP_USE_EPOLL
+  struct katcp_ready *r;
+#endif
+
+  if(fd < 0){
+    return 0;
+  }
+
+#ifdef KATCP_USE_EPOLL
+  if(s->s_epoll >= 0){
+    if(fd >= s->s_limit){
+      return 0;
+    }
+    r = &(s->s_ready[fd]);
+    if(r->r_when != s->s_round){
+      return 0;
+    }
+    return r->r_have & mask;
+  }
+#endif
+
+  have = 0;
+
+  if((mask & KATCP_POLL_READ) && FD_ISSET(fd, &(s->s_read))){
+    have |= KATCP_POLL_READ;
+  }
+  if((mask & KATCP_POLL_WRITE) && FD_ISSET(fd, &(s->s_write))){
+    have |= KATCP_POLL_WRITE;
+  }
+
+  return have;
+}
+
+/* discard readiness gathered in this iteration, eg on a failed wait */
+
+void clear_poll_katcp(struct katcp_shared *s)
+{
+  FD_ZERO(&(s->s_read));
+  FD_ZERO(&(s->s_write));
+
+#ifdef KATCP_USE_EPOLL
+  if(s->s_epoll >= 0){
+    /* readiness is only valid for the round in which it was collected */
+    s->s_round++;
+    if(s->s_round == 0){
+      s->s_round++;
+    }
+  }
+#endif
+}
+
+#ifdef UNIT_TEST_POLL
+
+/* compare the cost of a loop iteration for many idle connections and one busy one */
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define ITERATIONS 2000
+
+static double now_poll(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+static int bench_poll(int *fds, int busy, int count, int use_epoll)
+{
+  struct katcp_shared *s;
+  struct katcp_poll *vector;
+  struct timespec delta;
+  int i, j, got;
+  double start, stop;
+  char byte;
+
+  s = malloc(sizeof(struct katcp_shared));
+  vector = malloc(sizeof(struct katcp_poll) * count);
+  if((s == NULL) || (vector == NULL)){
+    return -1;
+  }
+
+  sigemptyset(&(s->s_signal_mask));
+  startup_poll_katcp(s);
+
+  if((use_epoll == 0) && (s->s_epoll >= 0)){
+    close(s->s_epoll);
+    s->s_epoll = (-1);
+  }
+
+  if(use_epoll && (s->s_epoll < 0)){
+    printf("poll: epoll not available in this build\n");
+    free(vector);
+    free(s);
+    return -1;
+  }
+
+  if((use_epoll == 0) && (fds[count - 1] >= FD_SETSIZE)){
+    printf("poll: %5d idle clients pselect     : n/a, fds exceed FD_SETSIZE=%d\n", count, FD_SETSIZE);
+    free(vector);
+    free(s);
+    return 0;
+  }
+
+  for(i = 0; i < count; i++){
+    init_poll_katcp(&(vector[i]));
+  }
+
+  got = 0;
+  byte = 'x';
+
+  start = now_poll();
+
+  for(j = 0; j < ITERATIONS; j++){
+    /* the one active client */
+    if(write(busy, &byte, 1) != 1){
+      return -1;
+    }
+
+    reset_poll_katcp(s);
+    for(i = 0; i < count; i++){
+      load_poll_katcp(s, &(vector[i]), fds[i], KATCP_POLL_READ);
+    }
+
+    delta.tv_sec = 0;
+    delta.tv_nsec = 0;
+
+    if(wait_poll_katcp(s, &delta) < 0){
+      fprintf(stderr, "poll: wait failed: %s\n", strerror(errno));
+      return -1;
+    }
+
+    for(i = 0; i < count; i++){
+      if(ready_poll_katcp(s, fds[i], KATCP_POLL_READ)){
+        if(read(fds[i], &byte, 1) == 1){
+          got++;
+        }
+      }
+    }
+  }
+
+  stop = now_poll();
+
+  printf("poll: %5d idle clients %-11s : %8.2fus per iteration, %d messages seen\n", count, use_epoll ? "epoll" : "pselect", ((stop - start) * 1000000.0) / ITERATIONS, got);
+
+  shutdown_poll_katcp(s);
+
+  free(vector);
+  free(s);
+
+  return (got == ITERATIONS) ? 0 : -1;
+}
+
+#ifdef KATCP_USE_EPOLL
+/* an fd closed without release while a copy lives on may not keep waking us */
+
+static int stale_poll(void)
+{
+  struct katcp_shared *s;
+  struct katcp_poll p;
+  struct timespec delta;
+  int pair[2], copy, i, result;
+
+  s = malloc(sizeof(struct katcp_shared));
+  if(s == NULL){
+    return -1;
+  }
+
+  sigemptyset(&(s->s_signal_mask));
+  startup_poll_katcp(s);
+  if(s->s_epoll < 0){
+    free(s);
+    return -1;
+  }
+
+  if(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0){
+    return -1;
+  }
+  write(pair[1], "x", 1);
+
+  init_poll_katcp(&p);
+  reset_poll_katcp(s);
+  load_poll_katcp(s, &p, pair[0], KATCP_POLL_READ);
+
+  copy = dup(pair[0]); /* what a forked child would hold */
+  close(pair[0]);
+
+  result = 0;
+  for(i = 0; i < 3; i++){
+    reset_poll_katcp(s);
+    delta.tv_sec = 0;
+    delta.tv_nsec = 0;
+    result = wait_poll_katcp(s, &delta);
+  }
+
+  printf("poll: unreleased fd with live copy reported %d events after rebuild\n", result);
+
+  close(copy);
+  close(pair[1]);
+  shutdown_poll_katcp(s);
+  free(s);
+
+  return (result == 0) ? 0 : -1;
+}
+#endif
+
+int main(int argc, char **argv)
+{
+  int sizes[] = { 1000, 5000 };
+  int *fds, pair[2];
+  int i, j, count, result, busy, nfd;
+  struct rlimit rl;
+  pid_t pid;
+  char byte;
+
+  result = 0;
+
+  for(j = 0; j < sizeof(sizes) / sizeof(int); j++){
+    count = sizes[j];
+
+    rl.rlim_cur = (count * 2) + 64;
+    rl.rlim_max = (count * 2) + 64;
+    if(getrlimit(RLIMIT_NOFILE, &rl) == 0){
+      if(rl.rlim_cur < (count * 2) + 64){
+        rl.rlim_cur = (rl.rlim_max < (count * 2) + 64) ? rl.rlim_max : (count * 2) + 64;
+        setrlimit(RLIMIT_NOFILE, &rl);
+      }
+    }
+
+    fds = malloc(sizeof(int) * 2 * count);
+    if(fds == NULL){
+      return 1;
+    }
+
+    for(i = 0; i < count; i++){
+      if(socketpair(AF_UNIX, SOCK_STREAM, 0, &(fds[2 * i])) < 0){
+        fprintf(stderr, "poll: only able to create %d of %d connections: %s\n", i, count, strerror(errno));
+        return 1;
+      }
+    }
+
+    /* a child keeps the remote ends open so that the connections stay idle */
+    if(pipe(pair) < 0){
+      return 1;
+    }
+
+    pid = fork();
+    if(pid < 0){
+      return 1;
+    }
+    if(pid == 0){
+      close(pair[1]);
+      read(pair[0], &byte, 1); /* returns once parent closes its end */
+      _exit(0);
+    }
+    close(pair[0]);
+
+    /* fds[0] is the busy receiver, fds[1] its sender, rest idle. Compact the local ends to low fd numbers, otherwise pselect can't cope */
+    busy = fds[1];
+    for(i = 1; i < count; i++){
+      close(fds[(2 * i) + 1]);
+    }
+    for(i = 0; i < count; i++){
+      nfd = dup(fds[2 * i]);
+      if(nfd >= 0){
+        if(nfd < fds[2 * i]){
+          close(fds[2 * i]);
+          fds[i] = nfd;
+        } else {
+          close(nfd);
+          fds[i] = fds[2 * i];
+        }
+      } else {
+        fds[i] = fds[2 * i];
+      }
+    }
+
+    if(bench_poll(fds, busy, count, 0) < 0){
+      result = 1;
+    }
+#ifdef KATCP_USE_EPOLL
+    if(bench_poll(fds, busy, count, 1) < 0){
+      result = 1;
+    }
+#endif
+
+    for(i = 0; i < count; i++){
+      close(fds[i]);
+    }
+    close(busy);
+    close(pair[1]);
+    waitpid(pid, NULL, 0);
+
+    free(fds);
+  }
+
+#ifdef KATCP_USE_EPOLL
+  if(stale_poll() < 0){
+    result = 1;
+  }
+#endif
+
+  return result;
+}
+
+#endif
@@ -35,7 +35,7 @@ static struct katcl_parse *get_tail_katcl(struct katcl_queue *q)
   if((q->q_count == 0) || (q->q_size == 0) || (q->q_count >= q->q_size)){
     return NULL;
   }
-  tail = ((q->q_head + q->q_count) % q->q_size);
+  tail = ((q->q_head + q->q_count) & (q->q_size - 1));
   /* return ptr to parse structure else NULL */
 
   /* return matching parse */
@@ -46,6 +46,11 @@ static struct katcl_parse *get_tail_katcl(struct katcl_queue *q)
 
 /**************************************************************************/
 
+/* the queue is a ring of power of two size, doubling when full and halving once it drains to a quarter */
+
+#define QUEUE_MINIMUM   8    /* smallest allocation */
+#define QUEUE_KEEP     64    /* never shrink to below this */
+
 #if 0
 unsigned int is_empty_queue_katcl(struct katcl_queue *q)
 {
@@ -79,7 +84,7 @@ void destroy_queue_katcl(struct katcl_queue *q)
   unsigned int i, j;
 
   for(j = 0; j < q->q_count; j++){
-    i = (q->q_head + j) % q->q_size;
+    i = (q->q_head + j) & (q->q_size - 1);
     destroy_parse_katcl(q->q_queue[i]);
     q->q_queue[i] = NULL;
   }
@@ -110,13 +115,13 @@ void clear_queue_katcl(struct katcl_queue *q)
 #endif
 
 #ifdef DEBUG
-  fprintf(stderr, "queue[%p]: planning to clear used %u entries starting at %u of total space %u {%p}\n", q, q->q_count, q->q_size, q->q_size, q->q_queue);
+  fprintf(stderr, "queue[%p]: planning to clear used %u entries starting at %u of total space %u {%p}\n", q, q->q_count, q->q_head, q->q_size, q->q_queue);
 #endif
 
   for(j = 0; j < q->q_count; j++){
-    i = (q->q_head + j) % q->q_size;
+    i = (q->q_head + j) & (q->q_size - 1);
 
-#ifdef DEBUG
+#if DEBUG > 1
     fprintf(stderr, "queue[%p]: clearing [%u]=%p\n", q, i, q->q_queue[i]);
 #endif
 
@@ -125,13 +130,59 @@ void clear_queue_katcl(struct katcl_queue *q)
   }
 
   q->q_count = 0;
+  q->q_head = 0;
 }
 
 /* manage the parse queue logic *************************************************/
 
-int add_tail_queue_katcl(struct katcl_queue *q, struct katcl_parse *p)
+static int resize_queue_katcl(struct katcl_queue *q, unsigned int size)
 {
   struct katcl_parse **tmp;
+  unsigned int i, j;
+
+  /* copies entries to the start of a fresh ring, so the head ends up at zero */
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if((size < q->q_count) || (size & (size - 1))){
+    fprintf(stderr, "queue[%p]: bad resize to %u with %u entries\n", q, size, q->q_count);
+    abort();
+  }
+#endif
+
+  tmp = malloc(sizeof(struct katcl_parse *) * size);
+  if(tmp == NULL){
+    return -1;
+  }
+
+  for(j = 0; j < q->q_count; j++){
+    i = (q->q_head + j) & (q->q_size - 1);
+    tmp[j] = q->q_queue[i];
+  }
+  for(; j < size; j++){
+    tmp[j] = NULL;
+  }
+
+  if(q->q_queue){
+    free(q->q_queue);
+  }
+
+  q->q_queue = tmp;
+  q->q_size = size;
+  q->q_head = 0;
+
+  return 0;
+}
+
+static void shrink_queue_katcl(struct katcl_queue *q)
+{
+  if((q->q_size > QUEUE_KEEP) && (q->q_count <= (q->q_size / 4))){
+    /* failure to shrink is harmless, keep the larger ring */
+    resize_queue_katcl(q, q->q_size / 2);
+  }
+}
+
+int add_tail_queue_katcl(struct katcl_queue *q, struct katcl_parse *p)
+{
   unsigned int index;
 
   /* WARNING: adding to the queue adds to parse reference count */
@@ -155,26 +206,16 @@ int add_tail_queue_katcl(struct katcl_queue *q, struct katcl_parse *p)
       abort();
     }
 #endif
-    tmp = realloc(q->q_queue, sizeof(struct katcl_parse *) * (q->q_size + 1));
-
-    if(tmp == NULL){
+    if(resize_queue_katcl(q, (q->q_size > 0) ? (q->q_size * 2) : QUEUE_MINIMUM) < 0){
       return -1;
     }
-    q->q_queue = tmp;
-
-    if(q->q_head > 0){
-      q->q_queue[q->q_size] = q->q_queue[0];
-      if(q->q_head > 1){
-        memmove(&(q->q_queue[0]), &(q->q_queue[1]), sizeof(struct katcl_parse *) * (q->q_head - 1));
-      }
-      q->q_queue[q->q_head - 1] = NULL;
-    }
-
-    q->q_size = q->q_size + 1;
   } 
-  index = (q->q_head + q->q_count) % q->q_size;
+  index = (q->q_head + q->q_count) & (q->q_size - 1);
 
   q->q_queue[index] = copy_parse_katcl(p);
+  if(q->q_queue[index] == NULL){
+    return -1;
+  }
   q->q_count++;
 
 #if DEBUG > 1
@@ -189,15 +230,12 @@ int add_tail_queue_katcl(struct katcl_queue *q, struct katcl_parse *p)
 
 struct katcl_parse *get_index_queue_katcl(struct katcl_queue *q, unsigned int index)
 {
-  unsigned int wrap;
-
-  if((q->q_count == 0) || (q->q_size == 0) || (q->q_count >= q->q_size)){
+  if((q->q_count == 0) || (q->q_size == 0) || (q->q_count > q->q_size)){
     return NULL;
   }
 
-  if((q->q_count > index) && (index < q->q_size)){
-    wrap = ((q->q_head + index) % q->q_size);
-    return q->q_queue[wrap];
+  if(index < q->q_count){
+    return q->q_queue[(q->q_head + index) & (q->q_size - 1)];
   } else {
     return NULL;
   }
@@ -212,7 +250,7 @@ struct katcl_parse *get_head_queue_katcl(struct katcl_queue *q)
 
 struct katcl_parse *remove_index_queue_katcl(struct katcl_queue *q, unsigned int index)
 {
-  unsigned int end;
+  unsigned int mask, position, i, j;
   struct katcl_parse *p;
 
   /* WARNING: removing from queue does not decrease reference count */
@@ -235,59 +273,48 @@ struct katcl_parse *remove_index_queue_katcl(struct katcl_queue *q, unsigned int
   }
 #endif
 
+  mask = q->q_size - 1;
+  position = (index - q->q_head) & mask;
+
+  if(position >= q->q_count){
+    /* not a live entry */
+    return NULL;
+  }
+
 #if DEBUG > 1
   fprintf(stderr, "queue[%p/%u]: del [%d]=%p\n", q, q->q_size, index, q->q_queue[index]);
 #endif
 
   p = q->q_queue[index];
-  q->q_queue[index] = NULL;
 
-  if(index == q->q_head){
+  if(position == 0){
     /* hopefully the common, simple case: only one interested party */
-    q->q_head = (q->q_head + 1) % q->q_size;
-    q->q_count--;
-
-#if DEBUG > 1
-    fprintf(stderr, "remove queue: releasing %p with ref %u\n", p, p->p_refs);
-#endif
-
-    return p;
-  }
-
-  if((q->q_head + q->q_count) > q->q_size){ /* wrapping case */
-    if(index >= q->q_head){ /* position before wrap around, move up head */
-      if(index > q->q_head){
-        memmove(&(q->q_queue[q->q_head + 1]), &(q->q_queue[q->q_head]), (index - q->q_head) * sizeof(struct katcl_parse *));
-      }
-      q->q_queue[q->q_head] = NULL;
-      q->q_head = (q->q_head + 1) % q->q_size;
-      q->q_count--;
-#if DEBUG > 1
-      fprintf(stderr, "remove queue: releasing %p with ref %u\n", p, p->p_refs);
-#endif
-      return p; /* WARNING: done here */
+    q->q_queue[index] = NULL;
+    q->q_head = (q->q_head + 1) & mask;
+  } else if(position < (q->q_count / 2)){
+    /* closer to the head: shuffle the earlier entries up by one and advance the head */
+    for(j = position; j > 0; j--){
+      i = (q->q_head + j) & mask;
+      q->q_queue[i] = q->q_queue[(i - 1) & mask];
     }
-  } else { /* if no wrapping, we can not be before head */
-    if(index < q->q_head){
-      return NULL;
+    q->q_queue[q->q_head] = NULL;
+    q->q_head = (q->q_head + 1) & mask;
+  } else {
+    /* closer to the tail: shuffle the later entries down by one */
+    for(j = position; (j + 1) < q->q_count; j++){
+      i = (q->q_head + j) & mask;
+      q->q_queue[i] = q->q_queue[(i + 1) & mask];
     }
+    q->q_queue[(q->q_head + q->q_count - 1) & mask] = NULL;
   }
 
-  /* now move back end by one, to overwrite position at index */
-  end = q->q_head + q->q_count - 1; /* WARNING: relies on count+head never being zero, hence earlier test */
-  if(index > end){
-    return NULL;
-  }
-  if(index < end){
-    memmove(&(q->q_queue[index]), &(q->q_queue[index + 1]), (end - index) * sizeof(struct katcl_parse *));
-  } /* else index is end, no copy needed  */
+  q->q_count--;
 
-#if DEBUG > 1
-  fprintf(stderr, "queue[%p]: remove[%d]=%p\n", q, index, q->q_queue[index]);
-#endif
+  if(q->q_count == 0){
+    q->q_head = 0;
+  }
 
-  q->q_queue[end] = NULL;
-  q->q_count--;
+  shrink_queue_katcl(q);
 
 #if DEBUG > 1
   fprintf(stderr, "remove queue: releasing %p with ref %u\n", p, p->p_refs);
@@ -325,7 +352,7 @@ void dump_queue_parse_katcp(struct katcl_queue *q, FILE *fp)
   }
   fprintf(fp, "\n");
 
-  for(k = q->q_head, i = 0; i < q->q_count; i++, k = (k + 1) % q->q_size){
+  for(k = q->q_head, i = 0; i < q->q_count; i++, k = (k + 1) & (q->q_size - 1)){
     if(q->q_queue[k] == NULL){
       fprintf(stderr, "parse queue: error: null field at %d\n", k);
     }
@@ -337,7 +364,7 @@ void dump_queue_parse_katcp(struct katcl_queue *q, FILE *fp)
       fprintf(stderr, "parse queue: error: used field at %d\n", k);
     }
 
-    k = (k + 1) % q->q_size;
+    k = (k + 1) & (q->q_size - 1);
     i++;
   }
 }
@@ -347,67 +374,191 @@ void dump_queue_parse_katcp(struct katcl_queue *q, FILE *fp)
 #ifdef UNIT_TEST_QUEUE
 
 #include <unistd.h>
+#include <sys/time.h>
 
-#define FUDGE 10000
+#define FUDGE      10000
+#define RUNS       20000
+#define SHADOW     (RUNS + 1)
 
-int main()
+#define GROWTH    100000
+#define CHURN    1000000
+#define DEPTH       1000
+
+static unsigned long usecs_since(struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return ((now.tv_sec - start->tv_sec) * 1000000UL) + now.tv_usec - start->tv_usec;
+}
+
+static struct katcl_parse *make_parse(void)
+{
+  struct katcl_parse *p;
+
+  p = create_referenced_parse_katcl();
+  if(p == NULL){
+    return NULL;
+  }
+
+  if(add_string_parse_katcl(p, KATCP_FLAG_FIRST | KATCP_FLAG_LAST | KATCP_FLAG_STRING, "#queue-test") < 0){
+    destroy_parse_katcl(p);
+    return NULL;
+  }
+
+  return p;
+}
+
+static int check_head(struct katcl_queue *q, struct katcl_parse **shadow, unsigned int *front, unsigned int back)
+{
+  struct katcl_parse *px;
+
+  px = remove_head_queue_katcl(q);
+  if(px == NULL){
+    if(*front != back){
+      fprintf(stderr, "queue: nothing removed, but %u entries expected\n", back - *front);
+      return -1;
+    }
+    return 0;
+  }
+
+  if(px != shadow[*front]){
+    fprintf(stderr, "queue: removed %p, expected %p at %u\n", px, shadow[*front], *front);
+    return -1;
+  }
+  (*front)++;
+
+  destroy_parse_katcl(px);
+
+  return 0;
+}
+
+int main(int argc, char **argv)
 {
   struct katcl_queue *q;
-  struct katcl_parse *p, *px;
-  int i, k, r;
+  struct katcl_parse *p, *px, **shadow;
+  struct timeval start;
+  unsigned int front, back, i, k, r, position;
+  unsigned long us;
 
   q = create_queue_katcl();
   if(q == NULL){
     fprintf(stderr, "unable to create parse queue\n");
     return 1;
   }
-#if 0
-  d = startup_katcp();
-  if(d == NULL){
-    fprintf(stderr, "unable to create dispatch\n");
-    return 1;
-  }
-  q = malloc(sizeof(struct katcl_queue));
-  if(q == NULL){
-    fprintf(stderr, "unable to create parse\n");
+
+  shadow = malloc(sizeof(struct katcl_parse *) * SHADOW);
+  if(shadow == NULL){
     return 1;
   }
-  q->q_queue = NULL;
-  q->q_head = 0;
-  q->q_count = 0;
-  q->q_size = 0;
-#endif
 
-  p = malloc(sizeof(struct katcl_parse));
-  if(p == NULL){
-    return 1;
+  if(argc > 1){
+    srand(atoi(argv[1]));
   }
-  p->p_buffer = NULL;
-  p->p_size = 0;
-  p->p_have = 0;
-  p->p_used = 0;
-  p->p_kept = 0;
 
-  for(i = 0; i < 20; i++){
+  /* random additions and removals, checked against a shadow copy */
+
+  front = 0;
+  back = 0;
+
+  for(i = 0; i < RUNS; i++){
     r = rand() % FUDGE;
-    if(r == 0){
-      for(k = 0; k < FUDGE; k++){
-        px = remove_head_queue_katcl(q);
-        if(px){
-          destroy_parse_katcl(px);
+    if(r < 10){
+      for(k = 0; k < (FUDGE / 10); k++){
+        if(check_head(q, shadow, &front, back) < 0){
+          return 1;
         }
       }
     } else if((r % 3) == 0){
-      px = remove_head_queue_katcl(q);
-      if(px){
-        destroy_parse_katcl(px);
+      if(check_head(q, shadow, &front, back) < 0){
+        return 1;
       }
+    } else if(((r % 7) == 0) && (size_queue_katcl(q) > 0)){
+      position = rand() % size_queue_katcl(q);
+      px = remove_index_queue_katcl(q, (q->q_head + position) & (q->q_size - 1));
+      if(px != shadow[front + position]){
+        fprintf(stderr, "queue: removed %p from position %u, expected %p\n", px, position, shadow[front + position]);
+        return 1;
+      }
+      memmove(&(shadow[front + 1]), &(shadow[front]), sizeof(struct katcl_parse *) * position);
+      front++;
+      destroy_parse_katcl(px);
     } else {
-      add_tail_queue_katcl(q, p);
+      p = make_parse();
+      if(p == NULL){
+        return 1;
+      }
+      if(add_tail_queue_katcl(q, p) < 0){
+        fprintf(stderr, "queue: unable to add entry\n");
+        return 1;
+      }
+      shadow[back++] = p;
+      destroy_parse_katcl(p);
+    }
+
+    if(size_queue_katcl(q) != (back - front)){
+      fprintf(stderr, "queue: size %u does not match expected %u\n", size_queue_katcl(q), back - front);
+      return 1;
+    }
+    if((q->q_size > 0) && (q->q_size & (q->q_size - 1))){
+      fprintf(stderr, "queue: size %u not a power of two\n", q->q_size);
+      return 1;
+    }
+  }
+
+  while(front < back){
+    if(check_head(q, shadow, &front, back) < 0){
+      return 1;
     }
-    dump_queue_parse_katcp(q, stderr);
   }
 
+  if(q->q_size > 64){
+    fprintf(stderr, "queue: drained queue still holds %u slots\n", q->q_size);
+    return 1;
+  }
+
+  /* growth: a slow reader, backlog builds up while the head moves, then drains */
+
+  p = make_parse();
+  if(p == NULL){
+    return 1;
+  }
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < GROWTH; i++){
+    add_tail_queue_katcl(q, p);
+    add_tail_queue_katcl(q, p);
+    px = remove_head_queue_katcl(q);
+    destroy_parse_katcl(px);
+  }
+  for(i = 0; i < GROWTH; i++){
+    px = remove_head_queue_katcl(q);
+    destroy_parse_katcl(px);
+  }
+  us = usecs_since(&start);
+  printf("queue: growth to %u entries and drain in %luus (%.1fns/op)\n", GROWTH, us, (us * 1000.0) / (4 * GROWTH));
+
+  /* churn: steady state with a backlog of depth entries, head not at zero */
+
+  for(i = 0; i < DEPTH; i++){
+    add_tail_queue_katcl(q, p);
+  }
+  gettimeofday(&start, NULL);
+  for(i = 0; i < CHURN; i++){
+    add_tail_queue_katcl(q, p);
+    px = remove_head_queue_katcl(q);
+    destroy_parse_katcl(px);
+  }
+  us = usecs_since(&start);
+  printf("queue: churn of %u at depth %u in %luus (%.1fns/op)\n", CHURN, DEPTH, us, (us * 1000.0) / (2 * CHURN));
+
+  destroy_parse_katcl(p);
+  destroy_queue_katcl(q);
+  free(shadow);
+
+  printf("queue: ok\n");
+
   return 0;
 }
 #endif
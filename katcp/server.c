@@ -459,6 +459,13 @@ int system_info_cmd_katcp(struct katcp_dispatch *d, int argc)
 
   log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%d %s scheduled", s->s_length, (s->s_length == 1) ? "timer" : "timers");
 
+  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "io readiness checked using %s", epoll_poll_katcp(s) ? "epoll" : "pselect");
+
+  if(s->s_pool){
+    log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%u parses in use with a high water mark of %u and %u idle", s->s_pool->k_live, s->s_pool->k_high, s->s_pool->k_idle);
+    log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%lu of %lu parse allocations recycled for a hit rate of %lu%%", s->s_pool->k_hits, s->s_pool->k_requests, s->s_pool->k_requests ? ((s->s_pool->k_hits * 100) / s->s_pool->k_requests) : 0UL);
+  }
+
   return KATCP_RESULT_OK;
 #undef BUFFER
 }
@@ -565,6 +572,7 @@ int run_core_loop_katcp(struct katcp_dispatch *dl)
   unsigned int len;
   struct sockaddr_in sa;
   struct timespec delta;
+  struct timeval now, soon;
   struct katcp_shared *s;
   char label[LABEL_BUFFER];
   long opts;
@@ -577,8 +585,7 @@ int run_core_loop_katcp(struct katcp_dispatch *dl)
   run = 1;
 
   while(run){
-    FD_ZERO(&(s->s_read));
-    FD_ZERO(&(s->s_write));
+    reset_poll_katcp(s);
 
 #if 0
     gettimeofday(&now, NULL);
@@ -586,16 +593,11 @@ int run_core_loop_katcp(struct katcp_dispatch *dl)
     future.tv_usec = now.tv_usec;
 #endif
 
-    s->s_max = (-1);
-
     suspend = run_timers_katcp(dl, &delta);
 
     if(run > 0){ /* only bother with new connections if not stopping */
       if(s->s_lfd >= 0){
-        FD_SET(s->s_lfd, &(s->s_read));
-        if(s->s_lfd > s->s_max){
-          s->s_max = s->s_lfd;
-        }
+        load_poll_katcp(s, &(s->s_listen), s->s_lfd, KATCP_POLL_READ);
       } else {
         if(s->s_used <= 0){ /* if we are not listening, and we have run out of clients, shut down too */
           run = (-1);
@@ -640,13 +642,27 @@ int run_core_loop_katcp(struct katcp_dispatch *dl)
       delta.tv_nsec = 0;
 
       suspend = 0;
-      FD_ZERO(&(s->s_read));
+      mute_poll_katcp(s, KATCP_POLL_READ);
     }
     
     if(s->s_busy > 0){
       suspend = 0;
       delta.tv_sec = 0;
       delta.tv_nsec = KATCP_BRIEF_WAIT;
+    } else if(s->s_soon.tv_sec || s->s_soon.tv_usec){
+      /* something deferred, typically output being coalesced */
+      gettimeofday(&now, NULL);
+      if(cmp_time_katcp(&(s->s_soon), &now) > 0){
+        sub_time_katcp(&soon, &(s->s_soon), &now);
+      } else {
+        soon.tv_sec = 0;
+        soon.tv_usec = 0;
+      }
+      if(suspend || (soon.tv_sec < delta.tv_sec) || ((soon.tv_sec == delta.tv_sec) && ((soon.tv_usec * 1000) < delta.tv_nsec))){
+        suspend = 0;
+        delta.tv_sec = soon.tv_sec;
+        delta.tv_nsec = soon.tv_usec * 1000;
+      }
     }
 
 #ifdef DEBUG
@@ -658,17 +674,18 @@ int run_core_loop_katcp(struct katcp_dispatch *dl)
 #endif
 
     /* delta now timespec, not timeval */
-    result = pselect(s->s_max + 1, &(s->s_read), &(s->s_write), NULL, suspend ? NULL : &delta, &(s->s_signal_mask));
+    result = wait_poll_katcp(s, suspend ? NULL : &delta);
 #ifdef DEBUG
     fprintf(stderr, "multi: select=%d, used=%d\n", result, s->s_used);
 #endif
 
     s->s_busy = 0;
+    s->s_soon.tv_sec = 0;
+    s->s_soon.tv_usec = 0;
 
     if(result < 0){
 
-      FD_ZERO(&(s->s_read));
-      FD_ZERO(&(s->s_write));
+      clear_poll_katcp(s);
 
       switch(errno){
         case EAGAIN :
@@ -712,7 +729,7 @@ int run_core_loop_katcp(struct katcp_dispatch *dl)
     run_notices_katcp(dl);
     run_arb_katcp(dl);
 
-    if(FD_ISSET(s->s_lfd, &(s->s_read))){
+    if(ready_poll_katcp(s, s->s_lfd, KATCP_POLL_READ)){
       if(s->s_used < s->s_count){
 
         len = sizeof(struct sockaddr_in);
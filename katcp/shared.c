@@ -206,6 +206,10 @@ int startup_shared_katcp(struct katcp_dispatch *d)
   s->s_posthook = NULL;
 
   s->s_commands = NULL;
+  s->s_wild = NULL;
+  s->s_lookup = NULL;
+  s->s_slots = 0;
+  s->s_named = 0;
 
   s->s_mode_sensor = NULL;
   s->s_mode = 0;
@@ -233,6 +237,9 @@ int startup_shared_katcp(struct katcp_dispatch *d)
 
   s->s_queue = NULL;
   s->s_length = 0;
+  s->s_room = 0;
+  s->s_timers = NULL;
+  s->s_buckets = 0;
 
   s->s_extras = NULL;
   s->s_total = 0;
@@ -240,7 +247,19 @@ int startup_shared_katcp(struct katcp_dispatch *d)
   s->s_notices = NULL;
   s->s_pending = 0;
 
+  s->s_notice_table = NULL;
+  s->s_notice_slots = 0;
+  s->s_notice_order = NULL;
+  s->s_notice_named = 0;
+  s->s_ready_head = NULL;
+  s->s_ready_tail = NULL;
+  s->s_notice_pass = 0;
+
+  s->s_pool = NULL;
+
   s->s_busy = 0;
+  s->s_soon.tv_sec = 0;
+  s->s_soon.tv_usec = 0;
 
   s->s_groups = NULL;
   s->s_fallback = NULL;
@@ -250,9 +269,22 @@ int startup_shared_katcp(struct katcp_dispatch *d)
   s->s_this = NULL;
   s->s_changes = 0;
 
+  s->s_sampling = NULL;
+  s->s_sampled = 0;
+  s->s_sample_size = 0;
+  s->s_sample_pass = 0;
+  s->s_sample_due.tv_sec = 0;
+  s->s_sample_due.tv_usec = 0;
+
   s->s_endpoints = NULL;
+  s->s_waking_head = NULL;
+  s->s_waking_tail = NULL;
+  s->s_endpoint_batch = KATCP_ENDPOINT_BATCH;
+  s->s_endpoint_sweep = 0;
+  s->s_endpoint_pass = 0;
 
   s->s_region = NULL;
+  s->s_vrbl_epoch = 0;
 
   s->s_build_state = NULL;
   s->s_build_items = 0;
@@ -269,15 +301,28 @@ int startup_shared_katcp(struct katcp_dispatch *d)
   s->s_sensors = NULL;
   s->s_tally = 0;
 
-  FD_ZERO(&(s->s_read));
-  FD_ZERO(&(s->s_write));
+  s->s_ticks = NULL;
+  s->s_tick_count = 0;
+
+#ifdef KATCP_ASYNC_ACQUIRE
+  s->s_acquire_pool = NULL;
+#endif
+
+  startup_poll_katcp(s);
 
   s->s_vector = malloc(sizeof(struct katcp_entry));
   if(s->s_vector == NULL){
+    shutdown_poll_katcp(s);
     free(s);
     return -1;
   }
 
+  /* not fatal if this fails, parses will then come from malloc */
+  s->s_pool = create_pool_katcl();
+  if(s->s_pool){
+    install_pool_katcl(s->s_pool);
+  }
+
   s->s_vector[0].e_name = NULL;
   s->s_vector[0].e_prep = NULL;
   s->s_vector[0].e_enter = NULL;
@@ -317,6 +362,8 @@ int startup_shared_katcp(struct katcp_dispatch *d)
   if(startup_duplex_katcp(d, KATCP_FLAT_STACK) < 0){
 
     /* TODO: provide proper destruction function to undo setup_shared ... */
+    shutdown_poll_katcp(s);
+    destroy_pool_katcl(s->s_pool);
     free(s->s_vector);
     free(s);
     d->d_shared = NULL;
@@ -426,6 +473,7 @@ void shutdown_shared_katcp(struct katcp_dispatch *d)
 
 #ifdef KATCP_EXPERIMENTAL
   shutdown_duplex_katcp(d);
+  destroy_sampling_katcp(d);
 #if 0 /* was previously */
   destroy_flats_katcp(d);
   destroy_groups_katcp(d);
@@ -445,6 +493,14 @@ void shutdown_shared_katcp(struct katcp_dispatch *d)
     shutdown_cmd_katcp(c);
   }
 
+  s->s_wild = NULL;
+  if(s->s_lookup){
+    free(s->s_lookup);
+    s->s_lookup = NULL;
+  }
+  s->s_slots = 0;
+  s->s_named = 0;
+
   s->s_mode = 0;
   s->s_flaky = 1;
 
@@ -499,6 +555,12 @@ void shutdown_shared_katcp(struct katcp_dispatch *d)
 
   /* restore signal handlers if we messed with them */
   undo_signals_shared_katcp(s);
+
+  shutdown_poll_katcp(s);
+
+  /* parses still referenced elsewhere keep the pool around until released */
+  destroy_pool_katcl(s->s_pool);
+  s->s_pool = NULL;
   
   free(s);
 }
@@ -620,6 +682,7 @@ int load_shared_katcp(struct katcp_dispatch *d)
   struct katcp_shared *s;
   struct katcp_dispatch *dx;
   int i, result, fd, status;
+  unsigned int mask;
 
   sane_shared_katcp(d);
   s = d->d_shared;
@@ -644,6 +707,8 @@ int load_shared_katcp(struct katcp_dispatch *d)
     }
 #endif
 
+    mask = 0;
+
     status = exited_katcp(dx);
 #ifdef DEBUG
     fprintf(stderr, "load shared[%d]: status is %d, fd=%d\n", i, status, fd);
@@ -651,10 +716,7 @@ int load_shared_katcp(struct katcp_dispatch *d)
     switch(status){
       case KATCP_EXIT_NOTYET : /* still running */
         /* load up read fd */
-        FD_SET(fd, &(s->s_read));
-        if(fd > s->s_max){
-          s->s_max = fd;
-        }
+        mask |= KATCP_POLL_READ;
         break;
 
       case KATCP_EXIT_QUIT : /* only this connection is shutting down */
@@ -682,11 +744,10 @@ int load_shared_katcp(struct katcp_dispatch *d)
 #ifdef DEBUG
       fprintf(stderr, "load shared[%d]: want to flush data\n", i);
 #endif
-      FD_SET(fd, &(s->s_write));
-      if(fd > s->s_max){
-        s->s_max = fd;
-      }
+      mask |= KATCP_POLL_WRITE;
     }
+
+    load_poll_katcp(s, &(dx->d_interest), fd, mask);
   }
 
   return result;
@@ -710,7 +771,7 @@ int run_shared_katcp(struct katcp_dispatch *d)
     fprintf(stderr, "run shared[%d/%d]: %p, fd=%d\n", i, s->s_used, dx, fd);
 #endif
 
-    if(FD_ISSET(fd, &(s->s_write))){
+    if(ready_poll_katcp(s, fd, KATCP_POLL_WRITE)){
       if(write_katcp(dx) < 0){
         log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "write to %s failed: %s", dx->d_name, strerror(error_katcl(dx->d_line)));
         release_clone(dx);
@@ -726,7 +787,7 @@ int run_shared_katcp(struct katcp_dispatch *d)
       continue;
     }
 
-    if(FD_ISSET(fd, &(s->s_read))){
+    if(ready_poll_katcp(s, fd, KATCP_POLL_READ)){
       if((result = read_katcp(dx))){
         if(result > 0){
           log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "received end of file from %s", dx->d_name);
@@ -783,6 +844,75 @@ int ended_shared_katcp(struct katcp_dispatch *d)
   return (s->s_used > 0) ? 0 : 1;
 }
 
+/* for a forked child which does not exec: close the fds of the parent loop, */
+/* otherwise the parent's peers never see a hangup and its epoll entries outlive a close */
+
+void detach_shared_katcp(struct katcp_dispatch *d)
+{
+  struct katcp_shared *s;
+  struct katcp_dispatch *dx;
+  struct katcp_group *gx;
+  struct katcp_flat *fx;
+  struct katcp_job *j;
+  struct katcp_arb *a;
+  unsigned int i, k;
+
+  if((d == NULL) || (d->d_shared == NULL)){
+    return;
+  }
+
+  s = d->d_shared;
+
+  if(s->s_epoll >= 0){
+    close(s->s_epoll);
+    s->s_epoll = (-1);
+  }
+
+  if(s->s_lfd >= 0){
+    close(s->s_lfd);
+    s->s_lfd = (-1);
+  }
+
+  if(s->s_template && s->s_template->d_line){
+    exchange_katcl(s->s_template->d_line, -1);
+  }
+
+  for(i = 0; i < s->s_count; i++){
+    dx = s->s_clients[i];
+    if(dx && dx->d_line){
+      exchange_katcl(dx->d_line, -1);
+    }
+  }
+
+  for(i = 0; i < s->s_number; i++){
+    j = s->s_tasks[i];
+    if(j && j->j_line){
+      exchange_katcl(j->j_line, -1);
+    }
+  }
+
+  for(i = 0; i < s->s_total; i++){
+    a = s->s_extras[i];
+    if(a && (a->a_fd >= 0)){
+      close(a->a_fd);
+      a->a_fd = (-1);
+    }
+  }
+
+  for(i = 0; i < s->s_members; i++){
+    gx = s->s_groups[i];
+    if(gx == NULL){
+      continue;
+    }
+    for(k = 0; k < gx->g_count; k++){
+      fx = gx->g_flats[k];
+      if(fx && fx->f_line){
+        exchange_katcl(fx->f_line, -1);
+      }
+    }
+  }
+}
+
 
 /*******************************************************************/
 
@@ -13,6 +13,9 @@
 /* attempt to do stuff within 5ms */
 #define KATCP_DEFAULT_DEADLINE 5000
 
+/* initial size of timer hash and heap, both grow by doubling */
+#define KATCP_TS_BUCKETS 16
+
 void dump_timers_katcp(struct katcp_dispatch *d)
 {
   int i;
@@ -51,6 +54,13 @@ static struct katcp_time *create_ts_katcp(int (*call)(struct katcp_dispatch *d,
   ts->t_interval.tv_sec = 0;
   ts->t_interval.tv_usec = 0;
 
+  ts->t_armed = 0;
+
+  ts->t_index = (-1);
+  ts->t_due = 0;
+  ts->t_next = NULL;
+  ts->t_later = NULL;
+
   ts->t_data = data;
   ts->t_call = call;
 
@@ -68,16 +78,90 @@ static void destroy_ts_katcp(struct katcp_dispatch *d, struct katcp_time *ts)
     log_message_katcp(d, KATCP_LEVEL_FATAL, NULL, "destruction of armed timer should not happen");
   }
 
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if(ts->t_index >= 0){
+    fprintf(stderr, "timer: logic problem: destroying timer %p still at heap position %d\n", ts, ts->t_index);
+    abort();
+  }
+#endif
+
   ts->t_armed = 0;
   ts->t_magic = 0;
 
   free(ts);
 }
 
+/* hash of timers, keyed on the data pointer ******************************************/
+
+static unsigned int hash_ts_katcp(struct katcp_shared *s, void *data)
+{
+  unsigned long v;
+
+  v = (unsigned long) data;
+  v = (v >> 4) ^ (v >> 12) ^ (v >> 20);
+
+  return v & (s->s_buckets - 1);
+}
+
+static int grow_hash_ts_katcp(struct katcp_shared *s)
+{
+  struct katcp_time **table, **old, *ts, *tn;
+  unsigned int size, i, count, key;
+
+  size = (s->s_buckets > 0) ? (s->s_buckets * 2) : KATCP_TS_BUCKETS;
+
+  table = malloc(sizeof(struct katcp_time *) * size);
+  if(table == NULL){
+    return -1;
+  }
+
+  for(i = 0; i < size; i++){
+    table[i] = NULL;
+  }
+
+  old = s->s_timers;
+  count = s->s_buckets;
+
+  s->s_timers = table;
+  s->s_buckets = size;
+
+  for(i = 0; i < count; i++){
+    for(ts = old[i]; ts; ts = tn){
+      tn = ts->t_next;
+      key = hash_ts_katcp(s, ts->t_data);
+      ts->t_next = s->s_timers[key];
+      s->s_timers[key] = ts;
+    }
+  }
+
+  if(old){
+    free(old);
+  }
+
+  return 0;
+}
+
+static void unhash_ts_katcp(struct katcp_shared *s, struct katcp_time *ts)
+{
+  struct katcp_time **tp;
+
+  if(s->s_buckets == 0){
+    return;
+  }
+
+  for(tp = &(s->s_timers[hash_ts_katcp(s, ts->t_data)]); *tp; tp = &((*tp)->t_next)){
+    if(*tp == ts){
+      *tp = ts->t_next;
+      ts->t_next = NULL;
+      return;
+    }
+  }
+}
+
 static struct katcp_time *find_ts_katcp(struct katcp_dispatch *d, void *data)
 {
-  int i;
   struct katcp_shared *s;
+  struct katcp_time *ts;
 
   s = d->d_shared;
 #ifdef DEBUG
@@ -87,61 +171,209 @@ static struct katcp_time *find_ts_katcp(struct katcp_dispatch *d, void *data)
   }
 #endif
 
-  for(i = 0; i < s->s_length; i++){
-    if(s->s_queue[i]->t_data == data){
-      return s->s_queue[i];
+  if(s->s_buckets == 0){
+    return NULL;
+  }
+
+  for(ts = s->s_timers[hash_ts_katcp(s, data)]; ts; ts = ts->t_next){
+    if(ts->t_data == data){
+      return ts;
     }
   }
 
   return NULL;
 }
 
-static int append_ts_katcp(struct katcp_dispatch *d, struct katcp_time *ts)
+/* binary heap ordered on t_when ******************************************************/
+
+static void place_ts_katcp(struct katcp_shared *s, struct katcp_time *ts, unsigned int i)
+{
+  s->s_queue[i] = ts;
+  ts->t_index = i;
+}
+
+static void up_heap_ts_katcp(struct katcp_shared *s, unsigned int i)
 {
-  struct katcp_time **tptr;
-  struct katcp_shared *s;
+  struct katcp_time *ts;
+  unsigned int parent;
 
-  s = d->d_shared;
-#ifdef DEBUG
-  if(s == NULL){
-    fprintf(stderr, "prepend: no shared state\n");
-    return -1;
+  ts = s->s_queue[i];
+
+  while(i > 0){
+    parent = (i - 1) / 2;
+    if(cmp_time_katcp(&(s->s_queue[parent]->t_when), &(ts->t_when)) <= 0){
+      break;
+    }
+    place_ts_katcp(s, s->s_queue[parent], i);
+    i = parent;
   }
-#endif
 
-  tptr = realloc(s->s_queue, sizeof(struct katcp_time *) * (s->s_length + 1));
-  if(tptr == NULL){
-    return -1;
+  place_ts_katcp(s, ts, i);
+}
+
+static void down_heap_ts_katcp(struct katcp_shared *s, unsigned int i)
+{
+  struct katcp_time *ts;
+  unsigned int child;
+
+  ts = s->s_queue[i];
+
+  for(;;){
+    child = (2 * i) + 1;
+    if(child >= s->s_length){
+      break;
+    }
+    if(((child + 1) < s->s_length) && (cmp_time_katcp(&(s->s_queue[child + 1]->t_when), &(s->s_queue[child]->t_when)) < 0)){
+      child++;
+    }
+    if(cmp_time_katcp(&(ts->t_when), &(s->s_queue[child]->t_when)) <= 0){
+      break;
+    }
+    place_ts_katcp(s, s->s_queue[child], i);
+    i = child;
   }
 
-  s->s_queue = tptr;
+  place_ts_katcp(s, ts, i);
+}
+
+static int insert_heap_ts_katcp(struct katcp_shared *s, struct katcp_time *ts)
+{
+  struct katcp_time **tptr;
+  unsigned int room;
+
+  if(s->s_length >= s->s_room){
+    room = (s->s_room > 0) ? (s->s_room * 2) : KATCP_TS_BUCKETS;
+    tptr = realloc(s->s_queue, sizeof(struct katcp_time *) * room);
+    if(tptr == NULL){
+      return -1;
+    }
+    s->s_queue = tptr;
+    s->s_room = room;
+  }
 
-  s->s_queue[s->s_length] = ts;
+  place_ts_katcp(s, ts, s->s_length);
   s->s_length++;
 
+  up_heap_ts_katcp(s, ts->t_index);
+
+  return 0;
+}
+
+static void remove_heap_ts_katcp(struct katcp_shared *s, struct katcp_time *ts)
+{
+  unsigned int i;
+  struct katcp_time *tl;
+
+  if(ts->t_index < 0){
+    return;
+  }
+
+  i = ts->t_index;
+  ts->t_index = (-1);
+
+  s->s_length--;
+  if(i == s->s_length){
+    return;
+  }
+
+  tl = s->s_queue[s->s_length];
+  place_ts_katcp(s, tl, i);
+
+  if((i > 0) && (cmp_time_katcp(&(tl->t_when), &(s->s_queue[(i - 1) / 2]->t_when)) < 0)){
+    up_heap_ts_katcp(s, i);
+  } else {
+    down_heap_ts_katcp(s, i);
+  }
+}
+
+/* t_when has been changed, put it where it belongs */
+
+static int schedule_ts_katcp(struct katcp_shared *s, struct katcp_time *ts)
+{
+  unsigned int i;
+
+  if(ts->t_index < 0){
+    return insert_heap_ts_katcp(s, ts);
+  }
+
+  i = ts->t_index;
+
+  if((i > 0) && (cmp_time_katcp(&(ts->t_when), &(s->s_queue[(i - 1) / 2]->t_when)) < 0)){
+    up_heap_ts_katcp(s, i);
+  } else {
+    down_heap_ts_katcp(s, i);
+  }
+
   return 0;
 }
 
+/* forget about timer completely, unless it is in the list of timers being run, in which case run_timers does it */
+
+static void release_ts_katcp(struct katcp_dispatch *d, struct katcp_time *ts)
+{
+  struct katcp_shared *s;
+
+  s = d->d_shared;
+
+  remove_heap_ts_katcp(s, ts);
+
+  if(ts->t_due){
+    return;
+  }
+
+  unhash_ts_katcp(s, ts);
+  destroy_ts_katcp(d, ts);
+}
+
 static struct katcp_time *find_make_append_ts_katcp(struct katcp_dispatch *d, int (*call)(struct katcp_dispatch *d, void *data), void *data)
 {
+  struct katcp_shared *s;
   struct katcp_time *ts;
+  unsigned int key;
+
+  s = d->d_shared;
 
   ts = find_ts_katcp(d, data);
   if(ts == NULL){
+    /* keep the chains short, on average no more than two */
+    if((s->s_length + 1) >= (s->s_buckets * 2)){
+      if(grow_hash_ts_katcp(s) < 0){
+        return NULL;
+      }
+    }
+
     ts = create_ts_katcp(call, data);
     if(ts == NULL){
       return NULL;
     }
 
-    if(append_ts_katcp(d, ts) < 0){
-      destroy_ts_katcp(d, ts);
-      return NULL;
-    }
+    key = hash_ts_katcp(s, data);
+    ts->t_next = s->s_timers[key];
+    s->s_timers[key] = ts;
   }
 
   return ts;
 }
 
+/* arm a timer set up by find_make_append, which has its time field already set */
+
+static int arm_ts_katcp(struct katcp_dispatch *d, struct katcp_time *ts)
+{
+  struct katcp_shared *s;
+
+  s = d->d_shared;
+
+  ts->t_armed = 1;
+
+  if(schedule_ts_katcp(s, ts) < 0){
+    ts->t_armed = 0;
+    release_ts_katcp(d, ts);
+    return -1;
+  }
+
+  return 0;
+}
+
 /* functions to schedule things at particular times *******************************/
 
 int register_every_ms_katcp(struct katcp_dispatch *d, unsigned int milli, int (*call)(struct katcp_dispatch *d, void *data), void *data)
@@ -183,9 +415,7 @@ int register_every_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*
 
   add_time_katcp(&(ts->t_when), &now, tv);
 
-  ts->t_armed = 1;
-
-  return 0;
+  return arm_ts_katcp(d, ts);
 }
 
 int register_at_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data)
@@ -216,9 +446,34 @@ int register_at_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*cal
   ts->t_when.tv_sec = tv->tv_sec; 
   ts->t_when.tv_usec = tv->tv_usec; 
 
-  ts->t_armed = 1;
+  return arm_ts_katcp(d, ts);
+}
 
-  return 0;
+/* periodic, but first run at a given time, so that timers can share a phase */
+
+int register_every_at_tv_katcp(struct katcp_dispatch *d, struct timeval *at, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data)
+{
+  struct katcp_time *ts;
+
+#ifdef DEBUG
+  if((tv->tv_usec >= 1000000) || (at->tv_usec >= 1000000)){
+    fprintf(stderr, "every at tv: major logic problem: usec too large\n");
+    abort();
+  }
+#endif
+
+  ts = find_make_append_ts_katcp(d, call, data);
+  if(ts == NULL){
+    return -1;
+  }
+
+  ts->t_interval.tv_sec = tv->tv_sec;
+  ts->t_interval.tv_usec = tv->tv_usec;
+
+  ts->t_when.tv_sec = at->tv_sec;
+  ts->t_when.tv_usec = at->tv_usec;
+
+  return arm_ts_katcp(d, ts);
 }
 
 int register_in_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*call)(struct katcp_dispatch *d, void *data), void *data)
@@ -251,9 +506,7 @@ int register_in_tv_katcp(struct katcp_dispatch *d, struct timeval *tv, int (*cal
 
   add_time_katcp(&(ts->t_when), &now, tv);
 
-  ts->t_armed = 1;
-
-  return 0;
+  return arm_ts_katcp(d, ts);
 }
 
 /* involve notices *******************************************************************/
@@ -352,6 +605,11 @@ int unwarp_timers_katcp(struct katcp_dispatch *d)
     }
   }
 
+  /* many keys may have changed, rebuild heap bottom up */
+  for(i = s->s_length / 2; i > 0; i--){
+    down_heap_ts_katcp(s, i - 1);
+  }
+
   return 0;
 }
 
@@ -376,6 +634,8 @@ int discharge_timer_katcp(struct katcp_dispatch *d, void *data)
 
   ts->t_armed = (-1);
 
+  release_ts_katcp(d, ts);
+
   return 0;
 }
 
@@ -383,24 +643,37 @@ int empty_timers_katcp(struct katcp_dispatch *d)
 {
   unsigned int i;
   struct katcp_shared *s;
+  struct katcp_time *ts, *tn;
 
   s = d->d_shared;
   if(s == NULL){
     return -1;
   }
 
-  if(s->s_length == 0){
-    return 0;
+  for(i = 0; i < s->s_length; i++){
+    s->s_queue[i]->t_index = (-1);
   }
+  s->s_length = 0;
 
-  for(i = 0; i < s->s_length; i++){
-    s->s_queue[i]->t_armed = 0;
-    destroy_ts_katcp(d, s->s_queue[i]);
+  for(i = 0; i < s->s_buckets; i++){
+    for(ts = s->s_timers[i]; ts; ts = tn){
+      tn = ts->t_next;
+      ts->t_armed = 0;
+      destroy_ts_katcp(d, ts);
+    }
   }
 
-  free(s->s_queue);
-  s->s_queue = NULL;
-  s->s_length = 0;
+  if(s->s_queue){
+    free(s->s_queue);
+    s->s_queue = NULL;
+  }
+  s->s_room = 0;
+
+  if(s->s_timers){
+    free(s->s_timers);
+    s->s_timers = NULL;
+  }
+  s->s_buckets = 0;
 
   return 0;
 }
@@ -409,12 +682,11 @@ int empty_timers_katcp(struct katcp_dispatch *d)
 
 int run_timers_katcp(struct katcp_dispatch *d, struct timespec *interval)
 {
-  /* this used to be a snazzy priority queue */
+  /* a snazzy priority queue once more: timers live in a heap, earliest deadline at the top */
 
   struct katcp_shared *s;
-  struct katcp_time *ts;
-  struct timeval now, delta, min, deadline;
-  unsigned int i, j;
+  struct katcp_time *ts, *due, **tail;
+  struct timeval now, delta, deadline;
 
   s = d->d_shared;
   if(s == NULL){
@@ -441,59 +713,83 @@ int run_timers_katcp(struct katcp_dispatch *d, struct timespec *interval)
   dump_timers_katcp(d);
 #endif
 
-  /* run all timers */
-  for(i = 0; i < s->s_length; i++){
-    ts = s->s_queue[i];
-    if(ts->t_armed > 0){
-      if(cmp_time_katcp(&(ts->t_when), &now) <= 0){
-        if(cmp_time_katcp(&(ts->t_when), &deadline) <= 0){
-          log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "missed deadline: scheduled=%lu.%06lus actual=%lu.%06lus for %p", ts->t_when.tv_sec, ts->t_when.tv_usec, now.tv_sec, now.tv_usec, ts->t_data);
-        }
-        ts->t_armed = 0; /* assume that we won't run again */
+  /* take everything due off the heap first, so that callbacks which reschedule themselves wait for the next pass */
+  due = NULL;
+  tail = &due;
+
+  while((s->s_length > 0) && (cmp_time_katcp(&(s->s_queue[0]->t_when), &now) <= 0)){
+    ts = s->s_queue[0];
+    remove_heap_ts_katcp(s, ts);
+
+    ts->t_due = 1;
+    ts->t_later = NULL;
+    *tail = ts;
+    tail = &(ts->t_later);
+  }
+
+  /* run all due timers */
+  while(due){
+    ts = due;
+    due = ts->t_later;
+    ts->t_later = NULL;
+
+    if(ts->t_armed <= 0){ /* discharged by an earlier callback */
+      ts->t_due = 0;
+      release_ts_katcp(d, ts);
+      continue;
+    }
+
+    if(ts->t_index >= 0){ /* rescheduled by an earlier callback, no longer due */
+      ts->t_due = 0;
+      continue;
+    }
+
+    if(cmp_time_katcp(&(ts->t_when), &deadline) <= 0){
+      log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "missed deadline: scheduled=%lu.%06lus actual=%lu.%06lus for %p", ts->t_when.tv_sec, ts->t_when.tv_usec, now.tv_sec, now.tv_usec, ts->t_data);
+    }
+    ts->t_armed = 0; /* assume that we won't run again */
 #ifdef DEBUG
-        fprintf(stderr, "timer: running timer %p with data %p\n", ts->t_call, ts->t_data);
+    fprintf(stderr, "timer: running timer %p with data %p\n", ts->t_call, ts->t_data);
 #endif
-        if((*(ts->t_call))(d, ts->t_data) >= 0){
-          /* only automatically re-arm if periodic and not failed */
-          if((ts->t_interval.tv_sec != 0) || (ts->t_interval.tv_usec != 0)){
-            ts->t_armed++; /* a discharge will result in this still being zero */
-            add_time_katcp(&(ts->t_when), &(ts->t_when), &(ts->t_interval));
-            if(cmp_time_katcp(&(ts->t_when), &now) < 0){
-              log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "will miss deadline: scheduled=%lu.%06lus, now aiming for +%lu.%06lus for %p", ts->t_when.tv_sec, ts->t_when.tv_usec, ts->t_interval.tv_sec, ts->t_interval.tv_usec, ts->t_data);
+    if((*(ts->t_call))(d, ts->t_data) >= 0){
+      /* only automatically re-arm if periodic and not failed */
+      if((ts->t_interval.tv_sec != 0) || (ts->t_interval.tv_usec != 0)){
+        ts->t_armed++; /* a discharge will result in this still being zero */
+        add_time_katcp(&(ts->t_when), &(ts->t_when), &(ts->t_interval));
+        if(cmp_time_katcp(&(ts->t_when), &now) < 0){
+          log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "will miss deadline: scheduled=%lu.%06lus, now aiming for +%lu.%06lus for %p", ts->t_when.tv_sec, ts->t_when.tv_usec, ts->t_interval.tv_sec, ts->t_interval.tv_usec, ts->t_data);
 
 #if 0 /* might be needed later */
-              gettimeofday(&now, NULL);
-              delta.tv_sec = 0;
-              delta.tv_usec = KATCP_DEFAULT_DEADLINE;
-              sub_time_katcp(&deadline, &now, &delta);
+          gettimeofday(&now, NULL);
+          delta.tv_sec = 0;
+          delta.tv_usec = KATCP_DEFAULT_DEADLINE;
+          sub_time_katcp(&deadline, &now, &delta);
 #endif
 
-              add_time_katcp(&(ts->t_when), &now, &(ts->t_interval));
-            }
-          }
+          add_time_katcp(&(ts->t_when), &now, &(ts->t_interval));
         }
       }
     }
-  }
 
-  /* trim out empty elements */
-  j = 0;
-  for(i = 0; i < s->s_length; i++){
-    ts = s->s_queue[i];
+    ts->t_due = 0;
+
     if(ts->t_armed > 0){
-      s->s_queue[j] = ts;
-      j++;
+      if(schedule_ts_katcp(s, ts) < 0){
+        log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to reschedule timer for %p", ts->t_data);
+        ts->t_armed = 0;
+        release_ts_katcp(d, ts);
+      }
     } else {
-      destroy_ts_katcp(d, ts);
+      release_ts_katcp(d, ts);
     }
   }
-  s->s_length = j;
 
   /* only destroy queue if everthing has been done */
   if(s->s_length == 0){
 
     free(s->s_queue);
     s->s_queue = NULL;
+    s->s_room = 0;
 
 #ifdef DEBUG
     fprintf(stderr, "schedule: everything sheduled done, no timeout\n");
@@ -504,20 +800,7 @@ int run_timers_katcp(struct katcp_dispatch *d, struct timespec *interval)
   /* now try to catch up */
   gettimeofday(&now, NULL);
 
-  ts = s->s_queue[0];
-  min.tv_sec  = ts->t_when.tv_sec;
-  min.tv_usec = ts->t_when.tv_usec;
-
-  for(i = 1; i < s->s_length; i++){
-    ts = s->s_queue[i];
-
-    if(cmp_time_katcp(&(ts->t_when), &min) < 0){
-      min.tv_sec  = ts->t_when.tv_sec;
-      min.tv_usec = ts->t_when.tv_usec;
-    }
-  }
-
-  sub_time_katcp(&delta, &min, &now);
+  sub_time_katcp(&delta, &(s->s_queue[0]->t_when), &now);
 
 #ifdef DEBUG
   fprintf(stderr, "schedule: %d scheduled callbacks left\n", s->s_length);
@@ -528,3 +811,106 @@ int run_timers_katcp(struct katcp_dispatch *d, struct timespec *interval)
 
   return 0;
 }
+
+#ifdef UNIT_TEST_TS
+
+#define TIMERS 10000
+#define PASSES  1000
+
+static int fired_ts = 0;
+
+static int count_ts(struct katcp_dispatch *d, void *data)
+{
+  fired_ts++;
+  return 0;
+}
+
+static double elapsed_ts(struct timeval *start)
+{
+  struct timeval now, delta;
+
+  gettimeofday(&now, NULL);
+  sub_time_katcp(&delta, &now, start);
+
+  return (delta.tv_sec * 1000000.0) + delta.tv_usec;
+}
+
+int main(int argc, char **argv)
+{
+  struct katcp_dispatch *d;
+  struct timeval tv, start;
+  struct timespec interval;
+  char *handles;
+  unsigned int i;
+
+  d = startup_katcp();
+  handles = malloc(TIMERS);
+  if((d == NULL) || (handles == NULL)){
+    fprintf(stderr, "ts: unable to allocate state\n");
+    return 1;
+  }
+
+  srand(0);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < TIMERS; i++){
+    tv.tv_sec = 10 + (rand() % 10);
+    tv.tv_usec = rand() % 1000000;
+    if(register_in_tv_katcp(d, &tv, &count_ts, &(handles[i])) < 0){
+      fprintf(stderr, "ts: unable to register timer %u\n", i);
+      return 1;
+    }
+  }
+  printf("ts: arm %d timers: %.3fus per timer\n", TIMERS, elapsed_ts(&start) / TIMERS);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < PASSES; i++){
+    if(run_timers_katcp(d, &interval) != 0){
+      fprintf(stderr, "ts: expected timers to remain pending\n");
+      return 1;
+    }
+  }
+  printf("ts: idle pass over %d timers: %.3fus per pass (next in %lu.%09lds)\n", TIMERS, elapsed_ts(&start) / PASSES, (unsigned long)interval.tv_sec, interval.tv_nsec);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < TIMERS; i++){
+    tv.tv_sec = 10 + (rand() % 10);
+    tv.tv_usec = rand() % 1000000;
+    register_in_tv_katcp(d, &tv, &count_ts, &(handles[i]));
+  }
+  printf("ts: rearm %d timers: %.3fus per timer\n", TIMERS, elapsed_ts(&start) / TIMERS);
+
+  gettimeofday(&start, NULL);
+  for(i = 0; i < TIMERS; i += 2){
+    if(discharge_timer_katcp(d, &(handles[i])) < 0){
+      fprintf(stderr, "ts: unable to discharge timer %u\n", i);
+      return 1;
+    }
+  }
+  printf("ts: disarm %d timers: %.3fus per timer\n", TIMERS / 2, elapsed_ts(&start) / (TIMERS / 2));
+
+  /* make the remaining half due now */
+  gettimeofday(&tv, NULL);
+  for(i = 1; i < TIMERS; i += 2){
+    register_at_tv_katcp(d, &tv, &count_ts, &(handles[i]));
+  }
+
+  gettimeofday(&start, NULL);
+  if(run_timers_katcp(d, &interval) != 1){
+    fprintf(stderr, "ts: expected all timers to have run\n");
+    return 1;
+  }
+  printf("ts: fire %d timers: %.3fus per timer\n", TIMERS / 2, elapsed_ts(&start) / (TIMERS / 2));
+
+  if(fired_ts != TIMERS / 2){
+    fprintf(stderr, "ts: fired %d timers, expected %d\n", fired_ts, TIMERS / 2);
+    return 1;
+  }
+
+  shutdown_katcp(d);
+  free(handles);
+
+  return 0;
+}
+
+#endif
@@ -442,6 +442,12 @@ int add_tobject_tag_katcp(struct katcp_dispatch *d, struct katcp_tag *t, struct
     destroy_tobject_katcp(to);
     return -1;
   }
+
+  if (add_posting_tag_katcp(t, to) < 0){
+    tdelete((void *) to, &(t->t_tobject_root), &compare_tobject_katcp);
+    destroy_tobject_katcp(to);
+    return -1;
+  }
   
 #if 0
   log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "added tobject <%s> to tag <%s>", a->a_key, t->t_name);
@@ -485,6 +491,8 @@ int del_tobject_tag_katcp(struct katcp_dispatch *d, struct katcp_tag *t, struct
     return -1;
   }
 
+  del_posting_tag_katcp(t, to);
+
   destroy_tobject_katcp(to);
 
   log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "deleted tobject <%s> from tag <%s>", a->a_key, t->t_name);
@@ -0,0 +1,591 @@
+/* cache of programmed bof images, keyed by a hash of the image contents.
+ * For each image we keep the raw bitstream, which can be copied straight
+ * into the config device, and the register table in a flat format which
+ * can be loaded without revisiting the bof file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <limits.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <katcp.h>
+#include <katcl.h>
+#include <avltree.h>
+
+#include "tcpborphserver3.h"
+
+#define CACHE_MAGIC      0x54425352
+#define CACHE_VERSION             1
+
+#define CACHE_BITSTREAM      ".bit"
+#define CACHE_REGISTERS      ".reg"
+
+#define CACHE_FNV_OFFSET 0xcbf29ce484222325ULL
+#define CACHE_FNV_PRIME  0x100000001b3ULL
+
+struct cache_header
+{
+  uint32_t h_magic;
+  uint32_t h_version;
+  uint32_t h_count;
+  uint32_t h_top;
+};
+
+/* followed by the nul terminated name, padded to a multiple of 4 */
+struct cache_record
+{
+  uint32_t r_pos;
+  uint32_t r_len;
+  uint16_t r_mode;
+  uint16_t r_size;
+};
+
+#define CACHE_RECORD_SPACE(len) ((sizeof(struct cache_record) + (len) + 1 + 3) & ~3)
+
+/*********************************************************************/
+
+int setup_cache_tbs(struct katcp_dispatch *d, char *dir, unsigned long limit)
+{
+  struct tbs_raw *tr;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return -1;
+  }
+
+  if(tr->r_cache_dir){
+    free(tr->r_cache_dir);
+    tr->r_cache_dir = NULL;
+  }
+
+  tr->r_cache_limit = limit;
+
+  if((dir == NULL) || (dir[0] == '\0') || (limit == 0)){
+    log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "image cache disabled");
+    return 0;
+  }
+
+  if((mkdir(dir, S_IRWXU) < 0) && (errno != EEXIST)){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unable to create image cache %s: %s", dir, strerror(errno));
+    return -1;
+  }
+
+  tr->r_cache_dir = strdup(dir);
+  if(tr->r_cache_dir == NULL){
+    return -1;
+  }
+
+  return 0;
+}
+
+/* hashes the image 8 bytes at a time, the name is only used for messages */
+
+int key_cache_tbs(struct katcp_dispatch *d, char *name, char *key)
+{
+  struct tbs_raw *tr;
+  struct stat st;
+  uint64_t hash, word;
+  unsigned char *map;
+  unsigned long i, words;
+  int fd;
+
+  key[0] = '\0';
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if((tr == NULL) || (tr->r_cache_dir == NULL)){
+    return -1;
+  }
+
+  fd = open(name, O_RDONLY);
+  if(fd < 0){
+    return -1;
+  }
+
+  if((fstat(fd, &st) < 0) || (st.st_size <= 0)){
+    close(fd);
+    return -1;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unable to map %s for hashing: %s", name, strerror(errno));
+    return -1;
+  }
+
+  hash = CACHE_FNV_OFFSET ^ st.st_size;
+  words = st.st_size / 8;
+
+  for(i = 0; i < words; i++){
+    memcpy(&word, map + (i * 8), 8);
+    hash = (hash ^ word) * CACHE_FNV_PRIME;
+    hash ^= hash >> 29;
+  }
+  for(i = words * 8; i < st.st_size; i++){
+    hash = (hash ^ map[i]) * CACHE_FNV_PRIME;
+  }
+
+  munmap(map, st.st_size);
+
+  snprintf(key, TBS_CACHE_KEY, "%016llx", (unsigned long long)hash);
+  key[TBS_CACHE_KEY - 1] = '\0';
+
+  return 0;
+}
+
+char *path_cache_tbs(struct katcp_dispatch *d, char *key, char *suffix)
+{
+  struct tbs_raw *tr;
+  char *ptr;
+  int len;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if((tr == NULL) || (tr->r_cache_dir == NULL)){
+    return NULL;
+  }
+
+  len = strlen(tr->r_cache_dir) + 1 + strlen(key) + strlen(suffix) + 1;
+
+  ptr = malloc(len);
+  if(ptr == NULL){
+    return NULL;
+  }
+
+  snprintf(ptr, len, "%s/%s%s", tr->r_cache_dir, key, suffix);
+  ptr[len - 1] = '\0';
+
+  return ptr;
+}
+
+char *bitstream_cache_tbs(struct katcp_dispatch *d, char *key)
+{
+  return path_cache_tbs(d, key, CACHE_BITSTREAM);
+}
+
+void forget_cache_tbs(struct katcp_dispatch *d, char *key)
+{
+  char *path;
+
+  path = path_cache_tbs(d, key, CACHE_BITSTREAM);
+  if(path){
+    unlink(path);
+    free(path);
+  }
+
+  path = path_cache_tbs(d, key, CACHE_REGISTERS);
+  if(path){
+    unlink(path);
+    free(path);
+  }
+}
+
+/* returns 1 if both parts are present, and marks the entry as recently used */
+
+int have_cache_tbs(struct katcp_dispatch *d, char *key)
+{
+  char *bit, *reg;
+  struct stat st;
+  int result;
+
+  bit = path_cache_tbs(d, key, CACHE_BITSTREAM);
+  reg = path_cache_tbs(d, key, CACHE_REGISTERS);
+
+  result = 0;
+
+  if(bit && reg){
+    if((stat(reg, &st) == 0) && (stat(bit, &st) == 0)){
+      /* the bitstream mtime is the lru stamp */
+      if(utimes(bit, NULL) == 0){
+        result = 1;
+      }
+    }
+  }
+
+  if(bit){
+    free(bit);
+  }
+  if(reg){
+    free(reg);
+  }
+
+  return result;
+}
+
+/*********************************************************************/
+
+struct cache_writer
+{
+  FILE *w_fp;
+  unsigned int w_count;
+  int w_error;
+};
+
+static int write_register_cache_tbs(struct katcp_dispatch *d, void *global, char *key, void *data)
+{
+  struct cache_writer *cw;
+  struct cache_record cr;
+  struct tbs_entry *te;
+  unsigned int len, space;
+  char pad[4] = { 0, 0, 0, 0 };
+
+  cw = global;
+  te = data;
+
+  if((te == NULL) || (key == NULL) || cw->w_error){
+    return 0;
+  }
+
+  /* only plain registers, the cache holds what the bof file declared */
+  if(te->e_pos_offset || te->e_len_offset){
+    return 0;
+  }
+
+  len = strlen(key);
+  if(len >= 0xffff){
+    cw->w_error = 1;
+    return 0;
+  }
+
+  cr.r_pos = te->e_pos_base;
+  cr.r_len = te->e_len_base;
+  cr.r_mode = te->e_mode;
+  cr.r_size = len;
+
+  space = CACHE_RECORD_SPACE(len);
+
+  if((fwrite(&cr, sizeof(struct cache_record), 1, cw->w_fp) != 1) ||
+     (fwrite(key, len, 1, cw->w_fp) != 1) ||
+     (fwrite(pad, space - sizeof(struct cache_record) - len, 1, cw->w_fp) != 1)){
+    cw->w_error = 1;
+    return 0;
+  }
+
+  cw->w_count++;
+
+  return 0;
+}
+
+int save_registers_cache_tbs(struct katcp_dispatch *d, char *key)
+{
+  struct tbs_raw *tr;
+  struct cache_writer cw;
+  struct cache_header ch;
+  char *path, *temp;
+  int len;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if((tr == NULL) || (tr->r_registers == NULL)){
+    return -1;
+  }
+
+  path = path_cache_tbs(d, key, CACHE_REGISTERS);
+  if(path == NULL){
+    return -1;
+  }
+
+  len = strlen(path) + 6;
+  temp = malloc(len);
+  if(temp == NULL){
+    free(path);
+    return -1;
+  }
+  snprintf(temp, len, "%s.part", path);
+
+  cw.w_fp = fopen(temp, "w");
+  cw.w_count = 0;
+  cw.w_error = 0;
+
+  if(cw.w_fp == NULL){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unable to create %s: %s", temp, strerror(errno));
+    free(temp);
+    free(path);
+    return -1;
+  }
+
+  /* header rewritten once the count is known */
+  memset(&ch, 0, sizeof(struct cache_header));
+  if(fwrite(&ch, sizeof(struct cache_header), 1, cw.w_fp) != 1){
+    cw.w_error = 1;
+  }
+
+  complex_inorder_traverse_avltree(d, tr->r_registers->t_root, &cw, &write_register_cache_tbs);
+
+  ch.h_magic = CACHE_MAGIC;
+  ch.h_version = CACHE_VERSION;
+  ch.h_count = cw.w_count;
+  ch.h_top = tr->r_top_register;
+
+  if((fseek(cw.w_fp, 0, SEEK_SET) < 0) || (fwrite(&ch, sizeof(struct cache_header), 1, cw.w_fp) != 1)){
+    cw.w_error = 1;
+  }
+
+  if(fclose(cw.w_fp) != 0){
+    cw.w_error = 1;
+  }
+
+  if(cw.w_error || (rename(temp, path) < 0)){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unable to save register table to %s", path);
+    unlink(temp);
+    free(temp);
+    free(path);
+    return -1;
+  }
+
+  log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "saved %u registers to %s", cw.w_count, path);
+
+  free(temp);
+  free(path);
+
+  return 0;
+}
+
+int load_registers_cache_tbs(struct katcp_dispatch *d, char *key)
+{
+  struct tbs_raw *tr;
+  struct cache_header *ch;
+  struct cache_record *cr;
+  struct tbs_entry *te;
+  struct stat st;
+  unsigned char *map;
+  unsigned long pos, space;
+  unsigned int i;
+  char *path, *name;
+  int fd, result;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if((tr == NULL) || (tr->r_registers == NULL)){
+    return -1;
+  }
+
+  path = path_cache_tbs(d, key, CACHE_REGISTERS);
+  if(path == NULL){
+    return -1;
+  }
+
+  fd = open(path, O_RDONLY);
+  free(path);
+  if(fd < 0){
+    return -1;
+  }
+
+  if((fstat(fd, &st) < 0) || (st.st_size < sizeof(struct cache_header))){
+    close(fd);
+    return -1;
+  }
+
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED){
+    return -1;
+  }
+
+  ch = (struct cache_header *) map;
+  if((ch->h_magic != CACHE_MAGIC) || (ch->h_version != CACHE_VERSION)){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "register cache for %s has an unexpected format", key);
+    munmap(map, st.st_size);
+    return -1;
+  }
+
+  result = 0;
+  pos = sizeof(struct cache_header);
+
+  for(i = 0; i < ch->h_count; i++){
+    if((pos + sizeof(struct cache_record)) > st.st_size){
+      result = (-1);
+      break;
+    }
+
+    cr = (struct cache_record *)(map + pos);
+    space = CACHE_RECORD_SPACE(cr->r_size);
+
+    if(((pos + space) > st.st_size) || (map[pos + sizeof(struct cache_record) + cr->r_size] != '\0')){
+      result = (-1);
+      break;
+    }
+
+    name = (char *)(map + pos + sizeof(struct cache_record));
+
+    te = malloc(sizeof(struct tbs_entry));
+    if(te == NULL){
+      result = (-1);
+      break;
+    }
+
+    te->e_pos_base = cr->r_pos;
+    te->e_pos_offset = 0;
+    te->e_len_base = cr->r_len;
+    te->e_len_offset = 0;
+    te->e_mode = cr->r_mode;
+
+    if(store_named_node_avltree(tr->r_registers, name, te) < 0){
+      free(te);
+      result = (-1);
+      break;
+    }
+
+    pos += space;
+  }
+
+  if(result == 0){
+    if(tr->r_top_register < ch->h_top){
+      tr->r_top_register = ch->h_top;
+    }
+    log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "loaded %u registers from cache", ch->h_count);
+  } else {
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "register cache for %s is damaged", key);
+  }
+
+  munmap(map, st.st_size);
+
+  return result;
+}
+
+/*********************************************************************/
+
+/* runs in a subprocess: drops the least recently used images until
+ * the cache fits, never the one in keep */
+
+struct cache_entry
+{
+  char c_key[TBS_CACHE_KEY];
+  time_t c_used;
+  unsigned long c_size;
+};
+
+static int compare_entry_cache(const void *a, const void *b)
+{
+  const struct cache_entry *ca, *cb;
+
+  ca = a;
+  cb = b;
+
+  if(ca->c_used < cb->c_used){
+    return -1;
+  }
+  if(ca->c_used > cb->c_used){
+    return 1;
+  }
+
+  return 0;
+}
+
+static struct cache_entry *find_entry_cache(struct cache_entry *vector, unsigned int count, char *key)
+{
+  unsigned int i;
+
+  for(i = 0; i < count; i++){
+    if(!strcmp(vector[i].c_key, key)){
+      return &(vector[i]);
+    }
+  }
+
+  return NULL;
+}
+
+int evict_cache_tbs(struct katcl_line *l, char *dir, unsigned long limit, char *keep)
+{
+  DIR *dh;
+  struct dirent *de;
+  struct stat st;
+  struct cache_entry *vector, *tmp, *ce;
+  unsigned int count, size, i;
+  unsigned long total;
+  char path[PATH_MAX], key[TBS_CACHE_KEY];
+  char *suffix;
+  int len;
+
+  dh = opendir(dir);
+  if(dh == NULL){
+    return -1;
+  }
+
+  vector = NULL;
+  count = 0;
+  size = 0;
+  total = 0;
+
+  while((de = readdir(dh)) != NULL){
+    suffix = strrchr(de->d_name, '.');
+    if((suffix == NULL) || ((suffix - de->d_name) != (TBS_CACHE_KEY - 1))){
+      continue;
+    }
+
+    snprintf(path, PATH_MAX, "%s/%s", dir, de->d_name);
+    if(stat(path, &st) < 0){
+      continue;
+    }
+
+    memcpy(key, de->d_name, TBS_CACHE_KEY - 1);
+    key[TBS_CACHE_KEY - 1] = '\0';
+
+    ce = find_entry_cache(vector, count, key);
+    if(ce == NULL){
+      if(count >= size){
+        size = size ? (size * 2) : 16;
+        tmp = realloc(vector, sizeof(struct cache_entry) * size);
+        if(tmp == NULL){
+          break;
+        }
+        vector = tmp;
+      }
+      ce = &(vector[count++]);
+      memcpy(ce->c_key, key, TBS_CACHE_KEY);
+      ce->c_used = 0;
+      ce->c_size = 0;
+    }
+
+    ce->c_size += st.st_size;
+    total += st.st_size;
+
+    if(!strcmp(suffix, CACHE_BITSTREAM)){
+      ce->c_used = st.st_mtime;
+    }
+  }
+
+  closedir(dh);
+
+  if(total <= limit){
+    if(vector){
+      free(vector);
+    }
+    return 0;
+  }
+
+  qsort(vector, count, sizeof(struct cache_entry), &compare_entry_cache);
+
+  for(i = 0; (i < count) && (total > limit); i++){
+    if(keep && !strcmp(vector[i].c_key, keep)){
+      continue;
+    }
+
+    len = snprintf(path, PATH_MAX, "%s/%s%s", dir, vector[i].c_key, CACHE_BITSTREAM);
+    if(len < PATH_MAX){
+      unlink(path);
+    }
+    len = snprintf(path, PATH_MAX, "%s/%s%s", dir, vector[i].c_key, CACHE_REGISTERS);
+    if(len < PATH_MAX){
+      unlink(path);
+    }
+
+    total -= vector[i].c_size;
+
+    if(l){
+      sync_message_katcl(l, KATCP_LEVEL_INFO, TBS_FPGA_LABEL, "evicted cached image %s of %lu bytes", vector[i].c_key, vector[i].c_size);
+    }
+  }
+
+  free(vector);
+
+  return 0;
+}
@@ -0,0 +1,231 @@
+/* ethernet frame check sequence, as required by the 10GbE core when we
+ * write frames from the tap device into its transmit buffer
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CRC_ARM_ACLE
+#include <arm_acle.h>
+#endif
+
+#include <katcp.h>
+
+#include "tg.h"
+
+#define CRCPOLY_LE 0xedb88320
+
+#ifdef CRC_ARM_ACLE
+
+/* armv8 crc32 instructions use the ethernet polynomial, unlike the x86 one (castagnoli) */
+
+uint32_t crc32_le_getap(uint32_t crc, unsigned char *p, unsigned int len)
+{
+  uint64_t v;
+
+  while(len && (((unsigned long)p) & 0x7)){
+    crc = __crc32b(crc, *p++);
+    len--;
+  }
+
+  while(len >= 8){
+    memcpy(&v, p, 8);
+    crc = __crc32d(crc, v);
+    p += 8;
+    len -= 8;
+  }
+
+  while(len--){
+    crc = __crc32b(crc, *p++);
+  }
+
+  return crc;
+}
+
+#else
+
+/* slice by 8: table k holds the crc of a byte followed by k zero bytes */
+
+static uint32_t crc_table[8][256];
+static int crc_ready = 0;
+
+static void init_crc_table(void)
+{
+  uint32_t c;
+  unsigned int i, k;
+
+  for(i = 0; i < 256; i++){
+    c = i;
+    for(k = 0; k < 8; k++){
+      c = (c >> 1) ^ ((c & 1) ? CRCPOLY_LE : 0);
+    }
+    crc_table[0][i] = c;
+  }
+
+  for(i = 0; i < 256; i++){
+    for(k = 1; k < 8; k++){
+      crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+    }
+  }
+
+  crc_ready = 1;
+}
+
+uint32_t crc32_le_getap(uint32_t crc, unsigned char *p, unsigned int len)
+{
+  uint32_t a, b;
+
+  if(crc_ready == 0){
+    init_crc_table();
+  }
+
+  /* assemble words bytewise, the host may well be a big endian ppc */
+
+  while(len >= 8){
+    a = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)(p[3]) << 24));
+    b =        p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)(p[7]) << 24);
+
+    crc = crc_table[7][ a        & 0xff] ^
+          crc_table[6][(a >>  8) & 0xff] ^
+          crc_table[5][(a >> 16) & 0xff] ^
+          crc_table[4][ a >> 24        ] ^
+          crc_table[3][ b        & 0xff] ^
+          crc_table[2][(b >>  8) & 0xff] ^
+          crc_table[1][(b >> 16) & 0xff] ^
+          crc_table[0][ b >> 24        ];
+
+    p += 8;
+    len -= 8;
+  }
+
+  while(len--){
+    crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+  }
+
+  return crc;
+}
+
+#endif
+
+#ifdef UNIT_TEST_CRC
+
+#include <unistd.h>
+#include <sys/time.h>
+
+#define TEST_MAX   4096
+#define TEST_RUNS 10000
+#define BENCH_MB    256
+
+static uint32_t crc32_le_bitwise(uint32_t crc, unsigned char *p, unsigned int len)
+{
+  int i;
+  while (len--){
+    crc ^= *p++;
+    for (i = 0; i < 8; i++){
+      crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
+    }
+  }
+  return crc;
+}
+
+static double elapsed_ms(struct timeval *start)
+{
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+
+  return ((now.tv_sec - start->tv_sec) * 1000.0) + ((now.tv_usec - start->tv_usec) / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned char buffer[TEST_MAX + 8];
+  unsigned int i, j, len, offset, *sizes, count, total;
+  uint32_t expect, got, sum;
+  struct timeval start;
+  double slow, fast;
+
+  srand(getpid());
+
+  for(i = 0; i < sizeof(buffer); i++){
+    buffer[i] = rand();
+  }
+
+  got = ~crc32_le_getap(0xffffffffUL, (unsigned char *)"123456789", 9);
+  if(got != 0xcbf43926){
+    fprintf(stderr, "crc: check value is 0x%08x, expected 0xcbf43926\n", got);
+    return 1;
+  }
+
+  for(i = 0; i < TEST_RUNS; i++){
+    len = rand() % (TEST_MAX + 1);
+    offset = rand() % 8;
+    if(i % 16 == 0){
+      for(j = 0; j < sizeof(buffer); j++){
+        buffer[j] = rand();
+      }
+    }
+
+    expect = crc32_le_bitwise(0xffffffffUL, buffer + offset, len);
+    got    = crc32_le_getap(0xffffffffUL, buffer + offset, len);
+
+    if(expect != got){
+      fprintf(stderr, "crc: mismatch for %u bytes at offset %u: 0x%08x != 0x%08x\n", len, offset, got, expect);
+      return 1;
+    }
+  }
+
+  printf("crc: %u random frames match the bitwise routine\n", TEST_RUNS);
+
+  /* benchmark: random frame sizes between the minimum and the tap limit */
+
+  count = 0;
+  total = 0;
+  sizes = malloc(sizeof(unsigned int) * TEST_RUNS);
+  if(sizes == NULL){
+    return 1;
+  }
+  for(i = 0; i < TEST_RUNS; i++){
+    sizes[i] = 60 + (rand() % (TEST_MAX - 60 + 1));
+  }
+
+  sum = 0;
+  gettimeofday(&start, NULL);
+  for(i = 0; total < (BENCH_MB / 16) * 1024 * 1024; i = (i + 1) % TEST_RUNS){
+    sum ^= crc32_le_bitwise(0xffffffffUL, buffer, sizes[i]);
+    total += sizes[i];
+    count++;
+  }
+  slow = elapsed_ms(&start);
+  printf("crc: bitwise %u frames, %u bytes in %.1fms (%.1fMB/s)\n", count, total, slow, total / (slow * 1000.0));
+  slow = slow / total;
+
+  count = 0;
+  total = 0;
+  gettimeofday(&start, NULL);
+  for(i = 0; total < BENCH_MB * 1024 * 1024; i = (i + 1) % TEST_RUNS){
+    sum ^= crc32_le_getap(0xffffffffUL, buffer, sizes[i]);
+    total += sizes[i];
+    count++;
+  }
+  fast = elapsed_ms(&start);
+  printf("crc: %s %u frames, %u bytes in %.1fms (%.1fMB/s)\n",
+#ifdef CRC_ARM_ACLE
+    "armv8 crc32",
+#else
+    "slice by 8",
+#endif
+    count, total, fast, total / (fast * 1000.0));
+  fast = fast / total;
+
+  printf("crc: speedup %.1fx (checksum 0x%08x)\n", slow / fast, sum);
+
+  free(sizes);
+
+  return 0;
+}
+
+#endif
@@ -346,6 +346,9 @@ int register_hwmon_tbs(struct katcp_dispatch *d, char *label, char *desc, char *
   char *minptr = NULL;
   char *maxptr = NULL;  
   struct stat filestat;
+#ifdef KATCP_ASYNC_ACQUIRE
+  struct timeval timeout;
+#endif
 
   tr = get_mode_katcp(d, TBS_MODE_RAW);
   if (tr == NULL){
@@ -396,6 +399,14 @@ int register_hwmon_tbs(struct katcp_dispatch *d, char *label, char *desc, char *
     destroy_hwsensor_tbs(hs);
     return -1; 
   } 
+
+#ifdef KATCP_ASYNC_ACQUIRE
+  /* a wedged i2c bus should fail the sensor, not stall the server */
+  component_time_katcp(&timeout, TBS_HWMON_TIMEOUT);
+  if (async_acquire_katcp(d, a, &timeout) < 0){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "reading sensor %s in the main loop", label);
+  }
+#endif
   
 
 #if 0
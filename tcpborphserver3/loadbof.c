@@ -1,9 +1,14 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* F_SETPIPE_SZ */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <signal.h>
 
 #include <zlib.h>
 #if 0
@@ -12,8 +17,12 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/sendfile.h>
 
 #include <katcp.h>
+#include <katcl.h>
 #include <avltree.h>
 
 #include "tcpborphserver3.h"
@@ -476,6 +485,374 @@ int program_bof(struct katcp_dispatch *d, struct bof_state *bs, char *device)
 #undef BUFFER
 }
 
+/* pipelined programming, run in a subprocess: a helper process inflates  */
+/* the bitstream into a pipe (enlarged to act as the ring buffer) while    */
+/* this one drains it into the config device, so the two costs overlap    */
+
+#define PIPELINE_CHUNK   (256 * 1024)
+#define PIPELINE_RING   (1024 * 1024)
+#define PIPELINE_STEPS          8
+
+static int write_all_bof(int fd, char *buffer, int len)
+{
+  int have, wr;
+
+  have = 0;
+  while(have < len){
+    wr = write(fd, buffer + have, len - have);
+    if(wr < 0){
+      switch(errno){
+        case EAGAIN :
+        case EINTR  :
+          break;
+        default :
+          return -1;
+      }
+    } else if(wr == 0){
+      return -1;
+    } else {
+      have += wr;
+    }
+  }
+
+  return have;
+}
+
+static int inflate_bof(struct bof_state *bs, int fd)
+{
+  char *buffer;
+  unsigned long need;
+  int rr, can;
+
+  buffer = malloc(PIPELINE_CHUNK);
+  if(buffer == NULL){
+    return -1;
+  }
+
+  need = bs->b_bit_size;
+  while(need > 0){
+    can = (need > PIPELINE_CHUNK) ? PIPELINE_CHUNK : need;
+    rr = gzread(bs->b_gzf, buffer, can);
+    if(rr <= 0){
+      if((rr < 0) && ((errno == EAGAIN) || (errno == EINTR))){
+        continue;
+      }
+      free(buffer);
+      return -1;
+    }
+    if(write_all_bof(fd, buffer, rr) < 0){
+      free(buffer);
+      return -1;
+    }
+    need -= rr;
+  }
+
+  free(buffer);
+
+  return 0;
+}
+
+static void progress_bof(struct katcl_line *l, unsigned long done, unsigned long total)
+{
+  append_string_katcl(l, KATCP_FLAG_FIRST | KATCP_FLAG_STRING, TBS_FPGA_STATUS);
+  append_string_katcl(l, KATCP_FLAG_STRING, TBS_FPGA_PROGRESS);
+  append_unsigned_long_katcl(l, KATCP_FLAG_ULONG, done);
+  append_unsigned_long_katcl(l, KATCP_FLAG_LAST | KATCP_FLAG_ULONG, total);
+
+  while(write_katcl(l) == 0);
+}
+
+static int open_store_bof(struct katcl_line *l, char *store, char *part)
+{
+  int sfd;
+
+  if(store == NULL){
+    return -1;
+  }
+
+  if(snprintf(part, PATH_MAX, "%s.part", store) >= PATH_MAX){
+    return -1;
+  }
+
+  sfd = open(part, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+  if(sfd < 0){
+    sync_message_katcl(l, KATCP_LEVEL_WARN, TBS_FPGA_LABEL, "unable to cache bitstream in %s: %s", part, strerror(errno));
+    return -1;
+  }
+
+  return sfd;
+}
+
+/* store is optional, a copy of the inflated bitstream is kept there on success */
+
+int pipeline_bof(struct katcl_line *l, struct bof_state *bs, char *device, char *store)
+{
+  int dfd, sfd, pfds[2], rr, status, result;
+  unsigned long done, next, step;
+  struct timeval start, stop;
+  char *buffer;
+  char part[PATH_MAX];
+  pid_t pid;
+
+  gettimeofday(&start, NULL);
+
+  if(gzseek(bs->b_gzf, bs->b_bit_offset, SEEK_SET) != (bs->b_bit_offset)){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "seek to bitstream start at 0x%lx failed", bs->b_bit_offset);
+    return -1;
+  }
+
+#ifdef __PPC__
+  dfd = open(device, O_WRONLY);
+#else
+  dfd = open(device, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+#endif
+  if(dfd < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to open device %s: %s", device, strerror(errno));
+    return -1;
+  }
+
+  buffer = malloc(PIPELINE_CHUNK);
+  if(buffer == NULL){
+    close(dfd);
+    return -1;
+  }
+
+  if(pipe(pfds) < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to create pipe: %s", strerror(errno));
+    free(buffer);
+    close(dfd);
+    return -1;
+  }
+
+  sfd = open_store_bof(l, store, part);
+
+#ifdef F_SETPIPE_SZ
+  /* failure only means less overlap */
+  fcntl(pfds[1], F_SETPIPE_SZ, PIPELINE_RING);
+#endif
+
+  pid = fork();
+  if(pid < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to fork decompressor: %s", strerror(errno));
+    close(pfds[0]);
+    close(pfds[1]);
+    free(buffer);
+    close(dfd);
+    if(sfd >= 0){
+      close(sfd);
+      unlink(part);
+    }
+    return -1;
+  }
+
+  if(pid == 0){
+    close(pfds[0]);
+    close(dfd);
+    if(sfd >= 0){
+      close(sfd);
+    }
+    _exit((inflate_bof(bs, pfds[1]) < 0) ? 1 : 0);
+  }
+
+  close(pfds[1]);
+
+  sync_message_katcl(l, KATCP_LEVEL_INFO, TBS_FPGA_LABEL, "programming bitstream of %lu bytes to device %s", bs->b_bit_size, device);
+
+  step = (bs->b_bit_size / PIPELINE_STEPS) + 1;
+  next = step;
+  done = 0;
+
+  while(done < bs->b_bit_size){
+    rr = read(pfds[0], buffer, PIPELINE_CHUNK);
+    if(rr < 0){
+      if((errno == EAGAIN) || (errno == EINTR)){
+        continue;
+      }
+      break;
+    }
+    if(rr == 0){
+      break;
+    }
+
+    if(write_all_bof(dfd, buffer, rr) < 0){
+      sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "write to fpga failed after %lu bytes: %s", done, strerror(errno));
+      break;
+    }
+
+    /* the cache copy is a nicety, never hold up programming for it */
+    if((sfd >= 0) && (write_all_bof(sfd, buffer, rr) < 0)){
+      sync_message_katcl(l, KATCP_LEVEL_WARN, TBS_FPGA_LABEL, "abandoning bitstream cache copy: %s", strerror(errno));
+      close(sfd);
+      unlink(part);
+      sfd = (-1);
+    }
+
+    done += rr;
+    if((done >= next) || (done >= bs->b_bit_size)){
+      progress_bof(l, done, bs->b_bit_size);
+      next += step;
+    }
+  }
+
+  close(pfds[0]);
+  free(buffer);
+
+  if(done < bs->b_bit_size){
+    kill(pid, SIGTERM);
+  }
+
+  result = 0;
+
+  if((waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || WEXITSTATUS(status)){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "bitstream decompression failed");
+    result = (-1);
+  }
+
+  if(close(dfd) < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to program fpga: %s", strerror(errno));
+    result = (-1);
+  }
+
+  if(done < bs->b_bit_size){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "only loaded %lu of %lu bitstream bytes", done, bs->b_bit_size);
+    result = (-1);
+  }
+
+  if(sfd >= 0){
+    if((close(sfd) < 0) || (result < 0) || (rename(part, store) < 0)){
+      unlink(part);
+    }
+  }
+
+  if(result < 0){
+    return -1;
+  }
+
+  gettimeofday(&stop, NULL);
+
+  sync_message_katcl(l, KATCP_LEVEL_INFO, TBS_FPGA_LABEL, "programmed %lu bytes in %.3fs", done, (stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0));
+
+  return 0;
+}
+
+/* program an already inflated bitstream, the kernel moves the data */
+
+int copy_bitstream_bof(struct katcl_line *l, char *source, char *device)
+{
+  int sfd, dfd, result;
+  unsigned long done, next, step, total;
+  struct timeval start, stop;
+  struct stat st;
+  ssize_t rr;
+  char *buffer;
+
+  gettimeofday(&start, NULL);
+
+  sfd = open(source, O_RDONLY);
+  if(sfd < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to open cached bitstream %s: %s", source, strerror(errno));
+    return -1;
+  }
+
+  if(fstat(sfd, &st) < 0){
+    close(sfd);
+    return -1;
+  }
+
+  total = st.st_size;
+
+#ifdef __PPC__
+  dfd = open(device, O_WRONLY);
+#else
+  dfd = open(device, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+#endif
+  if(dfd < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to open device %s: %s", device, strerror(errno));
+    close(sfd);
+    return -1;
+  }
+
+  sync_message_katcl(l, KATCP_LEVEL_INFO, TBS_FPGA_LABEL, "programming cached bitstream of %lu bytes to device %s", total, device);
+
+  step = (total / PIPELINE_STEPS) + 1;
+  next = step;
+  done = 0;
+  buffer = NULL;
+
+  while(done < total){
+    if(buffer == NULL){
+      rr = sendfile(dfd, sfd, NULL, ((total - done) < PIPELINE_CHUNK) ? (total - done) : PIPELINE_CHUNK);
+      if(rr < 0){
+        if(errno == EINTR){
+          continue;
+        }
+        if((done > 0) || ((errno != EINVAL) && (errno != ENOSYS))){
+          break;
+        }
+        /* some drivers can not be spliced into, copy by hand */
+        buffer = malloc(PIPELINE_CHUNK);
+        if(buffer == NULL){
+          break;
+        }
+        continue;
+      }
+    } else {
+      rr = read(sfd, buffer, PIPELINE_CHUNK);
+      if(rr < 0){
+        if(errno == EINTR){
+          continue;
+        }
+        break;
+      }
+      if((rr > 0) && (write_all_bof(dfd, buffer, rr) < 0)){
+        break;
+      }
+    }
+
+    if(rr == 0){
+      break;
+    }
+
+    done += rr;
+    if((done >= next) || (done >= total)){
+      progress_bof(l, done, total);
+      next += step;
+    }
+  }
+
+  if(buffer){
+    free(buffer);
+  }
+
+  close(sfd);
+
+  result = 0;
+
+  if(done < total){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "only loaded %lu of %lu bitstream bytes: %s", done, total, strerror(errno));
+    result = (-1);
+  }
+
+  if(close(dfd) < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "unable to program fpga: %s", strerror(errno));
+    result = (-1);
+  }
+
+  if(result < 0){
+    return -1;
+  }
+
+  gettimeofday(&stop, NULL);
+
+  sync_message_katcl(l, KATCP_LEVEL_INFO, TBS_FPGA_LABEL, "programmed %lu cached bytes in %.3fs", done, (stop.tv_sec - start.tv_sec) + ((stop.tv_usec - start.tv_usec) / 1000000.0));
+
+  return 0;
+}
+
+#undef PIPELINE_CHUNK
+#undef PIPELINE_RING
+#undef PIPELINE_STEPS
+
 int index_bof(struct katcp_dispatch *d, struct bof_state *bs)
 {
   int rr;
@@ -8,6 +8,8 @@ struct bof_state *open_bof_fd(struct katcp_dispatch *d, int fd);
 void close_bof(struct katcp_dispatch *d, struct bof_state *bs);
 
 int program_bof(struct katcp_dispatch *d, struct bof_state *bs, char *device);
+int pipeline_bof(struct katcl_line *l, struct bof_state *bs, char *device, char *store);
+int copy_bitstream_bof(struct katcl_line *l, char *source, char *device);
 int index_bof(struct katcp_dispatch *d, struct bof_state *bs);
 
 #endif
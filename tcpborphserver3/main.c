@@ -32,6 +32,7 @@ void usage(char *app)
   " [-b bof-dir] [-f] [-h] [-i init-script] [-l log-file] [-m mode] [-p network-port]\n", app);
 
   printf("-b dir           directory containing bof files\n");
+  printf("-c dir           cache for unpacked images (default %s, empty to disable)\n", TBS_CACHE_PATH);
   printf("-f               run in foreground (default is background)\n");
   printf("-h               this help\n");
   printf("-i file          run the specified startup script\n");
@@ -46,7 +47,7 @@ int main(int argc, char **argv)
   struct katcp_dispatch *d;
   int status;
   int i, j, c, foreground, lfd;
-  char *port, *mode, *init, *lfile, *bofdir;
+  char *port, *mode, *init, *lfile, *bofdir, *cachedir;
   time_t now;
 
   port = "7147";
@@ -55,6 +56,7 @@ int main(int argc, char **argv)
   lfile = TBS_LOGFILE;
   foreground = 0;
   bofdir = NULL;
+  cachedir = TBS_CACHE_PATH;
 
   i = 1;
   j = 1;
@@ -79,6 +81,7 @@ int main(int argc, char **argv)
           break;
 
         case 'b' :
+        case 'c' :
         case 'i' :
         case 'l' :
         case 'm' :
@@ -95,6 +98,9 @@ int main(int argc, char **argv)
             case 'b' :
               bofdir = argv[i] + j;
               break;
+            case 'c' :
+              cachedir = argv[i] + j;
+              break;
             case 'i' :
               init = argv[i] + j;
               break;
@@ -142,6 +148,10 @@ int main(int argc, char **argv)
     return 1;
   }
 
+  if(setup_cache_tbs(d, cachedir, TBS_CACHE_LIMIT) < 0){
+    fprintf(stderr, "%s: unable to use %s as image cache, continuing without\n", argv[0], cachedir);
+  }
+
   /* mode from command line */
   if(mode){
     if(enter_name_mode_katcp(d, mode, NULL) < 0){
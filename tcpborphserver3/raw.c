@@ -938,28 +938,13 @@ void check_read_results(int *v, int floor)
 }
 #endif
 
-int read_register(struct katcp_dispatch *d, struct tbs_entry *te, struct katcl_byte_bit *start, struct katcl_byte_bit *amount, void *buffer, unsigned int size)
+int plan_register(struct katcp_dispatch *d, struct tbs_entry *te, struct katcl_byte_bit *start, struct katcl_byte_bit *amount, struct tbs_plan *tp)
 {
+  /* does all the checks and works out the shifts once, copy_register then only moves data */
   struct katcl_byte_bit sum, total, reg_len, reg_start, combined_start, limit;
   struct tbs_raw *tr;
-  unsigned int shift, grab_base, grab_offset, round_left;
-  unsigned long i, j;
-  uint32_t *ptr, prev, current, mask, tail_mask;
+  unsigned int round_left;
   int transfer;
-#ifdef PROFILE
-  struct timeval then, now, delta;
-
-  gettimeofday(&then, NULL);
-#endif
-
-#ifdef KATCP_CONSISTENCY_CHECKS
-  if(buffer == NULL){
-    return -1;
-  }
-  if(size <= 0){
-    return -1;
-  }
-#endif
 
   tr = get_mode_katcp(d, TBS_MODE_RAW);
   if(tr == NULL){
@@ -1040,10 +1025,6 @@ int read_register(struct katcp_dispatch *d, struct tbs_entry *te, struct katcl_b
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "zero read request length or request size wrapped");
     return KATCP_RESULT_FAIL;
   }
-  if(transfer > size){
-    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "supplied buffer of size %lu can not hold request %lu:%u", size, amount->b_byte, amount->b_bit);
-    return -1;
-  }
 
   /* work out memory locations */
   if(add_bb_katcl(&combined_start, &reg_start, start) < 0){
@@ -1052,34 +1033,86 @@ int read_register(struct katcp_dispatch *d, struct tbs_entry *te, struct katcl_b
   }
   word_normalise_bb_katcl(&combined_start);
 
+  tp->p_base = combined_start.b_byte;
+  tp->p_shift = combined_start.b_bit;
+  tp->p_bytes = amount->b_byte;
+  tp->p_bits = amount->b_bit;
+  tp->p_round = round_left;
+  tp->p_transfer = transfer;
 
-  if(combined_start.b_bit == 0){
-
+  if(tp->p_shift == 0){
     /* FAST: no bit offset => no shifts needed */
     log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "fast read start at %u:%u of 0x%x:%u maps to pos 0x%x:%u copied into %u bytes", start->b_byte, start->b_bit, amount->b_byte, amount->b_bit, combined_start.b_byte, combined_start.b_bit, transfer);
 
+    tp->p_grab_base = 0;
+    tp->p_grab_offset = 0;
+    tp->p_mask = 0;
+    tp->p_tail_mask = amount->b_bit ? (~(0xffffffff >> (amount->b_bit))) : 0;
+
+    return transfer;
+  }
+
+  /* COMPLEX: start at bit offset, read arb bytes and bits => shift, then copy */
+
+  tp->p_grab_base = amount->b_byte;
+  tp->p_grab_offset = combined_start.b_bit + amount->b_bit;
+
+  if(tp->p_grab_offset > 32){
+    tp->p_grab_offset -= 32;
+    tp->p_grab_base += 4;
+  }
+
+  tp->p_mask = ~(0xffffffff << tp->p_shift);
+  tp->p_tail_mask = 0;
+
+  if(tp->p_grab_offset){
+    if(tp->p_grab_base > 0){
+      tp->p_tail_mask = 0xffffffff << (32 - tp->p_grab_offset);
+    } else {
+#ifdef KATCP_CONSISTENCY_CHECKS
+      if(tp->p_shift > tp->p_grab_offset){
+        fprintf(stderr, "read: expected at least one bit (shifted %u bits, last data bit %u", tp->p_shift, tp->p_grab_offset);
+        abort();
+      }
+#endif
+      tp->p_tail_mask = 0xffffffff << (32 - (tp->p_grab_offset - tp->p_shift));
+    }
+  }
+
+  log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read starting at %u:%u of 0x%x:%u maps to pos 0x%x:%u with grab %u:%u shifted by %u (mask 0x%08x, tail 0x%08x) copied into %u bytes", start->b_byte, start->b_bit, amount->b_byte, amount->b_bit, combined_start.b_byte, combined_start.b_bit, tp->p_grab_base, tp->p_grab_offset, tp->p_shift, tp->p_mask, tp->p_tail_mask, transfer);
+
+  return transfer;
+}
+
+void copy_register(struct tbs_raw *tr, struct tbs_plan *tp, void *buffer)
+{
+  unsigned long i, j;
+  uint32_t *ptr, prev, current;
+
+  if(tp->p_shift == 0){
+
 #ifdef USE_MEMCPY
-    if(amount->b_bit > 0){
-      memcpy(buffer, tr->r_map + combined.start.b_byte, transfer);
-      buffer[amount->b_byte + amount->b_bit / 8] &= (~(0xff >> (amount->b_bit % 8)));
+    if(tp->p_bits > 0){
+      memcpy(buffer, tr->r_map + tp->p_base, tp->p_transfer);
+      buffer[tp->p_bytes + tp->p_bits / 8] &= (~(0xff >> (tp->p_bits % 8)));
     } else {
-      memcpy(buffer, tr->r_map + combined.start.b_byte, transfer);
+      memcpy(buffer, tr->r_map + tp->p_base, tp->p_transfer);
     }
 #else 
     /* WTF moments right here: FPGA 32 bit issues */
-    for(i = 0; i < amount->b_byte; i += 4){
-      current = *((uint32_t *)(tr->r_map + combined_start.b_byte + i));
+    for(i = 0; i < tp->p_bytes; i += 4){
+      current = *((uint32_t *)(tr->r_map + tp->p_base + i));
       memcpy(buffer + i, &current, 4);
     }
-    if(amount->b_bit){
-      current = *((uint32_t *)(tr->r_map + combined_start.b_byte + i));
-      current = current & (~(0xffffffff >> (amount->b_bit)));
-      memcpy(buffer + i, &current, round_left);
+    if(tp->p_bits){
+      current = *((uint32_t *)(tr->r_map + tp->p_base + i));
+      current = current & tp->p_tail_mask;
+      memcpy(buffer + i, &current, tp->p_round);
     }
 
 #ifdef KATCP_CONSISTENCY_CHECKS
-    if((i + round_left) != transfer){
-      fprintf(stderr, "read: read the incorrect number of bytes, needed %d\n", transfer);
+    if((i + tp->p_round) != tp->p_transfer){
+      fprintf(stderr, "read: read the incorrect number of bytes, needed %d\n", tp->p_transfer);
       abort();
     }
 #endif
@@ -1087,70 +1120,75 @@ int read_register(struct katcp_dispatch *d, struct tbs_entry *te, struct katcl_b
 #endif
 
     /* END easy case */
-    return transfer;
-  }
-
-  /* COMPLEX: start at bit offset, read arb bytes and bits => shift, then copy */
-
-  shift = combined_start.b_bit;
-  grab_base = amount->b_byte;
-  grab_offset = combined_start.b_bit + amount->b_bit;
-
-  if(grab_offset > 32){
-    grab_offset -= 32;
-    grab_base += 4;
+    return;
   }
 
-  log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read starting at %u:%u of 0x%x:%u maps to pos 0x%x:%u with grab %u:%u shifted by %u copied into %u bytes", start->b_byte, start->b_bit, amount->b_byte, amount->b_bit, combined_start.b_byte, combined_start.b_bit, grab_base, grab_offset, shift, transfer);
-
-  mask = ~(0xffffffff << shift);
-  ptr = (uint32_t *)(tr->r_map + combined_start.b_byte);
+  ptr = (uint32_t *)(tr->r_map + tp->p_base);
 
-  prev = (ptr[0]) << shift;
+  prev = (ptr[0]) << tp->p_shift;
   j = 1;
   i = 0;
 
-  log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read, partial first byte shifted is now 0x%08x (shift %u, mask 0x%08x)", prev, shift, mask);
-
-  while(i < grab_base){
-    current = ptr[j];
-
-    current = prev | (mask & (ptr[j] >> (32 - shift)));
+  while(i < tp->p_grab_base){
+    current = prev | (tp->p_mask & (ptr[j] >> (32 - tp->p_shift)));
     memcpy(buffer + i, &current, 4);
 
-    prev = current << shift;
+    prev = current << tp->p_shift;
 
     j++;
 
     i += 4;
   }
 
-  if(grab_offset){
+  if(tp->p_grab_offset){
 
-    if(grab_base > 0){
-      tail_mask = 0xffffffff << (32 - grab_offset);
-      current = (prev | (mask & ((ptr[j] & tail_mask) >> (32 - shift))));
+    if(tp->p_grab_base > 0){
+      current = (prev | (tp->p_mask & ((ptr[j] & tp->p_tail_mask) >> (32 - tp->p_shift))));
     } else {
-#ifdef KATCP_CONSISTENCY_CHECKS
-      if(shift > grab_offset){
-        fprintf(stderr, "read: expected at least one bit (shifted %u bits, last data bit %u", shift, grab_offset);
-        abort();
-      }
-#endif
-      tail_mask = 0xffffffff << (32 - (grab_offset - shift));
-      current = prev & tail_mask;
+      current = prev & tp->p_tail_mask;
     }
-    memcpy(buffer + i, &current, round_left);
+    memcpy(buffer + i, &current, tp->p_round);
 #ifdef KATCP_CONSISTENCY_CHECKS
-    if((i + round_left) != transfer){
-      fprintf(stderr, "read: read the incorrect number of bytes, needed %d\n", transfer);
+    if((i + tp->p_round) != tp->p_transfer){
+      fprintf(stderr, "read: read the incorrect number of bytes, needed %d\n", tp->p_transfer);
       abort();
     }
 #endif
+  }
+}
+
+int read_register(struct katcp_dispatch *d, struct tbs_entry *te, struct katcl_byte_bit *start, struct katcl_byte_bit *amount, void *buffer, unsigned int size)
+{
+  struct tbs_plan plan;
+  struct tbs_raw *tr;
+  int transfer;
+
+#ifdef KATCP_CONSISTENCY_CHECKS
+  if(buffer == NULL){
+    return -1;
+  }
+  if(size <= 0){
+    return -1;
+  }
+#endif
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return -1;
+  }
 
-    log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read, final word %u needs mask 0x%08x, prev is 0x%08x, result is 0x%08x", i, tail_mask, prev, current);
+  transfer = plan_register(d, te, start, amount, &plan);
+  if(transfer <= 0){
+    return -1;
   }
 
+  if(transfer > size){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "supplied buffer of size %lu can not hold request %lu:%u", size, amount->b_byte, amount->b_bit);
+    return -1;
+  }
+
+  copy_register(tr, &plan, buffer);
+
   return transfer;
 }
 
@@ -1382,55 +1420,491 @@ int read_cmd(struct katcp_dispatch *d, int argc)
     grab_base++;
   }
 
-  mask = ~(0xff << shift);
-  j = combined_base;
+  mask = ~(0xff << shift);
+  j = combined_base;
+
+  prev = (ptr[j]) << shift;
+  j++;
+
+  i = 0;
+
+  log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read, partial first byte shifted is now 0x%02x (shift %u, mask 0x%02x)", prev, shift, mask);
+
+  while(i < grab_base){
+    current = ptr[j];
+
+    buffer[i] = prev | (mask & (current >> (8 - shift)));
+
+    prev = current << shift;
+
+    i++;
+    j++;
+  }
+
+  if(want_offset){
+    tail_mask = 0xff << (8 - want_offset);
+
+    if(grab_base > 0){
+      current = ptr[j];
+      buffer[i] = (prev | (mask & (current >> (8 - shift)))) & tail_mask;
+    } else {
+      buffer[i] = prev & tail_mask;
+    }
+
+    log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read, final byte (%u) needs mask 0x%02x, prev is 0x%02x, result is 0x%02x", i, tail_mask, prev, buffer[i]);
+
+    i++;
+  }
+
+  results[0] = prepend_reply_katcp(d);
+  results[1] = append_string_katcp(d, KATCP_FLAG_STRING, KATCP_OK);
+  results[2] = append_buffer_katcp(d, KATCP_FLAG_BUFFER | KATCP_FLAG_LAST, buffer, i);
+
+  free(buffer);
+
+#ifdef DEBUG
+  check_read_results(results, want_base + 1);
+#endif
+  check_bus_error(d);
+
+  return KATCP_RESULT_OWN;
+#endif
+}
+
+/* read several registers in one request *********************************/
+
+#define TBS_READ_SEPARATOR ':'
+
+struct tbs_span
+{
+  struct tbs_entry *s_entry;
+  struct katcl_byte_bit s_start;
+  struct katcl_byte_bit s_amount;
+  unsigned int s_size;
+  struct tbs_plan s_plan;
+};
+
+static int resolve_span_tbs(struct katcp_dispatch *d, struct tbs_raw *tr, char *spec, struct tbs_span *ts)
+{
+  /* spec is name[:byte-offset[:byte-length]], the length defaults to the rest of the register */
+  char *name, *ptr, *end;
+  unsigned long offset, length;
+  int have;
+
+  name = strdup(spec);
+  if(name == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to duplicate %s", spec);
+    return -1;
+  }
+
+  offset = 0;
+  length = 0;
+  have = 0;
+
+  ptr = strchr(name, TBS_READ_SEPARATOR);
+  if(ptr){
+    *ptr = '\0';
+    ptr++;
+    offset = strtoul(ptr, &end, 0);
+    if(end == ptr){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to parse offset in %s", spec);
+      free(name);
+      return -1;
+    }
+    if(*end == TBS_READ_SEPARATOR){
+      ptr = end + 1;
+      length = strtoul(ptr, &end, 0);
+      if((end == ptr) || (length == 0)){
+        log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to parse a nonzero length in %s", spec);
+        free(name);
+        return -1;
+      }
+      have = 1;
+    }
+    if(*end != '\0'){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "trailing garbage in %s", spec);
+      free(name);
+      return -1;
+    }
+  }
+
+  ts->s_entry = find_data_avltree(tr->r_registers, name);
+  if(ts->s_entry == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register %s not defined", name);
+    free(name);
+    return -1;
+  }
+
+  if(!(ts->s_entry->e_mode & TBS_READABLE)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register %s is not marked readable", name);
+    free(name);
+    return -1;
+  }
+
+  free(name);
+
+  make_bb_katcl(&(ts->s_start), offset, 0);
+  word_normalise_bb_katcl(&(ts->s_start));
+
+  if(have){
+    make_bb_katcl(&(ts->s_amount), length, 0);
+  } else {
+    if(offset >= ts->s_entry->e_len_base){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "offset in %s is beyond the end of the register", spec);
+      return -1;
+    }
+    make_bb_katcl(&(ts->s_amount), ts->s_entry->e_len_base - offset, ts->s_entry->e_len_offset);
+  }
+  word_normalise_bb_katcl(&(ts->s_amount));
+
+  ts->s_size = ts->s_amount.b_byte + ((ts->s_amount.b_bit + 7) / 8);
+
+  if(plan_register(d, ts->s_entry, &(ts->s_start), &(ts->s_amount), &(ts->s_plan)) != ts->s_size){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to read %s", spec);
+    return -1;
+  }
+
+  return 0;
+}
+
+int read_many_cmd(struct katcp_dispatch *d, int argc)
+{
+  struct tbs_raw *tr;
+  struct tbs_span *vector;
+  struct timeval before, after, delta;
+  char *spec, *ptr;
+  unsigned int i, first, count;
+  size_t space, used;
+  int snapshot, results[3];
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(tr->r_fpga != TBS_FPGA_READY){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga not programmed");
+    return KATCP_RESULT_FAIL;
+  }
+
+  first = 1;
+  snapshot = 0;
+
+  if(argc > 1){
+    spec = arg_string_katcp(d, 1);
+    if(spec && !strcmp(spec, "-snapshot")){
+      snapshot = 1;
+      first++;
+    }
+  }
+
+  if(argc <= first){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "need at least one register to read, optionally followed by :byte-offset:byte-length");
+    return KATCP_RESULT_INVALID;
+  }
+
+  count = argc - first;
+
+  vector = malloc(sizeof(struct tbs_span) * count);
+  if(vector == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate %u read spans", count);
+    return KATCP_RESULT_FAIL;
+  }
+
+  /* resolve and plan everything up front, so that the reads themselves happen back to back */
+
+  space = 0;
+  for(i = 0; i < count; i++){
+    spec = arg_string_katcp(d, first + i);
+    if(spec == NULL){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register name %u inaccessible", i);
+      free(vector);
+      return KATCP_RESULT_FAIL;
+    }
+    if(resolve_span_tbs(d, tr, spec, &(vector[i])) < 0){
+      free(vector);
+      return KATCP_RESULT_FAIL;
+    }
+    if(vector[i].s_size > (TBS_READ_LIMIT - space)){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "reads would exceed limit of %u bytes at %s", TBS_READ_LIMIT, spec);
+      free(vector);
+      return KATCP_RESULT_FAIL;
+    }
+    space += vector[i].s_size;
+  }
+
+  ptr = malloc(space);
+  if(ptr == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate %lu bytes", (unsigned long)space);
+    free(vector);
+    return KATCP_RESULT_FAIL;
+  }
+
+  gettimeofday(&before, NULL);
+
+  used = 0;
+  for(i = 0; i < count; i++){
+    copy_register(tr, &(vector[i].s_plan), ptr + used);
+    used += vector[i].s_size;
+  }
+
+  if(snapshot){
+    gettimeofday(&after, NULL);
+    sub_time_katcp(&delta, &after, &before);
+    log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "sampled %u registers in %lu.%06lus", count, delta.tv_sec, delta.tv_usec);
+  }
+
+  free(vector);
+
+  results[0] = prepend_reply_katcp(d);
+  results[1] = append_string_katcp(d, KATCP_FLAG_STRING, KATCP_OK);
+  if(snapshot){
+    append_args_katcp(d, 0, "%lu%03lu", before.tv_sec, before.tv_usec / 1000);
+  }
+  results[2] = append_buffer_katcp(d, KATCP_FLAG_BUFFER | KATCP_FLAG_LAST, ptr, used);
+
+  free(ptr);
+
+#ifdef DEBUG
+  check_read_results(results, used + 1);
+#endif
+  check_bus_error(d);
+
+  return KATCP_RESULT_OWN;
+}
+
+/* register sets, resolved and planned once, read often ******************/
+
+void free_regset(void *data)
+{
+  struct tbs_regset *tg;
+
+  tg = data;
+  if(tg == NULL){
+    return;
+  }
+
+  if(tg->g_plans){
+    free(tg->g_plans);
+    tg->g_plans = NULL;
+  }
+
+  if(tg->g_buffer){
+    free(tg->g_buffer);
+    tg->g_buffer = NULL;
+  }
+
+  free(tg);
+}
+
+void print_regset(struct katcp_dispatch *d, char *key, void *data)
+{
+  struct tbs_regset *tg;
+
+  tg = data;
+  if(tg){
+    prepend_inform_katcp(d);
+    append_string_katcp(d, KATCP_FLAG_STRING, key);
+    append_unsigned_long_katcp(d, KATCP_FLAG_ULONG, tg->g_count);
+    append_unsigned_long_katcp(d, KATCP_FLAG_ULONG | KATCP_FLAG_LAST, tg->g_size);
+  }
+}
+
+int regset_define_cmd(struct katcp_dispatch *d, int argc)
+{
+  struct tbs_raw *tr;
+  struct tbs_regset *tg;
+  struct tbs_span span;
+  char *name, *spec;
+  unsigned int i;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(tr->r_fpga != TBS_FPGA_READY){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga not programmed");
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(argc <= 2){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "need a set name followed by registers, optionally followed by :byte-offset:byte-length");
+    return KATCP_RESULT_INVALID;
+  }
+
+  name = arg_string_katcp(d, 1);
+  if(name == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "set name inaccessible");
+    return KATCP_RESULT_FAIL;
+  }
+
+  tg = malloc(sizeof(struct tbs_regset));
+  if(tg == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate register set");
+    return KATCP_RESULT_FAIL;
+  }
+
+  tg->g_count = argc - 2;
+  tg->g_size = 0;
+  tg->g_buffer = NULL;
+
+  tg->g_plans = malloc(sizeof(struct tbs_plan) * tg->g_count);
+  if(tg->g_plans == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate %u read plans", tg->g_count);
+    free_regset(tg);
+    return KATCP_RESULT_FAIL;
+  }
+
+  for(i = 0; i < tg->g_count; i++){
+    spec = arg_string_katcp(d, 2 + i);
+    if(spec == NULL){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register name %u inaccessible", i);
+      free_regset(tg);
+      return KATCP_RESULT_FAIL;
+    }
+    if(resolve_span_tbs(d, tr, spec, &span) < 0){
+      free_regset(tg);
+      return KATCP_RESULT_FAIL;
+    }
+    if(span.s_size > (TBS_READ_LIMIT - tg->g_size)){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register set would exceed limit of %u bytes at %s", TBS_READ_LIMIT, spec);
+      free_regset(tg);
+      return KATCP_RESULT_FAIL;
+    }
+    tg->g_plans[i] = span.s_plan;
+    tg->g_size += span.s_size;
+  }
+
+  tg->g_buffer = malloc(tg->g_size);
+  if(tg->g_buffer == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate %lu bytes", (unsigned long)tg->g_size);
+    free_regset(tg);
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(tr->r_regsets == NULL){
+    tr->r_regsets = create_avltree();
+    if(tr->r_regsets == NULL){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create register set lookup structure");
+      free_regset(tg);
+      return KATCP_RESULT_FAIL;
+    }
+  }
+
+  if(find_data_avltree(tr->r_regsets, name)){
+    log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "replacing register set %s", name);
+    del_name_node_avltree(tr->r_regsets, name, &free_regset);
+  }
+
+  if(store_named_node_avltree(tr->r_regsets, name, tg) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to store register set %s", name);
+    free_regset(tg);
+    return KATCP_RESULT_FAIL;
+  }
+
+  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "register set %s reads %u registers into %lu bytes", name, tg->g_count, (unsigned long)tg->g_size);
+
+  return KATCP_RESULT_OK;
+}
+
+int regset_read_cmd(struct katcp_dispatch *d, int argc)
+{
+  struct tbs_raw *tr;
+  struct tbs_regset *tg;
+  struct timeval now;
+  char *name;
+  unsigned int i;
+  size_t used;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(tr->r_fpga != TBS_FPGA_READY){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga not programmed");
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(argc <= 1){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "need a register set to read");
+    return KATCP_RESULT_INVALID;
+  }
+
+  name = arg_string_katcp(d, 1);
+  if(name == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "set name inaccessible");
+    return KATCP_RESULT_FAIL;
+  }
+
+  tg = (tr->r_regsets) ? find_data_avltree(tr->r_regsets, name) : NULL;
+  if(tg == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register set %s not defined", name);
+    return KATCP_RESULT_FAIL;
+  }
 
-  prev = (ptr[j]) << shift;
-  j++;
+  gettimeofday(&now, NULL);
 
-  i = 0;
+  used = 0;
+  for(i = 0; i < tg->g_count; i++){
+    copy_register(tr, &(tg->g_plans[i]), tg->g_buffer + used);
+    used += tg->g_plans[i].p_transfer;
+  }
 
-  log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read, partial first byte shifted is now 0x%02x (shift %u, mask 0x%02x)", prev, shift, mask);
+  prepend_reply_katcp(d);
+  append_string_katcp(d, KATCP_FLAG_STRING, KATCP_OK);
+  append_args_katcp(d, 0, "%lu%03lu", now.tv_sec, now.tv_usec / 1000);
+  append_buffer_katcp(d, KATCP_FLAG_BUFFER | KATCP_FLAG_LAST, tg->g_buffer, used);
 
-  while(i < grab_base){
-    current = ptr[j];
+  check_bus_error(d);
 
-    buffer[i] = prev | (mask & (current >> (8 - shift)));
+  return KATCP_RESULT_OWN;
+}
 
-    prev = current << shift;
+int regset_delete_cmd(struct katcp_dispatch *d, int argc)
+{
+  struct tbs_raw *tr;
+  char *name;
 
-    i++;
-    j++;
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return KATCP_RESULT_FAIL;
   }
 
-  if(want_offset){
-    tail_mask = 0xff << (8 - want_offset);
-
-    if(grab_base > 0){
-      current = ptr[j];
-      buffer[i] = (prev | (mask & (current >> (8 - shift)))) & tail_mask;
-    } else {
-      buffer[i] = prev & tail_mask;
-    }
+  if(argc <= 1){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "need a register set to delete");
+    return KATCP_RESULT_INVALID;
+  }
 
-    log_message_katcp(d, KATCP_LEVEL_TRACE, NULL, "complex read, final byte (%u) needs mask 0x%02x, prev is 0x%02x, result is 0x%02x", i, tail_mask, prev, buffer[i]);
+  name = arg_string_katcp(d, 1);
+  if(name == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "set name inaccessible");
+    return KATCP_RESULT_FAIL;
+  }
 
-    i++;
+  if((tr->r_regsets == NULL) || (del_name_node_avltree(tr->r_regsets, name, &free_regset) < 0)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register set %s not defined", name);
+    return KATCP_RESULT_FAIL;
   }
 
-  results[0] = prepend_reply_katcp(d);
-  results[1] = append_string_katcp(d, KATCP_FLAG_STRING, KATCP_OK);
-  results[2] = append_buffer_katcp(d, KATCP_FLAG_BUFFER | KATCP_FLAG_LAST, buffer, i);
+  return KATCP_RESULT_OK;
+}
 
-  free(buffer);
+int regset_list_cmd(struct katcp_dispatch *d, int argc)
+{
+  struct tbs_raw *tr;
 
-#ifdef DEBUG
-  check_read_results(results, want_base + 1);
-#endif
-  check_bus_error(d);
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return KATCP_RESULT_FAIL;
+  }
 
-  return KATCP_RESULT_OWN;
-#endif
+  if(tr->r_regsets != NULL){
+    print_inorder_avltree(d, tr->r_regsets->t_root, &print_regset, 0);
+  }
+
+  return KATCP_RESULT_OK;
 }
 
 /************************************************************************/
@@ -1534,6 +2008,7 @@ int progdev_cmd(struct katcp_dispatch *d, int argc)
   struct bof_state *bs;
   struct tbs_raw *tr;
   char *buffer;
+  char key[TBS_CACHE_KEY];
   int len, type, status;
   struct katcp_dispatch *dl;
   struct katcp_job *j;
@@ -1547,11 +2022,18 @@ int progdev_cmd(struct katcp_dispatch *d, int argc)
   }
 
   nx = find_notice_katcp(d, TBS_KCPFPG_PATH);
+  if(nx == NULL){
+    nx = find_notice_katcp(d, TBS_FPGA_LABEL);
+  }
   if(nx){
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "not proceeding with programming as another instance is already in flight");
     return KATCP_RESULT_FAIL;
   }
 
+  if(programming_busy_tbs(d)){
+    return KATCP_RESULT_FAIL;
+  }
+
   stop_fpga_tbs(d);
 
   if(argc <= 1){
@@ -1588,12 +2070,20 @@ int progdev_cmd(struct katcp_dispatch *d, int argc)
   switch(type){
 
     case TBS_FORMAT_BOF :
+      /* an image seen before skips decompression and register parsing */
+      if((key_cache_tbs(d, buffer, key) == 0) && have_cache_tbs(d, key)){
+        log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "using cached bitstream %s for %s", key, file);
+        if(launch_bof_tbs(d, NULL, file, key) == 0){
+          status = KATCP_RESULT_PAUSE;
+          break;
+        }
+        /* stale entries are dropped by the launch, fall back to the image */
+      }
       bs = open_bof(d, buffer);
       if(bs){
-        if(start_bof_tbs(d, bs) == 0){
-          tr->r_image = strdup(file);
-          /* WARNING: no check here as this failure is survivable */
-          status = KATCP_RESULT_OK; /* success */
+        /* programmed in a subprocess, completion sets r_image and resumes us */
+        if(launch_bof_tbs(d, bs, file, key) == 0){
+          status = KATCP_RESULT_PAUSE;
         } else {
           log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to program fpga using %s", file);
         }
@@ -2036,6 +2526,12 @@ int stop_fpga_tbs(struct katcp_dispatch *d)
     return -1;
   }
 
+  /* the streaming child would go on reading an unconfigured or different design */
+  if(find_notice_katcp(d, TBS_READREMOTE_LABEL)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register stream still in progress, refusing to stop fpga");
+    return -1;
+  }
+
   result = 0;
 
   stop_all_getap(d, 0);
@@ -2083,6 +2579,14 @@ int stop_fpga_tbs(struct katcp_dispatch *d)
     tr->r_meta = NULL;
   }
 
+  if(tr->r_regsets){
+    destroy_avltree(tr->r_regsets, &free_regset);
+    log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "deallocated register sets");
+    tr->r_regsets = NULL;
+  }
+
+  tr->r_serial++;
+
   return result;
 }
 
@@ -2101,7 +2605,7 @@ int start_fpg_tbs(struct katcp_dispatch *d)
     return -1;
   }
 
-  tr->r_registers = create_avltree();
+  tr->r_registers = create_indexed_avltree();
   if(tr->r_registers == NULL){
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create register lookup structure");
     return -1;
@@ -2165,7 +2669,7 @@ int start_bof_tbs(struct katcp_dispatch *d, struct bof_state *bs)
     return -1;
   }
 
-  tr->r_registers = create_avltree();
+  tr->r_registers = create_indexed_avltree();
   if(tr->r_registers == NULL){
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create register lookup structure");
     return -1;
@@ -2192,6 +2696,326 @@ int start_bof_tbs(struct katcp_dispatch *d, struct bof_state *bs)
   return 0;
 }
 
+/* programming off the main loop ************************************/
+
+static void destroy_program_data_tbs(struct tbs_program_data *pg)
+{
+  if(pg == NULL){
+    return;
+  }
+
+  if(pg->g_image){
+    free(pg->g_image);
+    pg->g_image = NULL;
+  }
+
+  if(pg->g_source){
+    free(pg->g_source);
+    pg->g_source = NULL;
+  }
+
+  if(pg->g_store){
+    free(pg->g_store);
+    pg->g_store = NULL;
+  }
+
+  if(pg->g_cache_dir){
+    free(pg->g_cache_dir);
+    pg->g_cache_dir = NULL;
+  }
+
+  pg->g_bof = NULL;
+
+  free(pg);
+}
+
+static int subprocess_program_tbs(struct katcl_line *l, void *data)
+{
+  struct tbs_program_data *pg;
+
+  int result;
+
+  pg = data;
+
+  if((pg == NULL) || ((pg->g_bof == NULL) && (pg->g_source == NULL))){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_FPGA_LABEL, "no bitstream supplied to subordinate logic");
+    return -1;
+  }
+
+  /* yield to the main loop, it has clients to serve */
+  if(nice(TBS_PROGRAM_NICE) < 0){
+    sync_message_katcl(l, KATCP_LEVEL_DEBUG, TBS_FPGA_LABEL, "unable to lower priority: %s", strerror(errno));
+  }
+
+  if(pg->g_source){
+    return copy_bitstream_bof(l, pg->g_source, TBS_FPGA_CONFIG);
+  }
+
+  result = pipeline_bof(l, pg->g_bof, TBS_FPGA_CONFIG, pg->g_store);
+
+  /* fpga is done by now, tidy the cache while we still own the cpu time */
+  if((result == 0) && pg->g_store && pg->g_cache_dir){
+    evict_cache_tbs(l, pg->g_cache_dir, pg->g_cache_limit, pg->g_key);
+  }
+
+  return result;
+}
+
+static int progress_program_tbs(struct katcp_dispatch *d, struct katcp_notice *n, void *data)
+{
+  struct katcl_parse *p;
+  char *inform;
+
+  p = get_parse_notice_katcp(d, n);
+  if(p == NULL){
+    return 0;
+  }
+
+  inform = get_string_parse_katcl(p, 0);
+  if((inform == NULL) || strcmp(inform, TBS_FPGA_STATUS)){
+    return 0;
+  }
+
+  relay_inform_katcp(d, p);
+
+  return 1;
+}
+
+static int complete_program_tbs(struct katcp_dispatch *d, struct katcp_notice *n, void *data)
+{
+  struct tbs_program_data *pg;
+  struct tbs_raw *tr;
+  struct timeval now, delta;
+
+  pg = data;
+  if(pg == NULL){
+#ifdef KATCP_CONSISTENCY_CHECKS
+    fprintf(stderr, "logic problem: no programming state given to handler\n");
+    abort();
+#endif
+    return -1;
+  }
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    destroy_program_data_tbs(pg);
+    return -1;
+  }
+
+  if((tr->r_serial != pg->g_serial) || (tr->r_registers != pg->g_registers) || (tr->r_fpga != TBS_FPGA_DOWN)){
+    /* somebody else stopped or reloaded the fpga in the meantime, their state is not ours to map or tear down */
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga state changed while programming %s, not using it", pg->g_image);
+    destroy_program_data_tbs(pg);
+    return 0;
+  }
+
+  if(transfer_status_tbs(d, n) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to program fpga using %s", pg->g_image);
+    if(pg->g_store || pg->g_source){
+      /* a cached copy which does not program is worse than none */
+      forget_cache_tbs(d, pg->g_key);
+    }
+    stop_fpga_tbs(d);
+    destroy_program_data_tbs(pg);
+    return 0;
+  }
+
+  status_fpga_tbs(d, TBS_FPGA_PROGRAMMED);
+
+  if(map_raw_tbs(d) < 0){
+    stop_fpga_tbs(d);
+    destroy_program_data_tbs(pg);
+    return 0;
+  }
+
+  status_fpga_tbs(d, TBS_FPGA_READY);
+
+  if(tr->r_image){
+    free(tr->r_image);
+  }
+  tr->r_image = pg->g_image;
+  pg->g_image = NULL;
+
+  gettimeofday(&now, NULL);
+  sub_time_katcp(&delta, &now, &(pg->g_start));
+
+  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "fpga ready with %s after %lu.%06lus", tr->r_image, delta.tv_sec, delta.tv_usec);
+
+  destroy_program_data_tbs(pg);
+
+  return 0;
+}
+
+/* undo a launch whose child never got going, else the notice stays registered and blocks all later attempts */
+static void abandon_program_tbs(struct katcp_dispatch *d, struct katcp_dispatch *dl, struct katcp_notice *nx, struct tbs_program_data *pg, int resume)
+{
+  if(resume){
+    remove_notice_katcp(d, nx, &upload_generic_resume_tbs, NULL);
+  }
+
+  remove_notice_katcp(dl, nx, &complete_program_tbs, pg);
+
+  stop_fpga_tbs(d);
+  destroy_program_data_tbs(pg);
+}
+
+/* returns 0 if the subprocess was started and the request should pause. A
+ * NULL bs programs the cache entry for key, a non-empty key with a bs fills it */
+
+int launch_bof_tbs(struct katcp_dispatch *d, struct bof_state *bs, char *image, char *key)
+{
+  struct tbs_raw *tr;
+  struct tbs_program_data *pg;
+  struct katcp_dispatch *dl;
+  struct katcp_notice *nx;
+  struct katcp_url *url;
+  struct katcp_job *j;
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    log_message_katcp(d, KATCP_LEVEL_FATAL, NULL, "unable to acquire state");
+    return -1;
+  }
+
+  dl = template_shared_katcp(d);
+  if(dl == NULL){
+    return -1;
+  }
+
+  if((tr->r_registers)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga seems already programmed");
+    return -1;
+  }
+
+  if(find_notice_katcp(d, TBS_FPGA_LABEL)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga programming already in progress");
+    return -1;
+  }
+
+  pg = malloc(sizeof(struct tbs_program_data));
+  if(pg == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate programming state");
+    return -1;
+  }
+
+  pg->g_bof = bs;
+  pg->g_image = strdup(image);
+  pg->g_source = NULL;
+  pg->g_store = NULL;
+  pg->g_cache_dir = NULL;
+  pg->g_cache_limit = tr->r_cache_limit;
+  pg->g_key[0] = '\0';
+  pg->g_registers = NULL;
+  pg->g_serial = 0;
+  gettimeofday(&(pg->g_start), NULL);
+
+  if(pg->g_image == NULL){
+    destroy_program_data_tbs(pg);
+    return -1;
+  }
+
+  if(key && key[0] && tr->r_cache_dir){
+    strncpy(pg->g_key, key, TBS_CACHE_KEY - 1);
+    pg->g_key[TBS_CACHE_KEY - 1] = '\0';
+  }
+
+  if((bs == NULL) && (pg->g_key[0] == '\0')){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "no image or cache entry to program");
+    destroy_program_data_tbs(pg);
+    return -1;
+  }
+
+  /* the register table precedes the bitstream, so read it now without seeking back later */
+  tr->r_registers = create_indexed_avltree();
+  if(tr->r_registers == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create register lookup structure");
+    destroy_program_data_tbs(pg);
+    return -1;
+  }
+
+  pg->g_registers = tr->r_registers;
+  pg->g_serial = tr->r_serial;
+
+  if(bs == NULL){
+    pg->g_source = bitstream_cache_tbs(d, pg->g_key);
+    if((pg->g_source == NULL) || (load_registers_cache_tbs(d, pg->g_key) < 0)){
+      log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "discarding unusable cache entry %s", pg->g_key);
+      forget_cache_tbs(d, pg->g_key);
+      stop_fpga_tbs(d);
+      destroy_program_data_tbs(pg);
+      return -1;
+    }
+  } else {
+    if(index_bof(d, bs) < 0){
+      log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to load register mapping");
+      stop_fpga_tbs(d);
+      destroy_program_data_tbs(pg);
+      return -1;
+    }
+
+    /* the register table goes in first, the bitstream only lands once complete */
+    if(pg->g_key[0] && (save_registers_cache_tbs(d, pg->g_key) == 0)){
+      pg->g_store = bitstream_cache_tbs(d, pg->g_key);
+      pg->g_cache_dir = strdup(tr->r_cache_dir);
+      if((pg->g_store == NULL) || (pg->g_cache_dir == NULL)){
+        forget_cache_tbs(d, pg->g_key);
+        if(pg->g_store){
+          free(pg->g_store);
+          pg->g_store = NULL;
+        }
+      }
+    }
+  }
+
+  nx = create_notice_katcp(d, TBS_FPGA_LABEL, 0);
+  if(nx == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create notification logic to trigger when programming completes");
+    stop_fpga_tbs(d);
+    destroy_program_data_tbs(pg);
+    return -1;
+  }
+
+  /* global first, so that the fpga is ready by the time the request is answered */
+  if(add_notice_katcp(dl, nx, &complete_program_tbs, pg) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register callback for programming completion");
+    stop_fpga_tbs(d);
+    destroy_program_data_tbs(pg);
+    return -1;
+  }
+
+  if(add_notice_katcp(d, nx, &upload_generic_resume_tbs, NULL) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register callback to resume command");
+    abandon_program_tbs(d, dl, nx, pg, 0);
+    return -1;
+  }
+
+  url = create_exec_kurl_katcp(TBS_FPGA_LABEL);
+  if(url == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "%s: could not create kurl", __func__);
+    abandon_program_tbs(d, dl, nx, pg, 1);
+    return -1;
+  }
+
+  j = run_child_process_tbs(dl, url, &subprocess_program_tbs, pg, nx);
+  if(j == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to run child process to program fpga");
+    destroy_kurl_katcp(url);
+    abandon_program_tbs(d, dl, nx, pg, 1);
+    return -1;
+  }
+
+  /* the child has its own copy now */
+  pg->g_bof = NULL;
+
+  if(match_inform_job_katcp(dl, j, TBS_FPGA_STATUS, &progress_program_tbs, NULL) < 0){
+    log_message_katcp(d, KATCP_LEVEL_WARN, NULL, "unable to relay programming progress");
+  }
+
+  broadcast_inform_katcp(d, TBS_FPGA_STATUS, TBS_FPGA_PROGRESS);
+
+  return 0;
+}
+
 /*********************************************************************/
 
 void destroy_raw_tbs(struct katcp_dispatch *d, struct tbs_raw *tr)
@@ -2221,6 +3045,11 @@ void destroy_raw_tbs(struct katcp_dispatch *d, struct tbs_raw *tr)
     tr->r_meta = NULL;
   }
 
+  if(tr->r_regsets){
+    destroy_avltree(tr->r_regsets, &free_regset);
+    tr->r_regsets = NULL;
+  }
+
   if(tr->r_image){
     free(tr->r_image);
     tr->r_image = NULL;
@@ -2245,6 +3074,11 @@ void destroy_raw_tbs(struct katcp_dispatch *d, struct tbs_raw *tr)
     tr->r_bof_dir = NULL;
   }
 
+  if(tr->r_cache_dir){
+    free(tr->r_cache_dir);
+    tr->r_cache_dir = NULL;
+  }
+
   free(tr);
 }
 
@@ -2337,10 +3171,16 @@ int setup_raw_tbs(struct katcp_dispatch *d, char *bofdir, int argc, char **argv)
   tr->r_instances = 0;
 
   tr->r_meta = NULL;
+  tr->r_regsets = NULL;
+
+  tr->r_cache_dir = NULL;
+  tr->r_cache_limit = 0;
+
+  tr->r_serial = 0;
   /* clear out further structure elements */
 
   /* allocate structure elements */
-  tr->r_registers = create_avltree();
+  tr->r_registers = create_indexed_avltree();
   if(tr->r_registers == NULL){
     destroy_raw_tbs(d, tr);
     return -1;
@@ -2402,6 +3242,9 @@ int setup_raw_tbs(struct katcp_dispatch *d, char *bofdir, int argc, char **argv)
   /* upload and program bitstream */
   result += register_flag_mode_katcp(d, "?uploadbin",    "upload and program a bitstream (?uploadbin [port [length [timeout]]])", &upload_bin_cmd, 0, TBS_MODE_RAW);
 
+  /* stream out, the other direction */
+  result += register_flag_mode_katcp(d, "?readremote",   "stream raw register contents to a tcp connection (?readremote port register [byte-offset [byte-length [timeout]]])", &readremote_cmd, 0, TBS_MODE_RAW);
+
   /* not upload, just program */
   result += register_flag_mode_katcp(d, "?progdev",      "program the fpga (?progdev [filename])", &progdev_cmd, 0, TBS_MODE_RAW);
 
@@ -2411,6 +3254,12 @@ int setup_raw_tbs(struct katcp_dispatch *d, char *bofdir, int argc, char **argv)
   result += register_flag_mode_katcp(d, "?meta",         "more info abt design(key parent field value)", &meta_cmd, 0, TBS_MODE_RAW);
   result += register_flag_mode_katcp(d, "?write",        "write binary data to a named register (?write name byte-offset:bit-offset value byte-length:bit-length)", &write_cmd, 0, TBS_MODE_RAW);
   result += register_flag_mode_katcp(d, "?read",         "read binary data from a named register (?read name byte-offset:bit-offset byte-length:bit-length)", &read_cmd, 0, TBS_MODE_RAW);
+  result += register_flag_mode_katcp(d, "?read-many",    "read several registers into one buffer (?read-many [-snapshot] name[:byte-offset[:byte-length]]+)", &read_many_cmd, 0, TBS_MODE_RAW);
+
+  result += register_flag_mode_katcp(d, "?regset-define", "precompile a named set of registers (?regset-define set name[:byte-offset[:byte-length]]+)", &regset_define_cmd, 0, TBS_MODE_RAW);
+  result += register_flag_mode_katcp(d, "?regset-read",   "read a register set into one buffer (?regset-read set)", &regset_read_cmd, 0, TBS_MODE_RAW);
+  result += register_flag_mode_katcp(d, "?regset-delete", "forget a register set (?regset-delete set)", &regset_delete_cmd, 0, TBS_MODE_RAW);
+  result += register_flag_mode_katcp(d, "?regset-list",   "list register sets with their register count and size (?regset-list)", &regset_list_cmd, 0, TBS_MODE_RAW);
 
   result += register_flag_mode_katcp(d, "?wordwrite",    "write hex words to a named register (?wordwrite name index value+)", &word_write_cmd, 0, TBS_MODE_RAW);
   result += register_flag_mode_katcp(d, "?wordread",     "read hex words from a named register (?wordread name word-offset:bit-offset word-count)", &word_read_cmd, 0, TBS_MODE_RAW);
@@ -117,11 +117,8 @@ struct katcp_job *run_child_process_tbs(struct katcp_dispatch *d, struct katcp_u
   xl = create_katcl(fds[0]);
   close(fds[1]);
 
-#if 0
-  for (i=0; i<1024; i++)
-    if (i != fds[0])
-      close(i);
-#endif 
+  /* not all fds, callbacks may still use ones opened for them */
+  detach_shared_katcp(d);
 
   replace_argv(d, url->u_str);
 
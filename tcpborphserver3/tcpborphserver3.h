@@ -2,6 +2,7 @@
 #define TBS_H_
 
 #include <stdint.h>
+#include <sys/time.h>
 
 #include <katcp.h>
 #include <avltree.h>
@@ -27,23 +28,35 @@
 
 #define TBS_KCPFPG_PATH    "/bin/kcpfpg"
 #define TBS_RAMFILE_PATH   "/dev/shm/gateware"
+#define TBS_CACHE_PATH     "/dev/shm/gateware-cache"
+#define TBS_CACHE_LIMIT    (128*1024*1024)
+#define TBS_CACHE_KEY      17
 
 #define TBS_FPGA_STATUS    "#fpga"
+#define TBS_FPGA_PROGRESS  "programming"
+#define TBS_FPGA_LABEL     "fpga-program"
+#define TBS_READREMOTE_LABEL "readremote"
+#define TBS_PROGRAM_NICE   10
 #define TBS_KCPFPG_EXE     "kcpfpg"
 
 #define TBS_ROACH_CHASSIS  "roach2chassis"
+#define TBS_HWMON_TIMEOUT  2000 /* ms before a hardware sensor read counts as failed */
 
 /* on a 1Gb kernel / 3G user split, this is what we can see */
 #define TBS_ROACH_PARTIAL_MAP  (32*1024*1024)
 /* on a 2Gb kernel / 2G user split, we can see the full bank EPB of 128M */
 #define TBS_ROACH_FULL_MAP     (128*1024*1024)
 
+/* most data a single ?read-many or register set may gather, registers can be listed repeatedly */
+#define TBS_READ_LIMIT         TBS_ROACH_FULL_MAP
+
 int setup_raw_tbs(struct katcp_dispatch *d, char *bofdir, int argc, char **argv);
 
 #include "loadbof.h"
 
 int start_fpg_tbs(struct katcp_dispatch *d);
 int start_bof_tbs(struct katcp_dispatch *d, struct bof_state *bs);
+int launch_bof_tbs(struct katcp_dispatch *d, struct bof_state *bs, char *image, char *key);
 int stop_fpga_tbs(struct katcp_dispatch *d);
 
 int status_fpga_tbs(struct katcp_dispatch *d, int status);
@@ -66,6 +79,9 @@ unsigned int infer_fpga_range(struct katcp_dispatch *d);
 
 #define GETAP_VECTOR_PERIOD      4
 
+#define GETAP_LATENCY_BUCKETS   12  /* log2 histogram, first bucket below GETAP_LATENCY_BASE us */
+#define GETAP_LATENCY_BASE      32
+
 struct getap_state{
   uint32_t s_magic;
 
@@ -112,7 +128,12 @@ struct getap_state{
   struct timeval s_timeout;
 #endif
 
-  unsigned int s_timer;
+  unsigned int s_timer;         /* nominal polling interval in ms, nonzero if running */
+  unsigned int s_poll;          /* current polling interval in us, shrinks when busy */
+  unsigned int s_recent;        /* frames received since the arp logic last ran */
+  struct timeval s_arp_due;     /* arp logic still runs every s_timer ms */
+  struct timeval s_last_poll;
+  struct timeval s_tx_stamp;    /* when the frame in s_txb was read from the tap device */
 
   unsigned int s_rx_len;
   unsigned int s_tx_len;
@@ -126,6 +147,12 @@ struct getap_state{
   unsigned long s_rx_user;
   unsigned long s_rx_error;
 
+  unsigned long s_tx_bytes;
+  unsigned long s_rx_bytes;
+
+  unsigned long s_tx_latency[GETAP_LATENCY_BUCKETS]; /* tap read to fpga write */
+  unsigned long s_rx_latency[GETAP_LATENCY_BUCKETS]; /* polling gap before frame was found */
+
   unsigned char s_rxb[GETAP_MAX_FRAME];
   unsigned char s_txb[GETAP_MAX_FRAME];
 
@@ -175,6 +202,12 @@ struct tbs_raw
   unsigned int r_instances;
 
   struct avl_tree *r_meta;
+  struct avl_tree *r_regsets; /* precompiled register sets, dropped with the registers */
+
+  char *r_cache_dir; /* decompressed images, NULL if not caching */
+  unsigned long r_cache_limit;
+
+  unsigned int r_serial; /* bumped by stop_fpga_tbs, lets a programming job notice that it was overtaken */
 };
 
 struct meta_entry
@@ -198,6 +231,29 @@ struct tbs_entry
   unsigned char e_mode;
 };
 
+/* a read worked out in advance: all checks done, only data movement left */
+struct tbs_plan
+{
+  unsigned int p_base;        /* byte position of the first word in the map */
+  unsigned int p_shift;       /* bit offset of the data in that word */
+  unsigned int p_bytes;
+  unsigned int p_bits;
+  unsigned int p_round;       /* bytes used by the trailing bits */
+  unsigned int p_transfer;    /* bytes copied out in total */
+  unsigned int p_grab_base;
+  unsigned int p_grab_offset;
+  uint32_t p_mask;
+  uint32_t p_tail_mask;
+};
+
+struct tbs_regset
+{
+  unsigned int g_count;
+  size_t g_size;
+  struct tbs_plan *g_plans;
+  unsigned char *g_buffer;
+};
+
 struct tbs_hwsensor 
 {
   int h_adc_fd;
@@ -245,7 +301,41 @@ struct tbs_port_data {
 #endif
 };
 
+struct tbs_stream_data {
+  int o_port;
+  unsigned int o_timeout;
+
+  unsigned char *o_map;  /* start of the region in the fpga mapping */
+  unsigned int o_length;
+};
+
+struct tbs_program_data {
+  struct bof_state *g_bof; /* only valid up to the fork */
+  char *g_image;
+  struct timeval g_start;
+
+  char g_key[TBS_CACHE_KEY];
+  char *g_source;  /* cached bitstream to copy, instead of inflating g_bof */
+  char *g_store;   /* where to keep a copy of the inflated bitstream */
+  char *g_cache_dir;
+  unsigned long g_cache_limit;
+
+  struct avl_tree *g_registers; /* register table loaded for this image */
+  unsigned int g_serial;        /* r_serial when the table was loaded */
+};
+
+int setup_cache_tbs(struct katcp_dispatch *d, char *dir, unsigned long limit);
+int key_cache_tbs(struct katcp_dispatch *d, char *name, char *key);
+char *bitstream_cache_tbs(struct katcp_dispatch *d, char *key);
+int have_cache_tbs(struct katcp_dispatch *d, char *key);
+void forget_cache_tbs(struct katcp_dispatch *d, char *key);
+int save_registers_cache_tbs(struct katcp_dispatch *d, char *key);
+int load_registers_cache_tbs(struct katcp_dispatch *d, char *key);
+int evict_cache_tbs(struct katcl_line *l, char *dir, unsigned long limit, char *keep);
+
 int upload_generic_resume_tbs(struct katcp_dispatch *d, struct katcp_notice *n, void *data);
+int programming_busy_tbs(struct katcp_dispatch *d);
+int transfer_status_tbs(struct katcp_dispatch *d, struct katcp_notice *n);
 int detect_file_tbs(struct katcp_dispatch *d, char *name, int fd);
 
 struct katcp_job *run_child_process_tbs(struct katcp_dispatch *d, struct katcp_url *url, int (*call)(struct katcl_line *, void *), void *data, struct katcp_notice *n); 
@@ -253,6 +343,7 @@ struct katcp_job *run_child_process_tbs(struct katcp_dispatch *d, struct katcp_u
 int upload_program_cmd(struct katcp_dispatch *d, int argc);
 int upload_filesystem_cmd(struct katcp_dispatch *d, int argc);
 int upload_bin_cmd(struct katcp_dispatch *d, int argc);
+int readremote_cmd(struct katcp_dispatch *d, int argc);
 
 
 #if 0
@@ -26,6 +26,7 @@
 #include "tg.h"
 
 #define POLL_INTERVAL         10  /* polling interval, in msecs, how often we look at register */
+#define POLL_BUSY            250  /* usecs, how soon we look again after seeing traffic, doubles back to the polling interval when idle */
 #define CACHE_DIVISOR          4  /* 256 / div - longest initial delay */
 
 #define FRESH_VALID        50000 /* length of time to cache a valid reply - units are poll interval, approx */
@@ -52,7 +53,7 @@
 #define COPRIME_B        23 /* some other offset ... */
 #define COPRIME_C       101 /* offset to make requests not sequential ... */
 
-#define RECEIVE_BURST      8 /* read at most N frames per polling interval */
+#define RECEIVE_BURST      8 /* read at most N frames per timer run, more pending reschedules us immediately */
 
 #define GO_DEFAULT_PORT 7148
 
@@ -123,6 +124,7 @@ static const uint8_t broadcast_const[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
 
 static int write_mac_fpga(struct getap_state *gs, unsigned int offset, const uint8_t *mac);
 static int write_frame_fpga(struct getap_state *gs, unsigned char *data, unsigned int len);
+static int schedule_timer_tap(struct katcp_dispatch *d, struct getap_state *gs, unsigned int burst, int more);
 
 /************************************************************************/
 
@@ -677,20 +679,6 @@ int write_mac_fpga(struct getap_state *gs, unsigned int offset, const uint8_t *m
 
 /* transmit to gateware *************************************************/
 
-#define CRCPOLY_LE 0xedb88320
-
-static uint32_t crc32_le(uint32_t crc, unsigned char *p, unsigned int len)
-{
-  int i;
-  while (len--){
-    crc ^= *p++;
-    for (i = 0; i < 8; i++){
-      crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
-    }
-  }
-  return crc;
-}
-
 static int write_frame_fpga(struct getap_state *gs, unsigned char *data, unsigned int len)
 {
   uint32_t buffer_sizes, tmp;
@@ -739,7 +727,7 @@ static int write_frame_fpga(struct getap_state *gs, unsigned char *data, unsigne
 #endif
   }
 
-  tmp = crc32_le(0xffffffffUL, data, final - 4);
+  tmp = crc32_le_getap(0xffffffffUL, data, final - 4);
 
   data[final - 4] = ~(0xff & (tmp      ));
   data[final - 3] = ~(0xff & (tmp >>  8));
@@ -760,6 +748,8 @@ static int write_frame_fpga(struct getap_state *gs, unsigned char *data, unsigne
   log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "sent %u words to fpga from tap device %s", buffer_sizes >> 16, gs->s_tap_name);
 #endif
 
+  gs->s_tx_bytes += final;
+
   if(final < gs->s_tx_small){
     gs->s_tx_small = final;
   }
@@ -770,14 +760,38 @@ static int write_frame_fpga(struct getap_state *gs, unsigned char *data, unsigne
   return 1;
 }
 
+static void record_latency_getap(unsigned long *histogram, struct timeval *start, struct timeval *stop)
+{
+  struct timeval delta;
+  unsigned long us, limit;
+  unsigned int i;
+
+  if(sub_time_katcp(&delta, stop, start) < 0){
+    histogram[0]++;
+    return;
+  }
+
+  us = (delta.tv_sec * 1000000UL) + delta.tv_usec;
+
+  limit = GETAP_LATENCY_BASE;
+  for(i = 0; (i < (GETAP_LATENCY_BUCKETS - 1)) && (us >= limit); i++){
+    limit *= 2;
+  }
+
+  histogram[i]++;
+}
+
 static int transmit_frame_fpga(struct getap_state *gs)
 {
+  struct timeval now;
   int result;
 
   result = write_frame_fpga(gs, gs->s_txb, gs->s_tx_len);
   if(result != 0){
     gs->s_tx_len = 0;
     if(result > 0){
+      gettimeofday(&now, NULL);
+      record_latency_getap(gs->s_tx_latency, &gs->s_tx_stamp, &now);
       gs->s_tx_user++;
     } else {
       gs->s_tx_error++;
@@ -910,6 +924,7 @@ int receive_frame_fpga(struct getap_state *gs)
   memcpy(gs->s_rxb, base + GO_RXBUFFER, len);
 
   gs->s_rx_len = len;
+  gs->s_rx_bytes += len;
 
 #ifdef DEBUG
   fprintf(stderr, "rxf: data:");
@@ -974,6 +989,7 @@ int receive_ip_kernel(struct katcp_dispatch *d, struct getap_state *gs)
 #endif
 
   gs->s_tx_len = rr + SIZE_FRAME_HEADER;
+  gettimeofday(&(gs->s_tx_stamp), NULL);
 
   return 1;
 }
@@ -1033,9 +1049,10 @@ int run_timer_tap(struct katcp_dispatch *d, void *data)
 {
   struct getap_state *gs;
   struct katcp_arb *a;
-  int result, run;
+  int result, run, more;
   unsigned int burst;
   struct tbs_raw *tr;
+  struct timeval now, delta;
 
   gs = data;
   sane_gs(gs);
@@ -1068,25 +1085,21 @@ int run_timer_tap(struct katcp_dispatch *d, void *data)
   }
 
   if(gs->s_tx_len > 0){
-    result = write_frame_fpga(gs, gs->s_txb, gs->s_tx_len);
-    if(result != 0){
-      gs->s_tx_len = 0;
-      if(result > 0){
-        gs->s_tx_user++;
-      } else {
-        gs->s_tx_error++;
-      }
-    }
+    transmit_frame_fpga(gs);
   }
 
+  gettimeofday(&now, NULL);
+
   burst = 0;
+  more = 0;
   run = 1;
 
-  /* TODO: might want to handle burst of traffic better, instead of waiting poll interval for next frame */
   do{
 
     if(receive_frame_fpga(gs) > 0){
 
+      record_latency_getap(gs->s_rx_latency, &(gs->s_last_poll), &now);
+
       if(gs->s_rx_len > gs->s_rx_big){
         gs->s_rx_big = gs->s_rx_len;
       }
@@ -1139,6 +1152,7 @@ int run_timer_tap(struct katcp_dispatch *d, void *data)
       burst++;
 
       if(burst > gs->s_burst){
+        more = 1; /* probably more waiting, come back right away */
         run = 0;
       }
 
@@ -1147,6 +1161,29 @@ int run_timer_tap(struct katcp_dispatch *d, void *data)
     }
   } while(run);
 
+  gs->s_last_poll = now;
+  gs->s_recent += burst;
+
+  if(schedule_timer_tap(d, gs, burst, more) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to reschedule polling of %s", gs->s_tap_name);
+    return -1;
+  }
+
+  /* the arp tables count in units of the nominal polling interval, so only run that logic at that rate */
+  if(cmp_time_katcp(&now, &(gs->s_arp_due)) < 0){
+    return 0;
+  }
+
+  delta.tv_sec = gs->s_timer / 1000;
+  delta.tv_usec = (gs->s_timer % 1000) * 1000;
+  add_time_katcp(&(gs->s_arp_due), &(gs->s_arp_due), &delta);
+  if(cmp_time_katcp(&(gs->s_arp_due), &now) <= 0){
+    add_time_katcp(&(gs->s_arp_due), &now, &delta);
+  }
+
+  burst = gs->s_recent;
+  gs->s_recent = 0;
+
 #if DEBUG > 1
   fprintf(stderr, "run timer loop: burst now %d\n", burst);
 #endif
@@ -1163,6 +1200,37 @@ int run_timer_tap(struct katcp_dispatch *d, void *data)
   return 0;
 }
 
+static int schedule_timer_tap(struct katcp_dispatch *d, struct getap_state *gs, unsigned int burst, int more)
+{
+  struct timeval tv;
+  unsigned int limit;
+
+  limit = gs->s_timer * 1000;
+
+  if(more){
+    gs->s_poll = 0;
+  } else if((burst > 0) || (gs->s_tx_len > 0) || (gs->s_arp_len > 0)){
+    gs->s_poll = POLL_BUSY; /* traffic or a stalled transmit, look again soon */
+  } else if(gs->s_poll < POLL_BUSY){
+    gs->s_poll = POLL_BUSY;
+  } else {
+    gs->s_poll *= 2; /* idle, back off */
+  }
+
+  if(gs->s_poll > limit){
+    gs->s_poll = limit;
+  }
+
+  tv.tv_sec = gs->s_poll / 1000000;
+  tv.tv_usec = gs->s_poll % 1000000;
+
+#if DEBUG > 1
+  fprintf(stderr, "run timer loop: burst %u, next poll in %uus\n", burst, gs->s_poll);
+#endif
+
+  return register_in_tv_katcp(d, &tv, &run_timer_tap, gs);
+}
+
 int run_io_tap(struct katcp_dispatch *d, struct katcp_arb *a, unsigned int mode)
 {
   struct getap_state *gs;
@@ -1550,6 +1618,7 @@ struct getap_state *create_getap(struct katcp_dispatch *d, unsigned int instance
   struct getap_state *gs; 
   unsigned int i;
   struct tbs_raw *tr;
+  struct timeval tv;
 
   gs = NULL;
 
@@ -1622,6 +1691,8 @@ struct getap_state *create_getap(struct katcp_dispatch *d, unsigned int instance
   gs->s_mcast_count = 0;
 
   gs->s_timer = 0;
+  gs->s_poll = 0;
+  gs->s_recent = 0;
 
   gs->s_rx_len = 0;
   gs->s_tx_len = 0;
@@ -1635,6 +1706,14 @@ struct getap_state *create_getap(struct katcp_dispatch *d, unsigned int instance
   gs->s_rx_user = 0;
   gs->s_rx_error = 0;
 
+  gs->s_tx_bytes = 0;
+  gs->s_rx_bytes = 0;
+
+  for(i = 0; i < GETAP_LATENCY_BUCKETS; i++){
+    gs->s_tx_latency[i] = 0;
+    gs->s_rx_latency[i] = 0;
+  }
+
   gs->s_rx_big = 0;
   gs->s_rx_small = GETAP_MAX_FRAME + 1;
 
@@ -1724,8 +1803,18 @@ struct getap_state *create_getap(struct katcp_dispatch *d, unsigned int instance
     return NULL;
   }
 
-  if(register_every_ms_katcp(d, period, &run_timer_tap, gs) < 0){
-    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register timer for interval of %dms", gs->s_timer);
+  /* the timer reschedules itself, polling faster while frames arrive, see schedule_timer_tap */
+
+  gettimeofday(&(gs->s_last_poll), NULL);
+  gs->s_arp_due = gs->s_last_poll;
+  gs->s_recent = 0;
+  gs->s_poll = period * 1000;
+
+  tv.tv_sec = period / 1000;
+  tv.tv_usec = (period % 1000) * 1000;
+
+  if(register_in_tv_katcp(d, &tv, &run_timer_tap, gs) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register timer for interval of %ums", period);
     destroy_getap(d, gs);
     return NULL;
   }
@@ -2094,6 +2183,27 @@ static void tap_print_period_info(struct katcp_dispatch *d, char *prefix, unsign
   log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%s period initially every %ums currently %ums incrementing by %ums until %ums", prefix, array[GETAP_PERIOD_START] * POLL_INTERVAL, array[GETAP_PERIOD_CURRENT] * POLL_INTERVAL, array[GETAP_PERIOD_INCREMENT] * POLL_INTERVAL, array[GETAP_PERIOD_STOP] * POLL_INTERVAL);
 }
 
+static void tap_print_latency_info(struct katcp_dispatch *d, char *prefix, unsigned long *histogram)
+{
+  char buffer[GETAP_LATENCY_BUCKETS * 32];
+  unsigned int i, len;
+  unsigned long limit;
+
+  len = 0;
+  limit = GETAP_LATENCY_BASE;
+
+  for(i = 0; i < GETAP_LATENCY_BUCKETS; i++){
+    if(i < (GETAP_LATENCY_BUCKETS - 1)){
+      len += snprintf(buffer + len, sizeof(buffer) - len, " <%luus=%lu", limit, histogram[i]);
+    } else {
+      len += snprintf(buffer + len, sizeof(buffer) - len, " more=%lu", histogram[i]);
+    }
+    limit *= 2;
+  }
+
+  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "%s:%s", prefix, buffer);
+}
+
 void tap_print_info(struct katcp_dispatch *d, struct getap_state *gs)
 {
   unsigned int i;
@@ -2111,8 +2221,8 @@ void tap_print_info(struct katcp_dispatch *d, struct getap_state *gs)
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_DEBUG, NULL, "own index %u", gs->s_self);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "current iteration %u", gs->s_iteration);
 
-  log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "polling interval %ums", gs->s_timer);
-  log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "max reads per interval %u", gs->s_burst);
+  log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "polling interval %ums when idle, currently %uus", gs->s_timer, gs->s_poll);
+  log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "max reads per poll %u", gs->s_burst);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "address %s", gs->s_address_name);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "subnet is /%u with %u-2 stations", gs->s_subnet, gs->s_table_size);
   if(gs->s_gateway_name[0] != '\0'){
@@ -2143,9 +2253,13 @@ void tap_print_info(struct katcp_dispatch *d, struct getap_state *gs)
 
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "TX arp=%lu user=%lu error=%lu total=%lu", gs->s_tx_arp, gs->s_tx_user, gs->s_tx_error, gs->s_tx_arp + gs->s_tx_user);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "TX sizes smallest=%u biggest=%u", gs->s_tx_small, gs->s_tx_big);
+  log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "TX bytes=%lu", gs->s_tx_bytes);
+  tap_print_latency_info(d, "TX latency from tap read", gs->s_tx_latency);
 
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "RX arp=%lu user=%lu error=%lu total=%lu", gs->s_rx_arp, gs->s_rx_user, gs->s_rx_error, gs->s_rx_arp + gs->s_rx_user);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "RX sizes smallest=%u biggest=%u", gs->s_rx_small, gs->s_rx_big);
+  log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "RX bytes=%lu", gs->s_rx_bytes);
+  tap_print_latency_info(d, "RX latency bound by poll gap", gs->s_rx_latency);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "arp requests used to glean stations %u", gs->s_x_glean);
   log_message_katcp(gs->s_dispatch, KATCP_LEVEL_INFO, NULL, "link status word is 0x%08x", link);
 
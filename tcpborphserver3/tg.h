@@ -1,6 +1,8 @@
 #ifndef TG_H_
 #define TG_H_
 
+#include <stdint.h>
+
 int tap_stop_cmd(struct katcp_dispatch *d, int argc);
 int tap_start_cmd(struct katcp_dispatch *d, int argc);
 
@@ -20,4 +22,6 @@ int tap_multicast_remove_group_cmd(struct katcp_dispatch *d, int argc);
 
 void stop_all_getap(struct katcp_dispatch *d, int final);
 
+uint32_t crc32_le_getap(uint32_t crc, unsigned char *p, unsigned int len);
+
 #endif
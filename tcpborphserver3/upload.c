@@ -10,6 +10,7 @@
 #include <signal.h>
 
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sysexits.h>
@@ -291,6 +292,23 @@ int upload_generic_resume_tbs(struct katcp_dispatch *d, struct katcp_notice *n,
   return 0;
 }
 
+/* a ?progdev child may still be writing the config device, tearing down the fpga under it would mix two images, */
+/* and a ?readremote child still reads the bus through its copy of the mapping */
+int programming_busy_tbs(struct katcp_dispatch *d)
+{
+  if(find_notice_katcp(d, TBS_FPGA_LABEL)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga programming still in progress, refusing to load another image");
+    return 1;
+  }
+
+  if(find_notice_katcp(d, TBS_READREMOTE_LABEL)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register stream still in progress, leaving the fpga alone");
+    return 1;
+  }
+
+  return 0;
+}
+
 int sane_port_tbs(struct katcp_dispatch *d, unsigned int port)
 {
   if(port <= 1024){
@@ -308,11 +326,10 @@ int sane_port_tbs(struct katcp_dispatch *d, unsigned int port)
 int detect_file_tbs(struct katcp_dispatch *d, char *name, int fd)
 {
 #define BUFFER 128
-  int rfd, rr;
+  int rfd, rr, zfd;
   char buffer[BUFFER]; 
   char bofmagic[4] = { 0x19, 'B', 'O', 'F' };
-
-  /* TODO - use gzopen */
+  gzFile gzf;
 
   if(fd < 0){
     if(name == NULL){
@@ -336,6 +353,21 @@ int detect_file_tbs(struct katcp_dispatch *d, char *name, int fd)
 
   rr = read(rfd, buffer, BUFFER);
 
+  /* compressed images: look at what is inside, open_bof inflates transparently */
+  if((rr >= 2) && ((unsigned char)buffer[0] == 0x1f) && ((unsigned char)buffer[1] == 0x8b)){
+    zfd = (lseek(rfd, 0, SEEK_SET) == 0) ? dup(rfd) : (-1);
+    gzf = (zfd < 0) ? NULL : gzdopen(zfd, "r");
+    if(gzf){
+      rr = gzread(gzf, buffer, BUFFER);
+      gzclose(gzf);
+    } else {
+      if(zfd >= 0){
+        close(zfd);
+      }
+      rr = (-1);
+    }
+  }
+
   if(rfd != fd){
     close(rfd);
   }
@@ -608,6 +640,10 @@ int upload_bin_cmd(struct katcp_dispatch *d, int argc)
     return KATCP_RESULT_FAIL;
   }
 
+  if(programming_busy_tbs(d)){
+    return KATCP_RESULT_FAIL;
+  }
+
   if(stop_fpga_tbs(d) < 0){
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to deprogram fpga");
     return KATCP_RESULT_FAIL;
@@ -744,6 +780,11 @@ int upload_program_partial_tbs(struct katcp_dispatch *d, struct katcp_notice *n,
     return -1;
   }
 
+  if(programming_busy_tbs(d)){
+    destroy_port_data_tbs(d, pd, 1);
+    return -1;
+  }
+
   if(stop_fpga_tbs(d) < 0){
     destroy_port_data_tbs(d, pd, 1);
     return -1;
@@ -1013,6 +1054,10 @@ int upload_program_cmd(struct katcp_dispatch *d, int argc)
     return KATCP_RESULT_FAIL;
   }
 
+  if(programming_busy_tbs(d)){
+    return KATCP_RESULT_FAIL;
+  }
+
   stop_fpga_tbs(d);
 
   nx = create_notice_katcp(d, TBS_RAMFILE_PATH, 0);
@@ -1071,6 +1116,312 @@ int upload_program_cmd(struct katcp_dispatch *d, int argc)
 }
 
 
+/* stream register contents out over a side connection ***********************************/
+
+#ifdef __PPC__
+/* the roach bus wants 32 bit accesses, which send() on the mapping does not guarantee */
+#define READREMOTE_WORDWISE
+#endif
+
+void destroy_stream_data_tbs(struct katcp_dispatch *d, struct tbs_stream_data *sd)
+{
+  if(sd == NULL){
+    return;
+  }
+
+  sd->o_map = NULL;
+  sd->o_length = 0;
+
+  free(sd);
+}
+
+int subprocess_readremote_tbs(struct katcl_line *l, void *data)
+{
+  struct tbs_stream_data *sd;
+  int lfd, nfd, wr;
+  unsigned int sent, can, have;
+  unsigned char *ptr;
+  struct timeval start, stop, delta;
+  double elapsed;
+#ifdef READREMOTE_WORDWISE
+  uint32_t buf[(MTU / 4) + 1];
+  unsigned int i;
+#endif
+
+  sd = data;
+
+  if(sd == NULL){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_READREMOTE_LABEL, "no state supplied to subordinate logic");
+    return -1;
+  }
+
+  lfd = net_listen(NULL, sd->o_port, 0);
+  if(lfd < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_READREMOTE_LABEL, "unable to bind port %d: %s", sd->o_port, strerror(errno));
+    return -1;
+  }
+
+  signal(SIGALRM, SIG_DFL);
+  alarm(sd->o_timeout);
+
+  nfd = accept(lfd, NULL, 0);
+  close(lfd);
+
+  if(nfd < 0){
+    sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_READREMOTE_LABEL, "accept on port %d failed: %s", sd->o_port, strerror(errno));
+    return -1;
+  }
+
+  gettimeofday(&start, NULL);
+
+  sent = 0;
+  while(sent < sd->o_length){
+    can = sd->o_length - sent;
+    if(can > MTU){
+      can = MTU;
+    }
+
+#ifdef READREMOTE_WORDWISE
+    for(i = 0; i < ((can + 3) / 4); i++){
+      buf[i] = ((volatile uint32_t *)(sd->o_map + sent))[i];
+    }
+    ptr = (unsigned char *)buf;
+#else
+    ptr = sd->o_map + sent;
+#endif
+
+    have = 0;
+    do{
+      wr = send(nfd, ptr + have, can - have, MSG_NOSIGNAL);
+      if(wr < 0){
+        switch(errno){
+          case EAGAIN :
+          case EINTR  :
+            break;
+          default :
+            sync_message_katcl(l, KATCP_LEVEL_ERROR, TBS_READREMOTE_LABEL, "send failed after %u bytes: %s", sent + have, strerror(errno));
+            close(nfd);
+            return -1;
+        }
+      } else {
+        have += wr;
+      }
+    } while(have < can);
+
+    sent += can;
+
+    alarm(sd->o_timeout);
+  }
+
+  close(nfd);
+  alarm(0);
+
+  gettimeofday(&stop, NULL);
+  sub_time_katcp(&delta, &stop, &start);
+  elapsed = delta.tv_sec + (delta.tv_usec / 1000000.0);
+
+  sync_message_katcl(l, KATCP_LEVEL_INFO, TBS_READREMOTE_LABEL, "sent %u bytes in %lu.%06lus (%.0f bytes/s)", sent, delta.tv_sec, delta.tv_usec, (elapsed > 0.0) ? (sent / elapsed) : 0.0);
+
+  return 0;
+}
+
+int readremote_complete_tbs(struct katcp_dispatch *d, struct katcp_notice *n, void *data)
+{
+  struct tbs_stream_data *sd;
+  int result;
+
+  sd = data;
+  if(sd == NULL){
+#ifdef KATCP_CONSISTENCY_CHECKS
+    fprintf(stderr, "logic problem: no stream data given to handler\n");
+    abort();
+#endif
+    return -1;
+  }
+
+  result = transfer_status_tbs(d, n);
+
+  log_message_katcp(d, KATCP_LEVEL_DEBUG, NULL, "streaming of %u bytes on port %d %s", sd->o_length, sd->o_port, (result < 0) ? "failed" : "succeeded");
+
+  destroy_stream_data_tbs(d, sd);
+
+  return 0;
+}
+
+/* undo a partially set up stream, the notice goes away once it has no callbacks left */
+
+static void abandon_readremote_tbs(struct katcp_dispatch *d, struct katcp_dispatch *dl, struct katcp_notice *nx, struct tbs_stream_data *sd, int resume)
+{
+  if(resume){
+    remove_notice_katcp(d, nx, &upload_generic_resume_tbs, NULL);
+  }
+
+  remove_notice_katcp(dl, nx, &readremote_complete_tbs, sd);
+
+  destroy_stream_data_tbs(d, sd);
+}
+
+int readremote_cmd(struct katcp_dispatch *d, int argc)
+{
+  struct katcp_dispatch *dl;
+  struct katcp_job *j;
+  struct katcp_url *url;
+  struct katcp_notice *nx;
+  struct tbs_stream_data *sd;
+  struct tbs_entry *te;
+  struct tbs_raw *tr;
+  unsigned int port, timeout, offset, length;
+  char *name;
+
+  dl = template_shared_katcp(d);
+  if(dl == NULL){
+    return KATCP_RESULT_FAIL;
+  }
+
+  tr = get_mode_katcp(d, TBS_MODE_RAW);
+  if(tr == NULL){
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(programming_busy_tbs(d)){
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(tr->r_fpga != TBS_FPGA_READY){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "fpga not programmed");
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(argc < 3){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "need a port and register name to stream data");
+    return KATCP_RESULT_INVALID;
+  }
+
+  port = arg_unsigned_long_katcp(d, 1);
+  if(sane_port_tbs(d, port) < 0){
+    return KATCP_RESULT_INVALID;
+  }
+
+  name = arg_string_katcp(d, 2);
+  if(name == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to acquire register name");
+    return KATCP_RESULT_FAIL;
+  }
+
+  te = find_data_avltree(tr->r_registers, name);
+  if(te == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register %s not defined", name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  if(!(te->e_mode & TBS_READABLE)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register %s is not marked readable", name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  offset = 0;
+  if(argc > 3){
+    offset = arg_unsigned_long_katcp(d, 3);
+  }
+
+  if(offset >= te->e_len_base){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "offset %u is beyond the end of register %s", offset, name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  length = te->e_len_base - offset;
+  if(argc > 4){
+    length = arg_unsigned_long_katcp(d, 4);
+  }
+
+  timeout = UPLOAD_TIMEOUT;
+  if(argc > 5){
+    timeout = arg_unsigned_long_katcp(d, 5);
+  }
+
+  if((te->e_pos_offset != 0) || ((te->e_pos_base + offset) % 4)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "streaming of %s needs to start on a word boundary", name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  if((length == 0) || ((offset + length) > te->e_len_base) || ((offset + length) < offset)){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "request for %u bytes at %u does not fit register %s", length, offset, name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  if((te->e_pos_base + offset + ((length + 3) & ~3)) > tr->r_map_size){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "register %s is outside mapped range", name);
+    return KATCP_RESULT_FAIL;
+  }
+
+  nx = find_notice_katcp(d, TBS_READREMOTE_LABEL);
+  if(nx){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "another stream already seems in progress, halting this attempt");
+    return KATCP_RESULT_FAIL;
+  }
+
+  /* allocated ahead of the notice, so that failing here leaves nothing behind */
+  sd = malloc(sizeof(struct tbs_stream_data));
+  if(sd == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to allocate stream state");
+    return KATCP_RESULT_FAIL;
+  }
+
+  sd->o_port = port;
+  sd->o_timeout = (timeout > 0) ? timeout : UPLOAD_TIMEOUT;
+  sd->o_map = ((unsigned char *)(tr->r_map)) + te->e_pos_base + offset;
+  sd->o_length = length;
+
+  nx = create_notice_katcp(d, TBS_READREMOTE_LABEL, 0);
+  if(nx == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create notification logic to trigger when streaming completes");
+    destroy_stream_data_tbs(d, sd);
+    return KATCP_RESULT_FAIL;
+  }
+
+  /* added in the global space dl, so that it completes even if client goes away */
+  if(add_notice_katcp(dl, nx, &readremote_complete_tbs, sd) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register callback for stream completion");
+    /* no callbacks, so the notice is collected on the next pass */
+    destroy_stream_data_tbs(d, sd);
+    return KATCP_RESULT_FAIL;
+  }
+
+  /* add to local connection d, to resume it */
+  if(add_notice_katcp(d, nx, &upload_generic_resume_tbs, NULL) < 0){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to register callback to resume command");
+    abandon_readremote_tbs(d, dl, nx, sd, 0);
+    return KATCP_RESULT_FAIL;
+  }
+
+  url = create_exec_kurl_katcp(TBS_READREMOTE_LABEL);
+  if(url == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "%s: could not create kurl", __func__);
+    abandon_readremote_tbs(d, dl, nx, sd, 1);
+    return KATCP_RESULT_FAIL;
+  }
+
+  j = find_job_katcp(dl, url->u_str);
+  if(j){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "found job for %s", url->u_str);
+    destroy_kurl_katcp(url);
+    abandon_readremote_tbs(d, dl, nx, sd, 1);
+    return KATCP_RESULT_FAIL;
+  }
+
+  j = run_child_process_tbs(dl, url, &subprocess_readremote_tbs, sd, nx);
+  if(j == NULL){
+    log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to run child process");
+    destroy_kurl_katcp(url);
+    abandon_readremote_tbs(d, dl, nx, sd, 1);
+    return KATCP_RESULT_FAIL;
+  }
+
+  log_message_katcp(d, KATCP_LEVEL_INFO, NULL, "awaiting connection on port %d to send %u bytes of %s", port, length, name);
+
+  return KATCP_RESULT_PAUSE;
+}
+
 /* unused ************************************************************************/
 
 #if 0
@@ -1133,6 +1484,11 @@ int upload_complete_tbs(struct katcp_dispatch *d, struct katcp_notice *n, void *
       destroy_port_data_tbs(d, pd, 1);
       return 0;
     }
+
+    if(programming_busy_tbs(d)){
+      destroy_port_data_tbs(d, pd, 1);
+      return 0;
+    }
    
     if(stop_fpga_tbs(d) < 0){
       destroy_port_data_tbs(d, pd, 1);
@@ -1214,6 +1570,10 @@ int upload_cmd(struct katcp_dispatch *d, int argc)
     return KATCP_RESULT_FAIL;
   }
 
+  if(programming_busy_tbs(d)){
+    return KATCP_RESULT_FAIL;
+  }
+
   nx = create_notice_katcp(d, TBS_FPGA_CONFIG, 0);
   if(nx == NULL){
     log_message_katcp(d, KATCP_LEVEL_ERROR, NULL, "unable to create notification logic to trigger when upload completes");